@@ -12,6 +12,7 @@
 #include "cls_tabular_utils.h"
 #include "cls_tabular_processing.h"
 
+#include <atomic>
 #include <errno.h>
 #include <string>
 #include <sstream>
@@ -27,6 +28,7 @@ CLS_NAME(tabular)
 
 cls_handle_t h_class;
 cls_method_handle_t h_exec_query_op;
+cls_method_handle_t h_exec_query_batch_op;
 cls_method_handle_t h_example_query_op;
 cls_method_handle_t h_test_query_op;
 cls_method_handle_t h_wasm_query_op;
@@ -35,11 +37,14 @@ cls_method_handle_t h_build_index;
 cls_method_handle_t h_exec_build_sky_index_op;
 cls_method_handle_t h_compact_arrow_tables_op;
 cls_method_handle_t h_transform_db_op;
+cls_method_handle_t h_repartition_arrow_table_op;
 cls_method_handle_t h_freelockobj_query_op;
 cls_method_handle_t h_inittable_group_obj_query_op;
 cls_method_handle_t h_getlockobj_query_op;
 cls_method_handle_t h_acquirelockobj_query_op;
 cls_method_handle_t h_createlockobj_query_op;
+cls_method_handle_t h_alloc_rid_block_op;
+cls_method_handle_t h_append_with_index_op;
 
 void cls_log_message(std::string msg, bool is_err = false, int log_level = 20) {
     if (is_err)
@@ -441,6 +446,114 @@ int exec_build_sky_index_op(cls_method_context_t hctx, bufferlist *in, bufferlis
     return 0;
 }
 
+/*
+ * Function: append_with_index_op
+ * Description: Append a wrapped fbmeta to the object along with the index
+ * entries of its rows, built by the loader while it built the data, so the
+ * object is never read back to index it. The fb gets the next fb_seq_num and
+ * its IDX_FB entry points to where it was appended; the IDX_RID/IDX_REC
+ * entries arrive sorted and are set in batches of idx_batch_size, with the
+ * marker key of each index. Method calls on an object are applied one at a
+ * time, so concurrent appends get distinct offsets and sequence numbers.
+ * @param[in] in   : encoded idx_append_op
+ * @param[out] out : unused
+ * Return Value: error code
+ */
+static
+int append_with_index_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+    idx_append_op op;
+    try {
+        bufferlist::const_iterator it = in->begin();
+        using ceph::decode;
+        decode(op, it);
+    } catch (const buffer::error &err) {
+        CLS_ERR("ERROR: cls_tabular:append_with_index_op: decoding idx_append_op");
+        return -EINVAL;
+    }
+    if (op.data.length() == 0 or op.idx_batch_size == 0)
+        return -EINVAL;
+
+    unsigned int fb_seq_num = Tables::DATASTRUCT_SEQ_NUM_MIN;
+    uint64_t off = 0;
+    int ret;
+    if (op.overwrite) {
+        // the old data is gone, and with it everything its omap indexed
+        if (cls_cxx_stat(hctx, NULL, NULL) == 0) {
+            ret = cls_cxx_map_clear(hctx);
+            if (ret < 0) {
+                CLS_ERR("ERROR: append_with_index_op: clearing omap %d", ret);
+                return ret;
+            }
+        }
+        ret = cls_cxx_write_full(hctx, &op.data);
+    }
+    else {
+        ret = get_fb_seq_num(hctx, fb_seq_num);
+        if (ret < 0) {
+            CLS_ERR("ERROR: append_with_index_op: fb_seq_num entry from xattr %d", ret);
+            return ret;
+        }
+        ret = cls_cxx_stat(hctx, &off, NULL);
+        if (ret == -ENOENT) {
+            off = 0;
+            ret = 0;
+        }
+        if (ret == 0)
+            ret = cls_cxx_write(hctx, off, op.data.length(), &op.data);
+    }
+    if (ret < 0) {
+        CLS_ERR("ERROR: append_with_index_op: writing data %d", ret);
+        return ret;
+    }
+    ++fb_seq_num;
+
+    // IDX_FB entry, the wrapped bl including its length prefix, as
+    // exec_build_sky_index_op records it
+    using ceph::encode;
+    std::string key_fb_prefix = Tables::buildKeyPrefix(Tables::SIT_IDX_FB,
+                                                       op.db_schema_name,
+                                                       op.table_name);
+    std::map<std::string, bufferlist> entries;
+    struct idx_fb_entry fb_ent(off, op.data.length());
+    encode(fb_ent, entries[key_fb_prefix +
+                           Tables::buildKeyData(Tables::SDT_INT32, fb_seq_num)]);
+
+    // IDX_RID/IDX_REC entries, in key order so each batch is a sorted run
+    for (auto it = op.rec_entries.begin(); it != op.rec_entries.end(); ++it) {
+        it->second.fb_num = fb_seq_num;
+        encode(it->second, entries[it->first]);
+        if (entries.size() >= op.idx_batch_size) {
+            ret = cls_cxx_map_set_vals(hctx, &entries);
+            if (ret < 0) {
+                CLS_ERR("append_with_index_op: error setting recs index entries %d", ret);
+                return ret;
+            }
+            entries.clear();
+        }
+    }
+
+    // LASTLY the marker keys, as exec_build_sky_index_op sets them
+    for (auto it = op.idx_prefixes.begin(); it != op.idx_prefixes.end(); ++it)
+        entries[*it].append("");
+    if (!entries.empty()) {
+        ret = cls_cxx_map_set_vals(hctx, &entries);
+        if (ret < 0) {
+            CLS_ERR("append_with_index_op: error setting index entries %d", ret);
+            return ret;
+        }
+    }
+
+    ret = set_fb_seq_num(hctx, fb_seq_num);
+    if (ret < 0) {
+        CLS_ERR("append_with_index_op: error setting fb_seq_num entry to xattr %d", ret);
+        return ret;
+    }
+    CLS_LOG(20, "append_with_index_op: fb_seq_num=%u off=%lu len=%u entries=%lu",
+            fb_seq_num, off, op.data.length(), op.rec_entries.size());
+    return 0;
+}
+
 /*
  * Build an index from the primary key (orderkey,linenum), insert to omap.
  * Index contains <k=primarykey, v=offset of row within BL>
@@ -1269,6 +1382,428 @@ int indexing_lookup(cls_method_context_t hctx, std::map<int, struct Tables::read
     return ret;
 }
 
+/*
+ * Function: process_query_blob
+ * Description: Applies the query to one data structure of the object, or
+ * passes it through as stored, and appends the result fbmeta to result_bl.
+ * @param[in] op           : the query op
+ * @param[in] passthru     : return the data as stored, without processing
+ * @param[in] data_schema  : the table schema
+ * @param[in] query_schema : the projection
+ * @param[in] query_preds  : predicates to apply
+ * @param[in] fbmeta       : the decoded data structure
+ * @param[in] row_nums     : rows selected by an index lookup, if any
+ * @param[out] result_bl   : output bufferlist
+ * Return Value: error code
+*/
+static
+int process_query_blob(
+    query_op& op,
+    bool passthru,
+    Tables::schema_vec& data_schema,
+    Tables::schema_vec& query_schema,
+    Tables::predicate_vec& query_preds,
+    Tables::sky_meta& fbmeta,
+    std::vector<unsigned int>& row_nums,
+    bufferlist& result_bl)
+{
+    using namespace Tables;
+    int ret = 0;
+
+    // debug/accounting
+    std::string errmsg;
+
+    // CREATE An FB_META, start with an empty builder first
+    flatbuffers::FlatBufferBuilder *fbmeta_builder =  \
+        new flatbuffers::FlatBufferBuilder();
+
+    // call associated process method based on ds type
+    switch (fbmeta.blob_format) {
+
+    case SFT_JSON: {
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_JSON");
+
+        sky_root root = \
+            Tables::getSkyRoot(fbmeta.blob_data,
+                               fbmeta.blob_size,
+                               fbmeta.blob_format);
+
+        // TODO: write json processing function,
+        // now we just pass thru the original
+        // meta.data_blob as the processed result data
+        char* orig_data = const_cast<char*>(fbmeta.blob_data);
+        size_t orig_size = fbmeta.blob_size;
+
+        // TODO: call processJSON() here. See below for similar
+        // function required here to get result data
+        char* result_data = orig_data;
+        size_t result_size = orig_size;
+
+        createFbMeta(fbmeta_builder,
+                     SFT_FLATBUF_FLEX_ROW,
+                     reinterpret_cast<unsigned char*>(
+                        result_data),
+                     result_size);
+        break;
+    }
+
+    case SFT_FLATBUF_FLEX_ROW: {
+
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_FLATBUF_FLEX_ROW");
+
+        int bldr_size = 1024;
+        flatbuffers::FlatBufferBuilder result_builder(bldr_size);
+
+        // temporary toggle for wasm execution testing
+        bool wasm = false;
+
+        if (wasm) {
+
+            if (op.debug)
+                CLS_LOG(20, "cls: exec_query_op: case SFT_FLATBUF_FLEX_ROW (wasm)");
+
+            // convert all params to native char or int types for wasm
+            char* bldrptr = reinterpret_cast<char*>(&result_builder);
+            std::string ds = schemaToString(data_schema);
+            std::string qs = schemaToString(query_schema);
+            std::string qp = predsToString(query_preds, data_schema);
+            int ERRMSG_MAX_LEN = 256;
+            char* errmsg_ptr = (char*) calloc(ERRMSG_MAX_LEN, sizeof(char));
+            int row_nums_size = static_cast<int>(row_nums.size());
+            int* row_nums_ptr = (int*) calloc(row_nums_size, sizeof(int));
+            std::copy(row_nums.begin(), row_nums.end(), row_nums_ptr);
+
+            ret = processSkyFbWASM(
+                    bldrptr,
+                    bldr_size,
+                    const_cast<char*>(ds.c_str()),
+                    ds.length(),
+                    const_cast<char*>(qs.c_str()),
+                    qs.length(),
+                    const_cast<char*>(qp.c_str()),
+                    qp.length(),
+                    const_cast<char*>(fbmeta.blob_data),
+                    fbmeta.blob_size,
+                    errmsg_ptr,
+                    ERRMSG_MAX_LEN,
+                    row_nums_ptr,
+                    row_nums_size);
+
+            errmsg.append(errmsg_ptr);
+            free(errmsg_ptr);
+            free(row_nums_ptr);
+        }
+        else {
+
+            // short circuit processing since select * query, or pushed back.
+            if (passthru) {
+
+            // just create a new fbmeta from the orig data blob.
+            createFbMeta(fbmeta_builder,
+                SFT_FLATBUF_FLEX_ROW,
+                reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
+                fbmeta.blob_size);
+            }
+            else {
+                // normal case, pass in cpp typed params
+                ret = processSkyFb(result_builder,
+                                   data_schema,
+                                   query_schema,
+                                   query_preds,
+                                   op.groupby_cols,
+                                   op.orderby_cols,
+                                   fbmeta.blob_data,
+                                   fbmeta.blob_size,
+                                   errmsg,
+                                   row_nums);
+
+
+                if (ret != 0) {
+                    CLS_ERR("ERROR: processSkyFb %s", errmsg.c_str());
+                    CLS_ERR("ERROR: TablesErrCodes::%d", ret);
+                    return -1;
+                }
+
+                createFbMeta(fbmeta_builder,
+                             SFT_FLATBUF_FLEX_ROW,
+                             reinterpret_cast<unsigned char*>(
+                                    result_builder.GetBufferPointer()),
+                                    result_builder.GetSize()
+                );
+            }
+        }
+        break;
+    }
+
+    case SFT_ARROW: {
+
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_ARROW");
+
+        // short circuit processing since select * query, or pushed back.
+        if (passthru) {
+
+        // just create a new fbmeta from the orig data blob.
+        createFbMeta(fbmeta_builder,
+            SFT_ARROW,
+            reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
+            fbmeta.blob_size);
+        }
+        else {
+            std::shared_ptr<arrow::Table> table;
+            ret = processArrowCol(&table,
+                                  data_schema,
+                                  query_schema,
+                                  query_preds,
+                                  op.groupby_cols,
+                                  op.orderby_cols,
+                                  fbmeta.blob_data,
+                                  fbmeta.blob_size,
+                                  errmsg,
+                                  row_nums);
+
+            if (ret != 0) {
+                CLS_ERR("ERROR: processArrowCol %s", errmsg.c_str());
+                CLS_ERR("ERROR: TablesErrCodes::%d", ret);
+                return -1;
+            }
+
+            std::shared_ptr<arrow::Buffer> buffer;
+            convert_arrow_to_buffer(table, &buffer);
+            createFbMeta(fbmeta_builder,
+                         SFT_ARROW,
+                         reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                         buffer->size());
+        }
+        break;
+    }
+
+    case SFT_PARQUET: {
+
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_PARQUET");
+
+        // short circuit processing since select * query, or pushed back.
+        if (passthru) {
+
+        // just create a new fbmeta from the orig data blob.
+        createFbMeta(fbmeta_builder,
+            SFT_PARQUET,
+            reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
+            fbmeta.blob_size);
+        }
+        else {
+            // the parquet blob is processed in-situ, the result set
+            // is returned as an arrow table.
+            std::shared_ptr<arrow::Table> table;
+            ret = processParquet(&table,
+                                 data_schema,
+                                 query_schema,
+                                 query_preds,
+                                 op.groupby_cols,
+                                 op.orderby_cols,
+                                 fbmeta.blob_data,
+                                 fbmeta.blob_size,
+                                 errmsg,
+                                 row_nums);
+
+            if (ret != 0) {
+                CLS_ERR("ERROR: processParquet %s", errmsg.c_str());
+                CLS_ERR("ERROR: TablesErrCodes::%d", ret);
+                return -1;
+            }
+
+            std::shared_ptr<arrow::Buffer> buffer;
+            convert_arrow_to_buffer(table, &buffer);
+            createFbMeta(fbmeta_builder,
+                         SFT_ARROW,
+                         reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                         buffer->size());
+        }
+        break;
+    }
+
+    case SFT_FLATBUF_UNION_COL: {
+
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_FLATBUF_UNION_COL");
+
+        // short circuit processing since select * query, or pushed back.
+        if (passthru) {
+
+        // just create a new fbmeta from the orig data blob.
+        createFbMeta(fbmeta_builder,
+            SFT_FLATBUF_UNION_COL,
+            reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
+            fbmeta.blob_size);
+        }
+        else {
+            // the encoded columns are processed in-situ, the result
+            // set is returned as an arrow table.
+            std::shared_ptr<arrow::Table> table;
+            ret = processSkyColFb(&table,
+                                  data_schema,
+                                  query_schema,
+                                  query_preds,
+                                  op.groupby_cols,
+                                  op.orderby_cols,
+                                  fbmeta.blob_data,
+                                  fbmeta.blob_size,
+                                  errmsg,
+                                  row_nums);
+
+            if (ret != 0) {
+                CLS_ERR("ERROR: processSkyColFb %s", errmsg.c_str());
+                CLS_ERR("ERROR: TablesErrCodes::%d", ret);
+                return -1;
+            }
+
+            std::shared_ptr<arrow::Buffer> buffer;
+            convert_arrow_to_buffer(table, &buffer);
+            createFbMeta(fbmeta_builder,
+                         SFT_ARROW,
+                         reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                         buffer->size());
+        }
+        break;
+    }
+
+    case SFT_FLATBUF_CSV_ROW:
+    case SFT_CSV: {
+
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SFT_CSV/SFT_FLATBUF_CSV_ROW");
+
+        // csv is parsed in-situ, only the fields the query needs are
+        // converted. clients do not read csv, so even when processing is
+        // short circuited the rows are returned as an arrow table.
+        std::shared_ptr<arrow::Table> table;
+        if (passthru) {
+            ret = transform_csv_to_arrow(fbmeta.blob_data,
+                                         fbmeta.blob_size,
+                                         fbmeta.blob_format,
+                                         data_schema,
+                                         errmsg,
+                                         &table);
+        }
+        else {
+            ret = processCsv(&table,
+                             data_schema,
+                             query_schema,
+                             query_preds,
+                             op.groupby_cols,
+                             op.orderby_cols,
+                             fbmeta.blob_data,
+                             fbmeta.blob_size,
+                             fbmeta.blob_format,
+                             errmsg,
+                             row_nums);
+        }
+
+        if (ret != 0) {
+            CLS_ERR("ERROR: processCsv %s", errmsg.c_str());
+            CLS_ERR("ERROR: TablesErrCodes::%d", ret);
+            return -1;
+        }
+
+        std::shared_ptr<arrow::Buffer> buffer;
+        convert_arrow_to_buffer(table, &buffer);
+        createFbMeta(fbmeta_builder,
+                     SFT_ARROW,
+                     reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                     buffer->size());
+        break;
+    }
+
+    case SFT_PG_TUPLE:
+    default:
+        if (op.debug)
+            CLS_LOG(20, "cls: exec_query_op: case SkyFormatTypeNotRecognized");
+        assert (SkyFormatTypeNotRecognized==0);
+        break;
+
+    } // end switch
+
+    // add meta_builder's data into the result bufferlist as char*
+    result_bl.append(reinterpret_cast<const char*>( \
+                     fbmeta_builder->GetBufferPointer()),
+                     fbmeta_builder->GetSize()
+    );
+
+    delete fbmeta_builder;
+
+    return 0;
+}
+
+// number of exec_query_op calls currently running in this osd, used to
+// shed load by pushing query processing back to the clients.
+static std::atomic<int> query_ops_in_flight(0);
+
+struct query_op_inflight {
+    int count;  // including this op
+    query_op_inflight() : count(++query_ops_in_flight) {}
+    ~query_op_inflight() { --query_ops_in_flight; }
+};
+
+/*
+ * Function: push_back_query
+ * Description: Decides whether to shed this query. When this osd is busy
+ * with more than op.pushback_threshold query ops, the query is split: the
+ * cheap comparison predicates are still applied here, to every column of
+ * the table, and the client applies the declined predicates, projection,
+ * groupby and orderby itself. A split is only made when all predicates are
+ * and-ed, otherwise, or when none are cheap, the blobs are returned as
+ * stored (like fastpath). Not done for index reads, whose row selection is
+ * only known here.
+ * @param[in] op          : the query op
+ * @param[in] inflight    : query ops running in this osd, including op
+ * @param[in] data_schema : the table schema
+ * @param[in] query_preds : the query predicates
+ * @param[out] osd_preds  : the predicates still applied here, if any
+ * @param[out] preds      : the declined predicates
+ * @param[out] reason     : the reason reported to the client
+ * Return Value: true if the query processing is pushed back
+*/
+static
+bool push_back_query(query_op& op,
+                     int inflight,
+                     Tables::schema_vec& data_schema,
+                     Tables::predicate_vec& query_preds,
+                     Tables::predicate_vec& osd_preds,
+                     std::string& preds,
+                     std::string& reason)
+{
+    using namespace Tables;
+
+    if (op.fastpath || op.index_read || op.pushback_threshold <= 0 ||
+        inflight <= op.pushback_threshold)
+        return false;
+
+    // or-ed predicates cannot be applied in parts
+    bool splittable = true;
+    for (auto p : query_preds)
+        splittable &= (p->chainOpType() == SOT_logical_and);
+
+    // regex matching and aggregates are left to the client
+    predicate_vec declined;
+    for (auto p : query_preds) {
+        if (splittable && !p->isGlobalAgg() && p->opType() != SOT_like)
+            osd_preds.push_back(p);
+        else
+            declined.push_back(p);
+    }
+
+    preds = osd_preds.empty() ? op.query_preds
+                              : predsToString(declined, data_schema);
+    reason = "osd busy: " + std::to_string(inflight) + " query ops in flight";
+    if (op.debug)
+        CLS_LOG(20, "exec_query_op: pushing back, %s, applying %lu of %lu preds",
+                reason.c_str(), osd_preds.size(), query_preds.size());
+    return true;
+}
+
 /*
  * Primary method to process queries
  */
@@ -1286,6 +1821,9 @@ int exec_query_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     // result set to be returned to client.
     bufferlist result_bl;
 
+    // counted for the whole call, whichever way it returns.
+    query_op_inflight inflight;
+
     // contains the serialized user request.
     query_op op;
 
@@ -1328,7 +1866,25 @@ int exec_query_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     if (ret < 0) {
         return ret;
     }
-    
+
+    // returns the blobs as stored if the query is fastpath or pushed back,
+    // or the rows of all columns passing the cheap predicates if only
+    // partly pushed back.
+    std::string push_back_preds;
+    std::string push_back_reason;
+    predicate_vec osd_preds;
+    bool pushed_back = push_back_query(op, inflight.count, data_schema,
+                                       query_preds, osd_preds,
+                                       push_back_preds, push_back_reason);
+    bool passthru = op.fastpath || (pushed_back && osd_preds.empty());
+    bool partial = pushed_back && !osd_preds.empty();
+    query_op part_op;
+    if (partial) {
+        part_op = op;
+        part_op.groupby_cols.clear();
+        part_op.orderby_cols.clear();
+    }
+
     // now we can decode and process each bl in the obj
     // loop over a list of reads() that may have come from an index lookup
     // or if no index lookup, then a single read with off=0 and len=0 to
@@ -1402,216 +1958,171 @@ int exec_query_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
                 CLS_LOG(20, "cls: exec_query_op: fbmeta.blob_compression=%d", fbmeta.blob_compression);
             }
 
-            // debug/accounting
-            std::string errmsg;
-
-            // CREATE An FB_META, start with an empty builder first
-            flatbuffers::FlatBufferBuilder *fbmeta_builder =  \
-                new flatbuffers::FlatBufferBuilder();
-
-            // call associated process method based on ds type
-            eval_start = getns();
-            switch (fbmeta.blob_format) {
-
-            case SFT_JSON: {
-                if (op.debug)
-                    CLS_LOG(20, "cls: exec_query_op: case SFT_JSON");
-
-                sky_root root = \
-                    Tables::getSkyRoot(fbmeta.blob_data,
-                                       fbmeta.blob_size,
-                                       fbmeta.blob_format);
+            // getSkyMeta decompresses blobs, arrow blobs are decompressed
+            // by the arrow reader.
+            if (fbmeta.blob_errcode) {
+                CLS_ERR("ERROR: exec_query_op: decompressing blob, compression=%d",
+                        fbmeta.blob_compression);
+                return -EINVAL;
+            }
 
-                // TODO: write json processing function,
-                // now we just pass thru the original
-                // meta.data_blob as the processed result data
-                char* orig_data = const_cast<char*>(fbmeta.blob_data);
-                size_t orig_size = fbmeta.blob_size;
+            ret = process_query_blob(partial ? part_op : op, passthru,
+                                     data_schema,
+                                     partial ? data_schema : query_schema,
+                                     partial ? osd_preds : query_preds,
+                                     fbmeta, row_nums, result_bl);
+            if (ret < 0)
+                return ret;
 
-                // TODO: call processJSON() here. See below for similar
-                // function required here to get result data
-                char* result_data = orig_data;
-                size_t result_size = orig_size;
+        } // end while itr>0
 
-                createFbMeta(fbmeta_builder,
-                             SFT_FLATBUF_FLEX_ROW,
-                             reinterpret_cast<unsigned char*>(
-                                result_data),
-                             result_size);
-                break;
-            }
+        eval_ns += getns() - eval_start; // add our processing time.
+    }  // end for reads
 
-            case SFT_FLATBUF_FLEX_ROW: {
-
-                if (op.debug)
-                    CLS_LOG(20, "cls: exec_query_op: case SFT_FLATBUF_FLEX_ROW");
-
-                int bldr_size = 1024;
-                flatbuffers::FlatBufferBuilder result_builder(bldr_size);
-
-                // temporary toggle for wasm execution testing
-                bool wasm = false;
-
-                if (wasm) {
-
-                    if (op.debug)
-                        CLS_LOG(20, "cls: exec_query_op: case SFT_FLATBUF_FLEX_ROW (wasm)");
-
-                    // convert all params to native char or int types for wasm
-                    char* bldrptr = reinterpret_cast<char*>(&result_builder);
-                    std::string ds = schemaToString(data_schema);
-                    std::string qs = schemaToString(query_schema);
-                    std::string qp = predsToString(query_preds, data_schema);
-                    int ERRMSG_MAX_LEN = 256;
-                    char* errmsg_ptr = (char*) calloc(ERRMSG_MAX_LEN, sizeof(char));
-                    int row_nums_size = static_cast<int>(row_nums.size());
-                    int* row_nums_ptr = (int*) calloc(row_nums_size, sizeof(int));
-                    std::copy(row_nums.begin(), row_nums.end(), row_nums_ptr);
-
-                    ret = processSkyFbWASM(
-                            bldrptr,
-                            bldr_size,
-                            const_cast<char*>(ds.c_str()),
-                            ds.length(),
-                            const_cast<char*>(qs.c_str()),
-                            qs.length(),
-                            const_cast<char*>(qp.c_str()),
-                            qp.length(),
-                            const_cast<char*>(fbmeta.blob_data),
-                            fbmeta.blob_size,
-                            errmsg_ptr,
-                            ERRMSG_MAX_LEN,
-                            row_nums_ptr,
-                            row_nums_size);
-
-                    errmsg.append(errmsg_ptr);
-                    free(errmsg_ptr);
-                    free(row_nums_ptr);
-                }
-                else {
+    if (op.debug)
+        CLS_LOG(20, "query_op.encoding result_bl size=%s", std::to_string(result_bl.length()).c_str());
 
-                    // short circuit processing since select * query.
-                    if (op.fastpath) {
+    cls_info info (read_ns, eval_ns, push_back_preds, push_back_reason);
 
-                    // just create a new fbmeta from the orig data blob.
-                    createFbMeta(fbmeta_builder,
-                        SFT_FLATBUF_FLEX_ROW,
-                        reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
-                        fbmeta.blob_size);
-                    }
-                    else {
-                        // normal case, pass in cpp typed params
-                        ret = processSkyFb(result_builder,
-                                           data_schema,
-                                           query_schema,
-                                           query_preds,
-                                           op.groupby_cols,
-                                           op.orderby_cols,
-                                           fbmeta.blob_data,
-                                           fbmeta.blob_size,
-                                           errmsg,
-                                           row_nums);
-
-
-                        if (ret != 0) {
-                            CLS_ERR("ERROR: processSkyFb %s", errmsg.c_str());
-                            CLS_ERR("ERROR: TablesErrCodes::%d", ret);
-                            return -1;
-                        }
+    // add both our cls info struct and our result bl to the output buffer.
+    using ceph::encode;
+    encode(info, *out);
+    encode(result_bl, *out);
 
-                        createFbMeta(fbmeta_builder,
-                                     SFT_FLATBUF_FLEX_ROW,
-                                     reinterpret_cast<unsigned char*>(
-                                            result_builder.GetBufferPointer()),
-                                            result_builder.GetSize()
-                        );
-                    }
-                }
-                break;
-            }
+    return 0;
+}
 
-            case SFT_ARROW: {
 
-                if (op.debug)
-                    CLS_LOG(20, "cls: exec_query_op: case SFT_ARROW");
 
-                // short circuit processing since select * query.
-                if (op.fastpath) {
+/*
+ * Function: exec_query_batch_op
+ * Description: Method to process several queries in one scan of the object.
+ * The object is read and each of its data structures decoded once, then
+ * every query of the batch is applied to it. The output holds a cls_info and
+ * a result bl per query, in batch order, each as exec_query_op returns them.
+ * Index reads cannot be batched since each needs its own reads.
+ * @param[in] hctx    : CLS method context
+ * @param[out] in     : input bufferlist
+ * @param[out] out    : output bufferlist
+ * Return Value: error code
+*/
+static
+int exec_query_batch_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+    int ret = 0;
 
-                // just create a new fbmeta from the orig data blob.
-                createFbMeta(fbmeta_builder,
-                    SFT_ARROW,
-                    reinterpret_cast<unsigned char*>(const_cast<char*>(fbmeta.blob_data)),
-                    fbmeta.blob_size);
-                }
-                else {
-                    std::shared_ptr<arrow::Table> table;
-                    ret = processArrowCol(&table,
-                                          data_schema,
-                                          query_schema,
-                                          query_preds,
-                                          op.groupby_cols,
-                                          op.orderby_cols,
-                                          fbmeta.blob_data,
-                                          fbmeta.blob_size,
-                                          errmsg,
-                                          row_nums);
-
-                    if (ret != 0) {
-                        CLS_ERR("ERROR: processArrowCol %s", errmsg.c_str());
-                        CLS_ERR("ERROR: TablesErrCodes::%d", ret);
-                        return -1;
-                    }
+    // counted once, a batch is a single scan.
+    query_op_inflight inflight;
 
-                    std::shared_ptr<arrow::Buffer> buffer;
-                    convert_arrow_to_buffer(table, &buffer);
-                    createFbMeta(fbmeta_builder,
-                                 SFT_ARROW,
-                                 reinterpret_cast<unsigned char*>(buffer->mutable_data()),
-                                 buffer->size());
-                }
-                break;
-            }
+    query_batch_op batch;
+    try {
+        bufferlist::const_iterator it = in->begin();
+        using ceph::decode;
+        decode(batch, it);
+    } catch (const buffer::error &err) {
+        CLS_ERR("ERROR: exec_query_batch_op: decoding query batch op failed");
+        return -EINVAL;
+    }
+    if (batch.ops.empty())
+        return -EINVAL;
 
-            case SFT_FLATBUF_CSV_ROW:
-            case SFT_PG_TUPLE:
-            case SFT_CSV:
-            default:
-                if (op.debug)
-                    CLS_LOG(20, "cls: exec_query_op: case SkyFormatTypeNotRecognized");
-                assert (SkyFormatTypeNotRecognized==0);
-                break;
+    using namespace Tables;
 
-            } // end switch
+    // the params of each query are parsed once for the whole object.
+    const size_t nops = batch.ops.size();
+    std::vector<schema_vec> data_schemas(nops);
+    std::vector<schema_vec> query_schemas(nops);
+    std::vector<predicate_vec> query_preds(nops);
+    std::vector<predicate_vec> osd_preds(nops);
+    std::vector<bool> passthru(nops);
+    std::vector<std::string> push_back_preds(nops);
+    std::vector<std::string> push_back_reasons(nops);
+    std::vector<uint64_t> eval_ns(nops, 0);
+    std::vector<bufferlist> result_bls(nops);
+    bool debug = false;
+
+    for (size_t i = 0; i < nops; i++) {
+        query_op& op = batch.ops[i];
+        if (op.index_read) {
+            CLS_ERR("ERROR: exec_query_batch_op: index reads cannot be batched");
+            return -EINVAL;
+        }
+        debug |= op.debug;
+        data_schemas[i] = schemaFromString(op.data_schema);
+        query_schemas[i] = schemaFromString(op.query_schema);
+        query_preds[i] = predsFromString(data_schemas[i], op.query_preds);
+        bool pushed_back = push_back_query(op, inflight.count,
+                                           data_schemas[i], query_preds[i],
+                                           osd_preds[i], push_back_preds[i],
+                                           push_back_reasons[i]);
+        passthru[i] = op.fastpath || (pushed_back && osd_preds[i].empty());
+        if (pushed_back && !osd_preds[i].empty()) {
+            // all the rows passing the cheap preds, as stored
+            op.groupby_cols.clear();
+            op.orderby_cols.clear();
+            query_schemas[i] = schemaFromString(op.data_schema);
+            query_preds[i] = osd_preds[i];
+        }
+    }
 
-            // add meta_builder's data into the result bufferlist as char*
-            result_bl.append(reinterpret_cast<const char*>( \
-                             fbmeta_builder->GetBufferPointer()),
-                             fbmeta_builder->GetSize()
-            );
+    if (debug)
+        CLS_LOG(20, "exec_query_batch_op %s", batch.toString().c_str());
 
-            delete fbmeta_builder;
+    // a single read of the entire object, shared by all the queries.
+    bufferlist b;
+    uint64_t read_start = getns();
+    ret = cls_cxx_read(hctx, 0, 0, &b);
+    if (ret < 0) {
+        CLS_ERR("ERROR: cls: exec_query_batch_op: %d reading obj", ret);
+        return ret;
+    }
+    uint64_t read_ns = getns() - read_start;
 
-        } // end while itr>0
+    std::vector<unsigned int> row_nums;  // no index lookups, all rows
+    ceph::bufferlist::const_iterator data_itr = b.begin();
+    while (data_itr.get_remaining() > 0) {
 
-        eval_ns += getns() - eval_start; // add our processing time.
-    }  // end for reads
+        bufferlist data;
+        try {
+            using ceph::decode;
+            decode(data, data_itr);
+        } catch (const buffer::error &err) {
+            CLS_ERR("ERROR: cls: exec_query_batch_op: decoding data from data_itr (ds sequence");
+            return -EINVAL;
+        }
 
-    if (op.debug)
-        CLS_LOG(20, "query_op.encoding result_bl size=%s", std::to_string(result_bl.length()).c_str());
+        // decoded (and decompressed) once, then read by every query.
+        sky_meta fbmeta = getSkyMeta(&data);
+        if (fbmeta.blob_errcode) {
+            CLS_ERR("ERROR: exec_query_batch_op: decompressing blob, compression=%d",
+                    fbmeta.blob_compression);
+            return -EINVAL;
+        }
 
-    cls_info info (read_ns, eval_ns, "", "");
+        for (size_t i = 0; i < nops; i++) {
+            uint64_t eval_start = getns();
+            ret = process_query_blob(batch.ops[i], passthru[i],
+                                     data_schemas[i], query_schemas[i],
+                                     query_preds[i], fbmeta, row_nums,
+                                     result_bls[i]);
+            if (ret < 0)
+                return ret;
+            eval_ns[i] += getns() - eval_start;
+        }
+    }
 
-    // add both our cls info struct and our result bl to the output buffer.
+    // the read is reported to each query, as it was done for each of them.
     using ceph::encode;
-    encode(info, *out);
-    encode(result_bl, *out);
+    for (size_t i = 0; i < nops; i++) {
+        cls_info info (read_ns, eval_ns[i], push_back_preds[i],
+                       push_back_reasons[i]);
+        encode(info, *out);
+        encode(result_bls[i], *out);
+    }
 
     return 0;
 }
 
-
-
 /*
  * Older test method to process queries a through f
  */
@@ -2026,6 +2537,11 @@ int exec_runstats_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
                 return -EINVAL;
             }
             sky_meta fbmeta = getSkyMeta(&data);
+            if (fbmeta.blob_errcode) {
+                CLS_ERR("ERROR: exec_runstats_op: decompressing blob, compression=%d",
+                        fbmeta.blob_compression);
+                return -EINVAL;
+            }
 
             CLS_LOG(20, "cls: exec_runstats_op: fbmeta.blob_format=%d", fbmeta.blob_format);
             CLS_LOG(20, "cls: exec_runstats_op: fbmeta.blob_data=0x%p", &fbmeta.blob_data[0]);
@@ -2342,6 +2858,7 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
     std::shared_ptr<arrow::Table> compacted_table;
     std::vector<std::shared_ptr<arrow::Table>> tables;
     bufferlist compacted_encoded_meta_bl;
+    CompressionType compression = none;  // keep the codec of the input tables
     while (it.get_remaining() > 0) {
         bufferlist bl;
         try {
@@ -2355,6 +2872,11 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
         // default usage here assumes the fbmeta is already in the bl
         sky_meta meta = getSkyMeta(&bl);
         std::string errmsg;
+        if (meta.blob_errcode) {
+            CLS_ERR("ERROR: compact_arrow_tables_op: decompressing blob, compression=%d",
+                    meta.blob_compression);
+            return -EINVAL;
+        }
 
         if (meta.blob_format != SFT_ARROW) {
             CLS_ERR("ERROR: Invalid data format=%s, expected Arrow", std::to_string(meta.blob_format).c_str());
@@ -2362,6 +2884,8 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
         }
 
         if (!meta.blob_deleted) {
+            compression = static_cast<CompressionType>(meta.blob_compression);
+
             // obtaining arrow table from blob data
             std::shared_ptr<arrow::Table> table;
             std::shared_ptr<arrow::Buffer> buffer = \
@@ -2382,7 +2906,7 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
     }
 
     std::shared_ptr<arrow::Buffer> buffer;
-    convert_arrow_to_buffer(compacted_table, &buffer);
+    convert_arrow_to_buffer(compacted_table, &buffer, compression);
 
     // CREATE An FB_META, start with an empty builder first
     flatbuffers::FlatBufferBuilder *meta_builder =  \
@@ -2391,7 +2915,9 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
     createFbMeta(meta_builder,
                  SFT_ARROW,
                  reinterpret_cast<unsigned char*>(buffer->mutable_data()),
-                 buffer->size());
+                 buffer->size(),
+                 false, 0, 0,
+                 compression);
 
     // Add meta_builder's data into a bufferlist as char*
     bufferlist meta_bl;
@@ -2413,6 +2939,198 @@ int compact_arrow_tables_op(cls_method_context_t hctx, bufferlist *in, bufferlis
     return 0;
 }
 
+/*
+ * Function: encode_arrow_tables_as_fbmetas
+ * Description: Append each arrow table as an encoded SFT_ARROW fbmeta to bl,
+ * i.e., the same object layout written by the other methods.
+ * @param[in] tables      : arrow tables to encode
+ * @param[out] bl         : output bufferlist
+ * @param[in] compression : codec for the arrow ipc buffers
+ * Return Value: none
+*/
+static
+void encode_arrow_tables_as_fbmetas(
+    std::vector<std::shared_ptr<arrow::Table>>& tables,
+    bufferlist& bl,
+    CompressionType compression)
+{
+    using namespace Tables;
+    for (auto it = tables.begin(); it != tables.end(); ++it) {
+        std::shared_ptr<arrow::Buffer> buffer;
+        convert_arrow_to_buffer(*it, &buffer, compression);
+
+        // CREATE An FB_META, start with an empty builder first
+        flatbuffers::FlatBufferBuilder *meta_builder = \
+            new flatbuffers::FlatBufferBuilder();
+        createFbMeta(meta_builder,
+                     SFT_ARROW,
+                     reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                     buffer->size(),
+                     false, 0, 0,
+                     compression);
+
+        // Add meta_builder's data into a bufferlist as char*
+        bufferlist meta_bl;
+        meta_bl.append(reinterpret_cast<const char*>(
+                        meta_builder->GetBufferPointer()),
+                        meta_builder->GetSize());
+        using ceph::encode;
+        encode(meta_bl, bl);
+        delete meta_builder;
+    }
+}
+
+/*
+ * Function: repartition_arrow_table_op
+ * Description: Method to repartition the Arrow tables of an object.
+ * All non-deleted tables in the object are concatenated, then either hash
+ * partitioned by key into op.num_objs destination parts that are returned to
+ * the client as a map of destination number to encoded fbmetas of the
+ * destination table op.table_name, or, if
+ * op.num_objs is 0, rewritten in place as tables of at most op.batch_rows.
+ * @param[in] hctx    : CLS method context
+ * @param[out] in     : input bufferlist
+ * @param[out] out    : output bufferlist
+ * Return Value: error code
+*/
+static
+int repartition_arrow_table_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+    repartition_op op;
+
+    // unpack the requested op from the inbl.
+    try {
+        bufferlist::const_iterator it = in->begin();
+        using ceph::decode;
+        decode(op, it);
+    } catch (const buffer::error &err) {
+        CLS_ERR("ERROR: cls_tabular:repartition_arrow_table_op: decoding repartition_op");
+        return -EINVAL;
+    }
+
+    CLS_LOG(20, "repartition_arrow_table_op: op=%s", op.toString().c_str());
+
+    // Object is sequence of actual data along with encoded metadata
+    bufferlist encoded_meta_bls;
+    int ret = cls_cxx_read(hctx, 0, 0, &encoded_meta_bls);
+    if (ret < 0) {
+        CLS_ERR("ERROR: repartition_arrow_table_op: reading obj. %d", ret);
+        return ret;
+    }
+
+    using namespace Tables;
+    std::vector<std::shared_ptr<arrow::Table>> tables;
+    std::list<bufferlist> table_bls;  // keeps the wrapped arrow data alive
+    CompressionType compression = none;  // keep the codec of the input tables
+    ceph::bufferlist::const_iterator it = encoded_meta_bls.begin();
+    while (it.get_remaining() > 0) {
+        table_bls.emplace_back();
+        bufferlist& bl = table_bls.back();
+        try {
+            using ceph::decode;
+            decode(bl, it);  // unpack the next bl
+        } catch (const buffer::error &err) {
+            CLS_ERR("ERROR: decoding object format from BL");
+            return -EINVAL;
+        }
+
+        // default usage here assumes the fbmeta is already in the bl
+        sky_meta meta = getSkyMeta(&bl);
+        if (meta.blob_errcode) {
+            CLS_ERR("ERROR: repartition_arrow_table_op: decompressing blob, compression=%d",
+                    meta.blob_compression);
+            return -EINVAL;
+        }
+        if (meta.blob_format != SFT_ARROW) {
+            CLS_ERR("ERROR: Invalid data format=%s, expected Arrow", std::to_string(meta.blob_format).c_str());
+            return -EINVALID_COMPACTION_FORMAT;
+        }
+        if (meta.blob_deleted)
+            continue;
+        compression = static_cast<CompressionType>(meta.blob_compression);
+
+        std::shared_ptr<arrow::Table> table;
+        std::shared_ptr<arrow::Buffer> buffer = \
+            arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(meta.blob_data)), meta.blob_size);
+        extract_arrow_from_buffer(&table, buffer);
+        tables.push_back(table);
+    }
+
+    std::map<uint64_t, bufferlist> parts;
+    if (tables.empty()) {
+        CLS_LOG(20, "repartition_arrow_table_op: no tables in obj");
+        if (op.num_objs > 0) {
+            using ceph::encode;
+            encode(parts, *out);
+        }
+        return 0;
+    }
+
+    std::shared_ptr<arrow::Table> table;
+    arrow::Result<std::shared_ptr<arrow::Table>> result = arrow::ConcatenateTables(tables);
+    if (!result.ok()) {
+        CLS_ERR("ERROR: arrow::ConcatenateTables returned bad result\n");
+        return -EINVAL;
+    }
+    table = std::move(result).ValueOrDie();
+    int64_t max_rows = op.batch_rows > 0 ? static_cast<int64_t>(op.batch_rows)
+                                         : std::max<int64_t>(1, table->num_rows());
+
+    // rebatch in place
+    if (op.num_objs == 0) {
+        std::vector<std::shared_ptr<arrow::Table>> batches;
+        ret = split_arrow_table(table, max_rows, &batches);
+        if (ret != 0) {
+            CLS_ERR("ERROR: repartition_arrow_table_op: split_arrow_table %d", ret);
+            return -EINVAL;
+        }
+        bufferlist rebatched_bl;
+        encode_arrow_tables_as_fbmetas(batches, rebatched_bl, compression);
+
+        // cls_cxx_replace truncates the original object and writes full object.
+        ret = cls_cxx_replace(hctx, 0, rebatched_bl.length(), &rebatched_bl);
+        if (ret < 0) {
+            CLS_ERR("ERROR: repartition_arrow_table_op: cls_cxx_replace: writing obj full %d", ret);
+            return ret;
+        }
+        return 0;
+    }
+
+    // hash partition and return each destination's fbmetas to the client
+    std::map<uint64_t, std::shared_ptr<arrow::Table>> part_map;
+    ret = hash_partition_arrow_table(table, op.num_objs, &part_map);
+    if (ret != 0) {
+        CLS_ERR("ERROR: repartition_arrow_table_op: hash_partition_arrow_table %d", ret);
+        return -EINVAL;
+    }
+    for (auto pit = part_map.begin(); pit != part_map.end(); ++pit) {
+
+        // the parts belong to the destination table
+        auto orig_metadata = pit->second->schema()->metadata();
+        std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
+        for (int64_t i = 0; i < orig_metadata->size(); i++) {
+            if (orig_metadata->key(i) == ToString(METADATA_TABLE_NAME))
+                metadata->Append(orig_metadata->key(i), op.table_name);
+            else
+                metadata->Append(orig_metadata->key(i), orig_metadata->value(i));
+        }
+        pit->second = pit->second->ReplaceSchemaMetadata(metadata);
+
+        std::vector<std::shared_ptr<arrow::Table>> batches;
+        ret = split_arrow_table(pit->second, max_rows, &batches);
+        if (ret != 0) {
+            CLS_ERR("ERROR: repartition_arrow_table_op: split_arrow_table %d", ret);
+            return -EINVAL;
+        }
+        encode_arrow_tables_as_fbmetas(batches, parts[pit->first], compression);
+    }
+
+    CLS_LOG(20, "repartition_arrow_table_op: num parts=%lu", parts.size());
+    using ceph::encode;
+    encode(parts, *out);
+    return 0;
+}
+
 /*
  * Function: transform_db_op
  * Description: Method to convert database format.
@@ -2470,6 +3188,11 @@ int transform_db_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
         // default usage here assumes the fbmeta is already in the bl
         sky_meta meta = getSkyMeta(&bl);
         std::string errmsg;
+        if (meta.blob_errcode) {
+            CLS_ERR("ERROR: transform_db_op: decompressing blob, compression=%d",
+                    meta.blob_compression);
+            return -EINVAL;
+        }
 
         // Check if transformation is required or not
         if (meta.blob_format == op.required_type) {
@@ -2495,12 +3218,15 @@ int transform_db_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 
             // Convert arrow to a buffer
             std::shared_ptr<arrow::Buffer> buffer;
-            convert_arrow_to_buffer(table, &buffer);
+            CompressionType compression = static_cast<CompressionType>(op.compression);
+            convert_arrow_to_buffer(table, &buffer, compression);
 
             createFbMeta(meta_builder,
                          SFT_ARROW,
                          reinterpret_cast<unsigned char*>(buffer->mutable_data()),
-                         buffer->size());
+                         buffer->size(),
+                         false, 0, 0,
+                         compression);
 
         } else if (op.required_type == SFT_FLATBUF_FLEX_ROW) {
             flatbuffers::FlatBufferBuilder flatbldr(1024);  // pre-alloc sz
@@ -2514,7 +3240,68 @@ int transform_db_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
                          SFT_FLATBUF_FLEX_ROW,
                          reinterpret_cast<unsigned char*>(
                                  flatbldr.GetBufferPointer()),
-                         flatbldr.GetSize());
+                         flatbldr.GetSize(),
+                         false, 0, 0,
+                         static_cast<CompressionType>(op.compression));
+        } else if (op.required_type == SFT_PARQUET) {
+            std::shared_ptr<arrow::Table> table;
+            if (meta.blob_format == SFT_ARROW) {
+                std::shared_ptr<arrow::Buffer> src =                    \
+                    arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(meta.blob_data)), meta.blob_size);
+                ret = extract_arrow_from_buffer(&table, src);
+            } else {
+                ret = transform_fb_to_arrow(meta.blob_data, meta.blob_size,
+                                            query_schema, errmsg, &table);
+            }
+            if (ret != 0) {
+                CLS_ERR("ERROR: transforming object to arrow for parquet");
+                return ret;
+            }
+
+            // Row groups carry the min/max stats used to skip data at query time
+            std::shared_ptr<arrow::Buffer> buffer;
+            ret = convert_arrow_to_parquet_buffer(table, PARQUET_ROW_GROUP_ROWS, &buffer);
+            if (ret != 0) {
+                CLS_ERR("ERROR: converting arrow to parquet");
+                return ret;
+            }
+
+            createFbMeta(meta_builder,
+                         SFT_PARQUET,
+                         reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                         buffer->size(),
+                         false, 0, 0,
+                         static_cast<CompressionType>(op.compression));
+        } else if (op.required_type == SFT_FLATBUF_UNION_COL) {
+            std::shared_ptr<arrow::Table> table;
+            if (meta.blob_format == SFT_ARROW) {
+                std::shared_ptr<arrow::Buffer> src =                    \
+                    arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(meta.blob_data)), meta.blob_size);
+                ret = extract_arrow_from_buffer(&table, src);
+            } else {
+                ret = transform_fb_to_arrow(meta.blob_data, meta.blob_size,
+                                            query_schema, errmsg, &table);
+            }
+            if (ret != 0) {
+                CLS_ERR("ERROR: transforming object to arrow for encoded columns");
+                return ret;
+            }
+
+            // each column is encoded with the smallest applicable encoding
+            flatbuffers::FlatBufferBuilder flatbldr(1024);  // pre-alloc sz
+            ret = transform_arrow_to_skycol(table, errmsg, flatbldr);
+            if (ret != 0) {
+                CLS_ERR("ERROR: transforming arrow to encoded columns %s", errmsg.c_str());
+                return ret;
+            }
+
+            createFbMeta(meta_builder,
+                         SFT_FLATBUF_UNION_COL,
+                         reinterpret_cast<unsigned char*>(
+                                 flatbldr.GetBufferPointer()),
+                         flatbldr.GetSize(),
+                         false, 0, 0,
+                         static_cast<CompressionType>(op.compression));
         }
 
         // Add meta_builder's data into a bufferlist as char*
@@ -2901,6 +3688,73 @@ int lock_obj_acquire_op(cls_method_context_t hctx, bufferlist *in, bufferlist *o
     encode(op_out, *out);
     return 0;
 }
+/*
+ * Function: alloc_rid_block_op
+ * Description: Hand out the next block of RIDs of a table. The next free
+ * RID of each table is kept in omap, method calls on an object are applied
+ * one at a time so concurrent loaders always get disjoint blocks. RIDs
+ * start at 1.
+ * @param[in] in   : encoded rid_alloc_op
+ * @param[out] out : encoded first RID of the block (uint64_t)
+ * Return Value: error code
+ */
+static
+int alloc_rid_block_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+    rid_alloc_op op;
+    try {
+        bufferlist::const_iterator it = in->begin();
+        using ceph::decode;
+        decode(op, it);
+    } catch (const buffer::error &err) {
+        CLS_ERR("ERROR: cls_tabular:alloc_rid_block_op: decoding rid_alloc_op");
+        return -EINVAL;
+    }
+    if (op.count == 0)
+        return -EINVAL;
+
+    const std::string key = "rid_next." + op.table_name;
+    uint64_t next = 1;
+    bufferlist bl;
+    int ret = cls_cxx_map_get_val(hctx, key, &bl);
+    if (ret == 0) {
+        try {
+            bufferlist::const_iterator it = bl.begin();
+            using ceph::decode;
+            decode(next, it);
+        } catch (const buffer::error &err) {
+            CLS_ERR("ERROR: cls_tabular:alloc_rid_block_op: decoding %s", key.c_str());
+            return -EINVAL;
+        }
+    }
+    else if (ret != -ENOENT) {
+        CLS_ERR("ERROR: alloc_rid_block_op: reading %s %d", key.c_str(), ret);
+        return ret;
+    }
+    if (next > UINT64_MAX - op.count)
+        return -ERANGE;
+
+    if (cls_cxx_stat(hctx, NULL, NULL) < 0) {
+        ret = cls_cxx_create(hctx, false);
+        if (ret < 0)
+            return ret;
+    }
+
+    using ceph::encode;
+    std::map<std::string, bufferlist> vals;
+    encode(next + op.count, vals[key]);
+    ret = cls_cxx_map_set_vals(hctx, &vals);
+    if (ret < 0) {
+        CLS_ERR("ERROR: alloc_rid_block_op: writing %s %d", key.c_str(), ret);
+        return ret;
+    }
+    CLS_LOG(20, "alloc_rid_block_op: table=%s rids=%lu+%lu",
+            op.table_name.c_str(), next, op.count);
+
+    encode(next, *out);
+    return 0;
+}
+
 void __cls_init()
 {
   CLS_LOG(20, "Loaded tabular class!");
@@ -2910,6 +3764,9 @@ void __cls_init()
   cls_register_cxx_method(h_class, "exec_query_op",
       CLS_METHOD_RD, exec_query_op, &h_exec_query_op);
 
+  cls_register_cxx_method(h_class, "exec_query_batch_op",
+      CLS_METHOD_RD, exec_query_batch_op, &h_exec_query_batch_op);
+
   cls_register_cxx_method(h_class, "test_query_op",
       CLS_METHOD_RD, test_query_op, &h_test_query_op);
 
@@ -2934,6 +3791,9 @@ void __cls_init()
   cls_register_cxx_method(h_class, "transform_db_op",
       CLS_METHOD_RD | CLS_METHOD_WR, transform_db_op, &h_transform_db_op);
 
+  cls_register_cxx_method(h_class, "repartition_arrow_table_op",
+      CLS_METHOD_RD | CLS_METHOD_WR, repartition_arrow_table_op, &h_repartition_arrow_table_op);
+
   cls_register_cxx_method(h_class, "lock_obj_init_op",
       CLS_METHOD_PROMOTE | CLS_METHOD_WR, lock_obj_init_op, &h_inittable_group_obj_query_op);
 
@@ -2948,5 +3808,11 @@ void __cls_init()
 
   cls_register_cxx_method(h_class, "lock_obj_create_op",
       CLS_METHOD_RD | CLS_METHOD_WR, lock_obj_create_op, &h_createlockobj_query_op);
+
+  cls_register_cxx_method(h_class, "alloc_rid_block_op",
+      CLS_METHOD_RD | CLS_METHOD_WR, alloc_rid_block_op, &h_alloc_rid_block_op);
+
+  cls_register_cxx_method(h_class, "append_with_index_op",
+      CLS_METHOD_RD | CLS_METHOD_WR, append_with_index_op, &h_append_with_index_op);
 }
 
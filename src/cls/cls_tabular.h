@@ -79,7 +79,8 @@ enum SkyFormatType {
     SFT_PYARROW_BINARY,
     SFT_HDF5,
     SFT_EXAMPLE_FORMAT,
-    SFT_ANY
+    SFT_ANY,
+    SFT_ARROW_STREAM
 };
 
 
@@ -98,16 +99,29 @@ inline int sky_format_type_from_string (std::string type) {
     if (type == "SFT_HDF5")              return SFT_HDF5;
     if (type == "SFT_JSON")              return SFT_JSON;
     if (type == "SFT_EXAMPLE_FORMAT")    return SFT_EXAMPLE_FORMAT;
+    if (type == "SFT_ARROW_STREAM")      return SFT_ARROW_STREAM;
     return 0;   // format unrecognized
 }
 
+// compression codec of a data blob inside an fb_meta.
+// for SFT_ARROW blobs the codec is applied to the arrow ipc buffers instead
+// of the whole blob, so arrow readers decompress them transparently.
 enum CompressionType {
     none = 0,
-    // lzw,  TODO: placeholder, not yet supported.
-    // bz2,
+    lz4,
+    zstd,
+    // bz2,  TODO: placeholder, not yet supported.
     // etc.
 };
 
+inline int compression_type_from_string (std::string type) {
+    std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+    if (type == "none")  return none;
+    if (type == "lz4")   return lz4;
+    if (type == "zstd")  return zstd;
+    return -1;  // compression unrecognized
+}
+
 struct testencode {
 
     string s;
@@ -151,8 +165,10 @@ struct query_op {
   std::string orderby_cols;
   std::string index_preds;
   std::string index2_preds;
+  int pushback_threshold;  // max query ops in flight on the osd before
+                           // processing is pushed back to the client, 0=never
 
-  query_op() {}
+  query_op() : pushback_threshold(0) {}
 
   // serialize the fields into bufferlist to be sent over the wire
   void encode(bufferlist& bl) const {
@@ -178,6 +194,7 @@ struct query_op {
     encode(orderby_cols, bl);
     encode(index_preds, bl);
     encode(index2_preds, bl);
+    encode(pushback_threshold, bl);
   }
 
   // deserialize the fields from the bufferlist into this struct
@@ -204,6 +221,10 @@ struct query_op {
     decode(orderby_cols, bl);
     decode(index_preds, bl);
     decode(index2_preds, bl);
+    // older clients do not send it
+    pushback_threshold = 0;
+    if (!bl.end())
+        decode(pushback_threshold, bl);
   }
 
   std::string toString() {
@@ -228,11 +249,42 @@ struct query_op {
     s.append(" .orderby_cols=" + orderby_cols);
     s.append(" .index_preds=" + index_preds);
     s.append(" .index2_preds=" + index2_preds);
+    s.append(" .pushback_threshold=" + std::to_string(pushback_threshold));
     return s;
   }
 };
 WRITE_CLASS_ENCODER(query_op)
 
+// queries over the same table, evaluated in a single scan of the object.
+// results come back as one cls_info and result bl per query, in order.
+struct query_batch_op {
+  std::vector<query_op> ops;
+
+  query_batch_op() {}
+
+  // serialize the fields into bufferlist to be sent over the wire
+  void encode(bufferlist& bl) const {
+    using ceph::encode;
+    encode(ops, bl);
+  }
+
+  // deserialize the fields from the bufferlist into this struct
+  void decode(bufferlist::const_iterator &bl) {
+    using ceph::decode;
+    decode(ops, bl);
+  }
+
+  std::string toString() {
+    std::string s;
+    s.append("query_batch_op:");
+    s.append(" .ops.size=" + std::to_string(ops.size()));
+    for (auto& op : ops)
+      s.append(" [" + op.toString() + "]");
+    return s;
+  }
+};
+WRITE_CLASS_ENCODER(query_batch_op)
+
 struct test_op {
 
   // query parameters (old)
@@ -352,10 +404,13 @@ struct transform_op {
   std::string table_name;
   std::string query_schema;
   int required_type;
+  int compression;
 
-  transform_op() {}
-  transform_op(std::string tname, std::string qrscma, int req_type) :
-    table_name(tname), query_schema(qrscma), required_type(req_type) { }
+  transform_op() : compression(none) {}
+  transform_op(std::string tname, std::string qrscma, int req_type,
+               int _compression=none) :
+    table_name(tname), query_schema(qrscma), required_type(req_type),
+    compression(_compression) { }
 
   // serialize the fields into bufferlist to be sent over the wire
   void encode(bufferlist& bl) const {
@@ -363,6 +418,7 @@ struct transform_op {
     encode(table_name, bl);
     encode(query_schema, bl);
     encode(required_type, bl);
+    encode(compression, bl);
   }
 
   // deserialize the fields from the bufferlist into this struct
@@ -371,6 +427,10 @@ struct transform_op {
     decode(table_name, bl);
     decode(query_schema, bl);
     decode(required_type, bl);
+    // older clients do not send it
+    compression = none;
+    if (!bl.end())
+        decode(compression, bl);
   }
 
   std::string toString() {
@@ -379,11 +439,54 @@ struct transform_op {
     s.append(" .table_name=" + table_name);
     s.append(" .query_schema=" + query_schema);
     s.append(" .required_type=" + std::to_string(required_type));
+    s.append(" .compression=" + std::to_string(compression));
     return s;
   }
 };
 WRITE_CLASS_ENCODER(transform_op)
 
+// used to rewrite the arrow tables of an object for repartitioning.
+// if num_objs > 0 the rows are hash partitioned by key into num_objs
+// destination parts of the table table_name which are returned to the
+// client, else the object is rebatched in place into tables of at most
+// batch_rows.
+struct repartition_op {
+
+  std::string table_name;
+  uint64_t num_objs;
+  uint64_t batch_rows;
+
+  repartition_op() {}
+  repartition_op(std::string tname, uint64_t nobjs, uint64_t brows) :
+    table_name(tname), num_objs(nobjs), batch_rows(brows) { }
+
+  // serialize the fields into bufferlist to be sent over the wire
+  void encode(bufferlist& bl) const {
+    using ceph::encode;
+    encode(table_name, bl);
+    encode(num_objs, bl);
+    encode(batch_rows, bl);
+  }
+
+  // deserialize the fields from the bufferlist into this struct
+  void decode(bufferlist::const_iterator &bl) {
+    using ceph::decode;
+    decode(table_name, bl);
+    decode(num_objs, bl);
+    decode(batch_rows, bl);
+  }
+
+  std::string toString() {
+    std::string s;
+    s.append("repartition_op:");
+    s.append(" .table_name=" + table_name);
+    s.append(" .num_objs=" + std::to_string(num_objs));
+    s.append(" .batch_rows=" + std::to_string(batch_rows));
+    return s;
+  }
+};
+WRITE_CLASS_ENCODER(repartition_op)
+
 // holds an omap entry containing flatbuffer location
 // this entry type contains physical location info
 // idx_key = idx_prefix + fb sequence number (int)
@@ -399,6 +502,7 @@ struct idx_fb_entry {
     void encode(bufferlist& bl) const {
         using ceph::encode;
         encode(off, bl);
+        encode(len, bl);
     }
 
     void decode(bufferlist::const_iterator &bl) {
@@ -903,13 +1007,108 @@ struct lockobj_info {
 };
 WRITE_CLASS_ENCODER(lockobj_info)
 
+// allocates a block of count RIDs of a table from a counter kept in the
+// omap of a table metadata object, so loaders running in parallel get
+// disjoint RIDs. the reply is the first RID of the block.
+struct rid_alloc_op {
+
+  std::string table_name;
+  uint64_t count;
+
+  rid_alloc_op() {}
+  rid_alloc_op(std::string tname, uint64_t cnt) :
+    table_name(tname), count(cnt) { }
+
+  // serialize the fields into bufferlist to be sent over the wire
+  void encode(bufferlist& bl) const {
+    using ceph::encode;
+    encode(table_name, bl);
+    encode(count, bl);
+  }
+
+  // deserialize the fields from the bufferlist into this struct
+  void decode(bufferlist::const_iterator &bl) {
+    using ceph::decode;
+    decode(table_name, bl);
+    decode(count, bl);
+  }
+
+  std::string toString() {
+    std::string s;
+    s.append("rid_alloc_op:");
+    s.append(" .table_name=" + table_name);
+    s.append(" .count=" + std::to_string(count));
+    return s;
+  }
+};
+WRITE_CLASS_ENCODER(rid_alloc_op)
+
+// appends one wrapped fbmeta to an object together with its IDX_RID/IDX_REC
+// entries, computed by the loader while it built the data. the fb_num of the
+// entries and the IDX_FB entry are set by the osd, which knows the fb
+// sequence number and offset of the appended data.
+struct idx_append_op {
+
+  bufferlist data;           // encoded bl wrapping the fbmeta, as appended
+  std::string db_schema_name;
+  std::string table_name;
+  bool overwrite;            // replace the object data and its omap
+  uint32_t idx_batch_size;
+  std::map<std::string, idx_rec_entry> rec_entries;  // sorted by key
+  std::vector<std::string> idx_prefixes;  // marker keys of the indexes
+
+  idx_append_op() {}
+  idx_append_op(std::string dbname, std::string tname, bool ow,
+                uint32_t batch_size) :
+    db_schema_name(dbname), table_name(tname), overwrite(ow),
+    idx_batch_size(batch_size) { }
+
+  // serialize the fields into bufferlist to be sent over the wire
+  void encode(bufferlist& bl) const {
+    using ceph::encode;
+    encode(data, bl);
+    encode(db_schema_name, bl);
+    encode(table_name, bl);
+    encode(overwrite, bl);
+    encode(idx_batch_size, bl);
+    encode(rec_entries, bl);
+    encode(idx_prefixes, bl);
+  }
+
+  // deserialize the fields from the bufferlist into this struct
+  void decode(bufferlist::const_iterator &bl) {
+    using ceph::decode;
+    decode(data, bl);
+    decode(db_schema_name, bl);
+    decode(table_name, bl);
+    decode(overwrite, bl);
+    decode(idx_batch_size, bl);
+    decode(rec_entries, bl);
+    decode(idx_prefixes, bl);
+  }
+
+  std::string toString() {
+    std::string s;
+    s.append("idx_append_op:");
+    s.append(" .data.length=" + std::to_string(data.length()));
+    s.append(" .db_schema_name=" + db_schema_name);
+    s.append(" .table_name=" + table_name);
+    s.append(" .overwrite=" + std::to_string(overwrite));
+    s.append(" .idx_batch_size=" + std::to_string(idx_batch_size));
+    s.append(" .rec_entries=" + std::to_string(rec_entries.size()));
+    s.append(" .idx_prefixes=" + std::to_string(idx_prefixes.size()));
+    return s;
+  }
+};
+WRITE_CLASS_ENCODER(idx_append_op)
+
 // Used to collect runtime information in CLS during processing tasks.
 struct cls_info {
   uint64_t rows_processed;
   uint64_t read_ns;
   uint64_t eval_ns;
-  std::string push_back_predicates;
-  std::string push_back_reason;
+  std::string push_back_predicates;  // preds the osd declined to apply
+  std::string push_back_reason;      // empty unless processing was declined
 
   cls_info() {}
   cls_info(
@@ -10,6 +10,13 @@
 
 #include "cls_tabular_processing.h"
 #include <algorithm>
+#include <set>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 namespace Tables {
@@ -586,6 +593,43 @@ int processArrowCol(
         const size_t datasz,
         std::string& errmsg,
         const std::vector<uint32_t>& row_nums)
+{
+    std::shared_ptr<arrow::Buffer> buffer =                             \
+        arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(dataptr)), datasz);
+    std::shared_ptr<arrow::Table> input_table;
+
+    // Get input table from dataptr
+    extract_arrow_from_buffer(&input_table, buffer);
+
+    return processArrowCol(table, tbl_schema, query_schema, preds,
+                           groupby_cols, orderby_cols, input_table,
+                           errmsg, row_nums);
+}
+
+/*
+ * Function: processArrowCol
+ * Description: Process the given arrow table columnwise for the corresponding
+ *              query and encapsulate the output in an output arrow table.
+ * @param[out] table       :  Ouput arrow table containing result set.
+ * @param[in] tbl_schema   : Schema of an input table
+ * @param[in] query_schema : Schema of an query
+ * @param[in] preds        : Predicates for the query
+ * @param[in] input_table  : Input arrow table
+ * @param[out] errmsg      : Error message
+ * @param[out] row_nums    : Specified rows to be processed
+ *
+ * Return Value: error code
+ */
+int processArrowCol(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        std::shared_ptr<arrow::Table>& input_table,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums)
 {
    int errcode = 0;
     int processed_rows = 0;
@@ -594,14 +638,8 @@ int processArrowCol(
     std::vector<arrow::ArrayBuilder *> builder_list;
     std::vector<std::shared_ptr<arrow::Array>> array_list;
     std::vector<std::shared_ptr<arrow::Field>> output_tbl_fields_vec;
-    std::shared_ptr<arrow::Buffer> buffer =                             \
-        arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(dataptr)), datasz);
-    std::shared_ptr<arrow::Table> input_table, temp_table;
     std::vector<uint32_t> result_rows;
 
-    // Get input table from dataptr
-    extract_arrow_from_buffer(&input_table, buffer);
-
     auto schema = input_table->schema();
     auto metadata = schema->metadata();
     uint32_t nrows = atoi(metadata->value(METADATA_NUM_ROWS).c_str());
@@ -1275,9 +1313,9 @@ int processArrowCol(
     nrows = processed.size();
     for (uint32_t i = 0; i < nrows; i++) {
 
-        uint32_t rnum = i;
-        if (!preds.empty())
-            rnum = processed[i];
+        // either preds or row_nums are present here, see the
+        // projection-only case above.
+        uint32_t rnum = processed[i];
 
         // Use the rnum to find which chunks it lies in and the specific position in this chunk
         int cur_chunk_idx = rnum;
@@ -1427,6 +1465,1549 @@ int processArrowCol(
 }
 
 
+// returns the numeric predicate value as a double, for comparing against
+// parquet column statistics
+static bool pred_val_as_double(PredicateBase* p, double* val)
+{
+    switch (p->colType()) {
+        case SDT_INT8:
+            *val = dynamic_cast<TypedPredicate<int8_t>*>(p)->Val();
+            return true;
+        case SDT_INT16:
+            *val = dynamic_cast<TypedPredicate<int16_t>*>(p)->Val();
+            return true;
+        case SDT_INT32:
+            *val = dynamic_cast<TypedPredicate<int32_t>*>(p)->Val();
+            return true;
+        case SDT_INT64:
+            *val = dynamic_cast<TypedPredicate<int64_t>*>(p)->Val();
+            return true;
+        case SDT_FLOAT:
+            *val = dynamic_cast<TypedPredicate<float>*>(p)->Val();
+            return true;
+        case SDT_DOUBLE:
+            *val = dynamic_cast<TypedPredicate<double>*>(p)->Val();
+            return true;
+        default:
+            return false;
+    }
+}
+
+// returns true if a value in [min, max] may satisfy the predicate op
+template <typename T>
+static bool range_may_match(const T& min, const T& max, const T& v, int op)
+{
+    switch (op) {
+        case SOT_lt:  return min < v;
+        case SOT_leq: return min <= v;
+        case SOT_gt:  return max > v;
+        case SOT_geq: return max >= v;
+        case SOT_eq:  return min <= v && v <= max;
+        case SOT_ne:  return !(min == v && max == v);
+        default:      return true;
+    }
+}
+
+// returns false only if the row group statistics prove that no row in the
+// row group can satisfy the predicate
+static bool row_group_may_match(parquet::RowGroupMetaData* rg_md,
+                                PredicateBase* p)
+{
+    std::shared_ptr<parquet::Statistics> stats = \
+        rg_md->ColumnChunk(p->colIdx())->statistics();
+    if (!stats || !stats->HasMinMax())
+        return true;
+
+    if (p->colType() == SDT_STRING || p->colType() == SDT_DATE) {
+        if (stats->physical_type() != parquet::Type::BYTE_ARRAY)
+            return true;
+        auto s = std::static_pointer_cast<parquet::ByteArrayStatistics>(stats);
+        std::string min(reinterpret_cast<const char*>(s->min().ptr), s->min().len);
+        std::string max(reinterpret_cast<const char*>(s->max().ptr), s->max().len);
+        std::string v = dynamic_cast<TypedPredicate<std::string>*>(p)->Val();
+        return range_may_match(min, max, v, p->opType());
+    }
+
+    double v;
+    if (!pred_val_as_double(p, &v))
+        return true;
+
+    switch (stats->physical_type()) {
+        case parquet::Type::INT32: {
+            auto s = std::static_pointer_cast<parquet::Int32Statistics>(stats);
+            return range_may_match<double>(s->min(), s->max(), v, p->opType());
+        }
+        case parquet::Type::INT64: {
+            auto s = std::static_pointer_cast<parquet::Int64Statistics>(stats);
+            return range_may_match<double>(s->min(), s->max(), v, p->opType());
+        }
+        case parquet::Type::FLOAT: {
+            auto s = std::static_pointer_cast<parquet::FloatStatistics>(stats);
+            return range_may_match<double>(s->min(), s->max(), v, p->opType());
+        }
+        case parquet::Type::DOUBLE: {
+            auto s = std::static_pointer_cast<parquet::DoubleStatistics>(stats);
+            return range_may_match<double>(s->min(), s->max(), v, p->opType());
+        }
+        default:
+            return true;
+    }
+}
+
+// returns true if p is a predicate that apply_dict_pred evaluates: like on
+// a string column, or a comparison on a date column.
+static bool is_dict_pred(PredicateBase* p)
+{
+    switch (p->colType()) {
+        case SDT_STRING:
+            return p->opType() == SOT_like;
+        case SDT_DATE:
+            switch (p->opType()) {
+                case SOT_lt:
+                case SOT_leq:
+                case SOT_gt:
+                case SOT_geq:
+                case SOT_eq:
+                case SOT_ne:
+                case SOT_before:
+                case SOT_after:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+// evaluates a predicate accepted by is_dict_pred once per dictionary entry
+// of a dictionary encoded column, then clears keep[i] for the rows whose
+// code fails.
+static void apply_dict_pred(PredicateBase* p,
+                            std::shared_ptr<arrow::ChunkedArray> col,
+                            std::vector<bool>& keep)
+{
+    TypedPredicate<std::string>* tp = dynamic_cast<TypedPredicate<std::string>*>(p);
+    int64_t offset = 0;
+    for (int c = 0; c < col->num_chunks(); c++) {
+        auto dict_arr = std::static_pointer_cast<arrow::DictionaryArray>(col->chunk(c));
+        auto dict = std::static_pointer_cast<arrow::StringArray>(dict_arr->dictionary());
+
+        // each chunk (row group) carries its own dictionary
+        std::vector<bool> dict_pass(dict->length(), false);
+        for (int64_t d = 0; d < dict->length(); d++) {
+            if (dict->IsNull(d))
+                continue;
+            if (p->opType() == SOT_like)
+                dict_pass[d] = RE2::PartialMatch(dict->GetString(d), *tp->getRegex());
+            else
+                dict_pass[d] = compare(dict->GetString(d), tp->Val(),
+                                       p->opType(), p->colType());
+        }
+        for (int64_t i = 0; i < dict_arr->length(); i++) {
+            if (dict_arr->IsNull(i) || !dict_pass[dict_arr->GetValueIndex(i)])
+                keep[offset + i] = false;
+        }
+        offset += dict_arr->length();
+    }
+}
+
+// decodes a dictionary encoded string column back to utf8
+static int decode_dict_col(std::shared_ptr<arrow::ChunkedArray> col,
+                           std::shared_ptr<arrow::ChunkedArray>* out)
+{
+    arrow::ArrayVector chunks;
+    for (int c = 0; c < col->num_chunks(); c++) {
+        auto dict_arr = std::static_pointer_cast<arrow::DictionaryArray>(col->chunk(c));
+        auto dict = std::static_pointer_cast<arrow::StringArray>(dict_arr->dictionary());
+        arrow::StringBuilder builder(arrow::default_memory_pool());
+        for (int64_t i = 0; i < dict_arr->length(); i++) {
+            arrow::Status s;
+            if (dict_arr->IsNull(i))
+                s = builder.AppendNull();
+            else
+                s = builder.Append(dict->GetView(dict_arr->GetValueIndex(i)));
+            if (!s.ok())
+                return TablesErrCodes::ArrowStatusErr;
+        }
+        std::shared_ptr<arrow::Array> arr;
+        if (!builder.Finish(&arr).ok())
+            return TablesErrCodes::ArrowStatusErr;
+        chunks.push_back(arr);
+    }
+    *out = std::make_shared<arrow::ChunkedArray>(chunks, arrow::utf8());
+    return 0;
+}
+
+/*
+ * Function: processParquet
+ * Description: Process the input parquet file in-situ for the corresponding
+ *              query and encapsulate the output in an output arrow table.
+ *              When the predicates are all AND-ed, row groups whose column
+ *              statistics cannot satisfy a predicate are skipped, like
+ *              predicates on string columns and comparisons on date columns
+ *              are evaluated once per dictionary entry and the rows filtered
+ *              on their codes, and only the columns required by the query
+ *              are decoded.
+ *              The remaining work is done by processArrowCol.
+ * @param[out] table       : Ouput arrow table containing result set.
+ * @param[in] tbl_schema   : Schema of an input table
+ * @param[in] query_schema : Schema of an query
+ * @param[in] preds        : Predicates for the query
+ * @param[in] groupby_cols : GROUP BY columns in a string
+ * @param[in] orderby_cols : ORDER BY columns in a string
+ * @param[in] dataptr      : Input parquet file in the form of char array
+ * @param[in] datasz       : Size of char array
+ * @param[out] errmsg      : Error message
+ * @param[out] row_nums    : Specified rows to be processed
+ *
+ * Return Value: error code
+ */
+int processParquet(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums)
+{
+    int errcode = 0;
+    int num_cols = std::distance(tbl_schema.begin(), tbl_schema.end());
+    auto pool = arrow::default_memory_pool();
+    std::shared_ptr<arrow::Buffer> buffer =                             \
+        arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(dataptr)), datasz);
+    auto input = std::make_shared<arrow::io::BufferReader>(buffer);
+
+    // stats and dictionary evaluation only apply when every predicate must
+    // hold for a row, and no specific rows were requested.
+    bool and_only = row_nums.empty();
+    for (auto p : preds) {
+        if (p->isGlobalAgg() || p->chainOpType() != SOT_logical_and)
+            and_only = false;
+    }
+
+    // string like and date predicates are evaluated on the dictionary
+    predicate_vec dict_preds;
+    predicate_vec other_preds;
+    for (auto p : preds) {
+        if (and_only && is_dict_pred(p))
+            dict_preds.push_back(p);
+        else
+            other_preds.push_back(p);
+    }
+
+    parquet::ArrowReaderProperties props(false);
+    for (auto p : dict_preds)
+        props.set_read_dictionary(p->colIdx(), true);
+
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    try {
+        arrow::Status s = parquet::arrow::FileReader::Make(
+                pool,
+                parquet::ParquetFileReader::Open(input),
+                props,
+                &reader);
+        if (!s.ok()) {
+            errmsg.append("ERROR processParquet(): " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+    } catch (const parquet::ParquetException& e) {
+        errmsg.append("ERROR processParquet(): ");
+        errmsg.append(e.what());
+        return TablesErrCodes::ArrowStatusErr;
+    }
+
+    std::shared_ptr<parquet::FileMetaData> file_md = reader->parquet_reader()->metadata();
+    std::shared_ptr<arrow::Schema> file_schema;
+    if (!reader->GetSchema(&file_schema).ok()) {
+        errmsg.append("ERROR processParquet(): cannot read arrow schema");
+        return TablesErrCodes::ArrowStatusErr;
+    }
+
+    // parquet leaf columns map 1:1 to arrow fields only for flat schemas
+    bool flat = (file_md->num_columns() == file_schema->num_fields());
+    if (!flat) {
+        and_only = false;
+        other_preds = preds;
+        dict_preds.clear();
+    }
+
+    // skip row groups using the column chunk min/max statistics
+    std::vector<int> row_groups;
+    for (int rg = 0; rg < file_md->num_row_groups(); rg++) {
+        bool keep_rg = true;
+        if (and_only) {
+            std::unique_ptr<parquet::RowGroupMetaData> rg_md = file_md->RowGroup(rg);
+            for (auto p : preds) {
+                if (!row_group_may_match(rg_md.get(), p)) {
+                    keep_rg = false;
+                    break;
+                }
+            }
+        }
+        if (keep_rg)
+            row_groups.push_back(rg);
+    }
+
+    // decode only the columns the query touches, groupby and orderby
+    // access arbitrary columns so read them all.
+    std::set<int> needed_cols;
+    std::set<int> dict_only_cols;
+    if (!flat || !groupby_cols.empty() || !orderby_cols.empty()) {
+        for (int i = 0; i < file_schema->num_fields(); i++)
+            needed_cols.insert(i);
+    } else {
+        for (auto it = query_schema.begin(); it != query_schema.end(); ++it)
+            needed_cols.insert(it->idx);
+        for (auto p : other_preds)
+            needed_cols.insert(p->colIdx());
+        needed_cols.insert(ARROW_RID_INDEX(num_cols));
+        needed_cols.insert(ARROW_DELVEC_INDEX(num_cols));
+        for (auto p : dict_preds) {
+            if (needed_cols.find(p->colIdx()) == needed_cols.end())
+                dict_only_cols.insert(p->colIdx());
+        }
+        needed_cols.insert(dict_only_cols.begin(), dict_only_cols.end());
+    }
+    std::vector<int> col_indices(needed_cols.begin(), needed_cols.end());
+
+    std::shared_ptr<arrow::Table> read_table;
+    arrow::Status s;
+    try {
+        if (file_md->num_row_groups() == 0)
+            s = reader->ReadTable(col_indices, &read_table);
+        else if (row_groups.empty())
+            s = reader->ReadRowGroups(std::vector<int>{0}, col_indices, &read_table);
+        else
+            s = reader->ReadRowGroups(row_groups, col_indices, &read_table);
+    } catch (const parquet::ParquetException& e) {
+        errmsg.append("ERROR processParquet(): ");
+        errmsg.append(e.what());
+        return TablesErrCodes::ArrowStatusErr;
+    }
+    if (!s.ok()) {
+        errmsg.append("ERROR processParquet(): " + s.ToString());
+        return TablesErrCodes::ArrowStatusErr;
+    }
+    if (row_groups.empty() && file_md->num_row_groups() > 0)
+        read_table = read_table->Slice(0, 0);
+    int64_t nrows = read_table->num_rows();
+
+    // evaluate the dictionary predicates on the codes
+    std::vector<bool> keep(nrows, true);
+    for (auto p : dict_preds) {
+        int pos = std::distance(col_indices.begin(),
+                                std::find(col_indices.begin(), col_indices.end(), p->colIdx()));
+        apply_dict_pred(p, read_table->column(pos), keep);
+    }
+
+    // rebuild a full width table so that column indices remain positional,
+    // unread columns are null placeholders.
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    std::vector<std::shared_ptr<arrow::ChunkedArray>> columns;
+    for (int i = 0; i < file_schema->num_fields(); i++) {
+        auto it = std::find(col_indices.begin(), col_indices.end(), i);
+        if (it == col_indices.end() || dict_only_cols.count(i)) {
+            auto placeholder = std::make_shared<arrow::NullArray>(nrows);
+            fields.push_back(arrow::field(file_schema->field(i)->name(), arrow::null()));
+            columns.push_back(std::make_shared<arrow::ChunkedArray>(
+                    arrow::ArrayVector{placeholder}, arrow::null()));
+            continue;
+        }
+        std::shared_ptr<arrow::ChunkedArray> col = \
+            read_table->column(std::distance(col_indices.begin(), it));
+        if (col->type()->id() == arrow::Type::DICTIONARY) {
+            errcode = decode_dict_col(col, &col);
+            if (errcode) {
+                errmsg.append("ERROR processParquet(): cannot decode dictionary");
+                return errcode;
+            }
+        }
+        fields.push_back(arrow::field(file_schema->field(i)->name(), col->type()));
+        columns.push_back(col);
+    }
+    auto metadata = copy_arrow_metadata(file_schema->metadata(), nrows);
+    std::shared_ptr<arrow::Table> input_table = arrow::Table::Make(
+            std::make_shared<arrow::Schema>(fields, metadata), columns);
+
+    arrow::Result<std::shared_ptr<arrow::Table>> combined = input_table->CombineChunks(pool);
+    if (!combined.ok()) {
+        errmsg.append("ERROR processParquet(): cannot combine chunks");
+        return TablesErrCodes::ArrowStatusErr;
+    }
+    input_table = combined.ValueOrDie();
+
+    std::vector<uint32_t> rows = row_nums;
+    if (!dict_preds.empty()) {
+        for (int64_t i = 0; i < nrows; i++) {
+            if (keep[i])
+                rows.push_back(i);
+        }
+        // an empty row list means all rows to processArrowCol
+        if (rows.empty())
+            input_table = input_table->Slice(0, 0);
+    }
+
+    errcode = processArrowCol(table, tbl_schema, query_schema, other_preds,
+                              groupby_cols, orderby_cols, input_table,
+                              errmsg, rows);
+    if (errcode)
+        return errcode;
+
+    // the metadata row count reflects the rows actually returned
+    auto out_metadata = copy_arrow_metadata((*table)->schema()->metadata(),
+                                            (*table)->num_rows());
+    *table = (*table)->ReplaceSchemaMetadata(out_metadata);
+    return errcode;
+}
+
+// returns the predicate value of an integer typed column as int64, unsigned
+// 64 bit values keep their bit pattern.
+static bool skycol_pred_int(PredicateBase* p, int64_t* val)
+{
+    switch (p->colType()) {
+        case SDT_BOOL:
+            *val = dynamic_cast<TypedPredicate<bool>*>(p)->Val();
+            return true;
+        case SDT_CHAR:
+            *val = dynamic_cast<TypedPredicate<char>*>(p)->Val();
+            return true;
+        case SDT_UCHAR:
+            *val = dynamic_cast<TypedPredicate<unsigned char>*>(p)->Val();
+            return true;
+        case SDT_INT8:
+            *val = dynamic_cast<TypedPredicate<int8_t>*>(p)->Val();
+            return true;
+        case SDT_INT16:
+            *val = dynamic_cast<TypedPredicate<int16_t>*>(p)->Val();
+            return true;
+        case SDT_INT32:
+            *val = dynamic_cast<TypedPredicate<int32_t>*>(p)->Val();
+            return true;
+        case SDT_INT64:
+            *val = dynamic_cast<TypedPredicate<int64_t>*>(p)->Val();
+            return true;
+        case SDT_UINT8:
+            *val = dynamic_cast<TypedPredicate<uint8_t>*>(p)->Val();
+            return true;
+        case SDT_UINT16:
+            *val = dynamic_cast<TypedPredicate<uint16_t>*>(p)->Val();
+            return true;
+        case SDT_UINT32:
+            *val = dynamic_cast<TypedPredicate<uint32_t>*>(p)->Val();
+            return true;
+        case SDT_UINT64:
+            *val = static_cast<int64_t>(dynamic_cast<TypedPredicate<uint64_t>*>(p)->Val());
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline bool skycol_is_null(const Column_COL* col, uint32_t i)
+{
+    return col->nullbits() && ((col->nullbits()->Get(i / 64) >> (i % 64)) & 1);
+}
+
+// compares an integer value, unsigned 64 bit columns compare unsigned
+static inline bool skycol_compare_int(int64_t colval, int64_t predval,
+                                      int op, int type)
+{
+    if (type == SDT_UINT64)
+        return compare(static_cast<uint64_t>(colval),
+                       static_cast<uint64_t>(predval), op);
+    return compare(colval, predval, op);
+}
+
+// evaluates a comparison on a frame of reference column, with T the type
+// the column values are ordered as.
+template <typename T>
+static void skycol_apply_for_pred(const Column_COL* col,
+                                  int64_t predval,
+                                  int op,
+                                  uint32_t nrows,
+                                  std::vector<bool>& keep)
+{
+    T min_val = static_cast<T>(col->min_val());
+    T max_val = static_cast<T>(col->max_val());
+    T v = static_cast<T>(predval);
+    uint32_t bw = col->bit_width();
+
+    // the predicate value lies outside [min, max], so the result
+    // is the same for every row.
+    if (!range_may_match(min_val, max_val, v, op) ||
+        v < min_val || v > max_val) {
+        bool pass = range_may_match(min_val, max_val, v, op) &&
+                    compare(min_val, v, op);
+        for (uint32_t i = 0; i < nrows; i++) {
+            if (!pass || skycol_is_null(col, i))
+                keep[i] = false;
+        }
+        return;
+    }
+
+    // otherwise compare in the offset domain without decoding
+    uint64_t off_v = static_cast<uint64_t>(v) - static_cast<uint64_t>(min_val);
+    for (uint32_t i = 0; i < nrows; i++) {
+        if (!keep[i])
+            continue;
+        if (skycol_is_null(col, i) ||
+            !compare(skycol_unpack(col->packed(), bw, i), off_v, op))
+            keep[i] = false;
+    }
+}
+
+// evaluates one predicate directly on the encoded column, clearing keep[i]
+// for the rows that fail. returns false if the predicate cannot be evaluated
+// on the encoded column and must be applied after decoding.
+static bool skycol_apply_pred(PredicateBase* p,
+                              const Column_COL* col,
+                              uint32_t nrows,
+                              std::vector<bool>& keep)
+{
+    int op = p->opType();
+    int type = p->colType();
+    bool is_cmp = (op == SOT_lt || op == SOT_leq || op == SOT_gt ||
+                   op == SOT_geq || op == SOT_eq || op == SOT_ne);
+
+    switch (type) {
+
+        case SDT_BOOL:
+        case SDT_CHAR:
+        case SDT_UCHAR:
+        case SDT_INT8:
+        case SDT_INT16:
+        case SDT_INT32:
+        case SDT_INT64:
+        case SDT_UINT8:
+        case SDT_UINT16:
+        case SDT_UINT32:
+        case SDT_UINT64: {
+            int64_t v;
+            if (!is_cmp || !skycol_pred_int(p, &v))
+                return false;
+
+            if (col->encoding() == SCE_RLE) {
+                // one comparison per run
+                uint32_t start = 0;
+                for (uint32_t r = 0; r < col->run_ends()->size(); r++) {
+                    uint32_t end = col->run_ends()->Get(r);
+                    bool pass = skycol_compare_int(col->run_values()->Get(r),
+                                                   v, op, type);
+                    for (uint32_t i = start; i < end; i++) {
+                        if (!pass || skycol_is_null(col, i))
+                            keep[i] = false;
+                    }
+                    start = end;
+                }
+                return true;
+            }
+            if (col->encoding() != SCE_FOR_BITPACK)
+                return false;
+
+            // uint64 min/max hold the bits of the unsigned bounds
+            if (type == SDT_UINT64)
+                skycol_apply_for_pred<uint64_t>(col, v, op, nrows, keep);
+            else
+                skycol_apply_for_pred<int64_t>(col, v, op, nrows, keep);
+            return true;
+        }
+
+        case SDT_FLOAT:
+        case SDT_DOUBLE: {
+            if (!is_cmp || col->encoding() != SCE_PLAIN)
+                return false;
+            double v;
+            if (type == SDT_FLOAT)
+                v = dynamic_cast<TypedPredicate<float>*>(p)->Val();
+            else
+                v = dynamic_cast<TypedPredicate<double>*>(p)->Val();
+            for (uint32_t i = 0; i < nrows; i++) {
+                if (!keep[i])
+                    continue;
+                if (skycol_is_null(col, i) ||
+                    !compare(col->doubles()->Get(i), v, op))
+                    keep[i] = false;
+            }
+            return true;
+        }
+
+        case SDT_DATE:
+        case SDT_STRING: {
+            if (type == SDT_STRING && op != SOT_like)
+                return false;
+            if (type == SDT_DATE && !is_cmp && op != SOT_before && op != SOT_after)
+                return false;
+            std::string v = dynamic_cast<TypedPredicate<std::string>*>(p)->Val();
+
+            if (col->encoding() == SCE_PLAIN) {
+                for (uint32_t i = 0; i < nrows; i++) {
+                    if (!keep[i])
+                        continue;
+                    if (skycol_is_null(col, i) ||
+                        !compare(col->strings()->Get(i)->str(), v, op, type))
+                        keep[i] = false;
+                }
+                return true;
+            }
+
+            // one comparison per dictionary entry, rows then look up their code
+            std::vector<bool> dict_pass(col->dict()->size());
+            for (uint32_t d = 0; d < col->dict()->size(); d++)
+                dict_pass[d] = compare(col->dict()->Get(d)->str(), v, op, type);
+
+            if (col->encoding() == SCE_RLE) {
+                uint32_t start = 0;
+                for (uint32_t r = 0; r < col->run_ends()->size(); r++) {
+                    uint32_t end = col->run_ends()->Get(r);
+                    bool pass = !dict_pass.empty() &&
+                                dict_pass[col->run_values()->Get(r)];
+                    for (uint32_t i = start; i < end; i++) {
+                        if (!pass || skycol_is_null(col, i))
+                            keep[i] = false;
+                    }
+                    start = end;
+                }
+                return true;
+            }
+            for (uint32_t i = 0; i < nrows; i++) {
+                if (!keep[i])
+                    continue;
+                uint64_t code = skycol_unpack(col->packed(), col->bit_width(), i);
+                if (skycol_is_null(col, i) || !dict_pass[code])
+                    keep[i] = false;
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// decodes the integer values of the selected rows
+static void skycol_decode_ints(const Column_COL* col,
+                               const std::vector<uint32_t>& rows,
+                               std::vector<int64_t>& vals)
+{
+    vals.resize(rows.size());
+    if (col->encoding() == SCE_RLE) {
+        // rows are ascending, so walk the runs once
+        uint32_t r = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            while (col->run_ends()->Get(r) <= rows[i])
+                r++;
+            vals[i] = col->run_values()->Get(r);
+        }
+        return;
+    }
+    uint64_t base = static_cast<uint64_t>(col->min_val());
+    for (size_t i = 0; i < rows.size(); i++) {
+        vals[i] = static_cast<int64_t>(
+            base + skycol_unpack(col->packed(), col->bit_width(), rows[i]));
+    }
+}
+
+template <typename BuilderT, typename CType>
+static arrow::Status skycol_build_ints(const Column_COL* col,
+                                       const std::vector<uint32_t>& rows,
+                                       const std::vector<int64_t>& vals,
+                                       std::shared_ptr<arrow::Array>* out)
+{
+    BuilderT builder(arrow::default_memory_pool());
+    arrow::Status s = builder.Reserve(rows.size());
+    if (!s.ok())
+        return s;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (skycol_is_null(col, rows[i]))
+            builder.UnsafeAppendNull();
+        else
+            builder.UnsafeAppend(static_cast<CType>(vals[i]));
+    }
+    return builder.Finish(out);
+}
+
+// decodes the selected rows of an encoded column into an arrow array
+static arrow::Status skycol_decode_col(const Column_COL* col,
+                                       int type,
+                                       const std::vector<uint32_t>& rows,
+                                       std::shared_ptr<arrow::Array>* out)
+{
+    std::vector<int64_t> vals;
+    switch (type) {
+        case SDT_BOOL:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::BooleanBuilder, bool>(col, rows, vals, out);
+        case SDT_CHAR:
+        case SDT_INT8:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::Int8Builder, int8_t>(col, rows, vals, out);
+        case SDT_INT16:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::Int16Builder, int16_t>(col, rows, vals, out);
+        case SDT_INT32:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::Int32Builder, int32_t>(col, rows, vals, out);
+        case SDT_INT64:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::Int64Builder, int64_t>(col, rows, vals, out);
+        case SDT_UCHAR:
+        case SDT_UINT8:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::UInt8Builder, uint8_t>(col, rows, vals, out);
+        case SDT_UINT16:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::UInt16Builder, uint16_t>(col, rows, vals, out);
+        case SDT_UINT32:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::UInt32Builder, uint32_t>(col, rows, vals, out);
+        case SDT_UINT64:
+            skycol_decode_ints(col, rows, vals);
+            return skycol_build_ints<arrow::UInt64Builder, uint64_t>(col, rows, vals, out);
+        case SDT_FLOAT: {
+            arrow::FloatBuilder builder(arrow::default_memory_pool());
+            for (auto r : rows) {
+                if (skycol_is_null(col, r))
+                    builder.AppendNull();
+                else
+                    builder.Append(static_cast<float>(col->doubles()->Get(r)));
+            }
+            return builder.Finish(out);
+        }
+        case SDT_DOUBLE: {
+            arrow::DoubleBuilder builder(arrow::default_memory_pool());
+            for (auto r : rows) {
+                if (skycol_is_null(col, r))
+                    builder.AppendNull();
+                else
+                    builder.Append(col->doubles()->Get(r));
+            }
+            return builder.Finish(out);
+        }
+        case SDT_DATE:
+        case SDT_STRING: {
+            arrow::StringBuilder builder(arrow::default_memory_pool());
+            if (col->encoding() == SCE_PLAIN) {
+                for (auto r : rows) {
+                    if (skycol_is_null(col, r))
+                        builder.AppendNull();
+                    else
+                        builder.Append(col->strings()->Get(r)->str());
+                }
+                return builder.Finish(out);
+            }
+            if (col->encoding() == SCE_RLE) {
+                skycol_decode_ints(col, rows, vals);
+            } else {
+                vals.resize(rows.size());
+                for (size_t i = 0; i < rows.size(); i++)
+                    vals[i] = skycol_unpack(col->packed(), col->bit_width(), rows[i]);
+            }
+            for (size_t i = 0; i < rows.size(); i++) {
+                if (skycol_is_null(col, rows[i]))
+                    builder.AppendNull();
+                else
+                    builder.Append(col->dict()->Get(vals[i])->str());
+            }
+            return builder.Finish(out);
+        }
+        default:
+            return arrow::Status::NotImplemented("UnsupportedSkyDataType");
+    }
+}
+
+/*
+ * Function: processSkyColFb
+ * Description: Process the input SFT_FLATBUF_UNION_COL flatbuffer in-situ for
+ *              the corresponding query and encapsulate the output in an output
+ *              arrow table. When the predicates are all AND-ed, they are
+ *              evaluated on the encoded columns: frame of reference columns
+ *              are pruned on their min/max and compared in the offset domain,
+ *              run length encoded columns once per run and dictionary coded
+ *              columns once per dictionary entry. Only the selected rows of
+ *              the columns required by the query are decoded, the remaining
+ *              work is done by processArrowCol.
+ * @param[out] table       : Ouput arrow table containing result set.
+ * @param[in] tbl_schema   : Schema of an input table
+ * @param[in] query_schema : Schema of an query
+ * @param[in] preds        : Predicates for the query
+ * @param[in] groupby_cols : GROUP BY columns in a string
+ * @param[in] orderby_cols : ORDER BY columns in a string
+ * @param[in] dataptr      : Input flatbuffer in the form of char array
+ * @param[in] datasz       : Size of char array
+ * @param[out] errmsg      : Error message
+ * @param[out] row_nums    : Specified rows to be processed
+ *
+ * Return Value: error code
+ */
+int processSkyColFb(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums)
+{
+    int errcode = 0;
+    int num_cols = std::distance(tbl_schema.begin(), tbl_schema.end());
+    sky_root root = getSkyRoot(dataptr, datasz, SFT_FLATBUF_UNION_COL);
+    col_offs cols = static_cast<col_offs>(root.data_vec);
+    auto rids = GetTable_COL(dataptr)->RIDs();
+    uint32_t nrows = root.nrows;
+
+    std::map<int, const Column_COL*> col_map;
+    for (uint32_t i = 0; i < cols->size(); i++)
+        col_map[cols->Get(i)->col_idx()] = cols->Get(i);
+
+    // start from the requested rows, or all rows, that are not deleted
+    std::vector<bool> keep(nrows, row_nums.empty());
+    for (auto rnum : row_nums) {
+        if (rnum >= nrows) {
+            errmsg += "ERROR: rnum(" + std::to_string(rnum) +
+                      ") > nrows(" + std::to_string(nrows) + ")";
+            return RowIndexOOB;
+        }
+        keep[rnum] = true;
+    }
+    for (uint32_t i = 0; i < nrows; i++) {
+        if (root.delete_vec[i] == 1)
+            keep[i] = false;
+    }
+
+    // encoded evaluation only applies when every predicate must hold
+    bool and_only = true;
+    for (auto p : preds) {
+        if (p->isGlobalAgg() || p->chainOpType() != SOT_logical_and)
+            and_only = false;
+    }
+    predicate_vec other_preds;
+    for (auto p : preds) {
+        auto it = col_map.find(p->colIdx());
+        if (!and_only || it == col_map.end() ||
+            !skycol_apply_pred(p, it->second, nrows, keep))
+            other_preds.push_back(p);
+    }
+
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < nrows; i++) {
+        if (keep[i])
+            rows.push_back(i);
+    }
+
+    // decode only the columns the query touches, groupby and orderby
+    // access arbitrary columns so decode them all.
+    std::set<int> needed_cols;
+    if (!groupby_cols.empty() || !orderby_cols.empty()) {
+        for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it)
+            needed_cols.insert(it->idx);
+    } else {
+        for (auto it = query_schema.begin(); it != query_schema.end(); ++it)
+            needed_cols.insert(it->idx);
+        for (auto p : other_preds)
+            needed_cols.insert(p->colIdx());
+    }
+
+    // build a full width table so that column indices remain positional,
+    // columns that are not decoded are null placeholders.
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    std::vector<std::shared_ptr<arrow::Array>> columns;
+    for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it) {
+        col_info col = *it;
+        std::shared_ptr<arrow::Array> array;
+        auto cit = col_map.find(col.idx);
+        if (!needed_cols.count(col.idx) || cit == col_map.end()) {
+            array = std::make_shared<arrow::NullArray>(rows.size());
+        } else {
+            arrow::Status s = skycol_decode_col(cit->second, col.type, rows, &array);
+            if (!s.ok()) {
+                errmsg.append("ERROR processSkyColFb(): col=" + col.name +
+                              " " + s.ToString());
+                return TablesErrCodes::ArrowStatusErr;
+            }
+        }
+        fields.push_back(arrow::field(col.name, array->type()));
+        columns.push_back(array);
+    }
+
+    // RID and deleted vector columns, deleted rows were dropped above.
+    {
+        arrow::Int64Builder rid_builder(arrow::default_memory_pool());
+        arrow::BooleanBuilder del_builder(arrow::default_memory_pool());
+        std::shared_ptr<arrow::Array> rid_array;
+        std::shared_ptr<arrow::Array> del_array;
+        arrow::Status s = rid_builder.Reserve(rows.size());
+        if (s.ok())
+            s = del_builder.Reserve(rows.size());
+        for (size_t i = 0; s.ok() && i < rows.size(); i++) {
+            rid_builder.UnsafeAppend(rids->Get(rows[i]));
+            del_builder.UnsafeAppend(false);
+        }
+        if (s.ok())
+            s = rid_builder.Finish(&rid_array);
+        if (s.ok())
+            s = del_builder.Finish(&del_array);
+        if (!s.ok()) {
+            errmsg.append("ERROR processSkyColFb(): " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+        fields.push_back(arrow::field("RID", arrow::int64()));
+        columns.push_back(rid_array);
+        fields.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
+        columns.push_back(del_array);
+    }
+
+    // NOTE: Preserve the order of appending, as later they will be
+    // referenced using enums.
+    std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
+    metadata->Append(ToString(METADATA_SKYHOOK_VERSION),
+                     std::to_string(root.skyhook_version));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA_VERSION),
+                     std::to_string(root.data_schema_version));
+    metadata->Append(ToString(METADATA_DATA_STRUCTURE_VERSION),
+                     std::to_string(root.data_structure_version));
+    metadata->Append(ToString(METADATA_DATA_FORMAT_TYPE),
+                     std::to_string(SFT_ARROW));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA), root.data_schema);
+    metadata->Append(ToString(METADATA_DB_SCHEMA), root.db_schema_name);
+    metadata->Append(ToString(METADATA_TABLE_NAME), root.table_name);
+    metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(rows.size()));
+    std::shared_ptr<arrow::Table> input_table = arrow::Table::Make(
+            std::make_shared<arrow::Schema>(fields, metadata), columns);
+
+    // the rows were already selected, so process all rows of input_table
+    errcode = processArrowCol(table, tbl_schema, query_schema, other_preds,
+                              groupby_cols, orderby_cols, input_table,
+                              errmsg);
+    if (errcode)
+        return errcode;
+
+    // the metadata row count reflects the rows actually returned
+    auto out_metadata = copy_arrow_metadata((*table)->schema()->metadata(),
+                                            (*table)->num_rows());
+    *table = (*table)->ReplaceSchemaMetadata(out_metadata);
+    return errcode;
+}
+
+// rows of a csv data structure, either lines of delimited text (SFT_CSV) or
+// the records of a Table_FBX flatbuffer (SFT_FLATBUF_CSV_ROW) whose fields
+// are stored as strings. Fields are located and converted lazily, only up to
+// the last field a query needs.
+struct csv_blob {
+    int format;
+    const Table_FBX* root;                 // SFT_FLATBUF_CSV_ROW
+    std::vector<std::string_view> lines;   // SFT_CSV
+    uint32_t nrows;
+};
+
+static void csv_open_blob(csv_blob& blob,
+                          const char* dataptr,
+                          size_t datasz,
+                          int format)
+{
+    blob.format = format;
+    blob.root = nullptr;
+    blob.lines.clear();
+    if (format == SFT_FLATBUF_CSV_ROW) {
+        blob.root = GetTable_FBX(dataptr);
+        blob.nrows = blob.root->rows_vec()->size();
+        return;
+    }
+
+    // line ends are found by memchr, which libc vectorizes
+    const char* p = dataptr;
+    const char* end = dataptr + datasz;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        const char* e = eol;
+        if (e > p && e[-1] == '\r')
+            e--;
+        if (e > p)
+            blob.lines.emplace_back(p, e - p);
+        p = eol + 1;
+    }
+    blob.nrows = blob.lines.size();
+}
+
+// splits line up to field max_field into fields, later fields are not
+// looked at. The delimiters are found 16 bytes at a time with SSE2.
+static void csv_split_fields(std::string_view line,
+                             char delim,
+                             int max_field,
+                             std::vector<std::string_view>& fields)
+{
+    fields.clear();
+    const char* p = line.data();
+    const char* end = p + line.size();
+    const char* start = p;
+#if defined(__SSE2__)
+    const __m128i d = _mm_set1_epi8(delim);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, d));
+        while (mask) {
+            const char* hit = p + __builtin_ctz(mask);
+            fields.emplace_back(start, hit - start);
+            if (static_cast<int>(fields.size()) > max_field)
+                return;
+            start = hit + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == delim) {
+            fields.emplace_back(start, p - start);
+            if (static_cast<int>(fields.size()) > max_field)
+                return;
+            start = p + 1;
+        }
+    }
+    fields.emplace_back(start, end - start);
+}
+
+// fields 0..max_field of row r, or fewer for a short row
+static void csv_row_fields(const csv_blob& blob,
+                           uint32_t r,
+                           int max_field,
+                           std::vector<std::string_view>& fields)
+{
+    if (blob.format == SFT_FLATBUF_CSV_ROW) {
+        auto data = blob.root->rows_vec()->Get(r)->data();
+        uint32_t n = std::min<uint32_t>(data->size(), max_field + 1);
+        fields.clear();
+        for (uint32_t i = 0; i < n; i++)
+            fields.emplace_back(data->Get(i)->c_str(), data->Get(i)->size());
+        return;
+    }
+    csv_split_fields(blob.lines[r], CSV_DELIM, max_field, fields);
+}
+
+// null fields are flagged in the record nullbits, or in text are missing or
+// "NULL" as the loader writes them.
+static bool csv_is_null(const csv_blob& blob,
+                        uint32_t r,
+                        int idx,
+                        const std::vector<std::string_view>& fields)
+{
+    if (idx < 0 || idx >= static_cast<int>(fields.size()))
+        return true;
+    if (blob.format == SFT_FLATBUF_CSV_ROW) {
+        auto nullbits = blob.root->rows_vec()->Get(r)->nullbits();
+        return nullbits && static_cast<uint32_t>(idx / 64) < nullbits->size() &&
+               ((nullbits->Get(idx / 64) >> (idx % 64)) & 1);
+    }
+    return fields[idx] == "NULL";
+}
+
+static uint64_t csv_rid(const csv_blob& blob, uint32_t r)
+{
+    if (blob.format == SFT_FLATBUF_CSV_ROW)
+        return blob.root->rows_vec()->Get(r)->RID();
+    return r;  // text has no rids, rows are numbered within the blob
+}
+
+static bool csv_deleted(const csv_blob& blob, uint32_t r)
+{
+    if (blob.format != SFT_FLATBUF_CSV_ROW)
+        return false;
+    auto delvec = blob.root->delete_vector();
+    return delvec && r < delvec->size() && delvec->Get(r) == 1;
+}
+
+// typed field parsers, in place and without allocations. Leading blanks and
+// a '+' sign are skipped, a field that is not a number reads as 0.
+static inline std::string_view csv_trim(std::string_view f)
+{
+    while (!f.empty() && (f.front() == ' ' || f.front() == '\t'))
+        f.remove_prefix(1);
+    if (!f.empty() && f.front() == '+')
+        f.remove_prefix(1);
+    return f;
+}
+
+static inline int64_t csv_parse_int(std::string_view f)
+{
+    f = csv_trim(f);
+    int64_t v = 0;
+    std::from_chars(f.data(), f.data() + f.size(), v);
+    return v;
+}
+
+static inline uint64_t csv_parse_uint(std::string_view f)
+{
+    f = csv_trim(f);
+    uint64_t v = 0;
+    std::from_chars(f.data(), f.data() + f.size(), v);
+    return v;
+}
+
+static inline double csv_parse_double(std::string_view f)
+{
+    // strtod needs a terminated string, so a short copy is parsed
+    char buf[64];
+    f = csv_trim(f);
+    size_t n = std::min(f.size(), sizeof(buf) - 1);
+    memcpy(buf, f.data(), n);
+    buf[n] = '\0';
+    return strtod(buf, NULL);
+}
+
+static inline bool csv_parse_bool(std::string_view f)
+{
+    f = csv_trim(f);
+    return f == "1" || f == "t" || f == "T" || f == "true" || f == "TRUE";
+}
+
+// "YYYY-MM-DD" as the integer YYYYMMDD, which orders as the dates do
+static inline int64_t csv_parse_date(std::string_view f)
+{
+    f = csv_trim(f);
+    size_t d1 = f.find('-');
+    size_t d2 = d1 == std::string_view::npos ? d1 : f.find('-', d1 + 1);
+    if (d2 == std::string_view::npos)
+        return 0;
+    return csv_parse_int(f.substr(0, d1)) * 10000 +
+           csv_parse_int(f.substr(d1 + 1, d2 - d1 - 1)) * 100 +
+           csv_parse_int(f.substr(d2 + 1));
+}
+
+// returns true if the predicate can be evaluated on the raw field
+static bool csv_pred_on_field(PredicateBase* p)
+{
+    int op = p->opType();
+    bool is_cmp = (op == SOT_lt || op == SOT_leq || op == SOT_gt ||
+                   op == SOT_geq || op == SOT_eq || op == SOT_ne);
+    switch (p->colType()) {
+        case SDT_BOOL:
+        case SDT_CHAR:
+        case SDT_UCHAR:
+        case SDT_INT8:
+        case SDT_INT16:
+        case SDT_INT32:
+        case SDT_INT64:
+        case SDT_UINT8:
+        case SDT_UINT16:
+        case SDT_UINT32:
+        case SDT_UINT64:
+        case SDT_FLOAT:
+        case SDT_DOUBLE:
+            return is_cmp;
+        case SDT_STRING:
+            return op == SOT_like;  // strings only compare by regex
+        case SDT_DATE:
+            return is_cmp || op == SOT_before || op == SOT_after;
+        default:
+            return false;
+    }
+}
+
+// evaluates a predicate accepted by csv_pred_on_field on a non null field,
+// converting only this field. date_predval is the csv_parse_date of the
+// predicate value of a date predicate, parsed once by the caller.
+static bool csv_eval_pred(PredicateBase* p,
+                          std::string_view f,
+                          int64_t date_predval)
+{
+    int op = p->opType();
+    int type = p->colType();
+    switch (type) {
+        case SDT_FLOAT:
+            return compare(static_cast<double>(static_cast<float>(csv_parse_double(f))),
+                           static_cast<double>(dynamic_cast<TypedPredicate<float>*>(p)->Val()),
+                           op);
+        case SDT_DOUBLE:
+            return compare(csv_parse_double(f),
+                           dynamic_cast<TypedPredicate<double>*>(p)->Val(), op);
+        case SDT_DATE:
+            // compared in place, as their YYYYMMDD integers
+            if (op == SOT_before)
+                op = SOT_lt;
+            else if (op == SOT_after)
+                op = SOT_gt;
+            return compare(csv_parse_date(f), date_predval, op);
+        case SDT_STRING:
+            return RE2::PartialMatch(
+                re2::StringPiece(f.data(), f.size()),
+                *dynamic_cast<TypedPredicate<std::string>*>(p)->getRegex());
+        default: {
+            int64_t predval;
+            skycol_pred_int(p, &predval);
+            int64_t colval;
+            if (type == SDT_BOOL)
+                colval = csv_parse_bool(f);
+            else if (type == SDT_CHAR)
+                colval = static_cast<char>(f.empty() ? 0 : f[0]);
+            else if (type == SDT_UCHAR)
+                colval = static_cast<unsigned char>(f.empty() ? 0 : f[0]);
+            else if (type == SDT_UINT8 || type == SDT_UINT16 ||
+                     type == SDT_UINT32 || type == SDT_UINT64)
+                colval = static_cast<int64_t>(csv_parse_uint(f));
+            else
+                colval = csv_parse_int(f);
+            return skycol_compare_int(colval, predval, op, type);
+        }
+    }
+}
+
+static arrow::Status csv_append_field(arrow::ArrayBuilder* b,
+                                      int type,
+                                      bool null,
+                                      std::string_view f)
+{
+    if (null)
+        return b->AppendNull();
+    switch (type) {
+        case SDT_BOOL:
+            return static_cast<arrow::BooleanBuilder*>(b)->Append(csv_parse_bool(f));
+        case SDT_CHAR:
+            return static_cast<arrow::Int8Builder*>(b)->Append(f.empty() ? 0 : f[0]);
+        case SDT_INT8:
+            return static_cast<arrow::Int8Builder*>(b)->Append(csv_parse_int(f));
+        case SDT_INT16:
+            return static_cast<arrow::Int16Builder*>(b)->Append(csv_parse_int(f));
+        case SDT_INT32:
+            return static_cast<arrow::Int32Builder*>(b)->Append(csv_parse_int(f));
+        case SDT_INT64:
+            return static_cast<arrow::Int64Builder*>(b)->Append(csv_parse_int(f));
+        case SDT_UCHAR:
+            return static_cast<arrow::UInt8Builder*>(b)->Append(f.empty() ? 0 : f[0]);
+        case SDT_UINT8:
+            return static_cast<arrow::UInt8Builder*>(b)->Append(csv_parse_uint(f));
+        case SDT_UINT16:
+            return static_cast<arrow::UInt16Builder*>(b)->Append(csv_parse_uint(f));
+        case SDT_UINT32:
+            return static_cast<arrow::UInt32Builder*>(b)->Append(csv_parse_uint(f));
+        case SDT_UINT64:
+            return static_cast<arrow::UInt64Builder*>(b)->Append(csv_parse_uint(f));
+        case SDT_FLOAT:
+            return static_cast<arrow::FloatBuilder*>(b)->Append(csv_parse_double(f));
+        case SDT_DOUBLE:
+            return static_cast<arrow::DoubleBuilder*>(b)->Append(csv_parse_double(f));
+        case SDT_DATE:
+        case SDT_STRING:
+            return static_cast<arrow::StringBuilder*>(b)->Append(f.data(), f.size());
+        default:
+            return arrow::Status::NotImplemented("UnsupportedSkyDataType");
+    }
+}
+
+// builds a full width arrow table of the given rows, laid out as
+// transform_fb_to_arrow lays out a table. Only the fields of needed_cols are
+// converted, the other columns are null placeholders.
+static int csv_build_table(const csv_blob& blob,
+                           schema_vec& tbl_schema,
+                           const std::set<int>& needed_cols,
+                           const std::vector<uint32_t>& rows,
+                           std::shared_ptr<arrow::Table>* table,
+                           std::string& errmsg)
+{
+    auto pool = arrow::default_memory_pool();
+    int max_field = -1;
+    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+    std::vector<col_info> built_cols;
+    for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it) {
+        if (!needed_cols.count(it->idx))
+            continue;
+        std::shared_ptr<arrow::DataType> type = sky_arrow_type(it->type);
+        std::unique_ptr<arrow::ArrayBuilder> b;
+        arrow::Status s = type == nullptr ?
+            arrow::Status::NotImplemented("UnsupportedSkyDataType") :
+            arrow::MakeBuilder(pool, type, &b);
+        if (s.ok())
+            s = b->Reserve(rows.size());
+        if (!s.ok()) {
+            errmsg.append("ERROR csv_build_table(): col=" + it->name +
+                          " " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+        builders.push_back(std::move(b));
+        built_cols.push_back(*it);
+        max_field = std::max(max_field, it->idx);
+    }
+
+    // each row is split once, up to the last needed field
+    std::vector<std::string_view> fields;
+    for (auto r : rows) {
+        if (max_field >= 0)
+            csv_row_fields(blob, r, max_field, fields);
+        for (size_t k = 0; k < built_cols.size(); k++) {
+            int idx = built_cols[k].idx;
+            bool null = csv_is_null(blob, r, idx, fields);
+            arrow::Status s = csv_append_field(builders[k].get(),
+                                               built_cols[k].type, null,
+                                               null ? std::string_view() :
+                                                      fields[idx]);
+            if (!s.ok()) {
+                errmsg.append("ERROR csv_build_table(): col=" +
+                              built_cols[k].name + " " + s.ToString());
+                return TablesErrCodes::ArrowStatusErr;
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<arrow::Field>> fields_vec;
+    std::vector<std::shared_ptr<arrow::Array>> columns;
+    size_t k = 0;
+    for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it) {
+        std::shared_ptr<arrow::Array> array;
+        if (!needed_cols.count(it->idx)) {
+            array = std::make_shared<arrow::NullArray>(rows.size());
+        } else {
+            arrow::Status s = builders[k++]->Finish(&array);
+            if (!s.ok()) {
+                errmsg.append("ERROR csv_build_table(): col=" + it->name +
+                              " " + s.ToString());
+                return TablesErrCodes::ArrowStatusErr;
+            }
+        }
+        fields_vec.push_back(arrow::field(it->name, array->type()));
+        columns.push_back(array);
+    }
+
+    // RID and deleted vector columns, deleted rows were dropped by the caller
+    {
+        arrow::Int64Builder rid_builder(pool);
+        arrow::BooleanBuilder del_builder(pool);
+        std::shared_ptr<arrow::Array> rid_array;
+        std::shared_ptr<arrow::Array> del_array;
+        arrow::Status s = rid_builder.Reserve(rows.size());
+        if (s.ok())
+            s = del_builder.Reserve(rows.size());
+        for (size_t i = 0; s.ok() && i < rows.size(); i++) {
+            rid_builder.UnsafeAppend(csv_rid(blob, rows[i]));
+            del_builder.UnsafeAppend(false);
+        }
+        if (s.ok())
+            s = rid_builder.Finish(&rid_array);
+        if (s.ok())
+            s = del_builder.Finish(&del_array);
+        if (!s.ok()) {
+            errmsg.append("ERROR csv_build_table(): " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+        fields_vec.push_back(arrow::field("RID", arrow::int64()));
+        columns.push_back(rid_array);
+        fields_vec.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
+        columns.push_back(del_array);
+    }
+
+    // NOTE: Preserve the order of appending, as later they will be
+    // referenced using enums. Text carries no metadata of its own.
+    int skyhook_version = 2;
+    int data_schema_version = 0;
+    int data_structure_version = 0;
+    std::string data_schema = schemaToString(tbl_schema);
+    std::string db_schema_name = DBSCHEMA_NAME_DEFAULT;
+    std::string table_name = TABLE_NAME_DEFAULT;
+    if (blob.format == SFT_FLATBUF_CSV_ROW) {
+        skyhook_version = blob.root->skyhook_version();
+        data_schema_version = blob.root->data_schema_version();
+        data_structure_version = blob.root->data_structure_version();
+        if (blob.root->data_schema())
+            data_schema = blob.root->data_schema()->str();
+        if (blob.root->db_schema_name())
+            db_schema_name = blob.root->db_schema_name()->str();
+        if (blob.root->table_name())
+            table_name = blob.root->table_name()->str();
+    }
+    std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
+    metadata->Append(ToString(METADATA_SKYHOOK_VERSION),
+                     std::to_string(skyhook_version));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA_VERSION),
+                     std::to_string(data_schema_version));
+    metadata->Append(ToString(METADATA_DATA_STRUCTURE_VERSION),
+                     std::to_string(data_structure_version));
+    metadata->Append(ToString(METADATA_DATA_FORMAT_TYPE),
+                     std::to_string(SFT_ARROW));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA), data_schema);
+    metadata->Append(ToString(METADATA_DB_SCHEMA), db_schema_name);
+    metadata->Append(ToString(METADATA_TABLE_NAME), table_name);
+    metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(rows.size()));
+    *table = arrow::Table::Make(
+            std::make_shared<arrow::Schema>(fields_vec, metadata), columns);
+    return 0;
+}
+
+/*
+ * Function: processCsv
+ * Description: Process the input SFT_CSV text or SFT_FLATBUF_CSV_ROW
+ *              flatbuffer in-situ for the corresponding query and encapsulate
+ *              the output in an output arrow table. Fields are parsed lazily:
+ *              when the predicates are all AND-ed, each row is split only up
+ *              to the last predicate column and only the predicate fields are
+ *              converted and compared. Then only the selected rows are split
+ *              up to the last column the query needs, and only those fields
+ *              are converted. The remaining work is done by processArrowCol.
+ * @param[out] table       : Ouput arrow table containing result set.
+ * @param[in] tbl_schema   : Schema of an input table
+ * @param[in] query_schema : Schema of an query
+ * @param[in] preds        : Predicates for the query
+ * @param[in] groupby_cols : GROUP BY columns in a string
+ * @param[in] orderby_cols : ORDER BY columns in a string
+ * @param[in] dataptr      : Input text or flatbuffer in the form of char array
+ * @param[in] datasz       : Size of char array
+ * @param[in] format       : SFT_CSV or SFT_FLATBUF_CSV_ROW
+ * @param[out] errmsg      : Error message
+ * @param[out] row_nums    : Specified rows to be processed
+ *
+ * Return Value: error code
+ */
+int processCsv(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        int format,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums)
+{
+    int errcode = 0;
+    csv_blob blob;
+    csv_open_blob(blob, dataptr, datasz, format);
+    uint32_t nrows = blob.nrows;
+
+    // start from the requested rows, or all rows, that are not deleted
+    std::vector<bool> keep(nrows, row_nums.empty());
+    for (auto rnum : row_nums) {
+        if (rnum >= nrows) {
+            errmsg += "ERROR: rnum(" + std::to_string(rnum) +
+                      ") > nrows(" + std::to_string(nrows) + ")";
+            return RowIndexOOB;
+        }
+        keep[rnum] = true;
+    }
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < nrows; i++) {
+        if (keep[i] && !csv_deleted(blob, i))
+            rows.push_back(i);
+    }
+
+    // field evaluation only applies when every predicate must hold
+    bool and_only = true;
+    for (auto p : preds) {
+        if (p->isGlobalAgg() || p->chainOpType() != SOT_logical_and)
+            and_only = false;
+    }
+    predicate_vec field_preds;
+    predicate_vec other_preds;
+    std::vector<int64_t> date_predvals;
+    int max_pred_field = -1;
+    for (auto p : preds) {
+        if (and_only && csv_pred_on_field(p)) {
+            field_preds.push_back(p);
+            date_predvals.push_back(p->colType() != SDT_DATE ? 0 :
+                csv_parse_date(
+                    dynamic_cast<TypedPredicate<std::string>*>(p)->Val()));
+            max_pred_field = std::max(max_pred_field, p->colIdx());
+        } else {
+            other_preds.push_back(p);
+        }
+    }
+
+    if (!field_preds.empty()) {
+        std::vector<std::string_view> fields;
+        std::vector<uint32_t> selected;
+        for (auto r : rows) {
+            csv_row_fields(blob, r, max_pred_field, fields);
+            bool pass = true;
+            for (size_t i = 0; i < field_preds.size(); i++) {
+                int idx = field_preds[i]->colIdx();
+                if (csv_is_null(blob, r, idx, fields) ||
+                    !csv_eval_pred(field_preds[i], fields[idx],
+                                   date_predvals[i])) {
+                    pass = false;
+                    break;
+                }
+            }
+            if (pass)
+                selected.push_back(r);
+        }
+        rows.swap(selected);
+    }
+
+    // convert only the columns the query touches, groupby and orderby
+    // access arbitrary columns so convert them all.
+    std::set<int> needed_cols;
+    if (!groupby_cols.empty() || !orderby_cols.empty()) {
+        for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it)
+            needed_cols.insert(it->idx);
+    } else {
+        for (auto it = query_schema.begin(); it != query_schema.end(); ++it)
+            needed_cols.insert(it->idx);
+        for (auto p : other_preds)
+            needed_cols.insert(p->colIdx());
+    }
+
+    std::shared_ptr<arrow::Table> input_table;
+    errcode = csv_build_table(blob, tbl_schema, needed_cols, rows,
+                              &input_table, errmsg);
+    if (errcode)
+        return errcode;
+
+    // the rows were already selected, so process all rows of input_table
+    errcode = processArrowCol(table, tbl_schema, query_schema, other_preds,
+                              groupby_cols, orderby_cols, input_table,
+                              errmsg);
+    if (errcode)
+        return errcode;
+
+    // the metadata row count reflects the rows actually returned
+    auto out_metadata = copy_arrow_metadata((*table)->schema()->metadata(),
+                                            (*table)->num_rows());
+    *table = (*table)->ReplaceSchemaMetadata(out_metadata);
+    return errcode;
+}
+
+/*
+ * Function: transform_csv_to_arrow
+ * Description: Convert all the live rows of an SFT_CSV text or
+ *              SFT_FLATBUF_CSV_ROW flatbuffer into an arrow table laid out as
+ *              stored arrow tables are, for returning the data as stored to a
+ *              client, which does not read csv.
+ * @param[in] dataptr    : Input text or flatbuffer in the form of char array
+ * @param[in] datasz     : Size of char array
+ * @param[in] format     : SFT_CSV or SFT_FLATBUF_CSV_ROW
+ * @param[in] tbl_schema : Schema of the table
+ * @param[out] errmsg    : Error message
+ * @param[out] table     : Output arrow table
+ *
+ * Return Value: error code
+ */
+int transform_csv_to_arrow(
+        const char* dataptr,
+        const size_t datasz,
+        int format,
+        schema_vec& tbl_schema,
+        std::string& errmsg,
+        std::shared_ptr<arrow::Table>* table)
+{
+    csv_blob blob;
+    csv_open_blob(blob, dataptr, datasz, format);
+
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < blob.nrows; i++) {
+        if (!csv_deleted(blob, i))
+            rows.push_back(i);
+    }
+    std::set<int> needed_cols;
+    for (auto it = tbl_schema.begin(); it != tbl_schema.end(); ++it)
+        needed_cols.insert(it->idx);
+    return csv_build_table(blob, tbl_schema, needed_cols, rows, table, errmsg);
+}
+
 /*
  * Function: processArrow
  * Description: Process the input arrow table rowwise for the corresponding input
@@ -52,6 +52,68 @@ int processArrowCol(
         std::string& errmsg,
         const std::vector<uint32_t>& row_nums=std::vector<uint32_t>());
 
+// process an arrow table, col access style
+int processArrowCol(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        std::shared_ptr<arrow::Table>& input_table,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums=std::vector<uint32_t>());
+
+// process parquet format data blob in-situ, returns an arrow table
+int processParquet(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums=std::vector<uint32_t>());
+
+// process encoded columnar flatbuffer data blob in-situ, returns an arrow table
+int processSkyColFb(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums=std::vector<uint32_t>());
+
+// process csv text or csv row flatbuffer data blob in-situ, parsing only the
+// fields the query needs, returns an arrow table
+int processCsv(
+        std::shared_ptr<arrow::Table>* table,
+        schema_vec& tbl_schema,
+        schema_vec& query_schema,
+        predicate_vec& preds,
+        std::string& groupby_cols,
+        std::string& orderby_cols,
+        const char* dataptr,
+        const size_t datasz,
+        int format,
+        std::string& errmsg,
+        const std::vector<uint32_t>& row_nums=std::vector<uint32_t>());
+
+// convert all live rows of a csv text or csv row flatbuffer data blob
+int transform_csv_to_arrow(
+        const char* dataptr,
+        const size_t datasz,
+        int format,
+        schema_vec& tbl_schema,
+        std::string& errmsg,
+        std::shared_ptr<arrow::Table>* table);
+
 // process arrow format data blob, row access style
 int processArrow(
         std::shared_ptr<arrow::Table>* table,
@@ -560,7 +560,8 @@ long long int printFlatbufFlexRowAsCsv(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print) {
+        long long int max_to_print,
+        std::string& out) {
 
     // get root table ptr as sky struct
     sky_root root = getSkyRoot(dataptr, datasz, SFT_FLATBUF_FLEX_ROW);
@@ -574,14 +575,14 @@ long long int printFlatbufFlexRowAsCsv(
     if (print_header) {
         bool first = true;
         for (schema_vec::iterator it = sc.begin(); it != sc.end(); ++it) {
-            if (!first) std::cout << CSV_DELIM;
+            if (!first) out.push_back(CSV_DELIM);
             first = false;
-            std::cout << it->name;
-            if (it->is_key) std::cout << "(key)";
-            if (!it->nullable) std::cout << "(NOT NULL)";
+            out.append(it->name);
+            if (it->is_key) out.append("(key)");
+            if (!it->nullable) out.append("(NOT NULL)");
 
         }
-        std::cout << std::endl; // newline to start first row.
+        out.push_back('\n'); // newline to start first row.
     }
 
     long long int counter = 0;
@@ -604,7 +605,7 @@ long long int printFlatbufFlexRowAsCsv(
         // for each col in the row, print a NULL or the col's value/
         bool first = true;
         for (uint32_t j = 0; j < sc.size(); j++) {
-            if (!first) std::cout << CSV_DELIM;
+            if (!first) out.push_back(CSV_DELIM);
             first = false;
             col_info col = sc.at(j);
 
@@ -616,34 +617,34 @@ long long int printFlatbufFlexRowAsCsv(
                     is_null =true;
                 }
                 if (is_null) {
-                    std::cout << "NULL";
+                    out.append("NULL");
                     continue;
                 }
             }
             switch (col.type) {
-                case SDT_BOOL: std::cout << row[j].AsBool(); break;
-                case SDT_INT8: std::cout << row[j].AsInt8(); break;
-                case SDT_INT16: std::cout << row[j].AsInt16(); break;
-                case SDT_INT32: std::cout << row[j].AsInt32(); break;
-                case SDT_INT64: std::cout << row[j].AsInt64(); break;
-                case SDT_UINT8: std::cout << row[j].AsUInt8(); break;
-                case SDT_UINT16: std::cout << row[j].AsUInt16(); break;
-                case SDT_UINT32: std::cout << row[j].AsUInt32(); break;
-                case SDT_UINT64: std::cout << row[j].AsUInt64(); break;
-                case SDT_FLOAT: std::cout << row[j].AsFloat(); break;
-                case SDT_DOUBLE: std::cout << row[j].AsDouble(); break;
-                case SDT_CHAR: std::cout <<
-                    std::string(1, row[j].AsInt8()); break;
-                case SDT_UCHAR: std::cout <<
-                    std::string(1, row[j].AsUInt8()); break;
-                case SDT_DATE: std::cout <<
-                    row[j].AsString().str(); break;
-                case SDT_STRING: std::cout <<
-                    row[j].AsString().str(); break;
+                case SDT_BOOL: out.push_back(row[j].AsBool() ? '1' : '0'); break;
+                case SDT_INT8: csv_append_int(out, row[j].AsInt8()); break;
+                case SDT_INT16: csv_append_int(out, row[j].AsInt16()); break;
+                case SDT_INT32: csv_append_int(out, row[j].AsInt32()); break;
+                case SDT_INT64: csv_append_int(out, row[j].AsInt64()); break;
+                case SDT_UINT8: csv_append_uint(out, row[j].AsUInt8()); break;
+                case SDT_UINT16: csv_append_uint(out, row[j].AsUInt16()); break;
+                case SDT_UINT32: csv_append_uint(out, row[j].AsUInt32()); break;
+                case SDT_UINT64: csv_append_uint(out, row[j].AsUInt64()); break;
+                case SDT_FLOAT: csv_append_double(out, row[j].AsFloat(), "%g"); break;
+                case SDT_DOUBLE: csv_append_double(out, row[j].AsDouble(), "%g"); break;
+                case SDT_CHAR: out.push_back(row[j].AsInt8()); break;
+                case SDT_UCHAR: out.push_back(row[j].AsUInt8()); break;
+                case SDT_DATE:
+                case SDT_STRING: {
+                    auto str = row[j].AsString();
+                    out.append(str.c_str(), str.length());
+                    break;
+                }
                 default: assert (TablesErrCodes::UnknownSkyDataType);
             }
         }
-        std::cout << std::endl;  // newline to start next row.
+        out.push_back('\n');  // newline to start next row.
     }
     return counter;
 }
@@ -653,7 +654,8 @@ long long int printFlatbufFlexRowAsPGBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print) {
+        long long int max_to_print,
+        std::string& out) {
 
     // get root table ptr as sky struct
     sky_root root = getSkyRoot(dataptr, datasz, SFT_FLATBUF_FLEX_ROW);
@@ -662,26 +664,23 @@ long long int printFlatbufFlexRowAsPGBinary(
 
     // postgres fstreams expect big endianness
     bool big_endian = is_big_endian();
-    stringstream ss(std::stringstream::in |
-                    std::stringstream::out|
-                    std::stringstream::binary);
 
     // print binary stream header sequence first time only
     if (print_header) {
 
         // 11 byte signature sequence
         const char* header_signature = "PGCOPY\n\377\r\n\0";
-        ss.write(header_signature, 11);
+        out.append(header_signature, 11);
 
         // 32 bit flags field, set bit#16=1 only if OIDs included in data
         int flags_field = 0;
-        ss.write(reinterpret_cast<const char*>(&flags_field),
-                 sizeof(flags_field));
+        out.append(reinterpret_cast<const char*>(&flags_field),
+                   sizeof(flags_field));
 
         // 32 bit extra header len
         int header_extension_len = 0;
-        ss.write(reinterpret_cast<const char*>(&header_extension_len),
-                 sizeof(header_extension_len));
+        out.append(reinterpret_cast<const char*>(&header_extension_len),
+                   sizeof(header_extension_len));
     }
 
     // 16 bit int, assumes same num cols for all rows below.
@@ -700,7 +699,7 @@ long long int printFlatbufFlexRowAsPGBinary(
             getSkyRec(static_cast<row_offs>(root.data_vec)->Get(i));
 
         // 16 bit int num cols in this row (all rows same ncols currently)
-        ss.write(reinterpret_cast<const char*>(&ncols), sizeof(ncols));
+        out.append(reinterpret_cast<const char*>(&ncols), sizeof(ncols));
 
         // get the flexbuf row's data as a flexbuf vec
         auto row = skyrec.data.AsVector();
@@ -720,8 +719,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                 if (is_null) {
                     // for null we only write the int representation of null,
                     // followed by no data
-                    ss.write(reinterpret_cast<const char*>(&PGNULLBINARY),
-                             sizeof(PGNULLBINARY));
+                    out.append(reinterpret_cast<const char*>(&PGNULLBINARY),
+                               sizeof(PGNULLBINARY));
                     continue;
                 }
             }
@@ -736,8 +735,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is single byte, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_INT8: {
@@ -747,8 +746,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is single byte, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_INT16: {
@@ -758,8 +757,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap16(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_INT32: {
@@ -769,8 +768,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap32(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_INT64: {
@@ -780,8 +779,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap64(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_UINT8: {
@@ -791,8 +790,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is single byte, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_UINT16: {
@@ -802,8 +801,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap16(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_UINT32: {
@@ -813,8 +812,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap32(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_UINT64: {
@@ -824,8 +823,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap64(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_FLOAT:    // postgres float is alias for double
@@ -849,12 +848,12 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val_bigend[6]=vptr[1];
                     val_bigend[7]=vptr[0];
                     len = __builtin_bswap32(len);
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(val_bigend, sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(val_bigend, sizeof(val));
                 }
                 else {
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 }
                 break;
             }
@@ -865,8 +864,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is single byte, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_UCHAR: {
@@ -876,8 +875,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is single byte, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_DATE: {
@@ -891,8 +890,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     val = __builtin_bswap32(val);
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                 break;
             }
             case SDT_STRING: {
@@ -902,8 +901,8 @@ long long int printFlatbufFlexRowAsPGBinary(
                     // val is byte array, has no endianness
                     len = __builtin_bswap32(len);
                 }
-                ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                ss.write(val.c_str(), static_cast<int>(val.length()));
+                out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                out.append(val.c_str(), static_cast<int>(val.length()));
                 break;
             }
             default: assert (TablesErrCodes::UnknownSkyDataType);
@@ -911,10 +910,6 @@ long long int printFlatbufFlexRowAsPGBinary(
         }
     }
 
-    // rewind and output all row data for this fb
-    ss.seekg (0, ios::beg);
-    std::cout << ss.rdbuf();
-    ss.flush();
     return counter;
 }
 
@@ -923,7 +918,8 @@ long long int printJSONAsCsv(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print) {
+        long long int max_to_print,
+        std::string& out) {
 
     // get root table ptr as sky struct
     sky_root root = getSkyRoot(dataptr, datasz, SFT_JSON);
@@ -937,14 +933,14 @@ long long int printJSONAsCsv(
     if (print_header) {
         bool first = true;
         for (schema_vec::iterator it = sc.begin(); it != sc.end(); ++it) {
-            if (!first) std::cout << CSV_DELIM;
+            if (!first) out.push_back(CSV_DELIM);
             first = false;
-            std::cout << it->name;
-            if (it->is_key) std::cout << "(key)";
-            if (!it->nullable) std::cout << "(NOT NULL)";
+            out.append(it->name);
+            if (it->is_key) out.append("(key)");
+            if (!it->nullable) out.append("(NOT NULL)");
 
         }
-        std::cout << std::endl; // newline to start first row.
+        out.push_back('\n'); // newline to start first row.
     }
 
     // iterate over each row data (Record_FBX)
@@ -983,7 +979,7 @@ long long int printJSONAsCsv(
             // for each row, extract as json string and print cols
             // from each row according to schema_vec sc.
             json_str = data->Get(j)->str();
-            std::cout << "row[" << i << "]=" << json_str << std::endl;
+            out.append("row[" + std::to_string(i) + "]=" + json_str + "\n");
 
             rapidjson::Document doc;
             doc.Parse(json_str.c_str());
@@ -998,11 +994,13 @@ long long int printJSONAsCsv(
 
             assert(d.HasMember("V"));
             assert(d["V"].IsString());
-            std::cout << d["V"].GetString() << std::endl;
+            out.append(d["V"].GetString());
+            out.push_back('\n');
 
             assert(d.HasMember("S"));
             assert(d["S"].IsString());
-            std::cout << d["S"].GetString() << std::endl;
+            out.append(d["S"].GetString());
+            out.push_back('\n');
         }
     }
     return counter;
@@ -1014,19 +1012,20 @@ long long int printExampleFormatAsCsv(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print) {
+        long long int max_to_print,
+        std::string& out) {
 
     // convert dataptr to desired format, here just a char string.
     std::string formatted_data(dataptr);
 
     // print extra info from result data.
     if (print_verbose)
-        std::cout << "EXAMPLE VERBOSE METADATA";
+        out.append("EXAMPLE VERBOSE METADATA");
 
     // print header row showing data schema
     if (print_header) {
-        std::cout << "EXAMPLE SCHEMA HEADER";
-        std::cout << std::endl; // newline to start first data row.
+        out.append("EXAMPLE SCHEMA HEADER");
+        out.push_back('\n'); // newline to start first data row.
     }
 
     std::vector<std::string> data_rows;
@@ -1037,12 +1036,110 @@ long long int printExampleFormatAsCsv(
     for (uint32_t i = 0; i < data_rows.size(); i++, counter++) {
         if (counter >= max_to_print)
             break;
-        std::cout << data_rows[i] <<std::endl;  // newline to start next row.
+        out.append(data_rows[i]);
+        out.push_back('\n');  // newline to start next row.
     }
     return counter;
 }
 
 
+// maps a skyhook compression type to the arrow codec implementing it
+static arrow::Compression::type arrow_compression_type(CompressionType compression)
+{
+    switch (compression) {
+        case lz4:  return arrow::Compression::LZ4_FRAME;
+        case zstd: return arrow::Compression::ZSTD;
+        default:   return arrow::Compression::UNCOMPRESSED;
+    }
+}
+
+// compressed blobs are prefixed with their uncompressed size
+static const size_t BLOB_COMPRESSION_HEADER_SIZE = sizeof(uint64_t);
+
+/*
+ * Function: compress_blob
+ * Description: Compress a data blob with the given codec. The output is the
+ *              uncompressed size (uint64_t) followed by the codec output.
+ * @param[in] compression : Codec to use, must not be none
+ * @param[in] data        : Input data
+ * @param[in] data_size   : Size of input data in bytes
+ * @param[out] out        : Output buffer
+ * Return Value: error code
+ */
+int compress_blob(
+    CompressionType compression,
+    const char *data,
+    size_t data_size,
+    std::shared_ptr<arrow::Buffer>* out)
+{
+    auto codec_result = arrow::util::Codec::Create(arrow_compression_type(compression));
+    if (!codec_result.ok() || !codec_result.ValueOrDie())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    std::unique_ptr<arrow::util::Codec> codec = std::move(codec_result).ValueOrDie();
+
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(data);
+    int64_t max_len = codec->MaxCompressedLen(data_size, input);
+    auto alloc = arrow::AllocateResizableBuffer(BLOB_COMPRESSION_HEADER_SIZE + max_len);
+    if (!alloc.ok())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    std::shared_ptr<arrow::ResizableBuffer> buffer = std::move(alloc).ValueOrDie();
+
+    uint64_t raw_size = data_size;
+    memcpy(buffer->mutable_data(), &raw_size, BLOB_COMPRESSION_HEADER_SIZE);
+    arrow::Result<int64_t> len = codec->Compress(
+            data_size,
+            input,
+            max_len,
+            buffer->mutable_data() + BLOB_COMPRESSION_HEADER_SIZE);
+    if (!len.ok())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    if (!buffer->Resize(BLOB_COMPRESSION_HEADER_SIZE + len.ValueOrDie()).ok())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    *out = buffer;
+    return 0;
+}
+
+/*
+ * Function: decompress_blob
+ * Description: Decompress a data blob produced by compress_blob.
+ * @param[in] compression : Codec the blob was compressed with
+ * @param[in] data        : Compressed data
+ * @param[in] data_size   : Size of compressed data in bytes
+ * @param[out] out        : Output buffer
+ * Return Value: error code
+ */
+int decompress_blob(
+    CompressionType compression,
+    const char *data,
+    size_t data_size,
+    std::shared_ptr<arrow::Buffer>* out)
+{
+    if (data_size < BLOB_COMPRESSION_HEADER_SIZE)
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+
+    auto codec_result = arrow::util::Codec::Create(arrow_compression_type(compression));
+    if (!codec_result.ok() || !codec_result.ValueOrDie())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    std::unique_ptr<arrow::util::Codec> codec = std::move(codec_result).ValueOrDie();
+
+    uint64_t raw_size;
+    memcpy(&raw_size, data, BLOB_COMPRESSION_HEADER_SIZE);
+    auto alloc = arrow::AllocateBuffer(raw_size);
+    if (!alloc.ok())
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    std::shared_ptr<arrow::Buffer> buffer = std::move(alloc).ValueOrDie();
+
+    arrow::Result<int64_t> len = codec->Decompress(
+            data_size - BLOB_COMPRESSION_HEADER_SIZE,
+            reinterpret_cast<const uint8_t*>(data) + BLOB_COMPRESSION_HEADER_SIZE,
+            raw_size,
+            buffer->mutable_data());
+    if (!len.ok() || static_cast<uint64_t>(len.ValueOrDie()) != raw_size)
+        return TablesErrCodes::EBLOB_COMPRESSION_FAILURE;
+    *out = buffer;
+    return 0;
+}
+
 // creates an fb meta data structure to wrap the underlying data
 // format (SkyFormatType)
 void
@@ -1054,10 +1151,31 @@ createFbMeta(
     bool data_deleted,                 // def=false
     size_t data_orig_off,              // def=0
     size_t data_orig_len,              // def=0
-    CompressionType data_compression)  // def=none
+    CompressionType data_compression,  // def=none
+    const std::string& data_sort_cols) // def="", rows not sorted
 {
+    // arrow blobs are compressed per ipc buffer by convert_arrow_to_buffer,
+    // the codec is only recorded here. other blobs are compressed whole,
+    // and stored uncompressed when that does not reduce their size.
+    std::shared_ptr<arrow::Buffer> compressed;
+    if (data_compression != none && data_format != SFT_ARROW) {
+        if (compress_blob(data_compression,
+                          reinterpret_cast<const char*>(data),
+                          data_size,
+                          &compressed) == 0 &&
+            static_cast<size_t>(compressed->size()) < data_size) {
+            data = const_cast<unsigned char*>(compressed->data());
+            data_size = compressed->size();
+        } else {
+            data_compression = none;
+        }
+    }
+
     flatbuffers::Offset<flatbuffers::Vector<unsigned char>> data_blob = \
             meta_builder->CreateVector(data, data_size);
+    flatbuffers::Offset<flatbuffers::String> sort_cols = 0;
+    if (!data_sort_cols.empty())
+        sort_cols = meta_builder->CreateString(data_sort_cols);
 
     flatbuffers::Offset<FB_Meta> meta_offset = Tables::CreateFB_Meta( \
             *meta_builder,
@@ -1067,7 +1185,8 @@ createFbMeta(
             data_deleted,
             data_orig_off,
             data_orig_len,
-            data_compression);
+            data_compression,
+            sort_cols);
     meta_builder->Finish(meta_offset);
     assert (meta_builder->GetSize()>0);   // temp check for debug only
 }
@@ -1082,6 +1201,48 @@ sky_meta getSkyMeta(bufferlist *bl, bool is_meta, int data_format) {
 
     if (is_meta) {
         const FB_Meta* meta = GetFB_Meta(bl->c_str());
+        std::string sort_cols = meta->blob_sort_cols() ?
+                                meta->blob_sort_cols()->str() : "";
+
+        // compressed blobs are decompressed and bl is replaced by the
+        // uncompressed fbmeta so the returned blob_data stays valid as long
+        // as bl. on failure no data is returned and blob_errcode is set.
+        if (meta->blob_compression() != none &&
+            meta->blob_format() != SFT_ARROW) {
+            std::shared_ptr<arrow::Buffer> raw;
+            int ret = decompress_blob(
+                static_cast<CompressionType>(meta->blob_compression()),
+                reinterpret_cast<const char*>(meta->blob_data()->Data()),
+                meta->blob_data()->size(),
+                &raw);
+            if (ret != 0) {
+                sky_meta failed(meta->blob_orig_off(),
+                                meta->blob_orig_len(),
+                                meta->blob_compression(),
+                                meta->blob_format(),
+                                meta->blob_deleted(),
+                                0,
+                                nullptr,
+                                sort_cols);
+                failed.blob_errcode = EBLOB_COMPRESSION_FAILURE;
+                return failed;
+            }
+            flatbuffers::FlatBufferBuilder meta_builder(raw->size() + 1024);
+            createFbMeta(&meta_builder,
+                         meta->blob_format(),
+                         const_cast<unsigned char*>(raw->data()),
+                         raw->size(),
+                         meta->blob_deleted(),
+                         meta->blob_orig_off(),
+                         meta->blob_orig_len(),
+                         none,
+                         sort_cols);
+            bl->clear();
+            bl->append(reinterpret_cast<const char*>(
+                           meta_builder.GetBufferPointer()),
+                       meta_builder.GetSize());
+            meta = GetFB_Meta(bl->c_str());
+        }
 
         return sky_meta(
             meta->blob_orig_off(),     // data position in original file
@@ -1092,7 +1253,8 @@ sky_meta getSkyMeta(bufferlist *bl, bool is_meta, int data_format) {
             meta->blob_data()->size(), // blob actual size
 
             // serialized blob data
-            reinterpret_cast<const char*>(meta->blob_data()->Data()));
+            reinterpret_cast<const char*>(meta->blob_data()->Data()),
+            sort_cols);                // cols the rows are sorted by
     }
     else {
         return sky_meta(    // for testing new raw formats without meta wrapper
@@ -1174,6 +1336,22 @@ sky_root getSkyRoot(const char *ds, size_t ds_size, int ds_format) {
             break;
         }
 
+        case SFT_FLATBUF_UNION_COL: {
+            const Table_COL* root = GetTable_COL(ds);
+            skyhook_version = root->skyhook_version();
+            data_format_type = root->data_format_type();
+            data_structure_version = root->data_structure_version();
+            data_schema_version = root->data_schema_version();
+            data_schema = root->data_schema()->str();
+            db_schema_name = root->db_schema()->str();
+            table_name = root->table_name()->str();
+            delete_vec = delete_vector(root->delete_vector()->begin(),
+                                       root->delete_vector()->end());
+            data_vec = root->cols();
+            nrows = root->nrows();
+            break;
+        }
+
         case SFT_FLATBUF_CSV_ROW:
         case SFT_PG_TUPLE:
         case SFT_CSV:
@@ -3009,11 +3187,14 @@ int flatten_table(const std::shared_ptr<arrow::Table> &input_table,
  *                    as an output stream.
  *  c. Writer - Does writing data to OutputStream. We are using arrow::RecordBatchStreamWriter
  *              which will write the data to output stream.
- * @param[in] table   : Arrow table to be converted
- * @param[out] buffer : Output buffer
+ * @param[in] table       : Arrow table to be converted
+ * @param[out] buffer     : Output buffer
+ * @param[in] compression : Codec for the record batch body buffers (def=none)
  * Return Value: error code
  */
-int convert_arrow_to_buffer(const std::shared_ptr<arrow::Table> &table, std::shared_ptr<arrow::Buffer>* buffer)
+int convert_arrow_to_buffer(const std::shared_ptr<arrow::Table> &table,
+                            std::shared_ptr<arrow::Buffer>* buffer,
+                            CompressionType compression)
 {
     // Initilization related to writing to the the file
     std::shared_ptr<arrow::ipc::RecordBatchWriter> writer;
@@ -3024,7 +3205,8 @@ int convert_arrow_to_buffer(const std::shared_ptr<arrow::Table> &table, std::sha
         output = out.ValueOrDie();
         arrow::io::OutputStream *raw_out = output.get();
         arrow::Table *raw_table = table.get();
-        const arrow::ipc::IpcWriteOptions options = arrow::ipc::IpcWriteOptions::Defaults();
+        arrow::ipc::IpcWriteOptions options = arrow::ipc::IpcWriteOptions::Defaults();
+        options.compression = arrow_compression_type(compression);
         arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchWriter>> result = arrow::ipc::NewStreamWriter(raw_out, raw_table->schema(), options);
         if (result.ok()) {
             writer = std::move(result).ValueOrDie();
@@ -3042,6 +3224,72 @@ int convert_arrow_to_buffer(const std::shared_ptr<arrow::Table> &table, std::sha
     return 0;
 }
 
+/*
+ * Function: extract_arrow_from_parquet_buffer
+ * Description: Read all row groups and columns of a parquet file held in a
+ *              buffer into an arrow table. Skyhook metadata is kept in the
+ *              arrow schema stored within the parquet file.
+ * @param[out] table  : Output arrow table
+ * @param[in] buffer  : Input buffer holding the parquet file
+ * Return Value: error code
+ */
+int extract_arrow_from_parquet_buffer(std::shared_ptr<arrow::Table>* table,
+                                      const std::shared_ptr<arrow::Buffer> &buffer)
+{
+    auto input = std::make_shared<arrow::io::BufferReader>(buffer);
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    arrow::Status s = parquet::arrow::OpenFile(input,
+                                               arrow::default_memory_pool(),
+                                               &reader);
+    if (!s.ok())
+        return TablesErrCodes::ArrowStatusErr;
+    s = reader->ReadTable(table);
+    if (!s.ok())
+        return TablesErrCodes::ArrowStatusErr;
+    return 0;
+}
+
+/*
+ * Function: convert_arrow_to_parquet_buffer
+ * Description: Write the arrow table into a parquet file in a buffer. The
+ *              arrow schema (including skyhook metadata) is stored in the
+ *              file, and row groups of row_group_rows rows each carry their
+ *              own column statistics which are used to skip data at query time.
+ * @param[in] table          : Arrow table to be converted
+ * @param[in] row_group_rows : Max number of rows per row group
+ * @param[out] buffer        : Output buffer
+ * Return Value: error code
+ */
+int convert_arrow_to_parquet_buffer(const std::shared_ptr<arrow::Table> &table,
+                                    int64_t row_group_rows,
+                                    std::shared_ptr<arrow::Buffer>* buffer)
+{
+    arrow::Result<std::shared_ptr<arrow::io::BufferOutputStream>> out;
+    out = arrow::io::BufferOutputStream::Create(STREAM_CAPACITY, arrow::default_memory_pool());
+    if (!out.ok())
+        return TablesErrCodes::ArrowStatusErr;
+    std::shared_ptr<arrow::io::BufferOutputStream> output = out.ValueOrDie();
+
+    std::shared_ptr<parquet::WriterProperties> props = \
+        parquet::WriterProperties::Builder().enable_statistics()->build();
+    std::shared_ptr<parquet::ArrowWriterProperties> arrow_props = \
+        parquet::ArrowWriterProperties::Builder().store_schema()->build();
+    arrow::Status s = parquet::arrow::WriteTable(*(table.get()),
+                                                 arrow::default_memory_pool(),
+                                                 output,
+                                                 row_group_rows,
+                                                 props,
+                                                 arrow_props);
+    if (!s.ok())
+        return TablesErrCodes::ArrowStatusErr;
+
+    arrow::Result<std::shared_ptr<arrow::Buffer>> buff = output->Finish();
+    if (!buff.ok())
+        return TablesErrCodes::ArrowStatusErr;
+    *buffer = buff.ValueOrDie();
+    return 0;
+}
+
 /*
  * Function: compress_arrow_tables
  * Description: Compress the given arrow tables into single arrow table. Before
@@ -3068,75 +3316,307 @@ int compress_arrow_tables(std::vector<std::shared_ptr<arrow::Table>> &table_vec,
 }
 
 
+/*
+ * Function: copy_arrow_metadata
+ * Description: Build a new skyhook metadata object from the original table
+ * metadata, replacing only the number of rows.
+ * @param[in] orig_metadata : Metadata of the original table
+ * @param[in] nrows         : Number of rows in the new table
+ * Return Value: new arrow metadata
+ */
+std::shared_ptr<arrow::KeyValueMetadata>
+copy_arrow_metadata(std::shared_ptr<const arrow::KeyValueMetadata> orig_metadata,
+                    int64_t nrows)
+{
+    // NOTE: Preserve the order of appending, as later they will be referenced
+    // using enums.
+    std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
+    metadata->Append(ToString(METADATA_SKYHOOK_VERSION),
+                     orig_metadata->value(METADATA_SKYHOOK_VERSION));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA_VERSION),
+                     orig_metadata->value(METADATA_DATA_SCHEMA_VERSION));
+    metadata->Append(ToString(METADATA_DATA_STRUCTURE_VERSION),
+                     orig_metadata->value(METADATA_DATA_STRUCTURE_VERSION));
+    metadata->Append(ToString(METADATA_DATA_FORMAT_TYPE),
+                     orig_metadata->value(METADATA_DATA_FORMAT_TYPE));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA),
+                     orig_metadata->value(METADATA_DATA_SCHEMA));
+    metadata->Append(ToString(METADATA_DB_SCHEMA),
+                     orig_metadata->value(METADATA_DB_SCHEMA));
+    metadata->Append(ToString(METADATA_TABLE_NAME),
+                     orig_metadata->value(METADATA_TABLE_NAME));
+    metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(nrows));
+    return metadata;
+}
+
 /*
  * Function: split_arrow_table
  * Description: Split the given arrow table into number of arrow tables. Based on
- * input parameter (max_rows) spliting is done.
+ * input parameter (max_rows) spliting is done. The last table holds the
+ * remaining rows and may be smaller than max_rows.
  * @param[in] table      : Table to be split.
  * @param[out] max_rows  : Maximum number of rows a table can have.
  * @param[out] table_vec : Vector of tables created after split.
  * Return Value: error code
  */
-int split_arrow_table(std::shared_ptr<arrow::Table> &table, int max_rows,
+int split_arrow_table(std::shared_ptr<arrow::Table> &table, int64_t max_rows,
                       std::vector<std::shared_ptr<arrow::Table>>* table_vec)
 {
+    if (max_rows <= 0)
+        return TablesErrCodes::ArrowStatusErr;
+
     auto orig_schema = table->schema();
     auto orig_metadata = orig_schema->metadata();
     int orig_num_cols = table->num_columns();
-    int remaining_rows = std::stoi(orig_metadata->value(METADATA_NUM_ROWS));
-    int offset = 0;
-
-    while ((remaining_rows / max_rows) >= 1) {
-
-        // Extract skyhook metadata from original table.
-        std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
-        metadata->Append(ToString(METADATA_SKYHOOK_VERSION),
-                         orig_metadata->value(METADATA_SKYHOOK_VERSION));
-        metadata->Append(ToString(METADATA_DATA_SCHEMA_VERSION),
-                         orig_metadata->value(METADATA_DATA_SCHEMA_VERSION));
-        metadata->Append(ToString(METADATA_DATA_STRUCTURE_VERSION),
-                         orig_metadata->value(METADATA_DATA_STRUCTURE_VERSION));
-        metadata->Append(ToString(METADATA_DATA_FORMAT_TYPE),
-                         orig_metadata->value(METADATA_DATA_FORMAT_TYPE));
-        metadata->Append(ToString(METADATA_DATA_SCHEMA),
-                         orig_metadata->value(METADATA_DATA_SCHEMA));
-        metadata->Append(ToString(METADATA_DB_SCHEMA),
-                         orig_metadata->value(METADATA_DB_SCHEMA));
-        metadata->Append(ToString(METADATA_TABLE_NAME),
-                         orig_metadata->value(METADATA_TABLE_NAME));
-
-        if (remaining_rows <= max_rows) {
-            metadata->Append(ToString(METADATA_NUM_ROWS),
-                             std::to_string(remaining_rows));
-        }
-        else {
-            metadata->Append(ToString(METADATA_NUM_ROWS),
-                             std::to_string(max_rows));
-        }
+
+    // use the physical row count, the metadata value is stale for tables
+    // produced by arrow::ConcatenateTables.
+    int64_t remaining_rows = table->num_rows();
+    int64_t offset = 0;
+
+    while (remaining_rows > 0) {
+        int64_t nrows = std::min(remaining_rows, max_rows);
 
         // Generate the schema for new table using original table schema
-        auto schema = std::make_shared<arrow::Schema>(orig_schema->fields(), metadata);
+        auto schema = std::make_shared<arrow::Schema>(
+                        orig_schema->fields(),
+                        copy_arrow_metadata(orig_metadata, nrows));
 
         // Split and create the columns from original table
         std::vector<std::shared_ptr<arrow::ChunkedArray>> column_list;
         for (int i = 0; i < orig_num_cols; i++) {
-            std::shared_ptr<arrow::ChunkedArray> column;
-            if (remaining_rows <= max_rows)
-                column = table->column(i)->Slice(offset);
-            else
-                column = table->column(i)->Slice(offset, max_rows);
-            column_list.emplace_back(column);
+            column_list.emplace_back(table->column(i)->Slice(offset, nrows));
         }
-        offset += max_rows;
 
         // Finally, create the arrow table based on schema and column vector
-        std::shared_ptr<arrow::Table> table = arrow::Table::Make(schema, column_list);
-        table_vec->push_back(table);
-        remaining_rows -= max_rows;
+        table_vec->push_back(arrow::Table::Make(schema, column_list));
+        offset += nrows;
+        remaining_rows -= nrows;
+    }
+    return 0;
+}
+
+// returns the value at row i of an integral or string key column as uint64,
+// matching the key interpretation used by the data writer for integral keys;
+// the writer hashes string keys instead.
+static uint64_t arrow_key_value(const std::shared_ptr<arrow::Array>& array,
+                                int64_t i)
+{
+    switch (array->type_id()) {
+        case arrow::Type::INT8:
+            return std::static_pointer_cast<arrow::Int8Array>(array)->Value(i);
+        case arrow::Type::INT16:
+            return std::static_pointer_cast<arrow::Int16Array>(array)->Value(i);
+        case arrow::Type::INT32:
+            return std::static_pointer_cast<arrow::Int32Array>(array)->Value(i);
+        case arrow::Type::INT64:
+            return std::static_pointer_cast<arrow::Int64Array>(array)->Value(i);
+        case arrow::Type::UINT8:
+            return std::static_pointer_cast<arrow::UInt8Array>(array)->Value(i);
+        case arrow::Type::UINT16:
+            return std::static_pointer_cast<arrow::UInt16Array>(array)->Value(i);
+        case arrow::Type::UINT32:
+            return std::static_pointer_cast<arrow::UInt32Array>(array)->Value(i);
+        case arrow::Type::UINT64:
+            return std::static_pointer_cast<arrow::UInt64Array>(array)->Value(i);
+        case arrow::Type::STRING:
+            return strtoull(std::static_pointer_cast<arrow::StringArray>(array)->GetString(i).c_str(),
+                            nullptr, 10);
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Function: hash_partition_arrow_table
+ * Description: Partition the rows of the given arrow table into num_parts
+ * tables by hashing the composite key (first two key cols of the data schema)
+ * with jumpConsistentHash, the same as the data writer. Deleted rows are
+ * dropped. Contiguous runs of rows with the same destination are sliced
+ * rather than copied.
+ * @param[in] table     : Table to be partitioned.
+ * @param[in] num_parts : Number of destination partitions.
+ * @param[out] part_map : Map of partition number to its table, only non-empty
+ *                        partitions are present.
+ * Return Value: error code
+ */
+int hash_partition_arrow_table(std::shared_ptr<arrow::Table> &table,
+                               uint64_t num_parts,
+                               std::map<uint64_t, std::shared_ptr<arrow::Table>>* part_map)
+{
+    if (num_parts == 0)
+        return TablesErrCodes::ArrowStatusErr;
+
+    auto orig_schema = table->schema();
+    auto orig_metadata = orig_schema->metadata();
+    schema_vec data_schema = schemaFromString(
+                                orig_metadata->value(METADATA_DATA_SCHEMA));
+    int num_cols = data_schema.size();
+    int64_t nrows = table->num_rows();
+
+    std::vector<int> key_cols;
+    for (auto it = data_schema.begin(); it != data_schema.end(); ++it) {
+        if (it->is_key)
+            key_cols.push_back(it->idx);
+    }
+    if (key_cols.size() > 2)
+        return TablesErrCodes::UnsupportedNumKeyCols;
+
+    // compute the destination of every row, UINT64_MAX marks deleted rows.
+    std::vector<uint64_t> dest(nrows, 0);
+    auto delvec = table->column(ARROW_DELVEC_INDEX(num_cols));
+    int64_t base = 0;
+    for (int c = 0; c < delvec->num_chunks(); c++) {
+        auto chunk = std::static_pointer_cast<arrow::BooleanArray>(delvec->chunk(c));
+        for (int64_t i = 0; i < chunk->length(); i++) {
+            if (chunk->Value(i))
+                dest[base + i] = UINT64_MAX;
+        }
+        base += chunk->length();
+    }
+
+    std::vector<uint64_t> keys(nrows, 0);
+    for (unsigned k = 0; k < key_cols.size(); k++) {
+        auto col = table->column(key_cols[k]);
+        base = 0;
+        for (int c = 0; c < col->num_chunks(); c++) {
+            auto chunk = col->chunk(c);
+            for (int64_t i = 0; i < chunk->length(); i++) {
+                uint64_t val = arrow_key_value(chunk, i);
+                keys[base + i] |= (k == 0) ? (val << 32) : val;
+            }
+            base += chunk->length();
+        }
+    }
+    for (int64_t i = 0; i < nrows; i++) {
+        if (dest[i] != UINT64_MAX)
+            dest[i] = jumpConsistentHash(keys[i], num_parts);
+    }
+
+    // slice each run of rows with the same destination.
+    std::map<uint64_t, std::vector<std::shared_ptr<arrow::Table>>> runs;
+    int64_t run_start = 0;
+    for (int64_t i = 1; i <= nrows; i++) {
+        if (i < nrows && dest[i] == dest[run_start])
+            continue;
+        if (dest[run_start] != UINT64_MAX)
+            runs[dest[run_start]].push_back(table->Slice(run_start, i - run_start));
+        run_start = i;
+    }
+
+    for (auto it = runs.begin(); it != runs.end(); ++it) {
+        arrow::Result<std::shared_ptr<arrow::Table>> result = \
+            arrow::ConcatenateTables(it->second);
+        if (!result.ok())
+            return TablesErrCodes::ArrowStatusErr;
+        std::shared_ptr<arrow::Table> part = std::move(result).ValueOrDie();
+        (*part_map)[it->first] = part->ReplaceSchemaMetadata(
+                        copy_arrow_metadata(orig_metadata, part->num_rows()));
     }
     return 0;
 }
 
+uint64_t jumpConsistentHash(uint64_t key, uint64_t num_buckets)
+{
+    // Source:
+    // A Fast, Minimal Memory, Consistent Hash Algorithm
+    // https://arxiv.org/ftp/arxiv/papers/1406/1406.2294.pdf
+
+    int64_t b=-1l, j=0l;
+    while(j < (int64_t)num_buckets) {
+        b = j;
+        key = key * 286293355588894185ULL + 1;
+        j = (b+1) * (double(1LL << 31) / double((key>>33) + 1));
+    }
+    return b;
+}
+
+// xxhash64 primes
+static const uint64_t XXH_PRIME1 = 11400714785074694791ULL;
+static const uint64_t XXH_PRIME2 = 14029467366897019727ULL;
+static const uint64_t XXH_PRIME3 = 1609587929392839161ULL;
+static const uint64_t XXH_PRIME4 = 9650029242287828579ULL;
+static const uint64_t XXH_PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t xxh_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME2;
+    acc = xxh_rotl(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh_round(0, val);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed)
+{
+    // Source:
+    // xxHash, extremely fast hash algorithm, XXH64
+    // https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+    // reads are little endian, as the hosts we run on.
+
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    const uint8_t *end = p + len;
+    uint64_t h, k;
+    uint32_t k32;
+
+    if (len >= 32) {
+        const uint8_t *limit = end - 32;
+        uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        uint64_t v2 = seed + XXH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME1;
+        do {
+            memcpy(&k, p, 8);      v1 = xxh_round(v1, k);
+            memcpy(&k, p + 8, 8);  v2 = xxh_round(v2, k);
+            memcpy(&k, p + 16, 8); v3 = xxh_round(v3, k);
+            memcpy(&k, p + 24, 8); v4 = xxh_round(v4, k);
+            p += 32;
+        } while (p <= limit);
+        h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) +
+            xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    }
+    else {
+        h = seed + XXH_PRIME5;
+    }
+    h += len;
+
+    for (; p + 8 <= end; p += 8) {
+        memcpy(&k, p, 8);
+        h ^= xxh_round(0, k);
+        h = xxh_rotl(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (p + 4 <= end) {
+        memcpy(&k32, p, 4);
+        h ^= static_cast<uint64_t>(k32) * XXH_PRIME1;
+        h = xxh_rotl(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * XXH_PRIME5;
+        h = xxh_rotl(h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
 // TODO: This function may need some changes as we have a single chunk for a column
 int print_arrowbuf_colwise(std::shared_ptr<arrow::Table>& table)
 {
@@ -3323,7 +3803,8 @@ long long int printArrowbufRowAsCsv(const char* dataptr,
                                     const size_t datasz,
                                     bool print_header,
                                     bool print_verbose,
-                                    long long int max_to_print)
+                                    long long int max_to_print,
+                                    std::string& out)
 {
     // Each column in arrow is represented using Chunked Array. A chunked array is
     // a vector of chunks i.e. arrays which holds actual data.
@@ -3352,10 +3833,10 @@ long long int printArrowbufRowAsCsv(const char* dataptr,
     for (auto it = sc.begin(); it != sc.end(); ++it) {
         col_info col = *it;
         if (print_header) {
-            std::cout << table->field(std::distance(sc.begin(), it))->name();
-            if (it->is_key) std::cout << "(key)";
-            if (!it->nullable) std::cout << "(NOT NULL)";
-            std::cout << CSV_DELIM;
+            out.append(table->field(std::distance(sc.begin(), it))->name());
+            if (it->is_key) out.append("(key)");
+            if (!it->nullable) out.append("(NOT NULL)");
+            out.push_back(CSV_DELIM);
         }
         chunk_vec.emplace_back(table->column(std::distance(sc.begin(), it))->chunk(0));
     }
@@ -3364,10 +3845,10 @@ long long int printArrowbufRowAsCsv(const char* dataptr,
         num_cols = sc.size();
 
         if (print_header) {
-            std::cout << table->field(ARROW_RID_INDEX(num_cols))->name()
-                      << CSV_DELIM;
-            std::cout << table->field(ARROW_DELVEC_INDEX(num_cols))->name()
-                      << CSV_DELIM;
+            out.append(table->field(ARROW_RID_INDEX(num_cols))->name());
+            out.push_back(CSV_DELIM);
+            out.append(table->field(ARROW_DELVEC_INDEX(num_cols))->name());
+            out.push_back(CSV_DELIM);
         }
 
         // Add RID and delete vector column
@@ -3376,7 +3857,7 @@ long long int printArrowbufRowAsCsv(const char* dataptr,
     }
 
     if (print_header)
-        std::cout << std::endl;
+        out.push_back('\n');
 
     long long int counter = 0;
     for (int i = 0; i < num_rows; i++, counter++) {
@@ -3388,84 +3869,88 @@ long long int printArrowbufRowAsCsv(const char* dataptr,
             auto print_array = chunk_vec[std::distance(sc.begin(), it)];
 
             if (print_array->IsNull(i)) {
-                std::cout << "NULL" << CSV_DELIM;
+                out.append("NULL");
+                out.push_back(CSV_DELIM);
                 continue;
             }
 
             switch(col.type) {
                 case SDT_BOOL: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::BooleanArray>(print_array)->Value(i));
+                    out.push_back(std::static_pointer_cast<arrow::BooleanArray>(print_array)->Value(i) ? '1' : '0');
                     break;
                 }
                 case SDT_INT8: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::Int8Array>(print_array)->Value(i));
+                    csv_append_int(out, std::static_pointer_cast<arrow::Int8Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_INT16: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::Int16Array>(print_array)->Value(i));
+                    csv_append_int(out, std::static_pointer_cast<arrow::Int16Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_INT32: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::Int32Array>(print_array)->Value(i));
+                    csv_append_int(out, std::static_pointer_cast<arrow::Int32Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_INT64: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::Int64Array>(print_array)->Value(i));
+                    csv_append_int(out, std::static_pointer_cast<arrow::Int64Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_UINT8: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::UInt8Array>(print_array)->Value(i));
+                    csv_append_uint(out, std::static_pointer_cast<arrow::UInt8Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_UINT16: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::UInt16Array>(print_array)->Value(i));
+                    csv_append_uint(out, std::static_pointer_cast<arrow::UInt16Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_UINT32: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::UInt32Array>(print_array)->Value(i));
+                    csv_append_uint(out, std::static_pointer_cast<arrow::UInt32Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_UINT64: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::UInt64Array>(print_array)->Value(i));
+                    csv_append_uint(out, std::static_pointer_cast<arrow::UInt64Array>(print_array)->Value(i));
                     break;
                 }
                 case SDT_CHAR: {
-                    std::cout << static_cast<char>(std::static_pointer_cast<arrow::Int8Array>(print_array)->Value(i));
+                    out.push_back(static_cast<char>(std::static_pointer_cast<arrow::Int8Array>(print_array)->Value(i)));
                     break;
                 }
                 case SDT_UCHAR: {
-                    std::cout << static_cast<unsigned char>(std::static_pointer_cast<arrow::UInt8Array>(print_array)->Value(i));
+                    out.push_back(static_cast<unsigned char>(std::static_pointer_cast<arrow::UInt8Array>(print_array)->Value(i)));
                     break;
                 }
                 case SDT_FLOAT: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::FloatArray>(print_array)->Value(i));
+                    csv_append_double(out, std::static_pointer_cast<arrow::FloatArray>(print_array)->Value(i), "%f");
                     break;
                 }
                 case SDT_DOUBLE: {
-                    std::cout << std::to_string(std::static_pointer_cast<arrow::DoubleArray>(print_array)->Value(i));
+                    csv_append_double(out, std::static_pointer_cast<arrow::DoubleArray>(print_array)->Value(i), "%f");
                     break;
                 }
                 case SDT_DATE:
                 case SDT_STRING: {
-                    std::cout << std::static_pointer_cast<arrow::StringArray>(print_array)->GetString(i);
+                    auto str = std::static_pointer_cast<arrow::StringArray>(print_array)->GetView(i);
+                    out.append(str.data(), str.size());
                     break;
                 }
                 default: {
                     return TablesErrCodes::UnsupportedSkyDataType;
                 }
             }
-            std::cout << CSV_DELIM;
+            out.push_back(CSV_DELIM);
         }
         if (print_verbose) {
             // Print RID
             auto print_array = chunk_vec[ARROW_RID_INDEX(num_cols)];
-            std::cout << std::to_string(std::static_pointer_cast<arrow::Int64Array>(print_array)->Value(i)) << CSV_DELIM;
+            csv_append_int(out, std::static_pointer_cast<arrow::Int64Array>(print_array)->Value(i));
+            out.push_back(CSV_DELIM);
 
             // Print Deleted Vector
             print_array = chunk_vec[ARROW_DELVEC_INDEX(num_cols)];
-            std::cout << std::to_string(std::static_pointer_cast<arrow::BooleanArray>(print_array)->Value(i)) << CSV_DELIM;
+            out.push_back(std::static_pointer_cast<arrow::BooleanArray>(print_array)->Value(i) ? '1' : '0');
+            out.push_back(CSV_DELIM);
         }
-        std::cout << std::endl;  // newline to start next row.
+        out.push_back('\n');  // newline to start next row.
     }
     return counter;
 }
@@ -3476,7 +3961,8 @@ long long int printArrowbufRowAsPGBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print)
+        long long int max_to_print,
+        std::string& out)
 {
 
     // Each column in arrow is represented using Chunked Array. A chunked array is
@@ -3500,26 +3986,23 @@ long long int printArrowbufRowAsPGBinary(
 
     // postgres fstreams expect big endianness
     bool big_endian = is_big_endian();
-    stringstream ss(std::stringstream::in |
-                    std::stringstream::out|
-                    std::stringstream::binary);
 
     // print binary stream header sequence first time only
     if (print_header) {
 
         // 11 byte signature sequence
         const char* header_signature = "PGCOPY\n\377\r\n\0";
-        ss.write(header_signature, 11);
+        out.append(header_signature, 11);
 
         // 32 bit flags field, set bit#16=1 only if OIDs included in data
         int flags_field = 0;
-        ss.write(reinterpret_cast<const char*>(&flags_field),
-                 sizeof(flags_field));
+        out.append(reinterpret_cast<const char*>(&flags_field),
+                   sizeof(flags_field));
 
         // 32 bit extra header len
         int header_extension_len = 0;
-        ss.write(reinterpret_cast<const char*>(&header_extension_len),
-                 sizeof(header_extension_len));
+        out.append(reinterpret_cast<const char*>(&header_extension_len),
+                   sizeof(header_extension_len));
     }
 
     // Get the names of each column and get the vector of chunks
@@ -3539,7 +4022,7 @@ long long int printArrowbufRowAsPGBinary(
         // TODO: if (root.delete_vec.at(i) == 1) continue;
 
         // 16 bit int num cols in this row (all rows same ncols currently)
-        ss.write(reinterpret_cast<const char*>(&ncols), sizeof(ncols));
+        out.append(reinterpret_cast<const char*>(&ncols), sizeof(ncols));
 
         // For this row get the data from each columns
         for (auto it = sc.begin(); it != sc.end(); ++it) {
@@ -3549,8 +4032,8 @@ long long int printArrowbufRowAsPGBinary(
             if (print_array->IsNull(i)) {
                 // for null we only write the int representation of null,
                 // followed by no data
-                ss.write(reinterpret_cast<const char*>(&PGNULLBINARY),
-                         sizeof(PGNULLBINARY));
+                out.append(reinterpret_cast<const char*>(&PGNULLBINARY),
+                           sizeof(PGNULLBINARY));
                 continue;
             }
 
@@ -3562,8 +4045,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is single byte, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_INT8: {
@@ -3573,8 +4056,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is single byte, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_INT16: {
@@ -3584,8 +4067,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap16(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_INT32: {
@@ -3595,8 +4078,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap32(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_INT64: {
@@ -3606,8 +4089,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap64(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_UINT8: {
@@ -3617,8 +4100,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is single byte, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_UINT16: {
@@ -3628,8 +4111,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap16(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_UINT32: {
@@ -3639,8 +4122,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap32(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_UINT64: {
@@ -3650,8 +4133,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap64(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_CHAR: {
@@ -3661,8 +4144,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is single byte, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_UCHAR: {
@@ -3672,8 +4155,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is single byte, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_FLOAT:
@@ -3697,12 +4180,12 @@ long long int printArrowbufRowAsPGBinary(
                         val_bigend[6]=vptr[1];
                         val_bigend[7]=vptr[0];
                         len = __builtin_bswap32(len);
-                        ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                        ss.write(val_bigend, sizeof(val));
+                        out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                        out.append(val_bigend, sizeof(val));
                     }
                     else {
-                        ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                        ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                        out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                        out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     }
                     break;
                 }
@@ -3717,8 +4200,8 @@ long long int printArrowbufRowAsPGBinary(
                         val = __builtin_bswap32(val);
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(reinterpret_cast<const char*>(&val), sizeof(val));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
                     break;
                 }
                 case SDT_STRING: {
@@ -3728,8 +4211,8 @@ long long int printArrowbufRowAsPGBinary(
                         // val is byte array, has no endianness
                         len = __builtin_bswap32(len);
                     }
-                    ss.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                    ss.write(val.c_str(), static_cast<int>(val.length()));
+                    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                    out.append(val.c_str(), static_cast<int>(val.length()));
                     break;
                     }
                 default: {
@@ -3739,10 +4222,6 @@ long long int printArrowbufRowAsPGBinary(
         }
     }
 
-    // rewind and output all row data for this fb
-    ss.seekg (0, ios::beg);
-    std::cout << ss.rdbuf();
-    ss.flush();
     return counter;
 }
 
@@ -3752,7 +4231,8 @@ long long int printArrowbufRowAsPyArrowBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print)
+        long long int max_to_print,
+        std::string& out)
 {
 
     // Each column in arrow is represented using Chunked Array. A chunked array is
@@ -3761,9 +4241,8 @@ long long int printArrowbufRowAsPyArrowBinary(
     // Declare vector for columns (i.e. chunked_arrays)
     std::vector<std::shared_ptr<arrow::Array>> chunk_vec;
     std::shared_ptr<arrow::Table> table;
-    std::shared_ptr<arrow::Buffer> buffer;
-    std::string str_buff(dataptr, datasz);
-    buffer = arrow::Buffer::FromString(str_buff);
+    std::shared_ptr<arrow::Buffer> buffer = std::make_shared<arrow::Buffer>(
+        reinterpret_cast<const uint8_t*>(dataptr), datasz);
     extract_arrow_from_buffer(&table, buffer);
 
     // From Table get the schema and from schema get the skyhook schema
@@ -3780,23 +4259,12 @@ long long int printArrowbufRowAsPyArrowBinary(
                   << std::endl;
     }
 
-    // output binary buffer as sstream for pyarrow consumption.
-    stringstream ss(std::stringstream::in  |
-                    std::stringstream::out |
-                    std::stringstream::binary);
-
-
     // add buf len to output
     uint64_t buf_len = static_cast<uint64_t>(datasz);
-    ss.write(reinterpret_cast<const char*>(&buf_len), sizeof(buf_len));
+    out.append(reinterpret_cast<const char*>(&buf_len), sizeof(buf_len));
 
     // add const char* arrow buf
-    ss.write(dataptr, datasz);
-
-    // rewind and output the stream
-    ss.seekg (0, ios::beg);
-    std::cout << ss.rdbuf();
-    ss.flush();
+    out.append(dataptr, datasz);
 
     // TODO: ignores deleted rows for now.
     // max_to_print unused here, we just output the existing arrow table
@@ -3805,12 +4273,353 @@ long long int printArrowbufRowAsPyArrowBinary(
 }
 
 
+// arrow type of a skyhook column type, as results are built with
+std::shared_ptr<arrow::DataType> sky_arrow_type(int sky_type)
+{
+    switch (sky_type) {
+        case SDT_BOOL:   return arrow::boolean();
+        case SDT_CHAR:
+        case SDT_INT8:   return arrow::int8();
+        case SDT_INT16:  return arrow::int16();
+        case SDT_INT32:  return arrow::int32();
+        case SDT_INT64:  return arrow::int64();
+        case SDT_UCHAR:
+        case SDT_UINT8:  return arrow::uint8();
+        case SDT_UINT16: return arrow::uint16();
+        case SDT_UINT32: return arrow::uint32();
+        case SDT_UINT64: return arrow::uint64();
+        case SDT_FLOAT:  return arrow::float32();
+        case SDT_DOUBLE: return arrow::float64();
+        case SDT_DATE:
+        case SDT_STRING: return arrow::utf8();
+        default:         return nullptr;
+    }
+}
+
+// the rows written to an ipc stream leave out the internal RID and
+// DELETED_VECTOR columns and the skyhook metadata of each object.
+static std::shared_ptr<arrow::Schema> ipc_stream_schema(
+        const std::shared_ptr<arrow::Schema>& schema)
+{
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    for (auto& f : schema->fields()) {
+        if (f->name() == "RID" || f->name() == "DELETED_VECTOR")
+            continue;
+        fields.push_back(f->RemoveMetadata());
+    }
+    return arrow::schema(fields);
+}
+
+// appends the schema message that starts an ipc stream
+static int ipc_schema_message(const std::shared_ptr<arrow::Schema>& schema,
+                              std::string& out)
+{
+    arrow::Result<std::shared_ptr<arrow::io::BufferOutputStream>> sink =
+        arrow::io::BufferOutputStream::Create(1024, arrow::default_memory_pool());
+    if (!sink.ok())
+        return TablesErrCodes::ArrowStatusErr;
+    std::shared_ptr<arrow::io::BufferOutputStream> output = sink.ValueOrDie();
+    arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchWriter>> writer =
+        arrow::ipc::NewStreamWriter(output.get(), schema,
+                                    arrow::ipc::IpcWriteOptions::Defaults());
+    if (!writer.ok() || !writer.ValueOrDie()->Close().ok())
+        return TablesErrCodes::ArrowStatusErr;
+    arrow::Result<std::shared_ptr<arrow::Buffer>> buf = output->Finish();
+    if (!buf.ok())
+        return TablesErrCodes::ArrowStatusErr;
+
+    // a stream closed without batches is the schema message then the end of
+    // stream marker, which the caller writes once at the very end.
+    std::string msg = buf.ValueOrDie()->ToString();
+    const size_t eos_len = ARROW_IPC_STREAM_EOS.size();
+    if (msg.size() < eos_len ||
+        msg.compare(msg.size() - eos_len, eos_len, ARROW_IPC_STREAM_EOS) != 0)
+        return TablesErrCodes::ArrowStatusErr;
+    out.append(msg, 0, msg.size() - eos_len);
+    return 0;
+}
+
+/*
+ * Function: printArrowIpcStreamSchema
+ * Description: Append the schema message of an arrow ipc stream whose schema
+ *              was not set by any result, i.e. no object returned rows. The
+ *              schema is made from the query schema, so readers can open the
+ *              stream. The caller ends the stream with ARROW_IPC_STREAM_EOS.
+ * @param[in] stream       : shared state of the output stream
+ * @param[in] query_schema : schema of the query
+ * @param[out] out         : stream output
+ * Return Value: error code
+ */
+int printArrowIpcStreamSchema(
+        arrow_ipc_stream& stream,
+        schema_vec& query_schema,
+        std::string& out)
+{
+    std::lock_guard<std::mutex> l(stream.lock);
+    if (stream.schema == nullptr) {
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        for (auto& col : query_schema) {
+            std::shared_ptr<arrow::DataType> type = sky_arrow_type(col.type);
+            if (type == nullptr)
+                return TablesErrCodes::UnknownSkyDataType;
+            fields.push_back(arrow::field(col.name, type));
+        }
+        stream.schema = arrow::schema(fields);
+    }
+    return ipc_schema_message(stream.schema, out);
+}
+
+static inline bool arrow_row_deleted(
+        const std::shared_ptr<arrow::BooleanArray>& del_vec,
+        int64_t i)
+{
+    return del_vec && del_vec->IsValid(i) && del_vec->Value(i);
+}
+
+/*
+ * Function: printArrowbufAsIpcStream
+ * Description: Append the rows of an arrow result buffer to an arrow ipc
+ *              stream. The stream schema is set by the first result formatted
+ *              and leaves out the internal RID and DELETED_VECTOR columns. The
+ *              rows of every result are projected to it by column name, a
+ *              result whose columns do not match is an error. Deleted rows
+ *              and rows beyond max_to_print are left out. Record batches are
+ *              appended byte for byte when nothing needs to be left out,
+ *              otherwise re-serialized. Dictionary encoded results are not
+ *              supported. With print_header set only the schema message is
+ *              appended, it must be written once before any batches. The
+ *              caller ends the stream with ARROW_IPC_STREAM_EOS.
+ * @param[in] dataptr      : arrow ipc stream buffer of one result
+ * @param[in] datasz       : size of the buffer
+ * @param[in] print_header : append the schema message instead of the batches
+ * @param[in] print_verbose: print the skyhook metadata of the schema
+ * @param[in] max_to_print : row limit
+ * @param[in] stream       : shared state of the output stream
+ * @param[out] out         : stream output
+ * Return Value: number of rows appended, or negative error code
+ */
+long long int printArrowbufAsIpcStream(
+        const char* dataptr,
+        const size_t datasz,
+        bool print_header,
+        bool print_verbose,
+        long long int max_to_print,
+        arrow_ipc_stream& stream,
+        std::string& out)
+{
+    // read the messages in place, offsets into the stream tell which bytes
+    // each message spans.
+    std::shared_ptr<arrow::Buffer> buffer = std::make_shared<arrow::Buffer>(
+        reinterpret_cast<const uint8_t*>(dataptr), datasz);
+    std::shared_ptr<arrow::io::BufferReader> input =
+        std::make_shared<arrow::io::BufferReader>(buffer);
+    std::unique_ptr<arrow::ipc::MessageReader> reader =
+        arrow::ipc::MessageReader::Open(input);
+
+    std::shared_ptr<arrow::Schema> schema;
+    std::shared_ptr<arrow::Schema> out_schema;
+    std::vector<int> out_cols;  // result column of each stream column
+    bool passthru = false;      // result batches are stream batches as is
+    arrow::ipc::DictionaryMemo memo;
+    int del_idx = -1;
+    long long int counter = 0;
+
+    while (counter < max_to_print || print_header) {
+        int64_t msg_start = input->Tell().ValueOrDie();
+        arrow::Result<std::unique_ptr<arrow::ipc::Message>> next =
+            reader->ReadNextMessage();
+        if (!next.ok())
+            return -TablesErrCodes::ArrowStatusErr;
+        std::unique_ptr<arrow::ipc::Message> msg = std::move(next).ValueOrDie();
+        if (msg == nullptr)
+            break;  // end of the result stream
+        int64_t msg_len = input->Tell().ValueOrDie() - msg_start;
+
+        if (msg->type() == arrow::ipc::MessageType::SCHEMA) {
+            arrow::Result<std::shared_ptr<arrow::Schema>> sch =
+                arrow::ipc::ReadSchema(*msg, &memo);
+            if (!sch.ok())
+                return -TablesErrCodes::ArrowStatusErr;
+            schema = sch.ValueOrDie();
+            for (auto& f : schema->fields()) {
+                if (f->type()->id() == arrow::Type::DICTIONARY)
+                    return -TablesErrCodes::SkyOutputBinaryNotImplemented;
+            }
+            if (print_verbose && schema->metadata()) {
+                auto metadata = schema->metadata();
+                printArrowHeader(metadata);
+            }
+            {
+                std::lock_guard<std::mutex> l(stream.lock);
+                if (stream.schema == nullptr)
+                    stream.schema = ipc_stream_schema(schema);
+                out_schema = stream.schema;
+            }
+            if (print_header) {
+                int ret = ipc_schema_message(out_schema, out);
+                return ret ? -ret : 0;
+            }
+
+            // map the stream columns to the result columns by name
+            passthru = (out_schema->num_fields() == schema->num_fields());
+            for (int i = 0; i < out_schema->num_fields(); i++) {
+                auto f = out_schema->field(i);
+                int idx = schema->GetFieldIndex(f->name());
+                if (idx < 0 || !schema->field(idx)->type()->Equals(f->type()))
+                    return -TablesErrCodes::RequestedColNotPresent;
+                out_cols.push_back(idx);
+                passthru = passthru && idx == i;
+            }
+            del_idx = schema->GetFieldIndex("DELETED_VECTOR");
+            if (del_idx >= 0 &&
+                schema->field(del_idx)->type()->id() != arrow::Type::BOOL)
+                del_idx = -1;
+            continue;
+        }
+
+        // dictionary batches would have to be merged across results
+        if (msg->type() != arrow::ipc::MessageType::RECORD_BATCH)
+            return -TablesErrCodes::SkyOutputBinaryNotImplemented;
+        if (schema == nullptr)
+            return -TablesErrCodes::ArrowStatusErr;
+
+        arrow::Result<std::shared_ptr<arrow::RecordBatch>> rb =
+            arrow::ipc::ReadRecordBatch(*msg, schema, &memo,
+                                        arrow::ipc::IpcReadOptions::Defaults());
+        if (!rb.ok())
+            return -TablesErrCodes::ArrowStatusErr;
+        std::shared_ptr<arrow::RecordBatch> batch = rb.ValueOrDie();
+        const int64_t nrows = batch->num_rows();
+
+        std::shared_ptr<arrow::BooleanArray> del_vec;
+        if (del_idx >= 0)
+            del_vec = std::static_pointer_cast<arrow::BooleanArray>(
+                batch->column(del_idx));
+        bool has_deleted = false;
+        for (int64_t i = 0; del_vec && i < nrows && !has_deleted; i++)
+            has_deleted = arrow_row_deleted(del_vec, i);
+
+        if (passthru && !has_deleted && nrows <= max_to_print - counter) {
+            out.append(dataptr + msg_start, msg_len);
+            counter += nrows;
+            continue;
+        }
+
+        std::vector<std::shared_ptr<arrow::Array>> columns;
+        for (int idx : out_cols)
+            columns.push_back(batch->column(idx));
+        std::shared_ptr<arrow::RecordBatch> out_batch =
+            arrow::RecordBatch::Make(out_schema, nrows, columns);
+
+        // write each run of live rows as its own batch
+        int64_t i = 0;
+        while (i < nrows && counter < max_to_print) {
+            if (arrow_row_deleted(del_vec, i)) {
+                i++;
+                continue;
+            }
+            int64_t j = i;
+            while (j < nrows && !arrow_row_deleted(del_vec, j) &&
+                   j - i < max_to_print - counter)
+                j++;
+            arrow::Result<std::shared_ptr<arrow::Buffer>> ser =
+                arrow::ipc::SerializeRecordBatch(
+                    *out_batch->Slice(i, j - i),
+                    arrow::ipc::IpcWriteOptions::Defaults());
+            if (!ser.ok())
+                return -TablesErrCodes::ArrowStatusErr;
+            std::shared_ptr<arrow::Buffer> sbuf = ser.ValueOrDie();
+            out.append(reinterpret_cast<const char*>(sbuf->data()),
+                       sbuf->size());
+            counter += j - i;
+            i = j;
+        }
+    }
+    return counter;
+}
+
+// returns true if the nullbit for col_idx is set in the record's nullbits
+static inline bool flx_is_null(const flatbuffers::Vector<uint64_t>* nullbits,
+                               int col_idx)
+{
+    if (nullbits == nullptr)
+        return false;
+    int pos = col_idx / (8 * sizeof(uint64_t));
+    uint64_t col_bitmask = 1ull << (col_idx % (8 * sizeof(uint64_t)));
+    return (nullbits->Get(pos) & col_bitmask) != 0;
+}
+
+// builds one fixed width arrow column from the pre-resolved flexbuffer rows,
+// get() extracts the typed value from a row element.
+template <typename ArrowType, typename Getter>
+static arrow::Status flx_col_to_array(
+        const std::vector<flexbuffers::Vector>& rows,
+        const std::vector<const flatbuffers::Vector<uint64_t>*>& nullbits,
+        const col_info& col,
+        Getter get,
+        arrow::MemoryPool* pool,
+        std::shared_ptr<arrow::Array>* array)
+{
+    typename arrow::TypeTraits<ArrowType>::BuilderType builder(pool);
+    arrow::Status s = builder.Reserve(rows.size());
+    if (!s.ok())
+        return s;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (col.nullable && flx_is_null(nullbits[i], col.idx))
+            builder.UnsafeAppendNull();
+        else
+            builder.UnsafeAppend(get(rows[i][col.idx]));
+    }
+    return builder.Finish(array);
+}
+
+// builds one string arrow column, the value data is reserved up front.
+static arrow::Status flx_string_col_to_array(
+        const std::vector<flexbuffers::Vector>& rows,
+        const std::vector<const flatbuffers::Vector<uint64_t>*>& nullbits,
+        const col_info& col,
+        arrow::MemoryPool* pool,
+        std::shared_ptr<arrow::Array>* array)
+{
+    arrow::StringBuilder builder(pool);
+
+    // resolve each string once, for sizing and for appending
+    std::vector<flexbuffers::String> strs;
+    std::vector<bool> nulls(rows.size(), false);
+    int64_t data_len = 0;
+    strs.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (col.nullable && flx_is_null(nullbits[i], col.idx)) {
+            nulls[i] = true;
+            strs.push_back(flexbuffers::String::EmptyString());
+        }
+        else {
+            strs.push_back(rows[i][col.idx].AsString());
+            data_len += strs.back().size();
+        }
+    }
+    arrow::Status s = builder.Reserve(rows.size());
+    if (s.ok())
+        s = builder.ReserveData(data_len);
+    if (!s.ok())
+        return s;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (nulls[i])
+            builder.UnsafeAppendNull();
+        else
+            builder.UnsafeAppend(strs[i].c_str(), strs[i].size());
+    }
+    return builder.Finish(array);
+}
+
 /*
  * Function: transform_fb_to_arrow
  * Description: Build arrow schema vector using skyhook schema information. Get the
- *              details of columns from skyhook schema and using array builders for
- *              each datatype add the data to array vectors. Finally, create arrow
- *              table using array vectors and schema vector.
+ *              details of columns from skyhook schema and using typed array
+ *              builders pre-sized to the number of rows, add the data to
+ *              array vectors one column at a time. Every row is kept, along
+ *              with its delete flag in the DELETED_VECTOR column.
+ *              Finally, create arrow table using array vectors and schema vector.
  * @param[in] fb      : Flatbuffer to be converted
  * @param[in] size    : Size of the flatbuffer
  * @param[out] errmsg : errmsg buffer
@@ -3826,16 +4635,33 @@ int transform_fb_to_arrow(const char* fb,
     int errcode = 0;
     sky_root root = getSkyRoot(fb, fb_size);
     schema_vec sc = schemaFromString(root.data_schema);
-    delete_vector del_vec = root.delete_vec;
+    delete_vector& del_vec = root.delete_vec;
     uint32_t nrows = root.nrows;
+    row_offs data_vec = static_cast<row_offs>(root.data_vec);
 
     // Initialization related to Apache Arrow
     auto pool = arrow::default_memory_pool();
-    std::vector<arrow::ArrayBuilder *> builder_list;
     std::vector<std::shared_ptr<arrow::Array>> array_list;
     std::vector<std::shared_ptr<arrow::Field>> schema_vector;
     std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
 
+    // Resolve the rows once, the columns are built from them below.
+    std::vector<flexbuffers::Vector> rows;
+    std::vector<const flatbuffers::Vector<uint64_t>*> nullbits;
+    std::vector<int64_t> rids;
+    std::vector<bool> dels;
+    rows.reserve(nrows);
+    nullbits.reserve(nrows);
+    rids.reserve(nrows);
+    dels.reserve(nrows);
+    for (uint32_t i = 0; i < nrows; i++) {
+        const Tables::Record* rec = data_vec->Get(i);
+        rows.push_back(rec->data_flexbuffer_root().AsVector());
+        nullbits.push_back(rec->nullbits());
+        rids.push_back(rec->RID());
+        dels.push_back(i < del_vec.size() && del_vec[i]);
+    }
+
     // Add skyhook metadata to arrow metadata.
     // NOTE: Preserve the order of appending, as later they will be referenced using
     // enums.
@@ -3870,115 +4696,87 @@ int transform_fb_to_arrow(const char* fb,
     metadata->Append(ToString(METADATA_TABLE_NAME), root.table_name);
     metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(root.nrows));
 
-    // Iterate through schema vector to get the details of columns i.e name and type.
-    for (auto it = query_schema.begin(); it != query_schema.end() && !errcode; ++it) {
+    // Build the data columns one at a time.
+    for (auto it = query_schema.begin(); it != query_schema.end(); ++it) {
         col_info col = *it;
-
-        // Create the array builders for respective datatypes. Use these array
-        // builders to store data to array vectors. These array vectors holds the
-        // actual column values. Also, add the details of column
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status s;
 
         switch(col.type) {
 
-            case SDT_BOOL: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::BooleanBuilder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_BOOL:
+                s = flx_col_to_array<arrow::BooleanType>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsBool(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::boolean()));
                 break;
-            }
-            case SDT_INT8: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int8Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_CHAR:
+            case SDT_INT8:
+                s = flx_col_to_array<arrow::Int8Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsInt8(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::int8()));
                 break;
-            }
-            case SDT_INT16: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int16Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_INT16:
+                s = flx_col_to_array<arrow::Int16Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsInt16(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::int16()));
                 break;
-            }
-            case SDT_INT32: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int32Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_INT32:
+                s = flx_col_to_array<arrow::Int32Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsInt32(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::int32()));
                 break;
-            }
-            case SDT_INT64: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int64Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_INT64:
+                s = flx_col_to_array<arrow::Int64Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsInt64(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::int64()));
                 break;
-            }
-            case SDT_UINT8: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::UInt8Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_UCHAR:
+            case SDT_UINT8:
+                s = flx_col_to_array<arrow::UInt8Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsUInt8(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::uint8()));
                 break;
-            }
-            case SDT_UINT16: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::UInt16Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_UINT16:
+                s = flx_col_to_array<arrow::UInt16Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsUInt16(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::uint16()));
                 break;
-            }
-            case SDT_UINT32: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::UInt32Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_UINT32:
+                s = flx_col_to_array<arrow::UInt32Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsUInt32(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::uint32()));
                 break;
-            }
-            case SDT_UINT64: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::UInt64Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_UINT64:
+                s = flx_col_to_array<arrow::UInt64Type>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsUInt64(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::uint64()));
                 break;
-            }
-            case SDT_FLOAT: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::FloatBuilder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_FLOAT:
+                s = flx_col_to_array<arrow::FloatType>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsFloat(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::float32()));
                 break;
-            }
-            case SDT_DOUBLE: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::DoubleBuilder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_DOUBLE:
+                s = flx_col_to_array<arrow::DoubleType>(rows, nullbits, col,
+                        [](const flexbuffers::Reference& r) { return r.AsDouble(); },
+                        pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::float64()));
                 break;
-            }
-            case SDT_CHAR: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int8Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
-                schema_vector.push_back(arrow::field(col.name, arrow::int8()));
-                break;
-            }
-            case SDT_UCHAR: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::UInt8Builder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
-                schema_vector.push_back(arrow::field(col.name, arrow::uint8()));
-                break;
-            }
             case SDT_DATE:
-            case SDT_STRING: {
-                auto ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::StringBuilder(pool));
-                builder_list.emplace_back(ptr.get());
-                ptr.release();
+            case SDT_STRING:
+                s = flx_string_col_to_array(rows, nullbits, col, pool, &array);
                 schema_vector.push_back(arrow::field(col.name, arrow::utf8()));
                 break;
-            }
             default: {
                 errcode = TablesErrCodes::UnsupportedSkyDataType;
                 errmsg.append("ERROR transform_row_to_col(): table=" +
@@ -3988,117 +4786,43 @@ int transform_fb_to_arrow(const char* fb,
                 return errcode;
             }
         }
+        if (!s.ok()) {
+            errcode = TablesErrCodes::ArrowStatusErr;
+            errmsg.append("ERROR transform_fb_to_arrow(): col=" + col.name +
+                          " " + s.ToString());
+            return errcode;
+        }
+        array_list.push_back(array);
     }
 
     // Add RID column
-    auto rid_ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::Int64Builder(pool));
-    builder_list.emplace_back(rid_ptr.get());
-    rid_ptr.release();
-    schema_vector.push_back(arrow::field("RID", arrow::int64()));
-
-    // Add deleted vector column
-    auto dv_ptr = std::unique_ptr<arrow::ArrayBuilder>(new arrow::BooleanBuilder(pool));
-    builder_list.emplace_back(dv_ptr.get());
-    dv_ptr.release();
-    schema_vector.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
-
-    // Iterate through rows and store data in each row in respective columns.
-    for (uint32_t i = 0; i < nrows; i++) {
-
-        // Get a skyhook record struct
-        sky_rec rec = getSkyRec(static_cast<row_offs>(root.data_vec)->Get(i));
-
-        // Get the row as a vector.
-        auto row = rec.data.AsVector();
-
-        // For the current row, go from 0 to num_cols and append the data into array
-        // builders.
-        for (auto it = query_schema.begin(); it != query_schema.end() && !errcode; ++it) {
-            auto builder = builder_list[std::distance(query_schema.begin(), it)];
-            col_info col = *it;
-
-            if (col.nullable) {  // check nullbit
-                bool is_null = false;
-                int pos = col.idx / (8*sizeof(rec.nullbits.at(0)));
-                int col_bitmask = 1 << col.idx;
-                if ((col_bitmask & rec.nullbits.at(pos)) == 1)  {
-                    is_null = true;
-                }
-                if (is_null) {
-                    builder->AppendNull();
-                    continue;
-                }
-            }
-
-            // Append data to the respective data type builders
-            switch(col.type) {
-
-                case SDT_BOOL:
-                    static_cast<arrow::BooleanBuilder *>(builder)->Append(row[col.idx].AsBool());
-                    break;
-                case SDT_INT8:
-                    static_cast<arrow::Int8Builder *>(builder)->Append(row[col.idx].AsInt8());
-                    break;
-                case SDT_INT16:
-                    static_cast<arrow::Int16Builder *>(builder)->Append(row[col.idx].AsInt16());
-                    break;
-                case SDT_INT32:
-                    static_cast<arrow::Int32Builder *>(builder)->Append(row[col.idx].AsInt32());
-                    break;
-                case SDT_INT64:
-                    static_cast<arrow::Int64Builder *>(builder)->Append(row[col.idx].AsInt64());
-                    break;
-                case SDT_UINT8:
-                    static_cast<arrow::UInt8Builder *>(builder)->Append(row[col.idx].AsUInt8());
-                    break;
-                case SDT_UINT16:
-                    static_cast<arrow::UInt16Builder *>(builder)->Append(row[col.idx].AsUInt16());
-                    break;
-                case SDT_UINT32:
-                    static_cast<arrow::UInt32Builder *>(builder)->Append(row[col.idx].AsUInt32());
-                    break;
-                case SDT_UINT64:
-                    static_cast<arrow::UInt64Builder *>(builder)->Append(row[col.idx].AsUInt64());
-                    break;
-                case SDT_FLOAT:
-                    static_cast<arrow::FloatBuilder *>(builder)->Append(row[col.idx].AsFloat());
-                    break;
-                case SDT_DOUBLE:
-                    static_cast<arrow::DoubleBuilder *>(builder)->Append(row[col.idx].AsDouble());
-                    break;
-                case SDT_CHAR:
-                    static_cast<arrow::Int8Builder *>(builder)->Append(row[col.idx].AsInt8());
-                    break;
-                case SDT_UCHAR:
-                    static_cast<arrow::UInt8Builder *>(builder)->Append(row[col.idx].AsUInt8());
-                    break;
-                case SDT_DATE:
-                case SDT_STRING:
-                    static_cast<arrow::StringBuilder *>(builder)->Append(row[col.idx].AsString().str());
-                    break;
-                default: {
-                    errcode = TablesErrCodes::UnsupportedSkyDataType;
-                    errmsg.append("ERROR transform_row_to_col(): table=" +
-                                  root.table_name + " col.type=" +
-                                  std::to_string(col.type) +
-                                  " UnsupportedSkyDataType.");
-                }
-            }
+    {
+        arrow::Int64Builder builder(pool);
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status s = builder.AppendValues(rids);
+        if (s.ok())
+            s = builder.Finish(&array);
+        if (!s.ok()) {
+            errmsg.append("ERROR transform_fb_to_arrow(): RID " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
         }
-
-        // Add entries for RID and Deleted vector
-        int num_cols = query_schema.size();
-        static_cast<arrow::Int64Builder *>(builder_list[ARROW_RID_INDEX(num_cols)])->Append(rec.RID);
-        static_cast<arrow::BooleanBuilder *>(builder_list[ARROW_DELVEC_INDEX(num_cols)])->Append(del_vec[i]);
+        array_list.push_back(array);
+        schema_vector.push_back(arrow::field("RID", arrow::int64()));
     }
 
-    // Finalize the arrays holding the data
-    for (auto it = builder_list.begin(); it != builder_list.end(); ++it) {
-        auto builder = *it;
+    // Add deleted vector column
+    {
+        arrow::BooleanBuilder builder(pool);
         std::shared_ptr<arrow::Array> array;
-        builder->Finish(&array);
+        arrow::Status s = builder.AppendValues(dels);
+        if (s.ok())
+            s = builder.Finish(&array);
+        if (!s.ok()) {
+            errmsg.append("ERROR transform_fb_to_arrow(): DELETED_VECTOR " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
         array_list.push_back(array);
-        delete builder;
+        schema_vector.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
     }
 
     // Generate schema from schema vector and add the metadata
@@ -4131,6 +4855,324 @@ int transform_arrow_to_fb(const char* data,
     return 0;
 }
 
+// returns the number of bits needed to store values in [0, max_val]
+uint32_t skycol_bit_width(uint64_t max_val)
+{
+    uint32_t bits = 0;
+    while (max_val) {
+        bits++;
+        max_val >>= 1;
+    }
+    return bits;
+}
+
+// packs vals into bit_width bits each
+static std::vector<uint64_t> skycol_pack(const std::vector<uint64_t>& vals,
+                                         uint32_t bit_width)
+{
+    std::vector<uint64_t> packed((vals.size() * bit_width + 63) / 64, 0);
+    if (bit_width == 0)
+        return packed;
+    for (size_t i = 0; i < vals.size(); i++) {
+        uint64_t bit = i * bit_width;
+        uint64_t word = bit >> 6;
+        uint64_t shift = bit & 63;
+        packed[word] |= vals[i] << shift;
+        if (shift + bit_width > 64)
+            packed[word + 1] |= vals[i] >> (64 - shift);
+    }
+    return packed;
+}
+
+// reads an integer typed arrow value as int64, unsigned values keep their
+// bit pattern.
+static int64_t skycol_arrow_int(const std::shared_ptr<arrow::Array>& arr,
+                                int type, int64_t i)
+{
+    switch (type) {
+        case SDT_BOOL:
+            return std::static_pointer_cast<arrow::BooleanArray>(arr)->Value(i);
+        case SDT_CHAR:
+        case SDT_INT8:
+            return std::static_pointer_cast<arrow::Int8Array>(arr)->Value(i);
+        case SDT_INT16:
+            return std::static_pointer_cast<arrow::Int16Array>(arr)->Value(i);
+        case SDT_INT32:
+            return std::static_pointer_cast<arrow::Int32Array>(arr)->Value(i);
+        case SDT_INT64:
+            return std::static_pointer_cast<arrow::Int64Array>(arr)->Value(i);
+        case SDT_UCHAR:
+        case SDT_UINT8:
+            return std::static_pointer_cast<arrow::UInt8Array>(arr)->Value(i);
+        case SDT_UINT16:
+            return std::static_pointer_cast<arrow::UInt16Array>(arr)->Value(i);
+        case SDT_UINT32:
+            return std::static_pointer_cast<arrow::UInt32Array>(arr)->Value(i);
+        case SDT_UINT64:
+            return static_cast<int64_t>(
+                std::static_pointer_cast<arrow::UInt64Array>(arr)->Value(i));
+        default:
+            return 0;
+    }
+}
+
+// encodes one arrow column as a Column_COL, picking the smaller of the
+// encodings applicable to its type.
+static int skycol_encode_col(flatbuffers::FlatBufferBuilder& flatbldr,
+                             const col_info& col,
+                             const std::shared_ptr<arrow::Array>& arr,
+                             std::string& errmsg,
+                             flatbuffers::Offset<Column_COL>* out)
+{
+    int64_t nrows = arr->length();
+
+    // nulls are kept in a bitmap, their encoded value is unused
+    std::vector<uint64_t> nullbits;
+    if (arr->null_count() > 0) {
+        nullbits.assign((nrows + 63) / 64, 0);
+        for (int64_t i = 0; i < nrows; i++) {
+            if (arr->IsNull(i))
+                nullbits[i / 64] |= 1ull << (i % 64);
+        }
+    }
+    auto nullbits_off = nullbits.empty() ? 0 : flatbldr.CreateVector(nullbits);
+
+    switch (col.type) {
+
+        case SDT_BOOL:
+        case SDT_CHAR:
+        case SDT_UCHAR:
+        case SDT_INT8:
+        case SDT_INT16:
+        case SDT_INT32:
+        case SDT_INT64:
+        case SDT_UINT8:
+        case SDT_UINT16:
+        case SDT_UINT32:
+        case SDT_UINT64: {
+            // uint64 values are ordered unsigned, min/max keep their bits
+            std::vector<int64_t> vals(nrows);
+            int64_t min_val = 0;
+            int64_t max_val = 0;
+            bool first = true;
+            bool is_unsigned = (col.type == SDT_UINT64);
+            auto less = [is_unsigned](int64_t a, int64_t b) {
+                return is_unsigned ?
+                    static_cast<uint64_t>(a) < static_cast<uint64_t>(b) : a < b;
+            };
+            for (int64_t i = 0; i < nrows; i++) {
+                if (arr->IsNull(i))
+                    continue;
+                vals[i] = skycol_arrow_int(arr, col.type, i);
+                if (first || less(vals[i], min_val)) min_val = vals[i];
+                if (first || less(max_val, vals[i])) max_val = vals[i];
+                first = false;
+            }
+            std::vector<uint32_t> run_ends;
+            std::vector<int64_t> run_values;
+            for (int64_t i = 0; i < nrows; i++) {
+                if (arr->IsNull(i))
+                    vals[i] = min_val;
+                if (run_values.empty() || run_values.back() != vals[i]) {
+                    run_values.push_back(vals[i]);
+                    run_ends.push_back(i + 1);
+                } else {
+                    run_ends.back() = i + 1;
+                }
+            }
+            uint32_t bit_width = skycol_bit_width(
+                static_cast<uint64_t>(max_val) - static_cast<uint64_t>(min_val));
+            size_t for_size = ((nrows * bit_width + 63) / 64) * sizeof(uint64_t);
+            size_t rle_size = run_ends.size() * (sizeof(uint32_t) + sizeof(int64_t));
+
+            if (rle_size < for_size) {
+                auto ends_off = flatbldr.CreateVector(run_ends);
+                auto values_off = flatbldr.CreateVector(run_values);
+                *out = CreateColumn_COL(flatbldr, col.idx, SCE_RLE,
+                                        nullbits_off, min_val, max_val, 0, 0,
+                                        ends_off, values_off);
+            } else {
+                std::vector<uint64_t> offsets(nrows);
+                for (int64_t i = 0; i < nrows; i++)
+                    offsets[i] = static_cast<uint64_t>(vals[i]) -
+                                 static_cast<uint64_t>(min_val);
+                auto packed_off = flatbldr.CreateVector(skycol_pack(offsets, bit_width));
+                *out = CreateColumn_COL(flatbldr, col.idx, SCE_FOR_BITPACK,
+                                        nullbits_off, min_val, max_val,
+                                        bit_width, packed_off);
+            }
+            return 0;
+        }
+
+        case SDT_FLOAT:
+        case SDT_DOUBLE: {
+            std::vector<double> vals(nrows, 0);
+            for (int64_t i = 0; i < nrows; i++) {
+                if (arr->IsNull(i))
+                    continue;
+                if (col.type == SDT_FLOAT)
+                    vals[i] = std::static_pointer_cast<arrow::FloatArray>(arr)->Value(i);
+                else
+                    vals[i] = std::static_pointer_cast<arrow::DoubleArray>(arr)->Value(i);
+            }
+            auto doubles_off = flatbldr.CreateVector(vals);
+            *out = CreateColumn_COL(flatbldr, col.idx, SCE_PLAIN,
+                                    nullbits_off, 0, 0, 0, 0, 0, 0, 0,
+                                    doubles_off);
+            return 0;
+        }
+
+        case SDT_DATE:
+        case SDT_STRING: {
+            auto str_arr = std::static_pointer_cast<arrow::StringArray>(arr);
+
+            // sorted dictionary, so codes keep the order of the values
+            std::map<std::string, uint32_t> dict_map;
+            for (int64_t i = 0; i < nrows; i++) {
+                if (arr->IsNull(i))
+                    continue;
+                dict_map.emplace(str_arr->GetString(i), 0);
+            }
+
+            // high cardinality columns are left plain
+            if (dict_map.size() > static_cast<size_t>(nrows / 2)) {
+                std::vector<std::string> vals(nrows);
+                for (int64_t i = 0; i < nrows; i++) {
+                    if (!arr->IsNull(i))
+                        vals[i] = str_arr->GetString(i);
+                }
+                auto strings_off = flatbldr.CreateVectorOfStrings(vals);
+                *out = CreateColumn_COL(flatbldr, col.idx, SCE_PLAIN,
+                                        nullbits_off, 0, 0, 0, 0, 0, 0, 0, 0,
+                                        strings_off);
+                return 0;
+            }
+
+            std::vector<std::string> dict;
+            for (auto& d : dict_map) {
+                d.second = dict.size();
+                dict.push_back(d.first);
+            }
+            std::vector<uint64_t> codes(nrows, 0);
+            std::vector<uint32_t> run_ends;
+            std::vector<int64_t> run_values;
+            for (int64_t i = 0; i < nrows; i++) {
+                if (!arr->IsNull(i))
+                    codes[i] = dict_map[str_arr->GetString(i)];
+                if (run_values.empty() ||
+                    run_values.back() != static_cast<int64_t>(codes[i])) {
+                    run_values.push_back(codes[i]);
+                    run_ends.push_back(i + 1);
+                } else {
+                    run_ends.back() = i + 1;
+                }
+            }
+            uint32_t bit_width = skycol_bit_width(dict.empty() ? 0 : dict.size() - 1);
+            size_t dict_size = ((nrows * bit_width + 63) / 64) * sizeof(uint64_t);
+            size_t rle_size = run_ends.size() * (sizeof(uint32_t) + sizeof(int64_t));
+
+            auto dict_off = flatbldr.CreateVectorOfStrings(dict);
+            if (rle_size < dict_size) {
+                auto ends_off = flatbldr.CreateVector(run_ends);
+                auto values_off = flatbldr.CreateVector(run_values);
+                *out = CreateColumn_COL(flatbldr, col.idx, SCE_RLE,
+                                        nullbits_off, 0, 0, 0, 0,
+                                        ends_off, values_off, dict_off);
+            } else {
+                auto packed_off = flatbldr.CreateVector(skycol_pack(codes, bit_width));
+                *out = CreateColumn_COL(flatbldr, col.idx, SCE_DICT,
+                                        nullbits_off, 0, 0, bit_width,
+                                        packed_off, 0, 0, dict_off);
+            }
+            return 0;
+        }
+
+        default:
+            errmsg.append("ERROR transform_arrow_to_skycol(): col=" + col.name +
+                          " col.type=" + std::to_string(col.type) +
+                          " UnsupportedSkyDataType.");
+            return TablesErrCodes::UnsupportedSkyDataType;
+    }
+}
+
+/*
+ * Function: transform_arrow_to_skycol
+ * Description: Encode the arrow table into the SFT_FLATBUF_UNION_COL format,
+ *              a flatbuffer holding one Column_COL per schema column. Integer
+ *              columns are frame of reference bit-packed or run length
+ *              encoded, low cardinality string columns are dictionary coded
+ *              (bit-packed or run length encoded codes), floating point and
+ *              high cardinality string columns are stored plain. For each
+ *              column the smaller applicable encoding is used.
+ * @param[in] table     : Arrow table with skyhook metadata, RID and deleted
+ *                        vector columns
+ * @param[out] errmsg   : errmsg buffer
+ * @param[out] flatbldr : flatbuffer builder of the Table_COL
+ * Return Value: error code
+ */
+int transform_arrow_to_skycol(std::shared_ptr<arrow::Table>& table,
+                              std::string& errmsg,
+                              flatbuffers::FlatBufferBuilder& flatbldr)
+{
+    int errcode = 0;
+    arrow::Result<std::shared_ptr<arrow::Table>> combined =
+        table->CombineChunks(arrow::default_memory_pool());
+    if (!combined.ok()) {
+        errmsg.append("ERROR transform_arrow_to_skycol(): CombineChunks");
+        return TablesErrCodes::ArrowStatusErr;
+    }
+    std::shared_ptr<arrow::Table> input_table = combined.ValueOrDie();
+    auto metadata = input_table->schema()->metadata();
+    schema_vec sc = schemaFromString(metadata->value(METADATA_DATA_SCHEMA));
+    int num_cols = sc.size();
+    int64_t nrows = input_table->num_rows();
+
+    // an empty arrow column has no chunks
+    auto column_array = [&input_table](int idx) -> std::shared_ptr<arrow::Array> {
+        auto col = input_table->column(idx);
+        if (col->num_chunks() == 0)
+            return arrow::MakeArrayOfNull(col->type(), 0).ValueOrDie();
+        return col->chunk(0);
+    };
+
+    std::vector<uint64_t> rids(nrows);
+    std::vector<uint8_t> delete_vec(nrows);
+    auto rid_arr = std::static_pointer_cast<arrow::Int64Array>(
+        column_array(ARROW_RID_INDEX(num_cols)));
+    auto del_arr = std::static_pointer_cast<arrow::BooleanArray>(
+        column_array(ARROW_DELVEC_INDEX(num_cols)));
+    for (int64_t i = 0; i < nrows; i++) {
+        rids[i] = rid_arr->Value(i);
+        delete_vec[i] = del_arr->Value(i);
+    }
+
+    std::vector<flatbuffers::Offset<Column_COL>> cols;
+    for (auto it = sc.begin(); it != sc.end(); ++it) {
+        flatbuffers::Offset<Column_COL> col_off;
+        errcode = skycol_encode_col(flatbldr, *it, column_array(it->idx),
+                                    errmsg, &col_off);
+        if (errcode)
+            return errcode;
+        cols.push_back(col_off);
+    }
+
+    auto root = CreateTable_COLDirect(
+        flatbldr,
+        SFT_FLATBUF_UNION_COL,
+        std::stoi(metadata->value(METADATA_SKYHOOK_VERSION)),
+        std::stoi(metadata->value(METADATA_DATA_STRUCTURE_VERSION)),
+        std::stoi(metadata->value(METADATA_DATA_SCHEMA_VERSION)),
+        metadata->value(METADATA_DATA_SCHEMA).c_str(),
+        metadata->value(METADATA_DB_SCHEMA).c_str(),
+        metadata->value(METADATA_TABLE_NAME).c_str(),
+        &delete_vec,
+        &rids,
+        &cols,
+        nrows);
+    flatbldr.Finish(root);
+    return errcode;
+}
+
 // a simple func called from a registered cls class method in cls_tabular.cc
 int example_func(int counter) {
 
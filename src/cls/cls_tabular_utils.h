@@ -16,6 +16,8 @@
 #include <sstream>
 #include <type_traits>
 #include <bitset>
+#include <map>
+#include <mutex>
 
 #include <include/types.h>
 #include <errno.h>
@@ -30,6 +32,11 @@
 #include <arrow/io/memory.h>
 #include <arrow/ipc/writer.h>
 #include <arrow/ipc/reader.h>
+#include <arrow/util/compression.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+#include <parquet/statistics.h>
 
 #include "re2/re2.h"
 #include "objclass/objclass.h"
@@ -39,6 +46,7 @@
 #include "flatbuffers/flexbuffers.h"
 #include "skyhookv2_generated.h"
 #include "skyhookv2_csv_generated.h"
+#include "skyhookv2_col_generated.h"
 #include "fb_meta_generated.h"
 
 namespace Tables {
@@ -83,7 +91,8 @@ enum TablesErrCodes {
     EDECODE_BUFFERLIST_FAILURE,
     ECLIENTSIDE_PROCESSING_FAILURE,
     ESTORAGESIDE_PROCESSING_FAILURE,
-    EINVALID_COMPACTION_FORMAT
+    EINVALID_COMPACTION_FORMAT,
+    EBLOB_COMPRESSION_FAILURE
 };
 
 // skyhook data types, as supported by underlying data format
@@ -199,6 +208,15 @@ enum SkyIdxPlanType
     SIP_IDX_UNION
 };
 
+// column encodings of the SFT_FLATBUF_UNION_COL format (Column_COL)
+enum SkyColEncoding
+{
+    SCE_PLAIN = 0,      // doubles or strings as is
+    SCE_DICT,           // strings as bit-packed codes into a sorted dict
+    SCE_RLE,            // runs of int values or dict codes
+    SCE_FOR_BITPACK     // ints as bit-packed offsets from min_val
+};
+
 const std::map<SkyIdxType, std::string> SkyIdxTypeMap = {
     {SIT_IDX_FB, "IDX_FBF"},
     {SIT_IDX_RID, "IDX_RID"},
@@ -271,6 +289,9 @@ const std::string RID_INDEX = "_RID_INDEX_";
 const int RID_COL_INDEX = -99; // magic number...
 const long long int ROW_LIMIT_DEFAULT = LLONG_MAX;
 const int NULLBITS64T_SIZE = 2;  // len of nullbits vector
+const int64_t PARQUET_ROW_GROUP_ROWS = 10000;  // granularity of stats skipping
+// end of an arrow ipc stream: continuation marker then a zero length
+const std::string ARROW_IPC_STREAM_EOS("\xff\xff\xff\xff\0\0\0\0", 8);
 
 // value used for null in postgres binary
 const int32_t PGNULLBINARY = -1;
@@ -666,6 +687,7 @@ std::vector<std::string> colnamesFromSchema(schema_vec &schema);
 // the below are used in our root table
 typedef vector<uint8_t> delete_vector;
 typedef const flatbuffers::Vector<flatbuffers::Offset<Record>>* row_offs;
+typedef const flatbuffers::Vector<flatbuffers::Offset<Column_COL>>* col_offs;
 
 // the below are used in our row table
 typedef vector<uint64_t> nullbits_vector;
@@ -681,11 +703,13 @@ struct fb_meta_format {
 
     size_t blob_orig_off;  // optional: offset of blob data in orig file
     size_t blob_orig_len;  // optional: num bytes in orig file
-    int blob_compression;  // optional: populated by enum {none, lzw, ...}
+    int blob_compression;  // optional: populated by enum {none, lz4, zstd}
     int blob_format;       // required: enum SkyFormatType (flatbuf,arrow, ...)
     bool blob_deleted;     // required: has this data been deleted?
     size_t blob_size;      // required: number of bytes in data blob
     const char* blob_data; // required: actual formatted data
+    std::string blob_sort_cols; // optional: cols the rows are sorted by, see fb_meta.fbs
+    int blob_errcode;      // set if the blob could not be decompressed
 
     fb_meta_format (
         size_t _blob_orig_off,
@@ -694,17 +718,27 @@ struct fb_meta_format {
         int _blob_format,
         bool _blob_deleted,
         size_t _blob_size,
-        const char* _blob_data) :
+        const char* _blob_data,
+        std::string _blob_sort_cols="") :
                                 blob_orig_off(_blob_orig_off),
                                 blob_orig_len(_blob_orig_len),
                                 blob_compression(_blob_compression),
                                 blob_format(_blob_format),
                                 blob_deleted(_blob_deleted),
                                 blob_size(_blob_size),
-                                blob_data(_blob_data) {};
+                                blob_data(_blob_data),
+                                blob_sort_cols(_blob_sort_cols),
+                                blob_errcode(0) {};
 };
 typedef struct fb_meta_format sky_meta;
 
+// arrow ipc stream written across results, its schema is set by the first
+// result formatted and every later result is written with it.
+struct arrow_ipc_stream {
+    std::mutex lock;
+    std::shared_ptr<arrow::Schema> schema;
+};
+
 // skyhookdb root metadata, refering to a (sub)partition of rows
 // abstracts a partition from its underlying data format/layout
 // this struct should point directly to metadata and data of the
@@ -868,7 +902,22 @@ void createFbMeta(
     bool data_deleted=false,
     size_t data_orig_off=0,
     size_t data_orig_len=0,
-    CompressionType data_compression=none);
+    CompressionType data_compression=none,
+    const std::string& data_sort_cols="");
+
+// compress/decompress a data blob with the given codec, the compressed
+// blob is prefixed with its uncompressed size.
+int compress_blob(
+    CompressionType compression,
+    const char *data,
+    size_t data_size,
+    std::shared_ptr<arrow::Buffer>* out);
+
+int decompress_blob(
+    CompressionType compression,
+    const char *data,
+    size_t data_size,
+    std::shared_ptr<arrow::Buffer>* out);
 
 // these extract the current data format (flatbuf) into a skyhook
 // root table and row table data structure defined above, abstracting
@@ -894,6 +943,38 @@ sky_rec getSkyRec(
 *    int format=SFT_CSV);
 */
 
+// fast text formatting for the print functions below, which append their
+// output to a caller provided buffer rather than writing to std::cout.
+inline void csv_append_uint(std::string& out, uint64_t v)
+{
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+inline void csv_append_int(std::string& out, int64_t v)
+{
+    if (v < 0) {
+        out.push_back('-');
+        csv_append_uint(out, 0 - static_cast<uint64_t>(v));
+    } else {
+        csv_append_uint(out, v);
+    }
+}
+
+// fmt "%g" matches iostream output, "%f" matches std::to_string
+inline void csv_append_double(std::string& out, double v, const char* fmt)
+{
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf), fmt, v);
+    if (n > 0)
+        out.append(buf, std::min(static_cast<size_t>(n), sizeof(buf) - 1));
+}
+
 // print functions
 void printSkyRootHeader(sky_root &r);
 void printSkyRecHeader(sky_rec &r);
@@ -903,21 +984,24 @@ long long int printFlatbufFlexRowAsCsv(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 long long int printJSONAsCsv(
         const char* dataptr,
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 long long int printArrowbufRowAsCsv(
         const char* dataptr,
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 // postgres binary fstream format
 long long int printFlatbufFlexRowAsPGBinary(
@@ -925,7 +1009,8 @@ long long int printFlatbufFlexRowAsPGBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 // postgres binary fstream format
 long long int printArrowbufRowAsPGBinary(
@@ -933,7 +1018,8 @@ long long int printArrowbufRowAsPGBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 // pyarrow binary fstream format
 long long int printArrowbufRowAsPyArrowBinary(
@@ -941,7 +1027,26 @@ long long int printArrowbufRowAsPyArrowBinary(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
+
+// arrow ipc stream format, header emits the schema message only
+long long int printArrowbufAsIpcStream(
+        const char* dataptr,
+        const size_t datasz,
+        bool print_header,
+        bool print_verbose,
+        long long int max_to_print,
+        arrow_ipc_stream& stream,
+        std::string& out);
+
+std::shared_ptr<arrow::DataType> sky_arrow_type(int sky_type);
+
+// schema message of an arrow ipc stream no result was written to
+int printArrowIpcStreamSchema(
+        arrow_ipc_stream& stream,
+        schema_vec& query_schema,
+        std::string& out);
 
 // print format example binary fstream format
 long long int printExampleFormatAsCsv(
@@ -949,7 +1054,8 @@ long long int printExampleFormatAsCsv(
         const size_t datasz,
         bool print_header,
         bool print_verbose,
-        long long int max_to_print);
+        long long int max_to_print,
+        std::string& out);
 
 void printArrowHeader(std::shared_ptr<const arrow::KeyValueMetadata> &metadata);
 
@@ -969,6 +1075,27 @@ int transform_arrow_to_fb(
         std::string& errmsg,
         flatbuffers::FlatBufferBuilder& flatbldr);
 
+int transform_arrow_to_skycol(
+        std::shared_ptr<arrow::Table>& table,
+        std::string& errmsg,
+        flatbuffers::FlatBufferBuilder& flatbldr);
+
+// bit-packing helpers for the SFT_FLATBUF_UNION_COL format
+uint32_t skycol_bit_width(uint64_t max_val);
+inline uint64_t skycol_unpack(const flatbuffers::Vector<uint64_t>* packed,
+                              uint32_t bit_width, uint64_t i)
+{
+    if (bit_width == 0)
+        return 0;
+    uint64_t bit = i * bit_width;
+    uint64_t word = bit >> 6;
+    uint64_t shift = bit & 63;
+    uint64_t v = packed->Get(word) >> shift;
+    if (shift + bit_width > 64)
+        v |= packed->Get(word + 1) << (64 - shift);
+    return bit_width == 64 ? v : v & ((1ull << bit_width) - 1);
+}
+
 bool hasAggPreds(predicate_vec &preds);
 
 // convert provided ops to/from internal skyhook representation (simple enums)
@@ -1055,12 +1182,33 @@ int extract_arrow_from_string(std::shared_ptr<arrow::Table>* table,
                               const char *ds, int ds_size);
 
 int convert_arrow_to_buffer(const std::shared_ptr<arrow::Table> &table,
-                            std::shared_ptr<arrow::Buffer>* buffer);
+                            std::shared_ptr<arrow::Buffer>* buffer,
+                            CompressionType compression=none);
+
+// Function related to extract/convert parquet buffer
+int extract_arrow_from_parquet_buffer(std::shared_ptr<arrow::Table>* table,
+                                      const std::shared_ptr<arrow::Buffer> &buffer);
+int convert_arrow_to_parquet_buffer(const std::shared_ptr<arrow::Table> &table,
+                                    int64_t row_group_rows,
+                                    std::shared_ptr<arrow::Buffer>* buffer);
 
 int compress_arrow_tables(std::vector<std::shared_ptr<arrow::Table>> &table_vec,
                           std::shared_ptr<arrow::Table> *table);
-int split_arrow_table(std::shared_ptr<arrow::Table> &table, int max_rows,
+std::shared_ptr<arrow::KeyValueMetadata> copy_arrow_metadata(
+        std::shared_ptr<const arrow::KeyValueMetadata> orig_metadata,
+        int64_t nrows);
+int split_arrow_table(std::shared_ptr<arrow::Table> &table, int64_t max_rows,
                       std::vector<std::shared_ptr<arrow::Table>>* table_vec);
+int hash_partition_arrow_table(std::shared_ptr<arrow::Table> &table,
+                               uint64_t num_parts,
+                               std::map<uint64_t, std::shared_ptr<arrow::Table>>* part_map);
+
+// consistent hashing of a composite key into one of num_buckets, shared by
+// the data writer and by repartitioning so rows keep their key locality.
+uint64_t jumpConsistentHash(uint64_t key, uint64_t num_buckets);
+
+// 64 bit xxhash of len bytes, chain the seed to hash several values.
+uint64_t hash64(const void *data, size_t len, uint64_t seed=0);
 
 int example_func(int counter);
 
@@ -18,7 +18,8 @@ struct FB_Meta FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_BLOB_DELETED = 10,
     VT_BLOB_ORIG_OFF = 12,
     VT_BLOB_ORIG_LEN = 14,
-    VT_BLOB_COMPRESSION = 16
+    VT_BLOB_COMPRESSION = 16,
+    VT_BLOB_SORT_COLS = 18
   };
   int32_t blob_format() const {
     return GetField<int32_t>(VT_BLOB_FORMAT, 0);
@@ -41,6 +42,9 @@ struct FB_Meta FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   int32_t blob_compression() const {
     return GetField<int32_t>(VT_BLOB_COMPRESSION, 0);
   }
+  const flatbuffers::String *blob_sort_cols() const {
+    return GetPointer<const flatbuffers::String *>(VT_BLOB_SORT_COLS);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int32_t>(verifier, VT_BLOB_FORMAT) &&
@@ -51,6 +55,8 @@ struct FB_Meta FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<uint64_t>(verifier, VT_BLOB_ORIG_OFF) &&
            VerifyField<uint64_t>(verifier, VT_BLOB_ORIG_LEN) &&
            VerifyField<int32_t>(verifier, VT_BLOB_COMPRESSION) &&
+           VerifyOffset(verifier, VT_BLOB_SORT_COLS) &&
+           verifier.VerifyString(blob_sort_cols()) &&
            verifier.EndTable();
   }
 };
@@ -79,6 +85,9 @@ struct FB_MetaBuilder {
   void add_blob_compression(int32_t blob_compression) {
     fbb_.AddElement<int32_t>(FB_Meta::VT_BLOB_COMPRESSION, blob_compression, 0);
   }
+  void add_blob_sort_cols(flatbuffers::Offset<flatbuffers::String> blob_sort_cols) {
+    fbb_.AddOffset(FB_Meta::VT_BLOB_SORT_COLS, blob_sort_cols);
+  }
   explicit FB_MetaBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -99,11 +108,13 @@ inline flatbuffers::Offset<FB_Meta> CreateFB_Meta(
     bool blob_deleted = false,
     uint64_t blob_orig_off = 0,
     uint64_t blob_orig_len = 0,
-    int32_t blob_compression = 0) {
+    int32_t blob_compression = 0,
+    flatbuffers::Offset<flatbuffers::String> blob_sort_cols = 0) {
   FB_MetaBuilder builder_(_fbb);
   builder_.add_blob_orig_len(blob_orig_len);
   builder_.add_blob_orig_off(blob_orig_off);
   builder_.add_blob_size(blob_size);
+  builder_.add_blob_sort_cols(blob_sort_cols);
   builder_.add_blob_compression(blob_compression);
   builder_.add_blob_data(blob_data);
   builder_.add_blob_format(blob_format);
@@ -119,8 +130,10 @@ inline flatbuffers::Offset<FB_Meta> CreateFB_MetaDirect(
     bool blob_deleted = false,
     uint64_t blob_orig_off = 0,
     uint64_t blob_orig_len = 0,
-    int32_t blob_compression = 0) {
+    int32_t blob_compression = 0,
+    const char *blob_sort_cols = nullptr) {
   auto blob_data__ = blob_data ? _fbb.CreateVector<uint8_t>(*blob_data) : 0;
+  auto blob_sort_cols__ = blob_sort_cols ? _fbb.CreateString(blob_sort_cols) : 0;
   return Tables::CreateFB_Meta(
       _fbb,
       blob_format,
@@ -129,7 +142,8 @@ inline flatbuffers::Offset<FB_Meta> CreateFB_MetaDirect(
       blob_deleted,
       blob_orig_off,
       blob_orig_len,
-      blob_compression);
+      blob_compression,
+      blob_sort_cols__);
 }
 
 inline const Tables::FB_Meta *GetFB_Meta(const void *buf) {
@@ -11,12 +11,23 @@
 /*
  * The program starts in the main function. The function takes in a data file,
  * schema file, number of objects (aka buckets), number of rows till object
- * flushes, and total number of rows to be read. The main function then enters
- * a while loop till the specified number of lines are read from the data file.
- * In the while loop, each data row is parsed, processed, and hashed into a
- * bucket. If the number of rows till the bucket flushes is reached or all the
- * data rows have been read, then the contents of the bucket are "finished",
- * writen to disk, and the bucket is deleted.
+ * flushes, and total number of rows to be read. The data file is mapped and
+ * loaded by a pipeline of threads:
+ *  - the main thread splits the file into large chunks on line boundaries,
+ *  - num_threads parsers parse, type-convert and encode the rows of a chunk
+ *    and hash each row into a bucket,
+ *  - builders insert the encoded rows into the buckets, each builder owning
+ *    the buckets of a subset of the oids,
+ *  - a writer flushes full buckets. If the number of rows till the bucket
+ *    flushes is reached or all the data rows have been read, then the
+ *    contents of the bucket are "finished", writen to disk (or with --pool
+ *    appended to the object in the pool, up to max_inflight async writes at
+ *    a time), and the bucket is deleted.
+ * Stages are connected by bounded queues, so memory use stays bounded. With
+ * one thread, buckets hold their rows in input order as the rows are read.
+ * With --index_rid or --index_cols, the index entries of the rows are built
+ * along with each bucket and written with it to the object omap, instead of
+ * by an exec_build_sky_index_op pass reading the objects back.
 */
 
 
@@ -31,6 +42,35 @@ bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_sche
 # for these, be sure to change num-objs to 1 in queries
 bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 1 --flush_rows 17 --read_rows 17 --csv_delim "|" --use_hashing false --rid_start_value 2 --table_name testdata --default_oid 111 --data_format SFT_FLATBUF_FLEX_ROW ;
 
+# large inputs, parse and encode rows on 16 threads
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 1000 --flush_rows 100000 --read_rows 600000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --num_threads 16 ;
+
+# load straight into arrow objects, no transform_db_op pass needed
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 2 --flush_rows 9 --read_rows 17 --csv_delim "|" --use_hashing true --rid_start_value 2 --table_name testdata --default_oid 0 --data_format SFT_ARROW ;
+
+# spread rows by a hash of all the key cols, or by ranges of a column
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 4 --flush_rows 100000 --read_rows 6000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --partitioner hash ;
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 4 --flush_rows 100000 --read_rows 6000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --partitioner range --partition_col shipdate --partition_bounds 1994-01-01,1996-01-01,1998-01-01 ;
+
+# sort the rows of each object by shipdate, recorded in the fbmeta
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 4 --flush_rows 100000 --read_rows 6000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_ARROW --cluster_by shipdate ;
+
+# load into many objects with bounded memory, buckets past 1GB of buffered
+# rows are flushed early as more fbmetas of their objects
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 10000 --flush_rows 100000 --read_rows 600000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --max_bucket_mem 1073741824 ;
+
+# loaders running in parallel on parts of a table take rids from one object
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.part1.txt --input_file_schema lineitem_schema.txt --num_objs 1000 --flush_rows 100000 --read_rows 300000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --pool tpchdata --rid_alloc_obj lineitem.rids ;
+
+# index the objects while writing them, no exec_build_sky_index_op pass that
+# reads them back is needed
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 1000 --flush_rows 100000 --read_rows 600000000 --csv_delim "|" --use_hashing true --rid_start_value 1 --table_name lineitem --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --pool tpchdata --index_rid true --index_cols orderkey,linenumber --index_unique true ;
+
+# write the objects straight to a pool, appending to existing objects
+bin/sky_tabular_flatflex_writer --input_file_name lineitem.txt --input_file_schema lineitem_schema.txt --num_objs 2 --flush_rows 9 --read_rows 17 --csv_delim "|" --use_hashing true --rid_start_value 2 --table_name testdata --default_oid 0 --data_format SFT_FLATBUF_FLEX_ROW --pool tpchdata --conf ceph.conf ;
+# then query with --oid-prefix skyhook.SFT_FLATBUF_FLEX_ROW
+# a single-osd test cluster: scripts/micro-osd.sh test /etc/ceph ; bin/rados mkpool tpchdata
+
 # setup
 bin/rados mkpool tpchdata;
 yes | PATH=$PATH:bin ../src/progly/rados-store-glob.sh tpchdata fbmeta.Skyhook.v2.SFT_FLATBUF_FLEX_ROW.testdata.* ;
@@ -42,11 +82,25 @@ yes | PATH=$PATH:bin ../src/progly/rados-store-glob.sh tpchdata fbmeta.Skyhook.v
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <set>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <charconv>
+#include <string_view>
 #include <unistd.h>    // for getOpt
 #include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <boost/program_options.hpp>
 
+#include "include/rados/librados.hpp"
 #include "cls_tabular_utils.h"
+#include "sky_tabular_flatflex_writer.h"
 
 using namespace std;
 using namespace Tables;
@@ -55,13 +109,54 @@ namespace po = boost::program_options ;
 const uint8_t SKYHOOK_VERSION = 1;
 const uint8_t SCHEMA_VERSION = 1;
 string SCHEMA = "";
-uint64_t RID = 1;
+CompressionType COMPRESSION = none;
+
+// input is handed to the parsers in pieces of about this size
+const size_t READ_CHUNK_SIZE = 4 << 20;
 typedef flatbuffers::FlatBufferBuilder fbBuilder;
 typedef flatbuffers::FlatBufferBuilder* fbb;
 typedef flexbuffers::Builder flxBuilder;
 typedef vector<uint8_t> delete_vector;
 typedef vector<flatbuffers::Offset<Record>> rows_vector;
 
+// typed column builders of an SFT_ARROW bucket, one per schema column
+// followed by the RID column
+typedef vector<std::unique_ptr<arrow::ArrayBuilder>> arrow_cols;
+
+// IDX_RID/IDX_REC entries of the rows of a bucket, sorted by key when the
+// bucket is written. the fb_num of the entries is set by the osd.
+typedef vector<std::pair<string, idx_rec_entry>> index_entries;
+
+// a piece of the input ending on a line boundary
+typedef struct {
+    const char *begin;
+    const char *end;
+    uint64_t first_line;  // line number of the first line in the chunk
+    uint64_t load_line;   // line number of the first line loaded
+    uint64_t first_rid;   // rid of the first line loaded, the rest follow it
+} chunk_t;
+
+// an encoded row, waiting to be inserted into its bucket
+typedef struct {
+    uint64_t rid;
+    uint64_t nullbits[2];
+    size_t flx_off;  // flexbuffer bytes in the batch flx_data
+    size_t flx_len;
+    const char *line;  // SFT_ARROW or cluster_by: the input line, parsed by the builder
+    size_t line_len;
+    size_t key_off;  // IDX_REC key data in the batch idx_keys
+    size_t key_len;
+} encoded_row_t;
+
+// the rows of one chunk for one bucket, their flexbuffers are packed into
+// flx_data so a row costs no allocation of its own.
+typedef struct {
+    uint64_t oid;
+    vector<encoded_row_t> rows;
+    vector<uint8_t> flx_data;
+    string idx_keys;
+} row_batch_t;
+
 typedef struct {
     uint64_t oid;
     uint64_t nrows;
@@ -69,8 +164,117 @@ typedef struct {
     fbb fb;
     delete_vector *deletev;
     rows_vector *rowsv;
+    arrow_cols *cols;  // instead of fb/deletev/rowsv for SFT_ARROW
+    // with --cluster_by, rows are held until the bucket is full, then
+    // sorted and encoded in cluster order.
+    vector<encoded_row_t> *held;
+    string sort_cols;  // recorded in the fbmeta
+    index_entries *index;  // with --index_rid or --index_cols
+    uint64_t idx_bytes;
+    uint64_t bytes;      // memory buffered, estimated
+    uint64_t last_fill;  // when a row was last added, for lru eviction
 } bucket_t;
 
+/*
+ * Blocking fifo between two loader stages. Bounded, so a fast stage cannot
+ * run ahead of a slow one by more than max_items.
+ */
+template <typename T>
+class stage_queue {
+public:
+    explicit stage_queue(size_t _max_items) : max_items(_max_items) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> l(lock);
+        not_full.wait(l, [this] { return items.size() < max_items; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    // false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> l(lock);
+        not_empty.wait(l, [this] { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> l(lock);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    size_t max_items;
+    bool closed = false;
+};
+
+// aio writes of the objects straight to a pool (--pool), at most
+// max_inflight at a time, so parsing goes on while buckets upload.
+typedef struct {
+    librados::IoCtx ioctx;
+    bool overwrite;         // replace objects on their first write
+    uint32_t max_inflight;
+    std::mutex lock;
+    std::condition_variable cond;
+    uint32_t inflight;
+    int error;              // first failed write
+    set<string> written;    // objects written by this load
+    string table_name;
+    uint32_t idx_batch_size;        // omap entries set at a time
+    vector<string> idx_prefixes;    // indexes built while writing
+} pool_writer_t;
+
+pool_writer_t *POOL_WRITER = NULL;
+
+// rids taken from blocks allocated on a table metadata object in the pool
+// (--rid_alloc_obj), so loaders of a table running in parallel never
+// produce the same rid.
+typedef struct {
+    string oid;
+    string table_name;
+    uint64_t block_size;
+    uint64_t next;  // unused rids of the current block are [next, end)
+    uint64_t end;
+} rid_allocator_t;
+
+
+// load parameters, shared read only by the loader threads
+typedef struct {
+    Tables::schema_vec schema;
+    vector<int> composite_key_indexes;
+    string table_name;
+    string data_format;
+    uint64_t num_objs;
+    uint64_t rid_start_value;
+    uint64_t read_rows;
+    uint64_t flush_rows;
+    uint64_t default_oid;
+    char csv_delim;
+    bool use_hashing;
+    const partitioner *part;  // picks the object of each row, with use_hashing
+    bool pack_keys;           // parseRow packs the key for the jump partitioner
+    string cluster_by;        // blob_sort_cols of the clustered buckets
+    Tables::schema_vec cluster_cols;
+    uint64_t max_bucket_mem;  // bytes buffered in buckets, 0 is unbounded
+    bool evict_lru;           // evict the lru bucket instead of the largest
+    int num_builders;
+    bool index_rid;           // IDX_RID entries are built with the data
+    Tables::schema_vec index_cols;  // IDX_REC entries on these cols
+    bool index_unique;
+    string idx_rid_prefix;
+    string idx_rec_prefix;
+} load_params_t;
+
 //----------------- check inputs ------------------
 std::vector<std::string> line_split(const std::string &s, char delim);
 void promptDataFile(ifstream&, string&);
@@ -81,20 +285,17 @@ void helpMenu();
 //-------------------------------------------------
 Tables::schema_vec getSchema(vector<int>&, string&);
 
-uint64_t getNextRID();
-
-vector<string> parseRow(string row, char csv_delim);
-
-void getFlxBuffer(flexbuffers::Builder *, vector<string>,
-                  Tables::schema_vec, vector<uint64_t> *);
+void parseRow(const char *begin, const char *end, char csv_delim,
+              const vector<int>& compositeKeyIndexes,
+              vector<std::string_view>& parsedRow, uint64_t *hashKey);
 
-uint64_t hashCompositeKey(vector<int>, vector<string>);
-
-uint64_t jumpConsistentHash(uint64_t, uint64_t);
+void getFlxBuffer(flexbuffers::Builder *, const vector<std::string_view>&,
+                  const Tables::schema_vec&, uint64_t *nullbits);
 
 bucket_t *retrieveBucketFromOID(map<uint64_t, bucket_t *> &, uint64_t, string);
 
-void insertRowIntoBucket(fbb, uint64_t, vector<uint64_t> *, vector<uint8_t>,
+void insertRowIntoBucket(fbb, uint64_t, const uint64_t *nullbits,
+                         const uint8_t *flx, size_t flx_len,
                          delete_vector *, rows_vector *);
 
 //------------- Finishing flatbuffer --------------
@@ -106,22 +307,78 @@ void finishFlatBuffer(fbb, uint8_t, uint8_t, string, string, delete_vector *,
 
 int writeToDisk(string, uint64_t, uint8_t, bucket_t*, uint64_t);
 
+int writeToPool(const string& oid, bufferlist& bl, index_entries *index);
+
+int drainPoolWrites();
+
+uint64_t takeRIDs(rid_allocator_t *rids, uint64_t n);
+
 void deleteBucket(bucket_t *bucketPtr, fbb fbPtr, delete_vector *deletePtr,
                   rows_vector *rowsPtr);
 
 //-------------------------------------------------
-vector<uint8_t> initializeFlexBuffer(vector<string> parsedRow,
-                                     Tables::schema_vec schema,
-                                     vector<uint64_t> *nullbits);
+void initializeFlexBuffer(flexbuffers::Builder *flx,
+                          const vector<std::string_view>& parsedRow,
+                          const Tables::schema_vec& schema,
+                          uint64_t *nullbits);
 
 
 
 bucket_t *GetAndInitializeBucket(map<uint64_t, bucket_t *> &FBmap,
                                  uint64_t oid,
-                                 vector<uint64_t> *nullbits,
-                                 vector<uint8_t> flxPtr,
+                                 uint64_t rid,
+                                 const uint64_t *nullbits,
+                                 const uint8_t *flx,
+                                 size_t flx_len,
                                  string tablename);
 
+//------------- Arrow buckets (SFT_ARROW) ---------
+bucket_t *GetAndInitializeArrowBucket(map<uint64_t, bucket_t *> &FBmap,
+                                      uint64_t oid,
+                                      uint64_t rid,
+                                      const vector<std::string_view>& parsedRow,
+                                      const load_params_t *params);
+
+bucket_t *retrieveArrowBucketFromOID(map<uint64_t, bucket_t *> &, uint64_t,
+                                     const load_params_t *params);
+
+arrow::Status appendArrowRow(arrow_cols& cols, uint64_t RID,
+                             const vector<std::string_view>& parsedRow,
+                             const Tables::schema_vec& schema);
+
+//------------- Indexes built while loading ------
+void indexKeyData(const load_params_t *params,
+                  const vector<std::string_view>& parsedRow,
+                  string& key_data);
+
+uint64_t indexRow(bucket_t *bucketPtr, const load_params_t *params,
+                  uint64_t rid, uint32_t row_num, std::string_view key_data);
+
+//------------- Clustered buckets (--cluster_by) --
+void holdRow(bucket_t *bucketPtr, const encoded_row_t& row);
+
+void clusterBucket(bucket_t *bucketPtr, const load_params_t *params);
+
+int finishArrowBucket(bucket_t *bucketPtr, uint8_t schema_v,
+                      std::shared_ptr<arrow::Table> *table, string& errmsg);
+
+void flushArrowBucket(string, uint8_t schema_v, bucket_t *bucketPtr,
+                      uint64_t numOfObjs);
+
+//------------- Loader pipeline stages ------------
+void parseChunks(const load_params_t *params,
+                 stage_queue<chunk_t> *chunks,
+                 vector<stage_queue<row_batch_t> *> *builder_queues);
+
+void buildBuckets(const load_params_t *params,
+                  stage_queue<row_batch_t> *batches,
+                  stage_queue<bucket_t *> *flushes);
+
+void flushBuckets(const load_params_t *params,
+                  stage_queue<bucket_t *> *flushes);
+
+uint64_t bucketBytes(const bucket_t *bucketPtr, const encoded_row_t& row);
+
 int main(int argc, char *argv[])
 {
     string input_file_name         = "";
@@ -135,6 +392,24 @@ int main(int argc, char *argv[])
     char csv_delim           = Tables::CSV_DELIM;
     bool use_hashing         = false;
     string data_format          = "";
+    string compression          = "none";
+    int num_threads          = 1;
+    string pool              = "";
+    string conf              = "";
+    uint32_t max_inflight    = 8;
+    bool overwrite_objs      = false;
+    string partitioner_name  = "jump";
+    string partition_col     = "";
+    string partition_bounds  = "";
+    string cluster_by        = "";
+    uint64_t max_bucket_mem  = 0;
+    string evict             = "largest";
+    string rid_alloc_obj     = "";
+    uint64_t rid_block_size  = 1 << 20;
+    bool index_rid           = false;
+    string index_cols        = "";
+    bool index_unique        = false;
+    uint32_t index_batch_size = 1000;
 
 // -------------- Get Variables ---------------
     po::options_description gen_opts("General options");
@@ -150,7 +425,25 @@ int main(int argc, char *argv[])
       ("use_hashing", po::value<bool>(&use_hashing)->required(), "use_hashing")
       ("table_name", po::value<string>(&table_name)->required(), "table_name")
       ("default_oid", po::value<uint64_t>(&default_oid)->required(), "default_oid")
-      ("data_format", po::value<string>(&data_format)->required(), "data_format");
+      ("data_format", po::value<string>(&data_format)->required(), "data_format: SFT_FLATBUF_FLEX_ROW, SFT_FLATBUF_UNION_COL or SFT_ARROW")
+      ("compression", po::value<string>(&compression)->default_value("none"), "blob compression: none, lz4, zstd")
+      ("num_threads", po::value<int>(&num_threads)->default_value(1), "threads parsing and encoding rows (more than 1 does not keep the input order of rows within a bucket)")
+      ("pool", po::value<string>(&pool)->default_value(""), "write the objects to this pool instead of local files")
+      ("conf", po::value<string>(&conf)->default_value(""), "path to ceph.conf, with --pool")
+      ("max_inflight", po::value<uint32_t>(&max_inflight)->default_value(8), "object writes in flight to the pool")
+      ("overwrite_objs", po::value<bool>(&overwrite_objs)->default_value(false), "replace existing objects instead of appending to them, with --pool")
+      ("partitioner", po::value<string>(&partitioner_name)->default_value("jump"), "how use_hashing spreads rows over the objects: jump (up to 2 integer key cols), hash (any key cols), range, roundrobin")
+      ("partition_col", po::value<string>(&partition_col)->default_value(""), "range partitioner column (def=first key col)")
+      ("partition_bounds", po::value<string>(&partition_bounds)->default_value(""), "range partitioner bounds, ascending and comma separated, object i gets the rows below bound i")
+      ("cluster_by", po::value<string>(&cluster_by)->default_value(""), "comma separated cols to sort the rows of each object by")
+      ("max_bucket_mem", po::value<uint64_t>(&max_bucket_mem)->default_value(0), "bytes of rows buffered in buckets before one is flushed early as an additional fbmeta of its object (0=unbounded)")
+      ("evict", po::value<string>(&evict)->default_value("largest"), "bucket flushed early past max_bucket_mem: largest or lru")
+      ("rid_alloc_obj", po::value<string>(&rid_alloc_obj)->default_value(""), "table metadata object in the pool handing out rids, for loaders running in parallel (def=rids follow the line numbers)")
+      ("rid_block_size", po::value<uint64_t>(&rid_block_size)->default_value(1 << 20), "rids allocated at a time from rid_alloc_obj")
+      ("index_rid", po::value<bool>(&index_rid)->default_value(false), "build the RID index of each object while writing it, with --pool")
+      ("index_cols", po::value<string>(&index_cols)->default_value(""), "comma separated integer cols to build a record index on while writing, with --pool")
+      ("index_unique", po::value<bool>(&index_unique)->default_value(false), "index_cols values are unique, else the rid is appended to each key")
+      ("index_batch_size", po::value<uint32_t>(&index_batch_size)->default_value(1000), "index entries set at a time in the omap");
 
     po::options_description all_opts("Allowed options");
     all_opts.add(gen_opts);
@@ -164,100 +457,527 @@ int main(int argc, char *argv[])
     }
     po::notify(vm);
 
+    int compression_type = compression_type_from_string(compression);
+    if (compression_type < 0) {
+        std::cout << "compression '" << compression << "' not supported. aborting." << std::endl;
+        exit(1);
+    }
+    COMPRESSION = static_cast<CompressionType>(compression_type);
+
     // returns schema vector and composite keys
     Tables::schema_vec schema;
     vector<int> composite_key_indexes;
     schema = getSchema(composite_key_indexes, input_file_schema);
     SCHEMA = Tables::schemaToString(schema);
+    partitioner *part = NULL;
+    if (use_hashing) {
+        string errmsg;
+        part = makePartitioner(partitioner_name, schema, composite_key_indexes,
+                               partition_col, partition_bounds, num_objs,
+                               errmsg);
+        if (part == NULL) {
+            std::cout << errmsg << " aborting." << std::endl;
+            exit(1);
+        }
+    }
+
+// ----------- Connect to the pool when writing to Ceph -----------
+    librados::Rados cluster;
+    if (!pool.empty()) {
+        cluster.init(NULL);
+        if (conf.empty())
+            cluster.conf_read_file(NULL);
+        else
+            cluster.conf_read_file(conf.c_str());
+        int ret = cluster.connect();
+        if (ret < 0) {
+            std::cout << "Cannot connect to cluster: " << ret << std::endl;
+            exit(1);
+        }
+        POOL_WRITER = new pool_writer_t();
+        ret = cluster.ioctx_create(pool.c_str(), POOL_WRITER->ioctx);
+        if (ret < 0) {
+            std::cout << "Cannot open pool '" << pool << "': " << ret << std::endl;
+            exit(1);
+        }
+        POOL_WRITER->overwrite = overwrite_objs;
+        POOL_WRITER->max_inflight = std::max<uint32_t>(max_inflight, 1);
+        POOL_WRITER->inflight = 0;
+        POOL_WRITER->error = 0;
+    }
+    rid_allocator_t *rids = NULL;
+    if (!rid_alloc_obj.empty()) {
+        if (POOL_WRITER == NULL) {
+            std::cout << "rid_alloc_obj requires --pool. aborting." << std::endl;
+            exit(1);
+        }
+        rids = new rid_allocator_t();
+        rids->oid = rid_alloc_obj;
+        rids->table_name = table_name;
+        rids->block_size = std::max<uint64_t>(rid_block_size, 1);
+        rids->next = 0;
+        rids->end = 0;
+    }
+    if ((index_rid || !index_cols.empty()) && POOL_WRITER == NULL) {
+        std::cout << "index_rid and index_cols require --pool. aborting." << std::endl;
+        exit(1);
+    }
 
 // ----------- Read Rows and Load into Corresponding FlatBuffer -----------
-    map<uint64_t, bucket_t *> FBmap;
-    bucket_t *bucketPtr;
+    if (num_threads < 1)
+        num_threads = 1;
+
+    load_params_t params;
+    params.schema = Tables::schema_vec(schema);
+    params.composite_key_indexes = composite_key_indexes;
+    params.table_name = table_name;
+    params.data_format = data_format;
+    params.num_objs = num_objs;
+    params.rid_start_value = rid_start_value;
+    params.read_rows = read_rows;
+    params.flush_rows = flush_rows;
+    params.default_oid = default_oid;
+    params.csv_delim = csv_delim;
+    params.use_hashing = use_hashing;
+    params.part = part;
+    params.pack_keys = dynamic_cast<jump_partitioner*>(part) != NULL;
+    params.max_bucket_mem = max_bucket_mem;
+    if (evict != "largest" && evict != "lru") {
+        std::cout << "evict '" << evict << "' not supported. aborting." << std::endl;
+        exit(1);
+    }
+    params.evict_lru = (evict == "lru");
+    if (!cluster_by.empty()) {
+        // the cols are recorded in each fbmeta by their schema names, as
+        // blob_sort_cols in fb_meta.fbs
+        vector<string> names;
+        for (string name : line_split(cluster_by, ',')) {
+            boost::trim(name);
+            auto it = std::find_if(schema.begin(), schema.end(),
+                [&](const Tables::col_info& c) {
+                    return boost::iequals(c.name, name);
+                });
+            if (it == schema.end()) {
+                std::cout << "cluster_by col '" << name
+                          << "' not in schema. aborting." << std::endl;
+                exit(1);
+            }
+            params.cluster_cols.push_back(*it);
+            names.push_back(it->name);
+        }
+        params.cluster_by = boost::algorithm::join(names, ",");
+    }
 
-    std::ifstream inFile(input_file_name);
-    std::string line;
+    // indexes are built as exec_build_sky_index_op builds them, under the
+    // "*" db schema the data is written with
+    params.index_rid = index_rid;
+    params.index_unique = index_unique;
+    if (index_rid) {
+        params.idx_rid_prefix = buildKeyPrefix(SIT_IDX_RID, "*", table_name,
+                                               {Tables::RID_INDEX});
+        POOL_WRITER->idx_prefixes.push_back(params.idx_rid_prefix);
+    }
+    if (!index_cols.empty()) {
+        vector<string> colnames;
+        for (string name : line_split(index_cols, ',')) {
+            boost::trim(name);
+            auto it = std::find_if(schema.begin(), schema.end(),
+                [&](const Tables::col_info& c) {
+                    return boost::iequals(c.name, name);
+                });
+            if (it == schema.end()) {
+                std::cout << "index col '" << name
+                          << "' not in schema. aborting." << std::endl;
+                exit(1);
+            }
+            if (!isSignedType(it->type) && !isUnsignedType(it->type) &&
+                it->type != SDT_BOOL) {
+                std::cout << "index col '" << name
+                          << "' is not an integer col. aborting." << std::endl;
+                exit(1);
+            }
+            params.index_cols.push_back(*it);
+            colnames.push_back(it->name);
+        }
+        params.idx_rec_prefix = buildKeyPrefix(SIT_IDX_REC, "*", table_name,
+                                               colnames);
+        POOL_WRITER->idx_prefixes.push_back(params.idx_rec_prefix);
+    }
+    if (POOL_WRITER != NULL) {
+        POOL_WRITER->table_name = table_name;
+        POOL_WRITER->idx_batch_size = std::max<uint32_t>(index_batch_size, 1);
+    }
+
+    int fd = open(input_file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Cannot open file '" << input_file_name << "'" << std::endl;
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        std::cout << "Cannot stat file '" << input_file_name << "'" << std::endl;
+        exit(1);
+    }
+    const size_t file_size = st.st_size;
+    const char *data = NULL;
+    if (file_size > 0) {
+        void *m = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            std::cout << "Cannot map file '" << input_file_name << "'" << std::endl;
+            exit(1);
+        }
+        madvise(m, file_size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(m);
+    }
+
+    // parsers -> builders -> writer, each builder owns the buckets of the
+    // oids equal to its number modulo the number of builders.
+    const int num_builders = num_threads;
+    params.num_builders = num_builders;
+    stage_queue<chunk_t> chunks(2 * num_threads);
+    stage_queue<bucket_t *> flushes(2 * num_builders);
+    vector<stage_queue<row_batch_t> *> builder_queues;
+    for (int i = 0; i < num_builders; i++)
+        builder_queues.push_back(new stage_queue<row_batch_t>(4 * num_threads));
+
+    std::thread writer(flushBuckets, &params, &flushes);
+    vector<std::thread> builders;
+    for (int i = 0; i < num_builders; i++)
+        builders.push_back(std::thread(buildBuckets, &params,
+                                       builder_queues[i], &flushes));
+    vector<std::thread> parsers;
+    for (int i = 0; i < num_threads; i++)
+        parsers.push_back(std::thread(parseChunks, &params, &chunks,
+                                      &builder_queues));
+
+    // split the input into chunks ending on a newline, up to the last
+    // line to be read.
+    const uint64_t last_line = rid_start_value + read_rows;
+    const uint64_t first_rid_line = std::max<uint64_t>(rid_start_value, 1);
+    size_t pos = 0;
     uint64_t line_counter = 1;
-    while(getline(inFile, line) && inFile.good()) {
-        if((line_counter >= rid_start_value) &&
-             (line_counter <= (rid_start_value+read_rows))) {
-            auto parsedRow = parseRow(line, csv_delim);
+    while (pos < file_size && line_counter <= last_line) {
+        size_t end = std::min(pos + READ_CHUNK_SIZE, file_size);
+        if (end < file_size) {
+            const char *nl = static_cast<const char*>(
+                memchr(data + end, '\n', file_size - end));
+            end = nl ? (nl - data) + 1 : file_size;
+        }
+        chunk_t chunk;
+        chunk.begin = data + pos;
+        chunk.end = data + end;
+        chunk.first_line = line_counter;
+        line_counter += std::count(chunk.begin, chunk.end, '\n');
+        if (chunk.end[-1] != '\n')
+            line_counter++;  // last line has no newline
+        pos = end;
+
+        // rids only for the lines loaded, from rid_start_value to last_line
+        chunk.load_line = std::max(chunk.first_line, rid_start_value);
+        const uint64_t load_end = std::min(line_counter, last_line + 1);
+        if (chunk.load_line >= load_end)
+            continue;
+        // without an allocator rids follow the line numbers, as if assigned
+        // in input order
+        if (rids != NULL)
+            chunk.first_rid = takeRIDs(rids, load_end - chunk.load_line);
+        else
+            chunk.first_rid = chunk.load_line - first_rid_line + 1;
+        chunks.push(chunk);
+    }
+
+    // drain the pipeline one stage at a time
+    chunks.close();
+    for (auto& t : parsers)
+        t.join();
+    for (auto q : builder_queues)
+        q->close();
+    for (auto& t : builders)
+        t.join();
+    flushes.close();
+    writer.join();
+    for (auto q : builder_queues)
+        delete q;
+
+    if (POOL_WRITER != NULL) {
+        int ret = drainPoolWrites();
+        POOL_WRITER->ioctx.close();
+        delete POOL_WRITER;
+        POOL_WRITER = NULL;
+        cluster.shutdown();
+        if (ret < 0) {
+            std::cout << "Writing objects to pool '" << pool << "' failed: "
+                      << ret << std::endl;
+            exit(1);
+        }
+    }
 
-            vector<uint64_t> *nullbits = new vector<uint64_t>(2,0);
+    delete part;
+    delete rids;
 
-            // --------- Get Row and Load into FlexBuffer ---------
-            vector<uint8_t> flxPtr = initializeFlexBuffer(parsedRow,
-                                                          schema,
-                                                          nullbits);
+    printf("Done flushing all the objects\n");
 
-            uint64_t oid     = -1 ;
-            if(use_hashing) {
-              // --------- Hash Composite Key ----------
-              uint64_t hashKey = hashCompositeKey(composite_key_indexes, parsedRow);
+    if (data != NULL)
+        munmap(const_cast<char*>(data), file_size);
+    close(fd);
 
-              // --------- Get Oid Using HashKey ----------
-              oid = jumpConsistentHash(hashKey, num_objs);
-            }
-            else {
-              // write all rows between rid_start_row and (rid_start_row+read_rows)
-              // to a single bucket/file.
-              // define default oid
-              oid  = default_oid ;
+    return 0;
+}
+
+/*
+ * Parser stage: parses, type-converts and encodes the rows of each chunk,
+ * hashes them into buckets and hands the rows of each bucket to the builder
+ * owning it, one batch per bucket per chunk.
+ */
+void parseChunks(const load_params_t *params,
+                 stage_queue<chunk_t> *chunks,
+                 vector<stage_queue<row_batch_t> *> *builder_queues) {
+
+    const uint64_t last_line = params->rid_start_value + params->read_rows;
+    const uint64_t num_builders = builder_queues->size();
+
+    // reused for every row of this thread
+    vector<std::string_view> parsedRow;
+    flexbuffers::Builder flx;
+    const vector<int> no_key_cols;
+    const vector<int>& key_cols = params->pack_keys ?
+        params->composite_key_indexes : no_key_cols;
+    // arrow and clustered rows are encoded by the builder instead
+    const bool defer_encoding = (params->data_format == "SFT_ARROW" ||
+                                 !params->cluster_cols.empty());
+    string key_data;
+
+    chunk_t chunk;
+    while (chunks->pop(chunk)) {
+        // batches of this chunk by oid, kept in the order first seen
+        vector<row_batch_t> batches;
+        map<uint64_t, size_t> batch_of_oid;
+
+        uint64_t line_counter = chunk.first_line;
+        const char *p = chunk.begin;
+        while (p < chunk.end && line_counter <= last_line) {
+            const char *nl = static_cast<const char*>(
+                memchr(p, '\n', chunk.end - p));
+            const char *eol = nl ? nl : chunk.end;
+
+            if (line_counter >= params->rid_start_value) {
+                // --------- Tokenize Row and Hash Composite Key ----------
+                uint64_t hashKey = 0;
+                parseRow(p, eol, params->csv_delim, key_cols, parsedRow,
+                         &hashKey);
+
+                encoded_row_t row;
+                row.nullbits[0] = 0;
+                row.nullbits[1] = 0;
+                row.line = p;
+                row.line_len = eol - p;
+
+                // --------- Get Row and Load into FlexBuffer ---------
+                // arrow rows go to their column builders as typed values,
+                // the builder parses the line again instead.
+                if (!defer_encoding)
+                    initializeFlexBuffer(&flx, parsedRow, params->schema,
+                                         row.nullbits);
+
+                uint64_t oid = -1;
+                if (params->use_hashing) {
+                    // --------- Get Oid Using the Partitioner ----------
+                    oid = params->part->partition(parsedRow, hashKey,
+                                                  line_counter);
+                }
+                else {
+                    // write all rows between rid_start_row and
+                    // (rid_start_row+read_rows) to a single bucket/file.
+                    oid = params->default_oid;
+                }
+
+                auto it = batch_of_oid.find(oid);
+                if (it == batch_of_oid.end()) {
+                    it = batch_of_oid.insert(
+                        std::make_pair(oid, batches.size())).first;
+                    batches.push_back(row_batch_t());
+                    batches.back().oid = oid;
+                }
+                row_batch_t& batch = batches[it->second];
+                row.rid = chunk.first_rid + (line_counter - chunk.load_line);
+                row.flx_off = batch.flx_data.size();
+                row.flx_len = 0;
+                if (!defer_encoding) {
+                    const vector<uint8_t>& buf = flx.GetBuffer();
+                    row.flx_len = buf.size();
+                    batch.flx_data.insert(batch.flx_data.end(), buf.begin(), buf.end());
+                }
+                // index key data comes from the tokens at hand, the builder
+                // adds the entry once the row has its place in the bucket.
+                // clustered rows are indexed once sorted.
+                row.key_off = batch.idx_keys.size();
+                row.key_len = 0;
+                if (!params->index_cols.empty() && params->cluster_cols.empty()) {
+                    key_data.clear();
+                    indexKeyData(params, parsedRow, key_data);
+                    row.key_len = key_data.size();
+                    batch.idx_keys.append(key_data);
+                }
+                batch.rows.push_back(row);
             }
 
+            line_counter++;
+            p = eol + 1;
+        }
+
+        for (auto& batch : batches) {
+            uint64_t b = batch.oid % num_builders;
+            (*builder_queues)[b]->push(std::move(batch));
+        }
+    }
+}
+
+/*
+ * Builder stage: inserts encoded rows into the buckets it owns and hands
+ * each bucket to the writer once it holds flush_rows rows.
+ * With max_bucket_mem, each builder keeps its share of the budget: when the
+ * rows buffered in its buckets exceed it, the largest (or least recently
+ * filled) buckets are handed to the writer early. They become additional
+ * fbmetas of their objects.
+ */
+void buildBuckets(const load_params_t *params,
+                  stage_queue<row_batch_t> *batches,
+                  stage_queue<bucket_t *> *flushes) {
+
+    map<uint64_t, bucket_t *> FBmap;
+    bucket_t *bucketPtr;
+    const uint64_t mem_budget = params->max_bucket_mem / params->num_builders;
+    uint64_t mem_used = 0;
+    uint64_t fill_seq = 0;
+    const bool to_arrow = (params->data_format == "SFT_ARROW");
+    vector<std::string_view> parsedRow;
+    const vector<int> no_key_cols;
+    uint64_t hashKey;
+
+    row_batch_t batch;
+    while (batches->pop(batch)) {
+        const uint64_t oid = batch.oid;
+        for (auto& row : batch.rows) {
+
             // --------- Get FB and insert ----------
-            if ((line_counter % 100000) == 0)
-                printf("Inserting Row %ld into Bucket %ld\n", line_counter, oid);
-            bucketPtr = GetAndInitializeBucket(FBmap, oid, nullbits, flxPtr, table_name);
+            if (!params->cluster_cols.empty()) {
+                bucketPtr = to_arrow ?
+                    retrieveArrowBucketFromOID(FBmap, oid, params) :
+                    retrieveBucketFromOID(FBmap, oid, params->table_name);
+                holdRow(bucketPtr, row);
+            }
+            else if (to_arrow) {
+                parseRow(row.line, row.line + row.line_len, params->csv_delim,
+                         no_key_cols, parsedRow, &hashKey);
+                bucketPtr = GetAndInitializeArrowBucket(FBmap, oid, row.rid,
+                                                        parsedRow, params);
+            }
+            else
+                bucketPtr = GetAndInitializeBucket(FBmap, oid, row.rid,
+                                                   row.nullbits,
+                                                   batch.flx_data.data() + row.flx_off,
+                                                   row.flx_len,
+                                                   params->table_name);
+
+            uint64_t bytes = bucketBytes(bucketPtr, row);
+            if (bucketPtr->held == NULL &&
+                (params->index_rid || !params->index_cols.empty()))
+                bytes += indexRow(bucketPtr, params, row.rid,
+                                  bucketPtr->nrows - 1,
+                                  std::string_view(batch.idx_keys.data() + row.key_off,
+                                                   row.key_len));
+            mem_used += bytes - bucketPtr->bytes;
+            bucketPtr->bytes = bytes;
+            bucketPtr->last_fill = fill_seq++;
 
             // ----------- Flush if rows_flush was met -----------
-            // TODO: either disable flushing when not using hashing
-            //       or increment the oid.
-            //       otherwise, when flush_rows < read_rows,
-            //       this will flush everything to the same object,
-            //       which overwrites previously written data.
-            if( bucketPtr->rowsv->size() >= flush_rows) {
+            // a bucket flushed more than once per object, e.g. when
+            // flush_rows < read_rows, is appended to the object as
+            // another fbmeta.
+            if (bucketPtr->nrows >= params->flush_rows) {
                 printf("\tFlushing bucket %ld to Ceph with %ld rows\n",
                        oid, bucketPtr->nrows);
-
-                // Flush FlatBuffer to Ceph (currently writes to a file on disk)
-                flushFlatBuffer(data_format,
-                                SKYHOOK_VERSION,
-                                SCHEMA_VERSION,
-                                bucketPtr,
-                                SCHEMA,
-                                num_objs);
                 FBmap.erase(oid);
-            } // if need to flush
-            delete nullbits;
-        } // if in rid range
-        else if(line_counter >= (rid_start_value+read_rows))
-             break ;
-        else
-            std::cout << "skipping row " << line_counter << std::endl ;
+                mem_used -= bucketPtr->bytes;
+                if (bucketPtr->held != NULL)
+                    clusterBucket(bucketPtr, params);
+                flushes->push(bucketPtr);
+            }
 
-        line_counter++;
-    } // while get a row
+            // ----------- Flush early past the memory budget -----------
+            while (mem_budget > 0 && mem_used > mem_budget && !FBmap.empty()) {
+                auto victim = FBmap.begin();
+                for (auto it = FBmap.begin(); it != FBmap.end(); ++it) {
+                    if (params->evict_lru ?
+                        it->second->last_fill < victim->second->last_fill :
+                        it->second->bytes > victim->second->bytes)
+                        victim = it;
+                }
+                bucket_t *b = victim->second;
+                printf("\tFlushing bucket %ld early with %ld rows, %ld bytes buffered\n",
+                       b->oid, b->nrows, mem_used);
+                FBmap.erase(victim);
+                mem_used -= b->bytes;
+                if (b->held != NULL)
+                    clusterBucket(b, params);
+                flushes->push(b);
+            }
+        }
+    }
 
 // ------------- Iterate over map and flush each bucket --------------
-   if(use_hashing) {
-        printf("\nFlush the remaining buckets in map\n");
-        for (auto& x: FBmap) {
-            bucket_t *b = x.second;
-            printf("\tFlushing bucket %ld to Ceph with %ld rows\n",
-                   b->oid, b->nrows);
-
-            flushFlatBuffer(data_format, SKYHOOK_VERSION, SCHEMA_VERSION, b, SCHEMA, num_objs);
-        } // for every FBmap key
-    } // if using hashing
-
+    // every bucket still held, hashed or not, has rows short of flush_rows
+    for (auto& x: FBmap) {
+        bucket_t *b = x.second;
+        printf("\tFlushing bucket %ld to Ceph with %ld rows\n",
+               b->oid, b->nrows);
+        if (b->held != NULL)
+            clusterBucket(b, params);
+        flushes->push(b);
+    }
     FBmap.clear();
-    printf("Done flushing all the objects\n");
+}
 
-    // Close .csv file
-    if( inFile.is_open() )
-        inFile.close();
+/*
+ * Memory a bucket buffers once row was added to it: the flatbuffer built
+ * so far, its row offsets and index entries, or for arrow and held rows an
+ * estimate from the input line, as their builders grow in steps.
+ */
+uint64_t bucketBytes(const bucket_t *bucketPtr, const encoded_row_t& row) {
+    if (bucketPtr->held != NULL)
+        return bucketPtr->held->capacity() * sizeof(encoded_row_t);
+    if (bucketPtr->cols != NULL)
+        return bucketPtr->bytes + row.line_len +
+               bucketPtr->cols->size() * sizeof(uint64_t);
+    return bucketPtr->fb->GetSize() +
+           bucketPtr->rowsv->capacity() * sizeof(flatbuffers::Offset<Record>) +
+           bucketPtr->deletev->capacity() +
+           bucketPtr->idx_bytes;
+}
 
-    return 0;
+/*
+ * Writer stage: finishes each full bucket and writes it out.
+ */
+void flushBuckets(const load_params_t *params,
+                  stage_queue<bucket_t *> *flushes) {
+
+    bucket_t *bucketPtr;
+    while (flushes->pop(bucketPtr)) {
+        if (bucketPtr->cols != NULL) {
+            flushArrowBucket(params->data_format,
+                             SCHEMA_VERSION,
+                             bucketPtr,
+                             params->num_objs);
+            continue;
+        }
+        // Flush FlatBuffer to Ceph (currently writes to a file on disk)
+        flushFlatBuffer(params->data_format,
+                        SKYHOOK_VERSION,
+                        SCHEMA_VERSION,
+                        bucketPtr,
+                        SCHEMA,
+                        params->num_objs);
+    }
 }
 
 std::vector<std::string> line_split(const std::string &s, char delim) {
@@ -328,8 +1048,38 @@ bool promptBoolVariable(string variable, string bool_string) {
     return i;
 }
 
-vector<string> parseRow(string row, char delim=Tables::CSV_DELIM) {
-    return line_split(row, delim);
+/*
+ * Splits the line [begin, end) into fields that point into the line, like
+ * line_split (an empty last field is dropped), reusing parsedRow. The key
+ * columns are parsed as they are found and combined into hashKey, upper 32
+ * bits from the first key column and lower from the second.
+ */
+void parseRow(const char *begin,
+              const char *end,
+              char delim,
+              const vector<int>& compositeKeyIndexes,
+              vector<std::string_view>& parsedRow,
+              uint64_t *hashKey) {
+
+    parsedRow.clear();
+    uint64_t upper = 0, lower = 0;
+    const char *p = begin;
+    while (p < end) {
+        // memchr is vectorized, much faster than a byte loop on long rows
+        const char *d = static_cast<const char*>(memchr(p, delim, end - p));
+        const char *field_end = d ? d : end;
+        std::string_view field(p, field_end - p);
+        int i = parsedRow.size();
+        if (!compositeKeyIndexes.empty()) {
+            if (i == compositeKeyIndexes[0])
+                upper = parseUnsigned<uint64_t>(field);
+            else if (compositeKeyIndexes.size() > 1 && i == compositeKeyIndexes[1])
+                lower = parseUnsigned<uint64_t>(field);
+        }
+        parsedRow.push_back(field);
+        p = field_end + 1;
+    }
+    *hashKey = (upper << 32) | lower;
 }
 
 Tables::schema_vec getSchema(vector<int>& compositeKey,
@@ -378,50 +1128,48 @@ Tables::schema_vec getSchema(vector<int>& compositeKey,
     return sky_schema;
 }
 
-vector<uint8_t>
-initializeFlexBuffer(vector<string> parsedRow,
-                     Tables::schema_vec schema,
-                     vector<uint64_t> *nullbits) {
+void
+initializeFlexBuffer(flexbuffers::Builder *flx,
+                     const vector<std::string_view>& parsedRow,
+                     const Tables::schema_vec& schema,
+                     uint64_t *nullbits) {
 
-    flexbuffers::Builder *flx = new flexbuffers::Builder();
+    // the builder is reused across rows, its buffer stays allocated
+    flx->Clear();
 
     // load parsed row into our flxBuilder and update nullbits
     getFlxBuffer(flx, parsedRow, schema, nullbits);
-
-    // get pointer to FlexBuffer
-    vector<uint8_t> flxPtr = flx->GetBuffer();
-    delete flx;
-    return flxPtr;
 }
 
 void getFlxBuffer(flxBuilder *flx,
-                  vector<string> parsedRow,
-                  Tables::schema_vec schema,
-                  vector<uint64_t> *nullbits) {
+                  const vector<std::string_view>& parsedRow,
+                  const Tables::schema_vec& schema,
+                  uint64_t *nullbits) {
 
     bool nullFlag = false;
-    string nullcmp = "NULL";
+    const std::string_view nullcmp = "NULL";
 
     // Create Flexbuffer from Parsed Row and Schema
     flx->Vector([&]() {
         for(int i=0;i<(int)schema.size();i++) {
-            Tables::col_info col = schema[i];
-            nullFlag = false;
-            if(strcmp(parsedRow[i].c_str(), nullcmp.c_str() ) == 0)
-                nullFlag = true;
+            const Tables::col_info& col = schema[i];
+            // a missing field is loaded as null
+            nullFlag = (i >= (int)parsedRow.size() ||
+                        col.idx >= (int)parsedRow.size() ||
+                        parsedRow[col.idx] == nullcmp);
             if(nullFlag) {
-                // Mark nullbit
+                // Mark nullbit, bit col.idx as the readers of the rows
+                // test it
                 uint64_t nullMask = 0x00;
-                if(i<64) {
-                    nullMask = 1lu << (63-i);
-                    nullbits[0][0] |=  nullMask;
+                if(col.idx<64) {
+                    nullMask = 1lu << col.idx;
+                    nullbits[0] |= nullMask;
                 }
                 else {
-                    nullMask = 1lu << (63- (i-64));
-                    nullbits[0][1] |= nullMask;
+                    nullMask = 1lu << (col.idx-64);
+                    nullbits[1] |= nullMask;
                 }
 
-                printf("NULL CASE SWITCHES \n");
                 // Put a dummy variable to hold the index for future updates
                 switch(col.type) {
                 case Tables::SDT_INT8:
@@ -475,51 +1223,52 @@ void getFlxBuffer(flxBuilder *flx,
                 }
             }
             else {
+                const std::string_view& field = parsedRow[col.idx];
                 switch(col.type) {
                 case Tables::SDT_INT8:
-                    flx->Add(static_cast<int8_t>(stoi(parsedRow[col.idx].c_str())));
+                    flx->Add(parseSigned<int8_t>(field));
                     break;
                 case Tables::SDT_INT16:
-                    flx->Add(static_cast<int16_t>(stoi(parsedRow[col.idx].c_str())));
+                    flx->Add(parseSigned<int16_t>(field));
                     break;
                 case Tables::SDT_INT32:
-                    flx->Add(static_cast<int32_t>(stoi(parsedRow[col.idx].c_str())));
+                    flx->Add(parseSigned<int32_t>(field));
                     break;
                 case Tables::SDT_INT64:
-                    flx->Add(static_cast<int64_t>(stoi(parsedRow[col.idx].c_str())));
+                    flx->Add(parseSigned<int64_t>(field));
                     break;
                 case Tables::SDT_UINT8:
-                    flx->Add(static_cast<uint8_t>(stoul(parsedRow[col.idx].c_str())));
+                    flx->Add(parseUnsigned<uint8_t>(field));
                     break;
                 case Tables::SDT_UINT16:
-                    flx->Add(static_cast<uint16_t>(stoul(parsedRow[col.idx].c_str())));
+                    flx->Add(parseUnsigned<uint16_t>(field));
                     break;
                 case Tables::SDT_UINT32:
-                    flx->Add(static_cast<uint32_t>(stoul(parsedRow[col.idx].c_str())));
+                    flx->Add(parseUnsigned<uint32_t>(field));
                     break;
                 case Tables::SDT_UINT64:
-                    flx->Add(static_cast<uint64_t>(stoul(parsedRow[col.idx].c_str())));
+                    flx->Add(parseUnsigned<uint64_t>(field));
                     break;
                 case Tables::SDT_CHAR:
-                    flx->Add(static_cast<char>(parsedRow[col.idx][0]));
+                    flx->Add(static_cast<char>(field.empty() ? 0 : field[0]));
                     break;
                 case Tables::SDT_UCHAR:
-                    flx->Add(static_cast<unsigned char>(parsedRow[col.idx][0]));
+                    flx->Add(static_cast<unsigned char>(field.empty() ? 0 : field[0]));
                     break;
                 case Tables::SDT_BOOL:
-                    flx->Add(static_cast<bool>(parsedRow[col.idx].c_str()));
+                    flx->Add(parseBool(field));
                     break;
                 case Tables::SDT_FLOAT:
-                    flx->Add(static_cast<float>(stof(parsedRow[col.idx].c_str())));
+                    flx->Add(static_cast<float>(parseDouble(field)));
                     break;
                 case Tables::SDT_DOUBLE:
-                    flx->Add(static_cast<double>(stod(parsedRow[col.idx].c_str())));
+                    flx->Add(parseDouble(field));
                     break;
                 case Tables::SDT_DATE:
-                    flx->Add(parsedRow[col.idx].c_str());
+                    flx->String(field.data(), field.size());
                     break;
                 case Tables::SDT_STRING:
-                    flx->Add(parsedRow[col.idx].c_str());
+                    flx->String(field.data(), field.size());
                     break;
                 default:
                     flx->Add("EMPTY");
@@ -531,40 +1280,13 @@ void getFlxBuffer(flxBuilder *flx,
     flx->Finish();
 }
 
-uint64_t hashCompositeKey(vector<int> compositeKeyIndexes,
-                          vector<string> parsedRow) {
-
-    // Hash the Composite Key
-    uint64_t hashKey=0, upper=0, lower=0;
-    stringstream(parsedRow[compositeKeyIndexes[0]]) >> upper;
-    hashKey = upper << 32;
-    if(compositeKeyIndexes.size() > 1) {
-        stringstream(parsedRow[compositeKeyIndexes[1]]) >> lower;
-        hashKey = hashKey | lower;
-    }
-    if (compositeKeyIndexes.size() > 2)
-        assert (Tables::TablesErrCodes::UnsupportedNumKeyCols==0);
-    return hashKey;
-}
-
-uint64_t jumpConsistentHash(uint64_t key, uint64_t num_buckets) {
-    // Source:
-    // A Fast, Minimal Memory, Consistent Hash Algorithm
-    // https://arxiv.org/ftp/arxiv/papers/1406/1406.2294.pdf
-
-    int64_t b=-1l, j=0l;
-    while(j < (int64_t)num_buckets) {
-        b = j;
-        key = key * 286293355588894185ULL + 1;
-        j = (b+1) * (double(1LL << 31) / double((key>>33) + 1));
-    }
-    return b;
-}
-
 bucket_t* GetAndInitializeBucket(
     map<uint64_t, bucket_t *> &FBmap,
-    uint64_t oid,vector<uint64_t> *nullbits,
-    vector<uint8_t> flxPtr,
+    uint64_t oid,
+    uint64_t RID,
+    const uint64_t *nullbits,
+    const uint8_t *flx,
+    size_t flx_len,
     string tablename) {
 
     bucket_t *bucketPtr;
@@ -576,9 +1298,7 @@ bucket_t* GetAndInitializeBucket(
     deletePtr = bucketPtr->deletev;
     rowsPtr = bucketPtr->rowsv;
 
-    uint64_t RID = getNextRID();
-
-    insertRowIntoBucket(fbPtr, RID, nullbits, flxPtr, deletePtr, rowsPtr);
+    insertRowIntoBucket(fbPtr, RID, nullbits, flx, flx_len, deletePtr, rowsPtr);
     bucketPtr->nrows++;
     return bucketPtr;
 }
@@ -602,6 +1322,12 @@ retrieveBucketFromOID(map<uint64_t, bucket_t *> &FBmap, uint64_t oid, string tab
         bucketPtr->fb = new fbBuilder();
         bucketPtr->deletev = new delete_vector();
         bucketPtr->rowsv = new rows_vector();
+        bucketPtr->cols = NULL;
+        bucketPtr->held = NULL;
+        bucketPtr->index = NULL;
+        bucketPtr->idx_bytes = 0;
+        bucketPtr->bytes = 0;
+        bucketPtr->last_fill = 0;
         FBmap[oid] = bucketPtr;
     }
     return bucketPtr;
@@ -611,22 +1337,469 @@ void
 insertRowIntoBucket(
     fbb fbPtr,
     uint64_t RID,
-    vector<uint64_t> *nullbits,
-    vector<uint8_t> flxPtr,
+    const uint64_t *nullbits,
+    const uint8_t *flx,
+    size_t flx_len,
     delete_vector *deletePtr,
     rows_vector *rowsPtr) {
 
     // Serialize FlexBuffer row into FlatBufferBuilder
-    auto flxSerial = fbPtr->CreateVector(flxPtr);
-    auto nullbitsSerial = fbPtr->CreateVector(*nullbits);
+    auto flxSerial = fbPtr->CreateVector(flx, flx_len);
+    auto nullbitsSerial = fbPtr->CreateVector(nullbits, 2);
     auto rowOffset = CreateRecord(*fbPtr, RID, nullbitsSerial, flxSerial);
     deletePtr->push_back(0);
     rowsPtr->push_back(rowOffset);
 }
 
-// NOTE: this is a blind increment, should come from database
-uint64_t getNextRID() {
-    return RID++;
+// arrow type a skyhook column type is stored as, as transform_fb_to_arrow does
+static std::shared_ptr<arrow::DataType> arrowType(int sky_type) {
+    switch (sky_type) {
+    case Tables::SDT_BOOL:   return arrow::boolean();
+    case Tables::SDT_CHAR:
+    case Tables::SDT_INT8:   return arrow::int8();
+    case Tables::SDT_INT16:  return arrow::int16();
+    case Tables::SDT_INT32:  return arrow::int32();
+    case Tables::SDT_INT64:  return arrow::int64();
+    case Tables::SDT_UCHAR:
+    case Tables::SDT_UINT8:  return arrow::uint8();
+    case Tables::SDT_UINT16: return arrow::uint16();
+    case Tables::SDT_UINT32: return arrow::uint32();
+    case Tables::SDT_UINT64: return arrow::uint64();
+    case Tables::SDT_FLOAT:  return arrow::float32();
+    case Tables::SDT_DOUBLE: return arrow::float64();
+    case Tables::SDT_DATE:
+    case Tables::SDT_STRING: return arrow::utf8();
+    default:                 return nullptr;
+    }
+}
+
+template <typename BuilderT, typename T>
+static inline arrow::Status appendValue(arrow::ArrayBuilder *b, T v) {
+    return static_cast<BuilderT*>(b)->Append(v);
+}
+
+/*
+ * Appends the fields of a parsed row to the column builders of an arrow
+ * bucket. NULL or missing fields are appended as nulls when the column is
+ * nullable, and as 0 (or empty) otherwise, as the flexbuffer rows hold them.
+ */
+arrow::Status appendArrowRow(arrow_cols& cols,
+                                    uint64_t RID,
+                                    const vector<std::string_view>& parsedRow,
+                                    const Tables::schema_vec& schema) {
+
+    const std::string_view nullcmp = "NULL";
+    arrow::Status s;
+    for (int i = 0; i < (int)schema.size() && s.ok(); i++) {
+        const Tables::col_info& col = schema[i];
+        arrow::ArrayBuilder *b = cols[i].get();
+        bool null = (i >= (int)parsedRow.size() ||
+                     col.idx >= (int)parsedRow.size() ||
+                     parsedRow[col.idx] == nullcmp);
+        if (null && col.nullable) {
+            s = b->AppendNull();
+            continue;
+        }
+        std::string_view field = null ? std::string_view() : parsedRow[col.idx];
+        switch (col.type) {
+        case Tables::SDT_BOOL:
+            s = appendValue<arrow::BooleanBuilder>(b, parseBool(field));
+            break;
+        case Tables::SDT_CHAR:
+            s = appendValue<arrow::Int8Builder>(b,
+                    static_cast<int8_t>(field.empty() ? 0 : field[0]));
+            break;
+        case Tables::SDT_INT8:
+            s = appendValue<arrow::Int8Builder>(b, parseSigned<int8_t>(field));
+            break;
+        case Tables::SDT_INT16:
+            s = appendValue<arrow::Int16Builder>(b, parseSigned<int16_t>(field));
+            break;
+        case Tables::SDT_INT32:
+            s = appendValue<arrow::Int32Builder>(b, parseSigned<int32_t>(field));
+            break;
+        case Tables::SDT_INT64:
+            s = appendValue<arrow::Int64Builder>(b, parseSigned<int64_t>(field));
+            break;
+        case Tables::SDT_UCHAR:
+            s = appendValue<arrow::UInt8Builder>(b,
+                    static_cast<uint8_t>(field.empty() ? 0 : field[0]));
+            break;
+        case Tables::SDT_UINT8:
+            s = appendValue<arrow::UInt8Builder>(b, parseUnsigned<uint8_t>(field));
+            break;
+        case Tables::SDT_UINT16:
+            s = appendValue<arrow::UInt16Builder>(b, parseUnsigned<uint16_t>(field));
+            break;
+        case Tables::SDT_UINT32:
+            s = appendValue<arrow::UInt32Builder>(b, parseUnsigned<uint32_t>(field));
+            break;
+        case Tables::SDT_UINT64:
+            s = appendValue<arrow::UInt64Builder>(b, parseUnsigned<uint64_t>(field));
+            break;
+        case Tables::SDT_FLOAT:
+            s = appendValue<arrow::FloatBuilder>(b,
+                    static_cast<float>(parseDouble(field)));
+            break;
+        case Tables::SDT_DOUBLE:
+            s = appendValue<arrow::DoubleBuilder>(b, parseDouble(field));
+            break;
+        case Tables::SDT_DATE:
+        case Tables::SDT_STRING:
+            s = static_cast<arrow::StringBuilder*>(b)->Append(
+                    field.data(), field.size());
+            break;
+        default:
+            s = arrow::Status::NotImplemented("unsupported column type " +
+                                              std::to_string(col.type));
+            break;
+        }
+    }
+    if (s.ok())
+        s = appendValue<arrow::Int64Builder>(cols[schema.size()].get(),
+                                             static_cast<int64_t>(RID));
+    return s;
+}
+
+bucket_t* GetAndInitializeArrowBucket(
+    map<uint64_t, bucket_t *> &FBmap,
+    uint64_t oid,
+    uint64_t RID,
+    const vector<std::string_view>& parsedRow,
+    const load_params_t *params) {
+
+    bucket_t *bucketPtr = retrieveArrowBucketFromOID(FBmap, oid, params);
+    arrow::Status s = appendArrowRow(*bucketPtr->cols, RID, parsedRow,
+                                     params->schema);
+    if (!s.ok()) {
+        std::cout << "appending row " << RID << " to arrow bucket failed: "
+                  << s.ToString() << std::endl;
+        exit(1);
+    }
+    bucketPtr->nrows++;
+    return bucketPtr;
+}
+
+/*
+ * Gets the arrow bucket of an oid, or creates one with a builder per column
+ * pre-sized to hold the rows of a full bucket.
+ */
+bucket_t*
+retrieveArrowBucketFromOID(map<uint64_t, bucket_t *> &FBmap,
+                           uint64_t oid,
+                           const load_params_t *params) {
+
+    auto it = FBmap.find(oid);
+    if (it != FBmap.end())
+        return it->second;
+
+    // under a memory budget the builders grow with the rows instead, else
+    // buckets that stay small would hold a full bucket of memory each.
+    int64_t capacity = std::min(params->flush_rows, params->read_rows + 1);
+    if (params->max_bucket_mem > 0)
+        capacity = std::min<int64_t>(capacity, 1024);
+    arrow::MemoryPool *pool = arrow::default_memory_pool();
+    arrow_cols *cols = new arrow_cols();
+    arrow::Status s;
+    for (auto& col : params->schema) {
+        std::shared_ptr<arrow::DataType> type = arrowType(col.type);
+        if (type == nullptr) {
+            std::cout << "column '" << col.name << "' type " << col.type
+                      << " not supported by SFT_ARROW. aborting." << std::endl;
+            exit(1);
+        }
+        std::unique_ptr<arrow::ArrayBuilder> b;
+        s = arrow::MakeBuilder(pool, type, &b);
+        if (s.ok())
+            s = b->Reserve(capacity);
+        if (!s.ok())
+            break;
+        cols->push_back(std::move(b));
+    }
+    if (s.ok()) {
+        // RID column
+        std::unique_ptr<arrow::ArrayBuilder> b(new arrow::Int64Builder(pool));
+        s = b->Reserve(capacity);
+        cols->push_back(std::move(b));
+    }
+    if (!s.ok()) {
+        std::cout << "creating arrow builders failed: " << s.ToString() << std::endl;
+        exit(1);
+    }
+
+    bucket_t *bucketPtr = new bucket_t();
+    bucketPtr->oid = oid;
+    bucketPtr->nrows = 0;
+    bucketPtr->table_name = params->table_name;
+    bucketPtr->fb = NULL;
+    bucketPtr->deletev = NULL;
+    bucketPtr->rowsv = NULL;
+    bucketPtr->cols = cols;
+    bucketPtr->held = NULL;
+    bucketPtr->index = NULL;
+    bucketPtr->idx_bytes = 0;
+    bucketPtr->bytes = 0;
+    bucketPtr->last_fill = 0;
+    FBmap[oid] = bucketPtr;
+    return bucketPtr;
+}
+
+// IDX_REC key data of a row, over the index cols of the load
+void indexKeyData(const load_params_t *params,
+                  const vector<std::string_view>& parsedRow,
+                  string& key_data) {
+    indexKeyData(params->index_cols, parsedRow, key_data);
+}
+
+/*
+ * Adds the IDX_RID and IDX_REC entries of row row_num of a bucket, keyed as
+ * exec_build_sky_index_op keys them. Returns the bytes they take.
+ */
+uint64_t indexRow(bucket_t *bucketPtr, const load_params_t *params,
+                  uint64_t rid, uint32_t row_num, std::string_view key_data) {
+
+    if (bucketPtr->index == NULL)
+        bucketPtr->index = new index_entries();
+    index_entries& entries = *bucketPtr->index;
+    uint64_t bytes = 0;
+    idx_rec_entry ent(0, row_num, rid);
+    if (params->index_rid) {
+        entries.push_back(std::make_pair(
+            params->idx_rid_prefix + Tables::u64tostr(rid), ent));
+        bytes += sizeof(entries.back()) + entries.back().first.capacity();
+    }
+    if (!params->index_cols.empty()) {
+        entries.push_back(std::make_pair(
+            indexRecKey(params->idx_rec_prefix, key_data,
+                        params->index_unique, rid), ent));
+        bytes += sizeof(entries.back()) + entries.back().first.capacity();
+    }
+    bucketPtr->idx_bytes += bytes;
+    return bytes;
+}
+
+/*
+ * Holds a row of a --cluster_by bucket, it is encoded once the bucket is
+ * full and sorted.
+ */
+void holdRow(bucket_t *bucketPtr, const encoded_row_t& row) {
+    if (bucketPtr->held == NULL)
+        bucketPtr->held = new vector<encoded_row_t>();
+    bucketPtr->held->push_back(row);
+    bucketPtr->nrows++;
+}
+
+// typed value of one cluster col of a row, only the field of its type is set
+typedef struct {
+    bool null;
+    int64_t i;
+    uint64_t u;
+    double d;
+    std::string_view s;
+} cluster_key_t;
+
+static cluster_key_t clusterKey(const Tables::col_info& col,
+                                const vector<std::string_view>& parsedRow) {
+    cluster_key_t k = {false, 0, 0, 0, std::string_view()};
+    if (col.idx >= (int)parsedRow.size() || parsedRow[col.idx] == "NULL") {
+        k.null = true;
+        return k;
+    }
+    std::string_view f = parsedRow[col.idx];
+    if (isSignedType(col.type))
+        k.i = parseSigned<int64_t>(f);
+    else if (isUnsignedType(col.type))
+        k.u = parseUnsigned<uint64_t>(f);
+    else if (isRealType(col.type))
+        k.d = parseDouble(f);
+    else
+        k.s = f;
+    return k;
+}
+
+// nulls sort first, as arrow does
+static int compareClusterKeys(const cluster_key_t *k1,
+                              const cluster_key_t *k2,
+                              const Tables::schema_vec& cols) {
+    for (size_t c = 0; c < cols.size(); c++) {
+        const cluster_key_t& a = k1[c];
+        const cluster_key_t& b = k2[c];
+        if (a.null || b.null) {
+            if (a.null != b.null)
+                return a.null ? -1 : 1;
+            continue;
+        }
+        int t = cols[c].type;
+        int cmp;
+        if (isSignedType(t))
+            cmp = (a.i > b.i) - (a.i < b.i);
+        else if (isUnsignedType(t))
+            cmp = (a.u > b.u) - (a.u < b.u);
+        else if (isRealType(t))
+            cmp = (a.d > b.d) - (a.d < b.d);
+        else
+            cmp = a.s.compare(b.s);
+        if (cmp != 0)
+            return cmp;
+    }
+    return 0;
+}
+
+/*
+ * Sorts the held rows of a full bucket by the cluster cols, then encodes
+ * them in that order into the bucket, as flexbuffer rows or into its arrow
+ * builders. The sort is stable, rows with equal keys keep their rid order.
+ * flush_rows bounds the rows held per bucket, so the sort is in memory.
+ */
+void clusterBucket(bucket_t *bucketPtr, const load_params_t *params) {
+
+    vector<encoded_row_t>& rows = *bucketPtr->held;
+    const Tables::schema_vec& cluster_cols = params->cluster_cols;
+    const size_t nkeys = cluster_cols.size();
+    const vector<int> no_key_cols;
+    vector<std::string_view> parsedRow;
+    uint64_t hashKey;
+
+    // sort keys of all the rows, nkeys per row, pointing into the input
+    vector<cluster_key_t> keys(rows.size() * nkeys);
+    for (size_t r = 0; r < rows.size(); r++) {
+        parseRow(rows[r].line, rows[r].line + rows[r].line_len,
+                 params->csv_delim, no_key_cols, parsedRow, &hashKey);
+        for (size_t k = 0; k < nkeys; k++)
+            keys[r * nkeys + k] = clusterKey(cluster_cols[k], parsedRow);
+    }
+
+    vector<uint32_t> order(rows.size());
+    for (size_t r = 0; r < order.size(); r++)
+        order[r] = r;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return compareClusterKeys(&keys[a * nkeys], &keys[b * nkeys],
+                                  cluster_cols) < 0;
+    });
+
+    flexbuffers::Builder flx;
+    const bool indexing = params->index_rid || !params->index_cols.empty();
+    string key_data;
+    uint32_t row_num = 0;
+    for (uint32_t r : order) {
+        const encoded_row_t& row = rows[r];
+        parseRow(row.line, row.line + row.line_len, params->csv_delim,
+                 no_key_cols, parsedRow, &hashKey);
+        if (indexing) {
+            key_data.clear();
+            indexKeyData(params, parsedRow, key_data);
+            indexRow(bucketPtr, params, row.rid, row_num, key_data);
+        }
+        row_num++;
+        if (bucketPtr->cols != NULL) {
+            arrow::Status s = appendArrowRow(*bucketPtr->cols, row.rid,
+                                             parsedRow, params->schema);
+            if (!s.ok()) {
+                std::cout << "appending row " << row.rid
+                          << " to arrow bucket failed: " << s.ToString()
+                          << std::endl;
+                exit(1);
+            }
+        }
+        else {
+            uint64_t nullbits[2] = {0, 0};
+            initializeFlexBuffer(&flx, parsedRow, params->schema, nullbits);
+            const vector<uint8_t>& buf = flx.GetBuffer();
+            insertRowIntoBucket(bucketPtr->fb, row.rid, nullbits,
+                                buf.data(), buf.size(),
+                                bucketPtr->deletev, bucketPtr->rowsv);
+        }
+    }
+
+    delete bucketPtr->held;
+    bucketPtr->held = NULL;
+    bucketPtr->sort_cols = params->cluster_by;
+}
+
+/*
+ * Finishes the column builders of an arrow bucket into a table laid out as
+ * transform_fb_to_arrow lays it out: the data columns, then RID and
+ * DELETED_VECTOR, with the skyhook metadata in the schema.
+ */
+int
+finishArrowBucket(
+    bucket_t *bucketPtr,
+    uint8_t schema_v,
+    std::shared_ptr<arrow::Table> *table,
+    string& errmsg) {
+
+    Tables::schema_vec sc = Tables::schemaFromString(SCHEMA);
+    arrow_cols& cols = *bucketPtr->cols;
+    std::vector<std::shared_ptr<arrow::Array>> array_list;
+    std::vector<std::shared_ptr<arrow::Field>> schema_vector;
+    std::shared_ptr<arrow::KeyValueMetadata> metadata(new arrow::KeyValueMetadata);
+
+    // NOTE: same keys in the same order as transform_fb_to_arrow, they are
+    // referenced by their enums.
+    metadata->Append(ToString(METADATA_SKYHOOK_VERSION), std::to_string(2));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA_VERSION),
+                     std::to_string(schema_v));
+    metadata->Append(ToString(METADATA_DATA_STRUCTURE_VERSION),
+                     std::to_string(schema_v));
+    metadata->Append(ToString(METADATA_DATA_FORMAT_TYPE),
+                     std::to_string(SFT_ARROW));
+    metadata->Append(ToString(METADATA_DATA_SCHEMA), SCHEMA);
+    metadata->Append(ToString(METADATA_DB_SCHEMA), "*");
+    metadata->Append(ToString(METADATA_TABLE_NAME), bucketPtr->table_name);
+    metadata->Append(ToString(METADATA_NUM_ROWS),
+                     std::to_string(bucketPtr->nrows));
+
+    for (size_t i = 0; i < cols.size(); i++) {
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status s = cols[i]->Finish(&array);
+        if (!s.ok()) {
+            errmsg.append("finishArrowBucket: " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+        array_list.push_back(array);
+        if (i < sc.size())
+            schema_vector.push_back(arrow::field(sc[i].name, array->type()));
+        else
+            schema_vector.push_back(arrow::field("RID", arrow::int64()));
+    }
+
+    // Add deleted vector column, no row is deleted yet
+    {
+        arrow::BooleanBuilder builder;
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status s = builder.Reserve(bucketPtr->nrows);
+        for (uint64_t i = 0; s.ok() && i < bucketPtr->nrows; i++)
+            builder.UnsafeAppend(false);
+        if (s.ok())
+            s = builder.Finish(&array);
+        if (!s.ok()) {
+            errmsg.append("finishArrowBucket: DELETED_VECTOR " + s.ToString());
+            return TablesErrCodes::ArrowStatusErr;
+        }
+        array_list.push_back(array);
+        schema_vector.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
+    }
+
+    auto schema = std::make_shared<arrow::Schema>(schema_vector, metadata);
+    *table = arrow::Table::Make(schema, array_list);
+    return 0;
+}
+
+void
+flushArrowBucket(
+    string data_format,
+    uint8_t schema_v,
+    bucket_t *bucketPtr,
+    uint64_t numOfObjs) {
+
+    // Flush to Ceph Here TO OID bucket with n Rows or Crash if Failed
+    if(writeToDisk(data_format, bucketPtr->oid, schema_v, bucketPtr, numOfObjs) < 0)
+        exit(EXIT_FAILURE);
+
+    printf("Clearing arrow builders, Delete Bucket from Map\n\n");
+    delete bucketPtr->cols;
+    delete bucketPtr->index;
+    delete bucketPtr;
 }
 
 void
@@ -728,7 +1901,11 @@ void finishFlatBuffer(
 }
 
 
-/* TODO: instead of writing objects to disk, write directly to ceph. */
+/*
+ * Writes the finished bucket as an fbmeta to a local file, or with --pool
+ * appends it to the object of the same name in the pool. Only called from
+ * the writer thread.
+ */
 int
 writeToDisk(
     string data_format,
@@ -748,7 +1925,54 @@ writeToDisk(
                 fbmeta_builder,
                 SFT_FLATBUF_FLEX_ROW,
                 reinterpret_cast<unsigned char*>(bucket->fb->GetBufferPointer()),
-                bucket->fb->GetSize());
+                bucket->fb->GetSize(),
+                false, 0, 0,
+                COMPRESSION,
+                bucket->sort_cols);
+    else if(data_format == "SFT_FLATBUF_UNION_COL") {
+        // encode the finished row bucket column-wise via arrow
+        std::string errmsg;
+        std::shared_ptr<arrow::Table> table;
+        schema_vec sc = schemaFromString(SCHEMA);
+        flatbuffers::FlatBufferBuilder flatbldr(1024);
+        int ret = transform_fb_to_arrow(
+                reinterpret_cast<const char*>(bucket->fb->GetBufferPointer()),
+                bucket->fb->GetSize(), sc, errmsg, &table);
+        if (ret == 0)
+            ret = transform_arrow_to_skycol(table, errmsg, flatbldr);
+        if (ret != 0) {
+            std::cout << "encoding columns failed: " << errmsg << std::endl;
+            exit(1);
+        }
+        createFbMeta(
+                fbmeta_builder,
+                SFT_FLATBUF_UNION_COL,
+                reinterpret_cast<unsigned char*>(flatbldr.GetBufferPointer()),
+                flatbldr.GetSize(),
+                false, 0, 0,
+                COMPRESSION,
+                bucket->sort_cols);
+    }
+    else if(data_format == "SFT_ARROW") {
+        std::string errmsg;
+        std::shared_ptr<arrow::Table> table;
+        std::shared_ptr<arrow::Buffer> buffer;
+        int ret = finishArrowBucket(bucket, schema_v, &table, errmsg);
+        if (ret == 0)
+            ret = convert_arrow_to_buffer(table, &buffer, COMPRESSION);
+        if (ret != 0) {
+            std::cout << "building arrow table failed: " << errmsg << std::endl;
+            exit(1);
+        }
+        createFbMeta(
+                fbmeta_builder,
+                SFT_ARROW,
+                reinterpret_cast<unsigned char*>(buffer->mutable_data()),
+                buffer->size(),
+                false, 0, 0,
+                COMPRESSION,
+                bucket->sort_cols);
+    }
     else {
         std::cout << "data_format '" << data_format << "' not supported. aborting." << std::endl;
         exit(1);
@@ -770,11 +1994,35 @@ writeToDisk(
                                         + "." + bucket->table_name
                                         + "." + std::to_string(oid);
 
-    // write to disk as binary bl data.
-    int mode = 0600;
-    fbmeta_wrapper_bl.write_file(fname.c_str(), mode);
-    std::cout << "bucket->fb->GetSize()=" << bucket->fb->GetSize()
-              << "; fbmeta_builder len=" << fbmeta_builder->GetSize()
+    if (POOL_WRITER != NULL) {
+        int ret = writeToPool(fname, fbmeta_wrapper_bl, bucket->index);
+        if (ret < 0) {
+            std::cout << "writing object '" << fname << "' failed: " << ret
+                      << std::endl;
+            delete fbmeta_builder;
+            return ret;
+        }
+    }
+    else {
+        // write to disk as binary bl data. the first write of a file by
+        // this load replaces it, later ones append another fbmeta.
+        static set<string> written_files;
+        int flags = O_WRONLY | O_CREAT;
+        flags |= written_files.insert(fname).second ? O_TRUNC : O_APPEND;
+        int fd = ::open(fname.c_str(), flags, 0600);
+        int ret = fd < 0 ? -errno : fbmeta_wrapper_bl.write_fd(fd);
+        if (fd >= 0)
+            ::close(fd);
+        if (ret < 0) {
+            std::cout << "writing file '" << fname << "' failed: " << ret
+                      << std::endl;
+            delete fbmeta_builder;
+            return ret;
+        }
+    }
+    if (bucket->fb != NULL)
+        std::cout << "bucket->fb->GetSize()=" << bucket->fb->GetSize() << "; ";
+    std::cout << "fbmeta_builder len=" << fbmeta_builder->GetSize()
               << "; fbmeta_bl len=" << fbmeta_bl.length()
               << "; fbmeta_wrapper_bl len=" << fbmeta_wrapper_bl.length()
               << std::endl;
@@ -783,6 +2031,144 @@ writeToDisk(
     return 0;
 }
 
+// one aio write to the pool
+typedef struct {
+    string oid;
+    librados::AioCompletion *c;
+} pool_write_t;
+
+static void poolWriteComplete(librados::completion_t cb, void *arg) {
+    pool_write_t *w = static_cast<pool_write_t*>(arg);
+    int ret = w->c->get_return_value();
+    if (ret < 0)
+        std::cout << "write of object '" << w->oid << "' failed: " << ret
+                  << std::endl;
+    w->c->release();
+    delete w;
+
+    std::lock_guard<std::mutex> l(POOL_WRITER->lock);
+    if (ret < 0 && POOL_WRITER->error == 0)
+        POOL_WRITER->error = ret;
+    POOL_WRITER->inflight--;
+    POOL_WRITER->cond.notify_all();
+}
+
+/*
+ * Issues an aio append of bl to oid, after waiting for a free slot when
+ * max_inflight writes are outstanding. The first write of an object by this
+ * load replaces it instead when overwrite is set, clearing its omap and
+ * fb_seq_num xattr. Appends to one object are applied in the order they are
+ * issued.
+ * With index entries, the append is done by the append_with_index_op method
+ * instead, which sets the entries, sorted here, in the object omap along with
+ * the IDX_FB entry of the appended data.
+ * Returns the error of an earlier failed write, if any.
+ */
+int writeToPool(const string& oid, bufferlist& bl, index_entries *index) {
+
+    bool write_full = false;
+    {
+        std::unique_lock<std::mutex> l(POOL_WRITER->lock);
+        POOL_WRITER->cond.wait(l, [] {
+            return POOL_WRITER->inflight < POOL_WRITER->max_inflight;
+        });
+        if (POOL_WRITER->error < 0)
+            return POOL_WRITER->error;
+        if (POOL_WRITER->overwrite)
+            write_full = POOL_WRITER->written.insert(oid).second;
+        POOL_WRITER->inflight++;
+    }
+
+    pool_write_t *w = new pool_write_t();
+    w->oid = oid;
+    w->c = librados::Rados::aio_create_completion(w, NULL, poolWriteComplete);
+    int ret;
+    if (index != NULL) {
+        idx_append_op op("*", POOL_WRITER->table_name, write_full,
+                         POOL_WRITER->idx_batch_size);
+        op.data = bl;
+        op.idx_prefixes = POOL_WRITER->idx_prefixes;
+        std::stable_sort(index->begin(), index->end(),
+                         [](const index_entries::value_type& a,
+                            const index_entries::value_type& b) {
+                             return a.first < b.first;
+                         });
+        for (auto& e : *index)
+            op.rec_entries.insert_or_assign(op.rec_entries.end(),
+                                            std::move(e.first), e.second);
+        index->clear();
+        bufferlist inbl;
+        using ceph::encode;
+        encode(op, inbl);
+        ret = POOL_WRITER->ioctx.aio_exec(oid, w->c, "tabular",
+                                          "append_with_index_op", inbl, NULL);
+    }
+    else if (write_full) {
+        // as append_with_index_op does when it replaces an object, the index
+        // entries of the old data and their fb_seq_num go with it
+        librados::ObjectWriteOperation op;
+        op.create(false);
+        op.omap_clear();
+        op.rmxattr("fb_seq_num");
+        op.write_full(bl);
+        ret = POOL_WRITER->ioctx.aio_operate(oid, w->c, &op);
+    }
+    else
+        ret = POOL_WRITER->ioctx.aio_append(oid, w->c, bl, bl.length());
+    if (ret < 0) {
+        w->c->release();
+        delete w;
+        std::lock_guard<std::mutex> l(POOL_WRITER->lock);
+        POOL_WRITER->inflight--;
+        POOL_WRITER->cond.notify_all();
+    }
+    return ret;
+}
+
+// waits for the outstanding pool writes, returns the first error
+int drainPoolWrites() {
+    std::unique_lock<std::mutex> l(POOL_WRITER->lock);
+    POOL_WRITER->cond.wait(l, [] { return POOL_WRITER->inflight == 0; });
+    return POOL_WRITER->error;
+}
+
+/*
+ * Returns the first of n consecutive rids. They come from the current
+ * block when it has n left, else from a new block of at least block_size
+ * rids allocated by the alloc_rid_block_op method on the rid object; the
+ * rest of the old block is not used. Exits if the allocation fails.
+ */
+uint64_t takeRIDs(rid_allocator_t *rids, uint64_t n) {
+
+    if (rids->end - rids->next < n) {
+        rid_alloc_op op(rids->table_name, std::max(rids->block_size, n));
+        bufferlist inbl, outbl;
+        using ceph::encode;
+        encode(op, inbl);
+        int ret = POOL_WRITER->ioctx.exec(rids->oid, "tabular",
+                                          "alloc_rid_block_op", inbl, outbl);
+        uint64_t first = 0;
+        if (ret >= 0) {
+            try {
+                bufferlist::const_iterator it = outbl.begin();
+                ceph::decode(first, it);
+            } catch (const buffer::error &err) {
+                ret = -EINVAL;
+            }
+        }
+        if (ret < 0) {
+            std::cout << "allocating rids from '" << rids->oid << "' failed: "
+                      << ret << std::endl;
+            exit(1);
+        }
+        rids->next = first;
+        rids->end = first + op.count;
+    }
+    uint64_t first = rids->next;
+    rids->next += n;
+    return first;
+}
+
 void
 deleteBucket(
     bucket_t *bucketPtr,
@@ -797,5 +2183,6 @@ deleteBucket(
     delete deletePtr;
     rowsPtr->clear();
     delete rowsPtr;
+    delete bucketPtr->index;
     delete bucketPtr;
 }
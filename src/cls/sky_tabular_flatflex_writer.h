@@ -0,0 +1,362 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#ifndef SKY_TABULAR_FLATFLEX_WRITER_H
+#define SKY_TABULAR_FLATFLEX_WRITER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+#include "cls_tabular_utils.h"
+
+/*
+ * Field parsing, partitioning and index keying of the flatflex writer,
+ * kept here so they can be tested on their own.
+ */
+
+/*
+ * Typed field parsers, in place on the field and without allocations.
+ * Leading blanks and a '+' sign are skipped, like stoi/stod do, a field
+ * that is not a number loads as 0.
+ */
+inline std::string_view trimField(std::string_view f) {
+    while (!f.empty() && (f.front() == ' ' || f.front() == '\t'))
+        f.remove_prefix(1);
+    if (!f.empty() && f.front() == '+')
+        f.remove_prefix(1);
+    return f;
+}
+
+template <typename T>
+inline T parseSigned(std::string_view f) {
+    f = trimField(f);
+    int64_t v = 0;
+    std::from_chars(f.data(), f.data() + f.size(), v);
+    return static_cast<T>(v);
+}
+
+template <typename T>
+inline T parseUnsigned(std::string_view f) {
+    f = trimField(f);
+    uint64_t v = 0;
+    std::from_chars(f.data(), f.data() + f.size(), v);
+    return static_cast<T>(v);
+}
+
+inline double parseDouble(std::string_view f) {
+    // strtod needs a terminated string, fields are not, so a short copy
+    // on the stack is parsed.
+    char buf[64];
+    f = trimField(f);
+    size_t n = std::min(f.size(), sizeof(buf) - 1);
+    memcpy(buf, f.data(), n);
+    buf[n] = '\0';
+    return strtod(buf, NULL);
+}
+
+inline bool parseBool(std::string_view f) {
+    f = trimField(f);
+    return f == "1" || f == "t" || f == "T" || f == "true" || f == "TRUE";
+}
+
+inline bool isSignedType(int t) {
+    return t == Tables::SDT_INT8 || t == Tables::SDT_INT16 ||
+           t == Tables::SDT_INT32 || t == Tables::SDT_INT64;
+}
+
+inline bool isUnsignedType(int t) {
+    return t == Tables::SDT_UINT8 || t == Tables::SDT_UINT16 ||
+           t == Tables::SDT_UINT32 || t == Tables::SDT_UINT64;
+}
+
+inline bool isRealType(int t) {
+    return t == Tables::SDT_FLOAT || t == Tables::SDT_DOUBLE;
+}
+
+/*
+ * Picks the object of each row, one of num_objs. Shared by the parser
+ * threads, partition() does not modify the partitioner.
+ *  - jump: the first two integer key cols packed into 64 bits by parseRow,
+ *    then jumpConsistentHash. Places rows as hash_partition_arrow_table does.
+ *    With more than two key cols, or key cols that are not integers, it
+ *    partitions as hash does.
+ *  - hash: hash64 chained over the typed values of all the key cols, then
+ *    jumpConsistentHash.
+ *  - range: rows below bound i of one column go to object i, the rest to the
+ *    object after the last bound.
+ *  - roundrobin: consecutive lines go to consecutive objects.
+ */
+class partitioner {
+public:
+    virtual ~partitioner() {}
+    virtual uint64_t partition(const std::vector<std::string_view>& row,
+                               uint64_t packed_key,
+                               uint64_t line) const = 0;
+};
+
+class jump_partitioner : public partitioner {
+public:
+    explicit jump_partitioner(uint64_t num_objs) : num_objs(num_objs) {}
+
+    uint64_t partition(const std::vector<std::string_view>& row,
+                       uint64_t packed_key,
+                       uint64_t line) const override {
+        return Tables::jumpConsistentHash(packed_key, num_objs);
+    }
+
+private:
+    uint64_t num_objs;
+};
+
+class hash_partitioner : public partitioner {
+public:
+    hash_partitioner(const Tables::schema_vec& schema,
+                     const std::vector<int>& key_cols,
+                     uint64_t num_objs) : num_objs(num_objs) {
+        for (int idx : key_cols) {
+            for (auto& col : schema) {
+                if (col.idx == idx)
+                    keys.push_back(col);
+            }
+        }
+    }
+
+    // numbers are hashed by value, so 7 and 007 land in the same object
+    uint64_t partition(const std::vector<std::string_view>& row,
+                       uint64_t packed_key,
+                       uint64_t line) const override {
+        uint64_t h = 0;
+        for (auto& col : keys) {
+            std::string_view f = col.idx < (int)row.size() ?
+                                 row[col.idx] : std::string_view();
+            switch (col.type) {
+            case Tables::SDT_INT8:
+            case Tables::SDT_INT16:
+            case Tables::SDT_INT32:
+            case Tables::SDT_INT64: {
+                int64_t v = parseSigned<int64_t>(f);
+                h = Tables::hash64(&v, sizeof(v), h);
+                break;
+            }
+            case Tables::SDT_UINT8:
+            case Tables::SDT_UINT16:
+            case Tables::SDT_UINT32:
+            case Tables::SDT_UINT64: {
+                uint64_t v = parseUnsigned<uint64_t>(f);
+                h = Tables::hash64(&v, sizeof(v), h);
+                break;
+            }
+            case Tables::SDT_FLOAT:
+            case Tables::SDT_DOUBLE: {
+                double v = parseDouble(f);
+                h = Tables::hash64(&v, sizeof(v), h);
+                break;
+            }
+            default:
+                h = Tables::hash64(f.data(), f.size(), h);
+                break;
+            }
+        }
+        return Tables::jumpConsistentHash(h, num_objs);
+    }
+
+private:
+    Tables::schema_vec keys;
+    uint64_t num_objs;
+};
+
+class range_partitioner : public partitioner {
+public:
+    explicit range_partitioner(const Tables::col_info& col) : col(col) {}
+
+    // parses the bounds as values of the column, false if not ascending
+    bool set_bounds(const std::vector<std::string>& bounds) {
+        for (auto& b : bounds) {
+            std::string_view f(b);
+            if (is_signed())
+                ibounds.push_back(parseSigned<int64_t>(f));
+            else if (is_unsigned())
+                ubounds.push_back(parseUnsigned<uint64_t>(f));
+            else if (is_real())
+                dbounds.push_back(parseDouble(f));
+            else
+                sbounds.push_back(b);
+        }
+        return std::is_sorted(ibounds.begin(), ibounds.end()) &&
+               std::is_sorted(ubounds.begin(), ubounds.end()) &&
+               std::is_sorted(dbounds.begin(), dbounds.end()) &&
+               std::is_sorted(sbounds.begin(), sbounds.end());
+    }
+
+    uint64_t partition(const std::vector<std::string_view>& row,
+                       uint64_t packed_key,
+                       uint64_t line) const override {
+        std::string_view f = col.idx < (int)row.size() ?
+                             row[col.idx] : std::string_view();
+        if (is_signed())
+            return below(ibounds, parseSigned<int64_t>(f));
+        if (is_unsigned())
+            return below(ubounds, parseUnsigned<uint64_t>(f));
+        if (is_real())
+            return below(dbounds, parseDouble(f));
+        return below(sbounds, f);
+    }
+
+private:
+    bool is_signed() const { return isSignedType(col.type); }
+    bool is_unsigned() const { return isUnsignedType(col.type); }
+    bool is_real() const { return isRealType(col.type); }
+
+    // number of bounds the value is not below
+    template <typename V, typename T>
+    static uint64_t below(const std::vector<V>& bounds, const T& v) {
+        return std::upper_bound(bounds.begin(), bounds.end(), v) - bounds.begin();
+    }
+
+    Tables::col_info col;
+    std::vector<int64_t> ibounds;
+    std::vector<uint64_t> ubounds;
+    std::vector<double> dbounds;
+    std::vector<std::string> sbounds;
+};
+
+class roundrobin_partitioner : public partitioner {
+public:
+    explicit roundrobin_partitioner(uint64_t num_objs) : num_objs(num_objs) {}
+
+    // by line number, so no state is shared between the parser threads
+    uint64_t partition(const std::vector<std::string_view>& row,
+                       uint64_t packed_key,
+                       uint64_t line) const override {
+        return line % num_objs;
+    }
+
+private:
+    uint64_t num_objs;
+};
+
+/*
+ * Creates the partitioner of the given name, or returns NULL with errmsg
+ * set when the schema or options do not suit it.
+ */
+inline partitioner *makePartitioner(const std::string& name,
+                                    const Tables::schema_vec& schema,
+                                    const std::vector<int>& composite_key_indexes,
+                                    const std::string& partition_col,
+                                    const std::string& partition_bounds,
+                                    uint64_t num_objs,
+                                    std::string& errmsg) {
+
+    if (name == "jump") {
+        if (composite_key_indexes.empty()) {
+            errmsg = "partitioner jump requires a key column in the schema.";
+            return NULL;
+        }
+        // only two integer key cols fit the packed key, wider composite keys
+        // and keys of other types are hashed over all their cols instead.
+        bool packs = composite_key_indexes.size() <= 2;
+        for (auto& c : schema) {
+            if (c.is_key && !isSignedType(c.type) && !isUnsignedType(c.type))
+                packs = false;
+        }
+        if (!packs)
+            return new hash_partitioner(schema, composite_key_indexes, num_objs);
+        return new jump_partitioner(num_objs);
+    }
+    if (name == "hash") {
+        if (composite_key_indexes.empty()) {
+            errmsg = "partitioner hash requires a key column in the schema.";
+            return NULL;
+        }
+        return new hash_partitioner(schema, composite_key_indexes, num_objs);
+    }
+    if (name == "roundrobin")
+        return new roundrobin_partitioner(num_objs);
+    if (name != "range") {
+        errmsg = "partitioner '" + name + "' not supported.";
+        return NULL;
+    }
+
+    const Tables::col_info *col = NULL;
+    for (auto& c : schema) {
+        if (partition_col.empty() ? c.is_key : c.name == partition_col) {
+            col = &c;
+            break;
+        }
+    }
+    if (col == NULL) {
+        errmsg = "partitioner range requires --partition_col or a key column.";
+        return NULL;
+    }
+    std::vector<std::string> bounds;
+    if (!partition_bounds.empty())
+        boost::split(bounds, partition_bounds, boost::is_any_of(","));
+    if (bounds.size() + 1 > num_objs) {
+        errmsg = "partitioner range needs num_objs > number of bounds.";
+        return NULL;
+    }
+    range_partitioner *part = new range_partitioner(*col);
+    if (!part->set_bounds(bounds)) {
+        delete part;
+        errmsg = "partition_bounds '" + partition_bounds + "' not ascending.";
+        return NULL;
+    }
+    return part;
+}
+
+/*
+ * IDX_REC key data of a row: the values of the index cols, as
+ * exec_build_sky_index_op builds them from the flexbuffer row, appended to
+ * key_data.
+ */
+inline void indexKeyData(const Tables::schema_vec& cols,
+                         const std::vector<std::string_view>& parsedRow,
+                         std::string& key_data) {
+    for (size_t i = 0; i < cols.size(); i++) {
+        if (i > 0) key_data += Tables::IDX_KEY_DELIM_INNER;
+        uint64_t v = 0;
+        if (cols[i].idx < (int)parsedRow.size() &&
+            parsedRow[cols[i].idx] != "NULL") {
+            std::string_view f = parsedRow[cols[i].idx];
+            if (isSignedType(cols[i].type))
+                v = parseSigned<int64_t>(f);
+            else if (cols[i].type == Tables::SDT_BOOL)
+                v = parseBool(f);
+            else
+                v = parseUnsigned<uint64_t>(f);
+        }
+        key_data += Tables::buildKeyData(cols[i].type, v);
+    }
+}
+
+/*
+ * IDX_REC key of a row from its key data, the rid is appended unless the
+ * index is unique, as exec_build_sky_index_op does.
+ */
+inline std::string indexRecKey(const std::string& prefix,
+                               std::string_view key_data,
+                               bool unique,
+                               uint64_t rid) {
+    std::string key = prefix;
+    key.append(key_data);
+    if (!unique)
+        key += (Tables::IDX_KEY_DELIM_OUTER +
+                Tables::IDX_KEY_DELIM_UNIQUE +
+                Tables::IDX_KEY_DELIM_INNER +
+                std::to_string(rid));
+    return key;
+}
+
+#endif
@@ -0,0 +1,426 @@
+// hand written in the form flatc 1.11 generates for skyhookv2_col.fbs, as
+// flatc is not part of the build. keep it in sync with the schema, or replace
+// it with the output of flatc --cpp skyhookv2_col.fbs.
+
+
+#ifndef FLATBUFFERS_GENERATED_SKYHOOKV2COL_TABLES_H_
+#define FLATBUFFERS_GENERATED_SKYHOOKV2COL_TABLES_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+namespace Tables {
+
+struct Table_COL;
+
+struct Column_COL;
+
+struct Table_COL FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_DATA_FORMAT_TYPE = 4,
+    VT_SKYHOOK_VERSION = 6,
+    VT_DATA_STRUCTURE_VERSION = 8,
+    VT_DATA_SCHEMA_VERSION = 10,
+    VT_DATA_SCHEMA = 12,
+    VT_DB_SCHEMA = 14,
+    VT_TABLE_NAME = 16,
+    VT_DELETE_VECTOR = 18,
+    VT_RIDS = 20,
+    VT_COLS = 22,
+    VT_NROWS = 24
+  };
+  int32_t data_format_type() const {
+    return GetField<int32_t>(VT_DATA_FORMAT_TYPE, 0);
+  }
+  int32_t skyhook_version() const {
+    return GetField<int32_t>(VT_SKYHOOK_VERSION, 0);
+  }
+  int32_t data_structure_version() const {
+    return GetField<int32_t>(VT_DATA_STRUCTURE_VERSION, 0);
+  }
+  int32_t data_schema_version() const {
+    return GetField<int32_t>(VT_DATA_SCHEMA_VERSION, 0);
+  }
+  const flatbuffers::String *data_schema() const {
+    return GetPointer<const flatbuffers::String *>(VT_DATA_SCHEMA);
+  }
+  const flatbuffers::String *db_schema() const {
+    return GetPointer<const flatbuffers::String *>(VT_DB_SCHEMA);
+  }
+  const flatbuffers::String *table_name() const {
+    return GetPointer<const flatbuffers::String *>(VT_TABLE_NAME);
+  }
+  const flatbuffers::Vector<uint8_t> *delete_vector() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_DELETE_VECTOR);
+  }
+  const flatbuffers::Vector<uint64_t> *RIDs() const {
+    return GetPointer<const flatbuffers::Vector<uint64_t> *>(VT_RIDS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<Tables::Column_COL>> *cols() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Tables::Column_COL>> *>(VT_COLS);
+  }
+  uint32_t nrows() const {
+    return GetField<uint32_t>(VT_NROWS, 0);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int32_t>(verifier, VT_DATA_FORMAT_TYPE) &&
+           VerifyField<int32_t>(verifier, VT_SKYHOOK_VERSION) &&
+           VerifyField<int32_t>(verifier, VT_DATA_STRUCTURE_VERSION) &&
+           VerifyField<int32_t>(verifier, VT_DATA_SCHEMA_VERSION) &&
+           VerifyOffset(verifier, VT_DATA_SCHEMA) &&
+           verifier.VerifyString(data_schema()) &&
+           VerifyOffset(verifier, VT_DB_SCHEMA) &&
+           verifier.VerifyString(db_schema()) &&
+           VerifyOffset(verifier, VT_TABLE_NAME) &&
+           verifier.VerifyString(table_name()) &&
+           VerifyOffset(verifier, VT_DELETE_VECTOR) &&
+           verifier.VerifyVector(delete_vector()) &&
+           VerifyOffset(verifier, VT_RIDS) &&
+           verifier.VerifyVector(RIDs()) &&
+           VerifyOffset(verifier, VT_COLS) &&
+           verifier.VerifyVector(cols()) &&
+           verifier.VerifyVectorOfTables(cols()) &&
+           VerifyField<uint32_t>(verifier, VT_NROWS) &&
+           verifier.EndTable();
+  }
+};
+
+struct Table_COLBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_data_format_type(int32_t data_format_type) {
+    fbb_.AddElement<int32_t>(Table_COL::VT_DATA_FORMAT_TYPE, data_format_type, 0);
+  }
+  void add_skyhook_version(int32_t skyhook_version) {
+    fbb_.AddElement<int32_t>(Table_COL::VT_SKYHOOK_VERSION, skyhook_version, 0);
+  }
+  void add_data_structure_version(int32_t data_structure_version) {
+    fbb_.AddElement<int32_t>(Table_COL::VT_DATA_STRUCTURE_VERSION, data_structure_version, 0);
+  }
+  void add_data_schema_version(int32_t data_schema_version) {
+    fbb_.AddElement<int32_t>(Table_COL::VT_DATA_SCHEMA_VERSION, data_schema_version, 0);
+  }
+  void add_data_schema(flatbuffers::Offset<flatbuffers::String> data_schema) {
+    fbb_.AddOffset(Table_COL::VT_DATA_SCHEMA, data_schema);
+  }
+  void add_db_schema(flatbuffers::Offset<flatbuffers::String> db_schema) {
+    fbb_.AddOffset(Table_COL::VT_DB_SCHEMA, db_schema);
+  }
+  void add_table_name(flatbuffers::Offset<flatbuffers::String> table_name) {
+    fbb_.AddOffset(Table_COL::VT_TABLE_NAME, table_name);
+  }
+  void add_delete_vector(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> delete_vector) {
+    fbb_.AddOffset(Table_COL::VT_DELETE_VECTOR, delete_vector);
+  }
+  void add_RIDs(flatbuffers::Offset<flatbuffers::Vector<uint64_t>> RIDs) {
+    fbb_.AddOffset(Table_COL::VT_RIDS, RIDs);
+  }
+  void add_cols(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Tables::Column_COL>>> cols) {
+    fbb_.AddOffset(Table_COL::VT_COLS, cols);
+  }
+  void add_nrows(uint32_t nrows) {
+    fbb_.AddElement<uint32_t>(Table_COL::VT_NROWS, nrows, 0);
+  }
+  explicit Table_COLBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  Table_COLBuilder &operator=(const Table_COLBuilder &);
+  flatbuffers::Offset<Table_COL> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<Table_COL>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<Table_COL> CreateTable_COL(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t data_format_type = 0,
+    int32_t skyhook_version = 0,
+    int32_t data_structure_version = 0,
+    int32_t data_schema_version = 0,
+    flatbuffers::Offset<flatbuffers::String> data_schema = 0,
+    flatbuffers::Offset<flatbuffers::String> db_schema = 0,
+    flatbuffers::Offset<flatbuffers::String> table_name = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> delete_vector = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint64_t>> RIDs = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Tables::Column_COL>>> cols = 0,
+    uint32_t nrows = 0) {
+  Table_COLBuilder builder_(_fbb);
+  builder_.add_nrows(nrows);
+  builder_.add_cols(cols);
+  builder_.add_RIDs(RIDs);
+  builder_.add_delete_vector(delete_vector);
+  builder_.add_table_name(table_name);
+  builder_.add_db_schema(db_schema);
+  builder_.add_data_schema(data_schema);
+  builder_.add_data_schema_version(data_schema_version);
+  builder_.add_data_structure_version(data_structure_version);
+  builder_.add_skyhook_version(skyhook_version);
+  builder_.add_data_format_type(data_format_type);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<Table_COL> CreateTable_COLDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t data_format_type = 0,
+    int32_t skyhook_version = 0,
+    int32_t data_structure_version = 0,
+    int32_t data_schema_version = 0,
+    const char *data_schema = nullptr,
+    const char *db_schema = nullptr,
+    const char *table_name = nullptr,
+    const std::vector<uint8_t> *delete_vector = nullptr,
+    const std::vector<uint64_t> *RIDs = nullptr,
+    const std::vector<flatbuffers::Offset<Tables::Column_COL>> *cols = nullptr,
+    uint32_t nrows = 0) {
+  auto data_schema__ = data_schema ? _fbb.CreateString(data_schema) : 0;
+  auto db_schema__ = db_schema ? _fbb.CreateString(db_schema) : 0;
+  auto table_name__ = table_name ? _fbb.CreateString(table_name) : 0;
+  auto delete_vector__ = delete_vector ? _fbb.CreateVector<uint8_t>(*delete_vector) : 0;
+  auto RIDs__ = RIDs ? _fbb.CreateVector<uint64_t>(*RIDs) : 0;
+  auto cols__ = cols ? _fbb.CreateVector<flatbuffers::Offset<Tables::Column_COL>>(*cols) : 0;
+  return Tables::CreateTable_COL(
+      _fbb,
+      data_format_type,
+      skyhook_version,
+      data_structure_version,
+      data_schema_version,
+      data_schema__,
+      db_schema__,
+      table_name__,
+      delete_vector__,
+      RIDs__,
+      cols__,
+      nrows);
+}
+
+struct Column_COL FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_COL_IDX = 4,
+    VT_ENCODING = 6,
+    VT_NULLBITS = 8,
+    VT_MIN_VAL = 10,
+    VT_MAX_VAL = 12,
+    VT_BIT_WIDTH = 14,
+    VT_PACKED = 16,
+    VT_RUN_ENDS = 18,
+    VT_RUN_VALUES = 20,
+    VT_DICT = 22,
+    VT_DOUBLES = 24,
+    VT_STRINGS = 26
+  };
+  int32_t col_idx() const {
+    return GetField<int32_t>(VT_COL_IDX, 0);
+  }
+  int32_t encoding() const {
+    return GetField<int32_t>(VT_ENCODING, 0);
+  }
+  const flatbuffers::Vector<uint64_t> *nullbits() const {
+    return GetPointer<const flatbuffers::Vector<uint64_t> *>(VT_NULLBITS);
+  }
+  int64_t min_val() const {
+    return GetField<int64_t>(VT_MIN_VAL, 0);
+  }
+  int64_t max_val() const {
+    return GetField<int64_t>(VT_MAX_VAL, 0);
+  }
+  uint32_t bit_width() const {
+    return GetField<uint32_t>(VT_BIT_WIDTH, 0);
+  }
+  const flatbuffers::Vector<uint64_t> *packed() const {
+    return GetPointer<const flatbuffers::Vector<uint64_t> *>(VT_PACKED);
+  }
+  const flatbuffers::Vector<uint32_t> *run_ends() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_RUN_ENDS);
+  }
+  const flatbuffers::Vector<int64_t> *run_values() const {
+    return GetPointer<const flatbuffers::Vector<int64_t> *>(VT_RUN_VALUES);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *dict() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *>(VT_DICT);
+  }
+  const flatbuffers::Vector<double> *doubles() const {
+    return GetPointer<const flatbuffers::Vector<double> *>(VT_DOUBLES);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *strings() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *>(VT_STRINGS);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int32_t>(verifier, VT_COL_IDX) &&
+           VerifyField<int32_t>(verifier, VT_ENCODING) &&
+           VerifyOffset(verifier, VT_NULLBITS) &&
+           verifier.VerifyVector(nullbits()) &&
+           VerifyField<int64_t>(verifier, VT_MIN_VAL) &&
+           VerifyField<int64_t>(verifier, VT_MAX_VAL) &&
+           VerifyField<uint32_t>(verifier, VT_BIT_WIDTH) &&
+           VerifyOffset(verifier, VT_PACKED) &&
+           verifier.VerifyVector(packed()) &&
+           VerifyOffset(verifier, VT_RUN_ENDS) &&
+           verifier.VerifyVector(run_ends()) &&
+           VerifyOffset(verifier, VT_RUN_VALUES) &&
+           verifier.VerifyVector(run_values()) &&
+           VerifyOffset(verifier, VT_DICT) &&
+           verifier.VerifyVector(dict()) &&
+           verifier.VerifyVectorOfStrings(dict()) &&
+           VerifyOffset(verifier, VT_DOUBLES) &&
+           verifier.VerifyVector(doubles()) &&
+           VerifyOffset(verifier, VT_STRINGS) &&
+           verifier.VerifyVector(strings()) &&
+           verifier.VerifyVectorOfStrings(strings()) &&
+           verifier.EndTable();
+  }
+};
+
+struct Column_COLBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_col_idx(int32_t col_idx) {
+    fbb_.AddElement<int32_t>(Column_COL::VT_COL_IDX, col_idx, 0);
+  }
+  void add_encoding(int32_t encoding) {
+    fbb_.AddElement<int32_t>(Column_COL::VT_ENCODING, encoding, 0);
+  }
+  void add_nullbits(flatbuffers::Offset<flatbuffers::Vector<uint64_t>> nullbits) {
+    fbb_.AddOffset(Column_COL::VT_NULLBITS, nullbits);
+  }
+  void add_min_val(int64_t min_val) {
+    fbb_.AddElement<int64_t>(Column_COL::VT_MIN_VAL, min_val, 0);
+  }
+  void add_max_val(int64_t max_val) {
+    fbb_.AddElement<int64_t>(Column_COL::VT_MAX_VAL, max_val, 0);
+  }
+  void add_bit_width(uint32_t bit_width) {
+    fbb_.AddElement<uint32_t>(Column_COL::VT_BIT_WIDTH, bit_width, 0);
+  }
+  void add_packed(flatbuffers::Offset<flatbuffers::Vector<uint64_t>> packed) {
+    fbb_.AddOffset(Column_COL::VT_PACKED, packed);
+  }
+  void add_run_ends(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> run_ends) {
+    fbb_.AddOffset(Column_COL::VT_RUN_ENDS, run_ends);
+  }
+  void add_run_values(flatbuffers::Offset<flatbuffers::Vector<int64_t>> run_values) {
+    fbb_.AddOffset(Column_COL::VT_RUN_VALUES, run_values);
+  }
+  void add_dict(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> dict) {
+    fbb_.AddOffset(Column_COL::VT_DICT, dict);
+  }
+  void add_doubles(flatbuffers::Offset<flatbuffers::Vector<double>> doubles) {
+    fbb_.AddOffset(Column_COL::VT_DOUBLES, doubles);
+  }
+  void add_strings(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> strings) {
+    fbb_.AddOffset(Column_COL::VT_STRINGS, strings);
+  }
+  explicit Column_COLBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  Column_COLBuilder &operator=(const Column_COLBuilder &);
+  flatbuffers::Offset<Column_COL> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<Column_COL>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<Column_COL> CreateColumn_COL(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t col_idx = 0,
+    int32_t encoding = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint64_t>> nullbits = 0,
+    int64_t min_val = 0,
+    int64_t max_val = 0,
+    uint32_t bit_width = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint64_t>> packed = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> run_ends = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int64_t>> run_values = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> dict = 0,
+    flatbuffers::Offset<flatbuffers::Vector<double>> doubles = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> strings = 0) {
+  Column_COLBuilder builder_(_fbb);
+  builder_.add_max_val(max_val);
+  builder_.add_min_val(min_val);
+  builder_.add_strings(strings);
+  builder_.add_doubles(doubles);
+  builder_.add_dict(dict);
+  builder_.add_run_values(run_values);
+  builder_.add_run_ends(run_ends);
+  builder_.add_packed(packed);
+  builder_.add_bit_width(bit_width);
+  builder_.add_nullbits(nullbits);
+  builder_.add_encoding(encoding);
+  builder_.add_col_idx(col_idx);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<Column_COL> CreateColumn_COLDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t col_idx = 0,
+    int32_t encoding = 0,
+    const std::vector<uint64_t> *nullbits = nullptr,
+    int64_t min_val = 0,
+    int64_t max_val = 0,
+    uint32_t bit_width = 0,
+    const std::vector<uint64_t> *packed = nullptr,
+    const std::vector<uint32_t> *run_ends = nullptr,
+    const std::vector<int64_t> *run_values = nullptr,
+    const std::vector<flatbuffers::Offset<flatbuffers::String>> *dict = nullptr,
+    const std::vector<double> *doubles = nullptr,
+    const std::vector<flatbuffers::Offset<flatbuffers::String>> *strings = nullptr) {
+  auto nullbits__ = nullbits ? _fbb.CreateVector<uint64_t>(*nullbits) : 0;
+  auto packed__ = packed ? _fbb.CreateVector<uint64_t>(*packed) : 0;
+  auto run_ends__ = run_ends ? _fbb.CreateVector<uint32_t>(*run_ends) : 0;
+  auto run_values__ = run_values ? _fbb.CreateVector<int64_t>(*run_values) : 0;
+  auto dict__ = dict ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*dict) : 0;
+  auto doubles__ = doubles ? _fbb.CreateVector<double>(*doubles) : 0;
+  auto strings__ = strings ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*strings) : 0;
+  return Tables::CreateColumn_COL(
+      _fbb,
+      col_idx,
+      encoding,
+      nullbits__,
+      min_val,
+      max_val,
+      bit_width,
+      packed__,
+      run_ends__,
+      run_values__,
+      dict__,
+      doubles__,
+      strings__);
+}
+
+inline const Tables::Table_COL *GetTable_COL(const void *buf) {
+  return flatbuffers::GetRoot<Tables::Table_COL>(buf);
+}
+
+inline const Tables::Table_COL *GetSizePrefixedTable_COL(const void *buf) {
+  return flatbuffers::GetSizePrefixedRoot<Tables::Table_COL>(buf);
+}
+
+inline bool VerifyTable_COLBuffer(
+    flatbuffers::Verifier &verifier) {
+  return verifier.VerifyBuffer<Tables::Table_COL>(nullptr);
+}
+
+inline bool VerifySizePrefixedTable_COLBuffer(
+    flatbuffers::Verifier &verifier) {
+  return verifier.VerifySizePrefixedBuffer<Tables::Table_COL>(nullptr);
+}
+
+inline void FinishTable_COLBuffer(
+    flatbuffers::FlatBufferBuilder &fbb,
+    flatbuffers::Offset<Tables::Table_COL> root) {
+  fbb.Finish(root);
+}
+
+inline void FinishSizePrefixedTable_COLBuffer(
+    flatbuffers::FlatBufferBuilder &fbb,
+    flatbuffers::Offset<Tables::Table_COL> root) {
+  fbb.FinishSizePrefixed(root);
+}
+
+}  // namespace Tables
+
+#endif  // FLATBUFFERS_GENERATED_SKYHOOKV2COL_TABLES_H_
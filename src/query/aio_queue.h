@@ -0,0 +1,116 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#ifndef SKYHOOK_AIO_QUEUE_H
+#define SKYHOOK_AIO_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bounded multi-producer multi-consumer lock-free queue, used to hand
+ * completed aio requests from the librados callbacks to the worker threads.
+ *
+ * Array based design by D. Vyukov: every cell carries a sequence number
+ * telling a producer (seq == pos) or a consumer (seq == pos + 1) that the
+ * cell is ready for it, so push and pop each cost a single CAS on their
+ * own position counter and never take a lock.
+ */
+template <typename T>
+class MPMCQueue {
+public:
+  MPMCQueue() : cells(nullptr), mask(0), enqueue_pos(0), dequeue_pos(0) {}
+  ~MPMCQueue() { delete[] cells; }
+
+  MPMCQueue(const MPMCQueue&) = delete;
+  MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+  // (re)size the queue to hold at least capacity entries, rounded up to a
+  // power of 2. not thread safe, call before producers or consumers start.
+  void init(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity)
+      n <<= 1;
+    delete[] cells;
+    cells = new cell[n];
+    for (size_t i = 0; i < n; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    mask = n - 1;
+    enqueue_pos.store(0, std::memory_order_relaxed);
+    dequeue_pos.store(0, std::memory_order_relaxed);
+  }
+
+  // returns false if the queue is full
+  bool push(const T& v) {
+    cell *c;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      c = &cells[pos & mask];
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    c->data = v;
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // returns false if the queue is empty
+  bool pop(T& v) {
+    cell *c;
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      c = &cells[pos & mask];
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    v = c->data;
+    c->seq.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // approximate, only exact when there are no concurrent push/pop
+  bool empty() const {
+    return enqueue_pos.load(std::memory_order_acquire) ==
+           dequeue_pos.load(std::memory_order_acquire);
+  }
+
+private:
+  struct cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  // keep the producer and consumer positions on separate cache lines
+  cell *cells;
+  size_t mask;
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+#endif
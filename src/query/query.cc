@@ -11,6 +11,7 @@
 
 #include <fstream>
 #include "query/query.h"
+#include "common/ceph_json.h"
 #include "cls/cls_tabular_utils.h"
 
 
@@ -30,6 +31,9 @@ uint32_t index_batch_size;
 uint64_t extra_row_cost;
 
 std::vector<timing> timings;
+QdepthController qdepth_ctl;
+OsdDispatch osd_dispatch;
+HedgeController hedge_ctl;
 
 // query parameters to be encoded into query_op struct
 
@@ -54,6 +58,7 @@ int qop_index2_type;
 int qop_index_plan_type;
 int qop_index_batch_size;
 int qop_result_format;   // SkyFormatType enum
+int qop_pushback_threshold;
 std::string qop_db_schema_name;
 std::string qop_table_name;
 std::string qop_data_schema;
@@ -79,6 +84,11 @@ std::string idx_op_text_delims;
 int trans_op_format_type;
 bool perform_compaction;
 
+// repartition op params
+std::string repart_dst_oid_prefix;
+std::set<uint64_t> repart_dst_written;  // destinations truncated this run
+std::mutex repart_lock;
+
 // Example op params
 int expl_func_counter;
 int expl_func_id;
@@ -118,11 +128,11 @@ std::atomic<unsigned> rows_returned;
 std::atomic<bool> print_header;
 std::atomic<long long int> row_counter;
 long long int row_limit;
+Tables::arrow_ipc_stream arrow_stream;
 
-// rename work_lock
-int outstanding_ios;
+std::atomic<int> outstanding_ios;
 std::vector<std::string> target_objects;
-std::list<AioState*> ready_ios;
+MPMCQueue<AioState*> ready_ios;
 
 std::mutex dispatch_lock;
 std::condition_variable dispatch_cond;
@@ -130,14 +140,195 @@ std::condition_variable dispatch_cond;
 std::mutex work_lock;
 std::condition_variable work_cond;
 
-bool stop;
+std::atomic<bool> stop;
+
+// the mutexes above are only taken when a thread has to sleep, these tell
+// the other side whether a wakeup is needed.
+static std::atomic<int> sleeping_workers(0);
+static std::atomic<bool> dispatch_waiting(false);
+
+OutputWriter output_writer;
+ResultSpool result_spool;
+std::atomic<uint64_t> pushed_back_objs(0);
+std::vector<std::unique_ptr<BatchQuery>> batch_queries;
+
+static std::mutex client_plans_lock;
+static std::map<std::pair<bool, std::string>,
+                std::shared_ptr<ClientPlan>> client_plans;
+
+// writes are coalesced up to this size before calling fwrite
+static const size_t OUTPUT_WRITE_CHUNK = 1 << 20;
+
+// max bytes of ordered output held back for an earlier object
+static const size_t OUTPUT_PENDING_MAX = 256 << 20;
+
+void OutputWriter::start(bool _ordered, bool expect_header)
+{
+  ordered = _ordered;
+  header_pending = expect_header;
+  done = false;
+  next_seq = 0;
+  pending_bytes = 0;
+  writer = std::thread(&OutputWriter::run, this);
+  started = true;
+}
+
+void OutputWriter::submit(uint64_t seq, std::string& data)
+{
+  if (!started) {
+    write_direct(data);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(lock);
+    if (ordered) {
+      pending_bytes += data.size();
+      pending[seq].swap(data);
+    } else if (!data.empty()) {
+      ready.emplace_back();
+      ready.back().swap(data);
+    }
+  }
+  cond.notify_one();
+}
+
+void OutputWriter::submit_header(std::string& data)
+{
+  if (!started) {
+    write_direct(data);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(lock);
+    header.swap(data);
+    header_pending = false;
+  }
+  cond.notify_one();
+}
+
+void OutputWriter::write_direct(std::string& data)
+{
+  std::lock_guard<std::mutex> l(direct_lock);
+  fwrite(data.data(), 1, data.size(), stdout);
+  fflush(stdout);
+}
+
+bool OutputWriter::wait_for_space(uint64_t timeout_ns)
+{
+  if (!started || !ordered)
+    return true;
+  std::unique_lock<std::mutex> l(lock);
+  auto pred = [this] { return done || pending_bytes < OUTPUT_PENDING_MAX; };
+  if (timeout_ns > 0)
+    return space_cond.wait_for(l, std::chrono::nanoseconds(timeout_ns), pred);
+  space_cond.wait(l, pred);
+  return true;
+}
+
+void OutputWriter::finish()
+{
+  if (!started)
+    return;
+  {
+    std::lock_guard<std::mutex> l(lock);
+    done = true;
+  }
+  cond.notify_one();
+  writer.join();
+  started = false;
+}
+
+void OutputWriter::run()
+{
+  std::vector<std::string> batch;
+  std::string outbuf;
+  std::unique_lock<std::mutex> l(lock);
+  while (true) {
+    cond.wait(l, [this] {
+      return done || (!header_pending &&
+                      (!header.empty() || !ready.empty() ||
+                       (ordered && pending.count(next_seq))));
+    });
+
+    // collect everything that may be written now
+    if (!header.empty()) {
+      batch.emplace_back();
+      batch.back().swap(header);
+    }
+    if (!header_pending || done) {
+      for (auto& r : ready) {
+        batch.emplace_back();
+        batch.back().swap(r);
+      }
+      ready.clear();
+      while (ordered && !pending.empty()) {
+        auto it = pending.begin();
+        // at the end, objects that never reported are skipped
+        if (it->first != next_seq && !done)
+          break;
+        pending_bytes -= it->second.size();
+        batch.emplace_back();
+        batch.back().swap(it->second);
+        next_seq = it->first + 1;
+        pending.erase(it);
+      }
+    }
+    bool finished = done && ready.empty() && pending.empty();
+    l.unlock();
+    space_cond.notify_one();
+
+    for (auto& b : batch) {
+      if (outbuf.size() + b.size() > OUTPUT_WRITE_CHUNK && !outbuf.empty()) {
+        fwrite(outbuf.data(), 1, outbuf.size(), stdout);
+        outbuf.clear();
+      }
+      if (b.size() >= OUTPUT_WRITE_CHUNK)
+        fwrite(b.data(), 1, b.size(), stdout);
+      else
+        outbuf.append(b);
+    }
+    batch.clear();
+    if (!outbuf.empty()) {
+      fwrite(outbuf.data(), 1, outbuf.size(), stdout);
+      outbuf.clear();
+    }
+    fflush(stdout);
+
+    l.lock();
+    if (finished)
+      break;
+  }
+}
+
+// output buffer of the object this worker thread is processing, if any
+static thread_local std::string *worker_out = NULL;
+
+// collects the output of one object, handed to the writer when done
+struct ObjectOutput {
+  uint64_t seq;
+  std::string data;
+  explicit ObjectOutput(uint64_t _seq) : seq(_seq) { worker_out = &data; }
+  ~ObjectOutput() {
+    worker_out = NULL;
+    output_writer.submit(seq, data);
+  }
+};
+
+// hands text to the output buffer of the current object, or outside of
+// the query workers straight to stdout.
+static void emit_output(std::string& local)
+{
+  if (worker_out == NULL && !local.empty())
+    output_writer.write_direct(local);
+}
 
 static void print_row(const char *row)
 {
   if (quiet)
     return;
 
-  print_lock.lock();
+  std::string local;
+  std::string& out = worker_out ? *worker_out : local;
 
   const size_t order_key_field_offset = 0;
   size_t line_number_field_offset;
@@ -162,97 +353,179 @@ static void print_row(const char *row)
       comment_field_length);
 
   if (old_projection) {
-    std::cout << order_key <<
-      "|" << line_number <<
-      std::endl;
+    Tables::csv_append_int(out, order_key);
+    out.push_back('|');
+    Tables::csv_append_int(out, line_number);
+    out.push_back('\n');
   } else {
-    std::cout << extended_price <<
-      "|" << order_key <<
-      "|" << line_number <<
-      "|" << ship_date <<
-      "|" << discount <<
-      "|" << quantity <<
-      "|" << comment <<
-      std::endl;
+    Tables::csv_append_double(out, extended_price, "%g");
+    out.push_back('|');
+    Tables::csv_append_int(out, order_key);
+    out.push_back('|');
+    Tables::csv_append_int(out, line_number);
+    out.push_back('|');
+    Tables::csv_append_int(out, ship_date);
+    out.push_back('|');
+    Tables::csv_append_double(out, discount, "%g");
+    out.push_back('|');
+    Tables::csv_append_double(out, quantity, "%g");
+    out.push_back('|');
+    out.append(comment);
+    out.push_back('\n');
   }
 
-  print_lock.unlock();
+  emit_output(local);
 }
 
+static void flexrow_to_arrow(const char *dataptr,
+                             const size_t datasz,
+                             std::shared_ptr<arrow::Table> *table)
+{
+    std::string errmsg;
+    Tables::sky_root root = Tables::getSkyRoot(dataptr, datasz);
+    Tables::schema_vec sc = Tables::schemaFromString(root.data_schema);
+    int ret = Tables::transform_fb_to_arrow(dataptr, datasz, sc, errmsg, table);
+    if (ret != 0) {
+        std::cerr << "ERROR: query.cc: transform_fb_to_arrow: "
+                  << errmsg << " ERR=" << ret << std::endl;
+        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+    }
+}
 
-static void print_data(const char *dataptr,
-                       const size_t datasz,
-                       const int ds_format=SFT_FLATBUF_FLEX_ROW)
+// append the data blob to the arrow ipc stream output. arrow results are
+// passed through, flatbuf results are converted to arrow first.
+static long long int format_arrow_stream(const char *dataptr,
+                                         const size_t datasz,
+                                         const int ds_format,
+                                         bool header,
+                                         bool verbose,
+                                         long long int max_to_print,
+                                         Tables::arrow_ipc_stream& stream,
+                                         std::string& out)
 {
+    long long int rows = 0;
+    switch (ds_format) {
 
-    // NOTE: quiet and print_verbose are exec flags in run-query
-    if (quiet)
-        return;
+        case SFT_ARROW:
+        case SFT_PYARROW_BINARY:
+            rows = Tables::printArrowbufAsIpcStream(
+                dataptr,
+                datasz,
+                header,
+                verbose,
+                max_to_print,
+                stream,
+                out);
+            break;
 
-    // NOTE: print_header is atomic, and declared in query.h
-    // used here to prevent duplicate printing of csv header at runtime
-    // row_counter used to limit num rows returned in result (csv output)
-    // print_lock prevents multiple worker threads from concurrent write output
+        case SFT_FLATBUF_FLEX_ROW: {
+            std::shared_ptr<arrow::Table> table;
+            std::shared_ptr<arrow::Buffer> buffer;
+            flexrow_to_arrow(dataptr, datasz, &table);
+            Tables::convert_arrow_to_buffer(table, &buffer);
+            rows = Tables::printArrowbufAsIpcStream(
+                reinterpret_cast<const char*>(buffer->data()),
+                buffer->size(),
+                header,
+                verbose,
+                max_to_print,
+                stream,
+                out);
+            break;
+        }
 
-    print_lock.lock();
+        default:
+            std::cerr << "Print format " << ds_format << ": "
+                      << "SFT_ARROW_STREAM not implemented" << std::endl;
+            assert (Tables::SkyOutputBinaryNotImplemented==0);
+    }
+    if (rows < 0) {
+        std::cerr << "ERROR: query.cc: format_arrow_stream: ERR=" << -rows
+                  << std::endl;
+        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+    }
+    return rows;
+}
+
+// format the data blob in the client output format, appending to out.
+// returns the number of rows formatted.
+static long long int format_data(const char *dataptr,
+                                 const size_t datasz,
+                                 const int ds_format,
+                                 bool header,
+                                 bool verbose,
+                                 long long int max_to_print,
+                                 std::string& out,
+                                 Tables::arrow_ipc_stream& stream=arrow_stream)
+{
+    if (skyhook_output_format == SkyFormatType::SFT_ARROW_STREAM)
+        return format_arrow_stream(dataptr, datasz, ds_format, header,
+                                   verbose, max_to_print, stream, out);
+
+    long long int rows = 0;
     switch (ds_format) {
 
         case SFT_FLATBUF_FLEX_ROW:
             if (skyhook_output_format == SkyFormatType::SFT_PG_BINARY) {
-                row_counter += Tables::printFlatbufFlexRowAsPGBinary(
+                rows = Tables::printFlatbufFlexRowAsPGBinary(
                     dataptr,
                     datasz,
-                    print_header,
-                    print_verbose,
-                    row_limit - row_counter);
+                    header,
+                    verbose,
+                    max_to_print,
+                    out);
             }
             else {
-                row_counter += Tables::printFlatbufFlexRowAsCsv(
+                rows = Tables::printFlatbufFlexRowAsCsv(
                     dataptr,
                     datasz,
-                    print_header,
-                    print_verbose,
-                    row_limit - row_counter);
+                    header,
+                    verbose,
+                    max_to_print,
+                    out);
             }
             break;
 
         case SFT_ARROW:
             if (skyhook_output_format == SkyFormatType::SFT_PG_BINARY) {
-                row_counter += Tables::printArrowbufRowAsPGBinary(
+                rows = Tables::printArrowbufRowAsPGBinary(
                     dataptr,
                     datasz,
-                    print_header,
-                    print_verbose,
-                    row_limit - row_counter);
+                    header,
+                    verbose,
+                    max_to_print,
+                    out);
             }
 
             else if (skyhook_output_format == SkyFormatType::SFT_PYARROW_BINARY) {
-                row_counter += Tables::printArrowbufRowAsPyArrowBinary(
+                rows = Tables::printArrowbufRowAsPyArrowBinary(
                     dataptr,
                     datasz,
-                    print_header,
-                    print_verbose,
-                    row_limit - row_counter
-                );
+                    header,
+                    verbose,
+                    max_to_print,
+                    out);
             }
 
             else {
-                row_counter += Tables::printArrowbufRowAsCsv(
+                rows = Tables::printArrowbufRowAsCsv(
                     dataptr,
                     datasz,
-                    print_header,
-                    print_verbose,
-                    row_limit - row_counter);
+                    header,
+                    verbose,
+                    max_to_print,
+                    out);
             }
             break;
 
         case SFT_PYARROW_BINARY:
-            row_counter += Tables::printArrowbufRowAsPyArrowBinary(
+            rows = Tables::printArrowbufRowAsPyArrowBinary(
                 dataptr,
                 datasz,
-                print_header,
-                print_verbose,
-                row_limit - row_counter);
+                header,
+                verbose,
+                max_to_print,
+                out);
             break;
 
         case SFT_JSON:
@@ -261,21 +534,23 @@ static void print_data(const char *dataptr,
                           << "SFT_PG_BINARY not implemented" << std::endl;
                 assert (Tables::SkyOutputBinaryNotImplemented==0);
             }
-            row_counter += Tables::printJSONAsCsv(
+            rows = Tables::printJSONAsCsv(
                 dataptr,
                 datasz,
-                print_header,
-                print_verbose,
-                row_limit - row_counter);
+                header,
+                verbose,
+                max_to_print,
+                out);
             break;
 
         case SFT_EXAMPLE_FORMAT:
-            row_counter += Tables::printExampleFormatAsCsv(
+            rows = Tables::printExampleFormatAsCsv(
                 dataptr,
                 datasz,
-                print_header,
-                print_verbose,
-                row_limit - row_counter);
+                header,
+                verbose,
+                max_to_print,
+                out);
             break;
 
         case SFT_FLATBUF_CSV_ROW:
@@ -284,8 +559,209 @@ static void print_data(const char *dataptr,
         default:
             assert (Tables::TablesErrCodes::SkyFormatTypeNotRecognized==0);
     }
-    print_header = false;
-    print_lock.unlock();
+    return rows;
+}
+
+// hands the data blob to the result spool instead of printing it
+static void spool_data(const char *dataptr,
+                       const size_t datasz,
+                       const int ds_format)
+{
+    std::shared_ptr<arrow::Table> table;
+    switch (ds_format) {
+        case SFT_ARROW:
+        case SFT_PYARROW_BINARY: {
+            std::shared_ptr<arrow::Buffer> buffer = \
+                std::make_shared<arrow::Buffer>(
+                    reinterpret_cast<const uint8_t*>(dataptr), datasz);
+            Tables::extract_arrow_from_buffer(&table, buffer);
+            break;
+        }
+        case SFT_FLATBUF_FLEX_ROW:
+            flexrow_to_arrow(dataptr, datasz, &table);
+            break;
+        default:
+            std::cerr << "Spool format " << ds_format << ": "
+                      << "orderby/groupby not implemented" << std::endl;
+            assert (Tables::TablesErrCodes::SkyFormatTypeNotImplemented==0);
+            return;
+    }
+
+    std::string errmsg;
+    int ret = result_spool.append(table, errmsg);
+    if (ret != 0) {
+        std::cerr << "ERROR: query.cc: result_spool.append: "
+                  << errmsg << "\n ERR=" << ret << std::endl;
+        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+    }
+}
+
+static void print_formatted(const char *dataptr,
+                            const size_t datasz,
+                            const int ds_format)
+{
+    // NOTE: print_header is atomic, and declared in query.h
+    // used here to prevent duplicate printing of csv header at runtime
+    // row_counter used to limit num rows returned in result (csv output)
+    // workers format concurrently into their own buffers, only with a
+    // --limit is formatting serialized so the limit stays exact.
+    std::unique_lock<std::mutex> limit_lock(print_lock, std::defer_lock);
+    if (row_limit != Tables::ROW_LIMIT_DEFAULT)
+        limit_lock.lock();
+
+    // the header is handed to the writer separately, so it is written
+    // first regardless of which object's rows are written first.
+    if (print_header.exchange(false) &&
+        skyhook_output_format != SkyFormatType::SFT_PYARROW_BINARY) {
+        std::string header;
+        format_data(dataptr, datasz, ds_format, true, false, 0, header);
+        output_writer.submit_header(header);
+    }
+
+    std::string local;
+    std::string& out = worker_out ? *worker_out : local;
+    row_counter += format_data(dataptr, datasz, ds_format, false,
+                               print_verbose, row_limit - row_counter, out);
+    emit_output(local);
+}
+
+static void print_data(const char *dataptr,
+                       const size_t datasz,
+                       const int ds_format=SFT_FLATBUF_FLEX_ROW)
+{
+
+    // NOTE: quiet and print_verbose are exec flags in run-query
+    if (quiet)
+        return;
+
+    // cross-object orderby/groupby, printed by print_spooled_results()
+    if (result_spool.active()) {
+        spool_data(dataptr, datasz, ds_format);
+        return;
+    }
+
+    print_formatted(dataptr, datasz, ds_format);
+}
+
+// writes the result of a batched query on one object to its own file.
+static void print_batch_result(BatchQuery& q, ceph::bufferlist& result)
+{
+    if (result.length() == 0)
+        return;
+
+    Tables::sky_meta fbmeta = Tables::getSkyMeta(&result);
+    if (fbmeta.blob_errcode) {
+        std::cerr << "ERROR: query.cc: print_batch_result: decompressing blob" << std::endl;
+        assert(Tables::TablesErrCodes::EBLOB_COMPRESSION_FAILURE==0);
+    }
+    Tables::sky_root root = Tables::getSkyRoot(fbmeta.blob_data,
+                                               fbmeta.blob_size,
+                                               fbmeta.blob_format);
+    q.result_count += root.nrows;
+    if (quiet)
+        return;
+
+    std::lock_guard<std::mutex> l(q.lock);
+    std::string out;
+    if (q.header_pending) {
+        q.header_pending = false;
+        format_data(fbmeta.blob_data, fbmeta.blob_size, fbmeta.blob_format,
+                    true, false, 0, out, q.stream);
+    }
+    q.rows += format_data(fbmeta.blob_data, fbmeta.blob_size,
+                          fbmeta.blob_format, false, print_verbose,
+                          row_limit - q.rows, out, q.stream);
+    if (fwrite(out.data(), 1, out.size(), q.out) != out.size()) {
+        std::cerr << "ERROR: query.cc: writing batch query results to "
+                  << q.path << std::endl;
+        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+    }
+}
+
+// sort and/or group the spooled results of all objects and print them.
+// called once all workers are done.
+void print_spooled_results()
+{
+    result_count = 0;
+    std::string errmsg;
+    int ret = result_spool.finish(
+        [](const std::shared_ptr<arrow::Table>& table) {
+            std::shared_ptr<arrow::Buffer> buffer;
+            Tables::convert_arrow_to_buffer(table, &buffer);
+            result_count += table->num_rows();
+            print_formatted(reinterpret_cast<const char*>(buffer->data()),
+                            buffer->size(), SFT_ARROW);
+            return row_counter < row_limit;
+        },
+        errmsg);
+    if (ret != 0) {
+        std::cerr << "ERROR: query.cc: result_spool.finish: "
+                  << errmsg << "\n ERR=" << ret << std::endl;
+        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+    }
+}
+
+static std::shared_ptr<ClientPlan> build_client_plan(bool pushdown_projection,
+                                                    const std::string& preds)
+{
+    using namespace Tables;
+
+    std::shared_ptr<ClientPlan> plan = std::make_shared<ClientPlan>();
+    if (!pushdown_projection) {
+        plan->tbl_schema = schema_vec(sky_tbl_schema);
+        plan->qry_schema = schema_vec(sky_qry_schema);
+    }
+    else {
+        // the pushdown result holds the query cols followed by any other
+        // pred cols, so both schemas are reindexed from 0.
+        int col_idx = 0;
+        for (const auto& ci : sky_qry_schema) {
+            plan->qry_schema.push_back(col_info(col_idx++, ci.type,
+                                                ci.is_key, ci.nullable,
+                                                ci.name));
+        }
+        col_idx = 0;
+        for (const auto& ci : sky_pushdown_cols_qry_schema) {
+            plan->tbl_schema.push_back(col_info(col_idx++, ci.type,
+                                                ci.is_key, ci.nullable,
+                                                ci.name));
+        }
+    }
+    plan->preds = predsFromString(plan->tbl_schema, preds);
+
+    if (debug) {
+        cerr << "DEBUG: query.cc: client plan tbl_schema=\n"
+             << schemaToString(plan->tbl_schema) << endl;
+        cerr << "DEBUG: query.cc: client plan qry_schema=\n"
+             << schemaToString(plan->qry_schema) << endl;
+        cerr << "DEBUG: query.cc: client plan preds="
+             << predsToString(plan->preds, plan->tbl_schema) << endl;
+    }
+    return plan;
+}
+
+std::shared_ptr<ClientPlan> get_client_plan(bool pushdown_projection,
+                                            const std::string& preds)
+{
+    std::lock_guard<std::mutex> l(client_plans_lock);
+    auto key = std::make_pair(pushdown_projection, preds);
+    auto it = client_plans.find(key);
+    if (it != client_plans.end())
+        return it->second;
+    std::shared_ptr<ClientPlan> plan = build_client_plan(pushdown_projection,
+                                                         preds);
+    if (!Tables::hasAggPreds(plan->preds))
+        client_plans[key] = plan;
+    return plan;
+}
+
+// the query preds as a string over the table schema, the key of the plans
+// for the preds this client applies itself.
+static const std::string& client_query_preds()
+{
+    static const std::string s = Tables::predsToString(sky_qry_preds,
+                                                       sky_tbl_schema);
+    return s;
 }
 
 /* NOTE: This function will be used by python driver for locking  */
@@ -404,6 +880,99 @@ void worker_transform_db_op(librados::IoCtx *ioctx, transform_op op)
   ioctx->close();
 }
 
+void worker_repartition_arrow_table_op(librados::IoCtx *ioctx, repartition_op op)
+{
+  while (true) {
+    work_lock.lock();
+    if (target_objects.empty()) {
+      work_lock.unlock();
+      break;
+    }
+    std::string oid = target_objects.back();
+    target_objects.pop_back();
+    work_lock.unlock();
+
+    ceph::bufferlist inbl, outbl;
+    using ceph::encode;
+    encode(op, inbl);
+
+    if (debug)
+        cout << "DEBUG: query.cc: worker_repartition_arrow_table_op: launching exec for oid=" << oid << endl;
+
+    int ret = ioctx->exec(oid, "tabular", "repartition_arrow_table_op",
+                          inbl, outbl);
+    checkret(ret, 0);
+
+    // rebatch in place, nothing returned
+    if (op.num_objs == 0)
+        continue;
+
+    // append each returned part to its destination object, appends from
+    // concurrent workers to the same destination are atomic in rados. the
+    // first write to a destination replaces any data left by a previous
+    // run, under the lock so no append can precede it.
+    std::map<uint64_t, ceph::bufferlist> parts;
+    try {
+      ceph::bufferlist::const_iterator it = outbl.begin();
+      using ceph::decode;
+      decode(parts, it);
+    } catch (ceph::buffer::error&) {
+      cerr << "ERROR: query.cc: worker_repartition_arrow_table_op: decoding parts for oid=" << oid << endl;
+      assert(0);
+    }
+    for (auto it = parts.begin(); it != parts.end(); ++it) {
+      std::string dst_oid = repart_dst_oid_prefix + std::to_string(it->first);
+      if (debug)
+          cout << "DEBUG: query.cc: worker_repartition_arrow_table_op: oid=" << oid
+               << " appending " << it->second.length() << " bytes to " << dst_oid << endl;
+      repart_lock.lock();
+      if (repart_dst_written.insert(it->first).second) {
+        ret = ioctx->write_full(dst_oid, it->second);
+        repart_lock.unlock();
+        checkret(ret, 0);
+        continue;
+      }
+      repart_lock.unlock();
+      ret = ioctx->append(dst_oid, it->second, it->second.length());
+      checkret(ret, 0);
+    }
+  }
+  ioctx->close();
+}
+
+/*
+ * The destination objects written by the partition phase of a repartition.
+ * Objects of the destination table it did not write, left by an earlier
+ * run whose rows went elsewhere or which had more destinations, are
+ * removed so they are neither rebatched nor kept.
+ */
+int repartition_dst_objects(librados::IoCtx *ioctx,
+                            std::vector<std::string>& dst_oids)
+{
+  std::set<std::string> written;
+  for (auto i : repart_dst_written)
+    written.insert(repart_dst_oid_prefix + std::to_string(i));
+
+  const std::string& prefix = repart_dst_oid_prefix;
+  for (auto it = ioctx->nobjects_begin(); it != ioctx->nobjects_end(); ++it) {
+    const std::string& oid = it->get_oid();
+    if (oid.size() <= prefix.size() ||
+        oid.compare(0, prefix.size(), prefix) != 0 ||
+        oid.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+      continue;
+    if (written.count(oid))
+      continue;
+    if (debug)
+        cout << "DEBUG: query.cc: repartition_dst_objects: removing stale " << oid << endl;
+    int ret = ioctx->remove(oid);
+    if (ret < 0 && ret != -ENOENT)
+      return ret;
+  }
+
+  dst_oids.assign(written.begin(), written.end());
+  return 0;
+}
+
 
 void worker_exec_runstats_op(librados::IoCtx *ioctx, stats_op op)
 {
@@ -493,6 +1062,10 @@ void worker_exec_runstats_op(librados::IoCtx *ioctx, stats_op op)
     }
     using namespace Tables;
     sky_meta fbmeta = getSkyMeta(&result);
+    if (fbmeta.blob_errcode) {
+      cerr << "ERROR: query.cc: exec_stats_op: decompressing blob" << endl;
+      assert(Tables::TablesErrCodes::EBLOB_COMPRESSION_FAILURE==0);
+    }
     print_data(fbmeta.blob_data,
               fbmeta.blob_size,
               fbmeta.blob_format);
@@ -589,26 +1162,429 @@ static void add_extra_row_cost(uint64_t cost)
   }
 }
 
-// primary method for read() queries.
-void worker_exec_query_op()
+/*
+ * Get the next completed io, sleeping only when the queue is empty.
+ * Returns NULL once stop is set and no ios remain.
+ */
+static AioState* dequeue_ready_io()
 {
-  std::unique_lock<std::mutex> lock(work_lock);
-
+  AioState *s;
   while (true) {
-    // wait for work, or done
-    if (ready_ios.empty()) {
-      if (stop)
-        break;
+    if (ready_ios.pop(s))
+      return s;
+
+    // register as sleeping before the final check, so that a concurrent
+    // enqueue_ready_io() either sees us or we see its io.
+    std::unique_lock<std::mutex> lock(work_lock);
+    sleeping_workers++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool found = ready_ios.pop(s);
+    if (!found && !stop)
       work_cond.wait(lock);
+    sleeping_workers--;
+    if (found)
+      return s;
+    if (stop && ready_ios.empty())
+      return NULL;
+  }
+}
+
+// window means within these factors of the base latency grow or shrink
+// the queue depth, in between it is held.
+static const double QDEPTH_GROW_LAT_FACTOR = 1.5;
+static const double QDEPTH_SHRINK_LAT_FACTOR = 2.0;
+static const int QDEPTH_MIN_WINDOW = 4;
+
+void QdepthController::init(int start, int max)
+{
+  // on_complete leaves the depth alone once min and max meet
+  min_depth = (max <= start) ? start : 1;
+  max_depth = std::max(start, max);
+  depth = start;
+  win_ios = 0;
+  win_lat_ns = 0;
+  base_lat_ns = 0;
+}
+
+void QdepthController::on_complete(const timing& t)
+{
+  if (max_depth == min_depth || t.response <= t.dispatch)
+    return;
+
+  uint64_t lat = t.response - t.dispatch;
+  if (lat > t.eval_ns)
+    lat -= t.eval_ns;
+
+  // the window is about one round of ios at the current depth
+  win_lat_ns += lat;
+  uint64_t n = ++win_ios;
+  uint64_t window = std::max(depth.load(), QDEPTH_MIN_WINDOW);
+  if (n < window || !adjust_lock.try_lock())
+    return;
+
+  n = win_ios.exchange(0);
+  uint64_t mean = win_lat_ns.exchange(0) / std::max(n, (uint64_t)1);
+
+  // the unloaded latency may drift up (e.g. larger objects), so let the
+  // base follow slowly rather than only ever decreasing.
+  if (base_lat_ns == 0 || mean < base_lat_ns)
+    base_lat_ns = mean;
+  else
+    base_lat_ns += (mean - base_lat_ns) / 64;
+
+  int d = depth;
+  if (mean <= base_lat_ns * QDEPTH_GROW_LAT_FACTOR)
+    d = std::min(d + 1, max_depth);
+  else if (mean > base_lat_ns * QDEPTH_SHRINK_LAT_FACTOR)
+    d = std::max(d - std::max(d / 4, 1), min_depth);
+
+  if (debug && d != depth)
+    cerr << "DEBUG: query.cc: qdepth " << depth << " -> " << d
+         << " mean_lat_ns=" << mean << " base_lat_ns=" << base_lat_ns
+         << endl;
+  depth = d;
+  adjust_lock.unlock();
+}
+
+// reads the acting primary of every pg of the pool, keyed by pgid string
+static int read_pg_primaries(librados::Rados& cluster,
+                             const std::string& pool,
+                             std::map<std::string, int>& primaries)
+{
+  std::string cmd = "{\"prefix\": \"pg ls-by-pool\", \"poolstr\": \"" +
+                    pool + "\", \"format\": \"json\"}";
+  ceph::bufferlist inbl, outbl;
+  std::string outs;
+  int ret = cluster.mon_command(cmd, inbl, &outbl, &outs);
+  if (ret < 0)
+    return ret;
+
+  JSONParser parser;
+  if (!parser.parse(outbl.c_str(), outbl.length()))
+    return -EINVAL;
+
+  // newer releases wrap the pg list in an object
+  std::vector<std::string> pgs;
+  if (parser.is_array()) {
+    pgs = parser.get_array_elements();
+  } else {
+    JSONObj *stats = parser.find_obj("pg_stats");
+    if (stats == NULL || !stats->is_array())
+      return -EINVAL;
+    pgs = stats->get_array_elements();
+  }
+
+  for (auto& pg : pgs) {
+    JSONParser pgp;
+    if (!pgp.parse(pg.c_str(), pg.length()))
+      return -EINVAL;
+    JSONObj *pgid = pgp.find_obj("pgid");
+    JSONObj *primary = pgp.find_obj("acting_primary");
+    if (pgid == NULL || primary == NULL)
       continue;
+    primaries[pgid->get_data()] = atoi(primary->get_data().c_str());
+  }
+  return 0;
+}
+
+int OsdDispatch::init(librados::Rados& cluster, librados::IoCtx& ioctx,
+                      const std::string& pool, std::vector<std::string>& oids,
+                      int _max_per_osd)
+{
+  max_per_osd = _max_per_osd;
+  next = 0;
+  remaining = oids.size();
+  osds.clear();
+  queues.clear();
+
+  std::map<std::string, int> primaries;
+  int ret = read_pg_primaries(cluster, pool, primaries);
+
+  // objects are dispatched from the back of oids, keep that order per osd
+  std::map<int, size_t> slot_of_osd;
+  for (auto it = oids.rbegin(); it != oids.rend(); ++it) {
+    int osd = -1;
+    uint32_t ps;
+    if (ret == 0 && ioctx.get_object_pg_hash_position2(*it, &ps) == 0) {
+      char pgid[64];
+      snprintf(pgid, sizeof(pgid), "%lld.%x",
+               (long long)ioctx.get_id(), ps);
+      auto p = primaries.find(pgid);
+      if (p != primaries.end())
+        osd = p->second;
     }
+    auto slot = slot_of_osd.find(osd);
+    if (slot == slot_of_osd.end()) {
+      slot = slot_of_osd.insert(std::make_pair(osd, osds.size())).first;
+      osds.push_back(osd);
+      queues.emplace_back();
+    }
+    queues[slot->second].push_back(std::move(*it));
+  }
+  oids.clear();
 
-    // prepare result
-    AioState *s = ready_ios.front();
-    ready_ios.pop_front();
+  outstanding.reset(new std::atomic<int>[queues.size()]);
+  for (size_t i = 0; i < queues.size(); i++)
+    outstanding[i] = 0;
+
+  if (debug) {
+    for (size_t i = 0; i < queues.size(); i++)
+      cout << "DEBUG: query.cc: osd " << osds[i] << ": "
+           << queues[i].size() << " objects" << endl;
+  }
+  return ret;
+}
 
+bool OsdDispatch::next_object(std::string& oid, int& slot)
+{
+  for (size_t n = 0; n < queues.size(); n++) {
+    size_t i = (next + n) % queues.size();
+    if (queues[i].empty())
+      continue;
+    if (max_per_osd > 0 && outstanding[i] >= max_per_osd)
+      continue;
+    oid = std::move(queues[i].front());
+    queues[i].pop_front();
+    outstanding[i]++;
+    remaining--;
+    slot = i;
+    next = i + 1;
+    return true;
+  }
+  return false;
+}
+
+// hedging waits for this many object latencies, and uses the most recent
+// HEDGE_WINDOW of them.
+static const size_t HEDGE_MIN_SAMPLES = 20;
+static const size_t HEDGE_WINDOW = 1024;
+
+int HedgeController::init(librados::IoCtx *_ioctx, double _percentile,
+                          bool _use_read, const std::string& log_path)
+{
+  ioctx = _ioctx;
+  percentile = _percentile;
+  use_read = _use_read;
+  issued = 0;
+  won = 0;
+  if (!log_path.empty()) {
+    log = fopen(log_path.c_str(), "w");
+    if (log == NULL)
+      return -errno;
+    fprintf(log, "oid,seq,latency_ns,read_ns,eval_ns,hedged,hedge_won\n");
+  }
+  return 0;
+}
+
+void HedgeController::track(ObjRequest *req, uint64_t seq)
+{
+  std::lock_guard<std::mutex> l(lock);
+  inflight[seq] = req;
+}
+
+// caller holds lock
+uint64_t HedgeController::threshold_ns()
+{
+  if (recent_lat_ns.size() < HEDGE_MIN_SAMPLES)
+    return 0;
+  std::vector<uint64_t> v(recent_lat_ns.begin(), recent_lat_ns.end());
+  size_t k = std::min(v.size() - 1, (size_t)(v.size() * percentile / 100.0));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+void HedgeController::issue_hedges()
+{
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t threshold = threshold_ns();
+  if (threshold == 0)
+    return;
+
+  // in dispatch order, so stop at the first request that is not late yet
+  uint64_t now = getns();
+  for (auto& it : inflight) {
+    ObjRequest *req = it.second;
+    std::lock_guard<std::mutex> rl(req->lock);
+    AioState *orig = req->ios[0];
+    if (req->done || req->hedged || orig == NULL)
+      continue;
+    if (now - orig->obj_dispatch < threshold)
+      break;
+
+    AioState *hs = new AioState;
+    memset(&hs->times, 0, sizeof(hs->times));
+    hs->seq = orig->seq;
+    hs->osd_slot = orig->osd_slot;
+    hs->oid = req->oid;
+    hs->obj_dispatch = orig->obj_dispatch;
+    hs->req = req;
+    hs->hedge = true;
+    hs->c = librados::Rados::aio_create_completion(hs, NULL, handle_cb);
+    hs->times.dispatch = getns();
+
+    int ret;
+    if (use_read || req->inbl.length() == 0) {
+      hs->raw_read = req->inbl.length() > 0;
+      ret = ioctx->aio_read(req->oid, hs->c, &hs->bl, 0, 0);
+    } else {
+      ret = ioctx->aio_exec(req->oid, hs->c, "tabular",
+                            batch_queries.empty() ? "exec_query_op"
+                                                  : "exec_query_batch_op",
+                            req->inbl, &hs->bl);
+    }
+    if (ret < 0) {
+      hs->c->release();
+      delete hs;
+      continue;
+    }
+    req->ios[1] = hs;
+    req->hedged = true;
+    issued++;
     if (debug)
-        cout << "DEBUG: query.cc: worker: popped front of ready_ios" << endl;
+      cout << "DEBUG: query.cc: hedging oid=" << req->oid << " after "
+           << (now - orig->obj_dispatch) << "ns" << endl;
+  }
+}
+
+bool HedgeController::take_response(AioState *s)
+{
+  ObjRequest *req = s->req;
+
+  // no longer a hedge candidate; this waits for the dispatcher to be done
+  // with req, after which only the two completions can reach it.
+  {
+    std::lock_guard<std::mutex> l(lock);
+    inflight.erase(s->seq);
+  }
+
+  bool win, last;
+  {
+    std::lock_guard<std::mutex> rl(req->lock);
+    int idx = (req->ios[0] == s) ? 0 : 1;
+    req->ios[idx] = NULL;
+    win = !req->done;
+    req->done = true;
+    s->hedged = req->hedged;
+    AioState *other = req->ios[1 - idx];
+    // librados runs completion callbacks on its finisher, so the cancelled
+    // io completes later rather than from within aio_cancel.
+    if (win && other != NULL)
+      ioctx->aio_cancel(other->c);
+    last = (other == NULL);
+  }
+  if (last)
+    delete req;
+
+  s->req = NULL;
+  if (win) {
+    if (s->hedge)
+      won++;
+    return true;
+  }
+  s->c->release();
+  delete s;
+  return false;
+}
+
+void HedgeController::record(const AioState *s)
+{
+  uint64_t start = s->obj_dispatch ? s->obj_dispatch : s->times.dispatch;
+  if (s->times.response <= start)
+    return;
+  uint64_t lat = s->times.response - start;
+
+  std::lock_guard<std::mutex> l(lock);
+  recent_lat_ns.push_back(lat);
+  if (recent_lat_ns.size() > HEDGE_WINDOW)
+    recent_lat_ns.pop_front();
+  all_lat_ns.push_back(lat);
+  if (log)
+    fprintf(log, "%s,%llu,%llu,%llu,%llu,%d,%d\n", s->oid.c_str(),
+            (unsigned long long)s->seq, (unsigned long long)lat,
+            (unsigned long long)s->times.read_ns,
+            (unsigned long long)s->times.eval_ns, s->hedged, s->hedge);
+}
+
+void HedgeController::print_summary()
+{
+  std::lock_guard<std::mutex> l(lock);
+  if (all_lat_ns.empty())
+    return;
+  std::sort(all_lat_ns.begin(), all_lat_ns.end());
+  auto pct = [this](double p) {
+    size_t k = std::min(all_lat_ns.size() - 1,
+                        (size_t)(all_lat_ns.size() * p / 100.0));
+    return all_lat_ns[k] / 1000000.0;
+  };
+  std::cout << "object latency ms: p50=" << pct(50) << " p95=" << pct(95)
+            << " p99=" << pct(99) << " max=" << all_lat_ns.back() / 1000000.0
+            << std::endl;
+  if (enabled())
+    std::cout << "hedged requests: " << issued << " issued, " << won
+              << " won" << std::endl;
+}
+
+void HedgeController::finish()
+{
+  if (log) {
+    fclose(log);
+    log = NULL;
+  }
+}
+
+// report the io latency to the depth controller, cls reads also carry the
+// osd side read and eval times in info, NULL for other reads.
+static void record_io_timing(AioState *s, const cls_info *info)
+{
+  if (info) {
+    s->times.read_ns = info->read_ns;
+    s->times.eval_ns = info->eval_ns;
+  }
+  qdepth_ctl.on_complete(s->times);
+  hedge_ctl.record(s);
+}
+
+// give back an io slot to the dispatcher, waking it if it is waiting
+static void release_io_slot()
+{
+  outstanding_ios--;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (dispatch_waiting) {
+    std::lock_guard<std::mutex> l(dispatch_lock);
+    dispatch_cond.notify_one();
+  }
+}
+
+// blocks the dispatcher until fewer than max_ios are outstanding,
+// or, with a timeout, until the timeout expires.
+void wait_io_slot(int max_ios, uint64_t timeout_ns)
+{
+  std::unique_lock<std::mutex> lock(dispatch_lock);
+  dispatch_waiting = true;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto pred = [max_ios] { return outstanding_ios < max_ios; };
+  if (timeout_ns > 0)
+    dispatch_cond.wait_for(lock, std::chrono::nanoseconds(timeout_ns), pred);
+  else
+    dispatch_cond.wait(lock, pred);
+  dispatch_waiting = false;
+}
+
+// primary method for read() queries.
+void worker_exec_query_op()
+{
+  while (true) {
+    // wait for work, or done
+    AioState *s = dequeue_ready_io();
+    if (s == NULL)
+      break;
+
+    // everything printed for this object is collected here and handed to
+    // the output writer when the iteration ends, however it ends.
+    ObjectOutput obj_out(s->seq);
+
+    if (debug)
+        cerr << "DEBUG: query.cc: worker: popped front of ready_ios" << endl;
 
     // get returned data out of our Aio State struct, used by each query type.
     ceph::bufferlist raw_result = s->bl;
@@ -617,24 +1593,39 @@ void worker_exec_query_op()
     ceph::bufferlist result;
 
     // contains cls stats such as read time, process time, pushdowns, etc.
+    // cls results start with it, it is decoded once here and data_it is
+    // left at the result data that follows.
     cls_info info;
+    const bool has_info = use_cls && !s->raw_read && raw_result.length() > 0;
+    ceph::bufferlist::const_iterator data_it = raw_result.begin();
+    if (has_info) {
+        try {
+            using ceph::decode;
+            decode(info, data_it);
+        }
+        catch (ceph::buffer::error&) {
+            std::cerr << "DEBUG: query.cc: worker: failed to decode cls_info" << std::endl;
+            assert(Tables::TablesErrCodes::EDECODE_BUFFERLIST_FAILURE==0);
+        }
+    }
 
-    // process result without lock. we own it now.
-    lock.unlock();
-    dispatch_lock.lock();
-    outstanding_ios--;
-    dispatch_lock.unlock();
-    dispatch_cond.notify_one();
+    // we own the result now, so the dispatcher can issue another io.
+    record_io_timing(s, has_info ? &info : NULL);
+    osd_dispatch.io_done(s->osd_slot);
+    release_io_slot();
 
     if (query == "flatbuf") {
 
         using namespace Tables;
 
+        // a hedged plain read is processed here like a non-cls read
+        const bool cls_result = use_cls && !s->raw_read;
+
         if (debug) {
-            cout << "DEBUG: query.cc: worker: query==flatbuf" << endl;
-            cout << "DEBUG: query.cc: worker: decoding result data start.\n";
-            cout << "DEBUG: query.cc: worker: raw_result.length()=" << raw_result.length() << endl;
-            cout << "DEBUG: query.cc: worker: use_cls=" << use_cls << endl;
+            cerr << "DEBUG: query.cc: worker: query==flatbuf" << endl;
+            cerr << "DEBUG: query.cc: worker: decoding result data start.\n";
+            cerr << "DEBUG: query.cc: worker: raw_result.length()=" << raw_result.length() << endl;
+            cerr << "DEBUG: query.cc: worker: use_cls=" << use_cls << endl;
         }
 
         delete s;  // release aio struct.
@@ -644,12 +1635,20 @@ void worker_exec_query_op()
         // (2) result was from a non-existing object/oid
         // (3) result was from an existing object/oid that contained zero data
         if (raw_result.length() >0) {
-            ceph::bufferlist::const_iterator it = raw_result.begin();
+            ceph::bufferlist::const_iterator it = data_it;
             try {
                 using ceph::decode;
-                if (use_cls) {
-                    decode(info, it);     // unpack the cls_info struct
+                if (cls_result) {
                     decode(result, it);  // unpack the result data bufferlist
+
+                    // the results of any batched queries follow, in order
+                    for (auto& q : batch_queries) {
+                        cls_info qinfo;
+                        ceph::bufferlist qresult;
+                        decode(qinfo, it);
+                        decode(qresult, it);
+                        print_batch_result(*q, qresult);
+                    }
                 }
                 else {                          // standard ceph read, no cls info was added.
                     decode(result, it); // unpack the result data bufferlist
@@ -661,51 +1660,73 @@ void worker_exec_query_op()
                 assert(Tables::TablesErrCodes::EDECODE_BUFFERLIST_FAILURE==0);
             }
             if (debug) {
-                cout << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
+                cerr << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
             }
         }
         else {
 
             // raw result was empty, so we can ignore this result
             if (debug) {
-                cout << "DEBUG: query.cc: worker: raw_result is empty." << endl;
+                cerr << "DEBUG: query.cc: worker: raw_result is empty." << endl;
             }
-            lock.lock();
-            break;
+            continue;
         }
 
         if (debug) {
-            cout << "DEBUG: query.cc: worker: decoding result data finish." << endl;
-            cout << "DEBUG: query.cc: worker: calling getSkyMeta(&result)." << endl;
+            cerr << "DEBUG: query.cc: worker: decoding result data finish." << endl;
+            cerr << "DEBUG: query.cc: worker: calling getSkyMeta(&result)." << endl;
         }
 
         // the result data should be a single bl with an fbmeta within.
         sky_meta fbmeta = getSkyMeta(&result);
+        if (fbmeta.blob_errcode) {
+            std::cerr << "ERROR: query.cc: worker: decompressing blob" << std::endl;
+            assert(Tables::TablesErrCodes::EBLOB_COMPRESSION_FAILURE==0);
+        }
 
         if (debug)
-            cout << "DEBUG: query.cc: worker: done with getSkyMeta(&result)." << endl;
+            cerr << "DEBUG: query.cc: worker: done with getSkyMeta(&result)." << endl;
+
+        // a busy osd may have declined to process the object, returning
+        // the rows of all columns as stored or filtered by its cheap preds,
+        // then the rest of the query is applied here.
+        const bool pushed_back = cls_result && !info.push_back_reason.empty();
+        if (pushed_back) {
+            pushed_back_objs++;
+            if (debug)
+                cerr << "DEBUG: query.cc: worker: pushed back: "
+                     << info.push_back_reason << endl;
+        }
+        const bool raw_rows = !cls_result || pushed_back;
 
         // TODO: add any global aggs here.
-        // TODO: check if any predicates or projects remain to be applied.
         bool more_processing = false;
 
-        if (!use_cls) {
+        if (raw_rows) {
             // TODO: remove pushed-down preds from sky_qry_preds then we
             // can remove project flag and just check size of preds here.
-            if ((project_cols != PROJECT_DEFAULT) || (sky_qry_preds.size() > 0)) {
+            if (pushed_back || (project_cols != PROJECT_DEFAULT) ||
+                (sky_qry_preds.size() > 0)) {
                 more_processing = true;
             }
         }
-	// if pushdown cols only, and there are preds left to process here
-        if (use_cls && pushdown_cols_only && sky_qry_preds.size() > 0) {
+        // if pushdown cols only, and there are preds left to process here
+        else if (pushdown_cols_only && sky_qry_preds.size() > 0) {
             more_processing = true;
         }
 
+        // the preds still to apply here. those the osd declined are over
+        // the data schema, with pushdown_cols_only the osd had none to
+        // decline and the query preds remain ours.
+        const std::string& client_preds =
+            pushed_back && !pushdown_cols_only ? info.push_back_predicates
+                                               : client_query_preds();
+
         // nothing left to do here, so we just print results
         if (!more_processing) {
 
             if (debug)
-                cout << "DEBUG: query.cc: worker:  !more_processing." << endl;
+                cerr << "DEBUG: query.cc: worker:  !more_processing." << endl;
 
             switch (fbmeta.blob_format) {
                 case SFT_JSON:
@@ -724,9 +1745,78 @@ void worker_exec_query_op()
                                fbmeta.blob_format);
                     break;
                 }
+                case SFT_PARQUET: {
+
+                    // fastpath results are the stored parquet blob, print
+                    // them as arrow.
+                    std::shared_ptr<arrow::Table> table;
+                    std::shared_ptr<arrow::Buffer> pq_buffer =  \
+                        arrow::MutableBuffer::Wrap(reinterpret_cast<uint8_t*>(const_cast<char*>(fbmeta.blob_data)), fbmeta.blob_size);
+                    int ret = extract_arrow_from_parquet_buffer(&table, pq_buffer);
+                    if (ret != 0) {
+                        std::cerr << "ERROR: query.cc: extract_arrow_from_parquet_buffer: "
+                                  << "ERR=" << ret << endl;
+                        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                    }
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                    break;
+                }
+                case SFT_FLATBUF_UNION_COL: {
+
+                    // fastpath results are the stored encoded columns,
+                    // decode them all and print them as arrow.
+                    sky_root root = \
+                        Tables::getSkyRoot(fbmeta.blob_data,
+                                           fbmeta.blob_size,
+                                           fbmeta.blob_format);
+                    schema_vec sc = schemaFromString(root.data_schema);
+                    predicate_vec no_preds;
+                    std::string no_cols;
+                    std::string errmsg;
+                    std::shared_ptr<arrow::Table> table;
+                    int ret = processSkyColFb(&table, sc, sc, no_preds,
+                                              no_cols, no_cols,
+                                              fbmeta.blob_data,
+                                              fbmeta.blob_size,
+                                              errmsg);
+                    if (ret != 0) {
+                        std::cerr << "ERROR: query.cc: processSkyColFb: "
+                                  << errmsg << "\n ERR=" << ret << endl;
+                        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                    }
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                    break;
+                }
                 case SFT_FLATBUF_CSV_ROW:
+                case SFT_CSV: {
+
+                    // csv blobs read as stored, print them as arrow.
+                    std::string errmsg;
+                    std::shared_ptr<arrow::Table> table;
+                    int ret = transform_csv_to_arrow(fbmeta.blob_data,
+                                                     fbmeta.blob_size,
+                                                     fbmeta.blob_format,
+                                                     sky_tbl_schema,
+                                                     errmsg,
+                                                     &table);
+                    if (ret != 0) {
+                        std::cerr << "ERROR: query.cc: transform_csv_to_arrow: "
+                                  << errmsg << "\n ERR=" << ret << endl;
+                        assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                    }
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                    break;
+                }
                 case SFT_PG_TUPLE:
-                case SFT_CSV:
                 default:
                     assert (Tables::TablesErrCodes::SkyFormatTypeNotRecognized==0);
             }
@@ -734,7 +1824,7 @@ void worker_exec_query_op()
         else {
 
             if (debug)
-                cout << "DEBUG: query.cc: worker:  more_processing." << endl;
+                cerr << "DEBUG: query.cc: worker:  more_processing." << endl;
 
             // more processing to do such as min, sort, any other remaining preds.
             std::string errmsg;
@@ -744,53 +1834,19 @@ void worker_exec_query_op()
             case SFT_FLATBUF_FLEX_ROW: {
 
                 if (debug)
-                    cout << "DEBUG: query.cc: worker:  case SFT_FLATBUF_FLEX_ROW." << endl;
+                    cerr << "DEBUG: query.cc: worker:  case SFT_FLATBUF_FLEX_ROW." << endl;
 
                 flatbuffers::FlatBufferBuilder flatbldr(1024); // pre-alloc
-                
-		// new qry_schema and tbl_schema for processing
-		// the col_idx in the schema should reindex starting from 0
-		Tables::schema_vec sky_process_qry_schema;
-		Tables::schema_vec sky_process_tbl_schema;
-		
-                int col_idx = 0;
-		// process_qry_schema is just the same as the required qry columns,
-		// we only need to reset col_idx
-                for (auto it_scm = sky_qry_schema.begin(); it_scm != sky_qry_schema.end(); ++it_scm) {
-                    const struct col_info ci(col_idx, (*it_scm).type,
-                                             (*it_scm).is_key, (*it_scm).nullable, (*it_scm).name);
-                    sky_process_qry_schema.push_back(ci);
-                    col_idx++;
-                }
-                col_idx = 0;
-		// the tbl_schema is only those columns in qry-schema and preds vec
-		// we can just use the pushdown_cols_qry_schema in run-query.cc
-		// also, reset the col_idx
-                for (auto it_scm = sky_pushdown_cols_qry_schema.begin(); it_scm != sky_pushdown_cols_qry_schema.end(); ++it_scm) {
-                    const struct col_info ci(col_idx, (*it_scm).type,
-                                             (*it_scm).is_key, (*it_scm).nullable, (*it_scm).name);
-                    sky_process_tbl_schema.push_back(ci);
-                    col_idx++;
-                }
-		
-		if (debug) {
-			cout << "DEBUG: query.cc: worker: sky_process_tbl_schema= " << endl
-			     << schemaToString(sky_process_tbl_schema) << endl;
-			cout << "DEBUG: query.cc: worker: sky_process_qry_schema= " << endl
-			     << schemaToString(sky_process_qry_schema) << endl;
-		}
-		// reconstruct the preds vector using the new tbl_schema
-		Tables::predicate_vec sky_process_qry_preds;
-		sky_process_qry_preds = predsFromString(sky_process_tbl_schema, predsToString(sky_qry_preds, sky_tbl_schema));
-		
-		if (debug) {
-			cout << "DEBUG: query.cc: worker: sky_process_qry_preds: "
-			     << predsToString(sky_process_qry_preds, sky_process_tbl_schema) << endl;
-		}
-		int ret = processSkyFb(flatbldr,
-                                       sky_process_tbl_schema,
-                                       sky_process_qry_schema,
-                                       sky_process_qry_preds,
+
+                // results of pushdown_cols_only hold just the query and
+                // pred cols, raw rows hold all the table cols.
+                std::shared_ptr<ClientPlan> plan = \
+                    get_client_plan(!raw_rows, client_preds);
+
+                int ret = processSkyFb(flatbldr,
+                                       plan->tbl_schema,
+                                       plan->qry_schema,
+                                       plan->preds,
                                        qop_groupby_cols,
                                        qop_orderby_cols,
                                        fbmeta.blob_data,
@@ -808,10 +1864,10 @@ void worker_exec_query_op()
                     reinterpret_cast<const char*>(flatbldr.GetBufferPointer());
                 sky_root root = getSkyRoot(processed_data, 0);
                 result_count += root.nrows;
-		if (debug) {
-			cout << "DEBUG: query.cc: worker: result count: " << result_count << endl;
-			cout << "DEBUG: query.cc: worker: flatbldr size: " << flatbldr.GetSize() << endl;
-		}    
+                if (debug) {
+                    cerr << "DEBUG: query.cc: worker: result count: " << result_count << endl;
+                    cerr << "DEBUG: query.cc: worker: flatbldr size: " << flatbldr.GetSize() << endl;
+                }
                 print_data(processed_data, 0, SFT_FLATBUF_FLEX_ROW);
                 break;
             }
@@ -819,14 +1875,16 @@ void worker_exec_query_op()
             case SFT_ARROW: {
 
                 if (debug)
-                    cout << "DEBUG: query.cc: worker:  case SFT_ARROW." << endl;
+                    cerr << "DEBUG: query.cc: worker:  case SFT_ARROW." << endl;
 
+                std::shared_ptr<ClientPlan> plan = \
+                    get_client_plan(false, client_preds);
                 std::shared_ptr<arrow::Table> table;
                 int ret = processArrowCol(
                               &table,
-                              sky_tbl_schema,
-                              sky_qry_schema,
-                              sky_qry_preds,
+                              plan->tbl_schema,
+                              plan->qry_schema,
+                              plan->preds,
                               qop_groupby_cols,
                               qop_orderby_cols,
                               fbmeta.blob_data,
@@ -844,17 +1902,116 @@ void worker_exec_query_op()
                     auto metadata = schema->metadata();
                     result_count += std::stoi(metadata->value(METADATA_NUM_ROWS));
                     convert_arrow_to_buffer(table, &buffer);
-                    print_data(buffer->ToString().c_str(), buffer->size(), SFT_ARROW);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
                 }
                 break;
             }
 
-            case SFT_JSON:  // TODO: call processJSON() here.
+            case SFT_PARQUET: {
+
+                if (debug)
+                    cerr << "DEBUG: query.cc: worker:  case SFT_PARQUET." << endl;
+
+                std::shared_ptr<ClientPlan> plan = \
+                    get_client_plan(false, client_preds);
+                std::shared_ptr<arrow::Table> table;
+                int ret = processParquet(
+                              &table,
+                              plan->tbl_schema,
+                              plan->qry_schema,
+                              plan->preds,
+                              qop_groupby_cols,
+                              qop_orderby_cols,
+                              fbmeta.blob_data,
+                              fbmeta.blob_size,
+                              errmsg);
+                if (ret != 0) {
+                    std::cerr << "ERROR: query.cc: processParquet: "
+                              << errmsg << "\n ERR=" << ret
+                              << endl;
+                    assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                }
+                else {
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                }
                 break;
+            }
+
+            case SFT_FLATBUF_UNION_COL: {
+
+                if (debug)
+                    cerr << "DEBUG: query.cc: worker:  case SFT_FLATBUF_UNION_COL." << endl;
+
+                std::shared_ptr<ClientPlan> plan = \
+                    get_client_plan(false, client_preds);
+                std::shared_ptr<arrow::Table> table;
+                int ret = processSkyColFb(
+                              &table,
+                              plan->tbl_schema,
+                              plan->qry_schema,
+                              plan->preds,
+                              qop_groupby_cols,
+                              qop_orderby_cols,
+                              fbmeta.blob_data,
+                              fbmeta.blob_size,
+                              errmsg);
+                if (ret != 0) {
+                    std::cerr << "ERROR: query.cc: processSkyColFb: "
+                              << errmsg << "\n ERR=" << ret
+                              << endl;
+                    assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                }
+                else {
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                }
+                break;
+            }
 
             case SFT_FLATBUF_CSV_ROW:
+            case SFT_CSV: {
+
+                if (debug)
+                    cerr << "DEBUG: query.cc: worker:  case SFT_CSV/SFT_FLATBUF_CSV_ROW." << endl;
+
+                std::shared_ptr<ClientPlan> plan = \
+                    get_client_plan(false, client_preds);
+                std::shared_ptr<arrow::Table> table;
+                int ret = processCsv(
+                              &table,
+                              plan->tbl_schema,
+                              plan->qry_schema,
+                              plan->preds,
+                              qop_groupby_cols,
+                              qop_orderby_cols,
+                              fbmeta.blob_data,
+                              fbmeta.blob_size,
+                              fbmeta.blob_format,
+                              errmsg);
+                if (ret != 0) {
+                    std::cerr << "ERROR: query.cc: processCsv: "
+                              << errmsg << "\n ERR=" << ret
+                              << endl;
+                    assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+                }
+                else {
+                    std::shared_ptr<arrow::Buffer> buffer;
+                    result_count += table->num_rows();
+                    convert_arrow_to_buffer(table, &buffer);
+                    print_data(reinterpret_cast<const char*>(buffer->data()), buffer->size(), SFT_ARROW);
+                }
+                break;
+            }
+
+            case SFT_JSON:  // TODO: call processJSON() here.
+                break;
+
             case SFT_PG_TUPLE:
-            case SFT_CSV:
             default:
                 assert (Tables::TablesErrCodes::SkyFormatTypeNotRecognized==0);
             }
@@ -869,33 +2026,26 @@ void worker_exec_query_op()
         // (2) result was from a non-existing object/oid
         // (3) result was from an existing object/oid that contained zero data
         if (raw_result.length() >0) {
-            ceph::bufferlist::const_iterator it = raw_result.begin();
+            ceph::bufferlist::const_iterator it = data_it;
             try {
                 using ceph::decode;
-                if (use_cls) {
-                    decode(info, it);     // unpack the cls_info struct
-                    decode(result, it);  // unpack the result data bufferlist
-                }
-                else {                          // standard ceph read, no cls info was added.
-                    decode(result, it); // unpack the result data bufferlist
-                }
+                decode(result, it);  // unpack the result data bufferlist
             }
             catch (ceph::buffer::error&) {
                 std::cerr << "DEBUG: query.cc: worker: failed to decode result data into a bufferlist" << std::endl;
                 assert(Tables::TablesErrCodes::EDECODE_BUFFERLIST_FAILURE==0);
             }
             if (debug) {
-                cout << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
+                cerr << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
             }
         }
         else {
 
             // raw result was empty, so we can ignore this result
             if (debug) {
-                cout << "DEBUG: query.cc: worker: raw_result is empty." << endl;
+                cerr << "DEBUG: query.cc: worker: raw_result is empty." << endl;
             }
-            lock.lock();
-            break;
+            continue;
         }
 
         print_data(result.c_str(), result.length(), SFT_EXAMPLE_FORMAT);
@@ -909,33 +2059,26 @@ void worker_exec_query_op()
         // (2) result was from a non-existing object/oid
         // (3) result was from an existing object/oid that contained zero data
         if (raw_result.length() >0) {
-            ceph::bufferlist::const_iterator it = raw_result.begin();
+            ceph::bufferlist::const_iterator it = data_it;
             try {
                 using ceph::decode;
-                if (use_cls) {
-                    decode(info, it);     // unpack the cls_info struct
-                    decode(result, it);  // unpack the result data bufferlist
-                }
-                else {                          // standard ceph read, no cls info was added.
-                    decode(result, it); // unpack the result data bufferlist
-                }
+                decode(result, it);  // unpack the result data bufferlist
             }
             catch (ceph::buffer::error&) {
                 std::cerr << "DEBUG: query.cc: worker: failed to decode result data into a bufferlist" << std::endl;
                 assert(Tables::TablesErrCodes::EDECODE_BUFFERLIST_FAILURE==0);
             }
             if (debug) {
-                cout << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
+                cerr << "DEBUG: query.cc: worker: decoded result.length()=" << result.length() << endl;
             }
         }
         else {
 
             // raw result was empty, so we can ignore this result
             if (debug) {
-                cout << "DEBUG: query.cc: worker: raw_result is empty." << endl;
+                cerr << "DEBUG: query.cc: worker: raw_result is empty." << endl;
             }
-            lock.lock();
-            break;
+            continue;
         }
 
         print_data(result.c_str(), result.length(), SFT_EXAMPLE_FORMAT);
@@ -953,15 +2096,11 @@ void worker_exec_query_op()
         static const size_t comment_field_offset = 97;
         static const size_t comment_field_length = 44;
 
-        cls_info info;
-        ceph::bufferlist result;
-
-        // if it was a cls read, first unpack some of the cls processing info
+        // if it was a cls read, the cls processing info was unpacked above
         if (use_cls) {
             try {
                 using ceph::decode;
-                ceph::bufferlist::const_iterator it = s->bl.begin();
-                decode(info, it);
+                ceph::bufferlist::const_iterator it = data_it;
                 decode(result, it);
             } catch (ceph::buffer::error&) {
                 int decode_runquery_cls = 0;
@@ -1136,8 +2275,6 @@ void worker_exec_query_op()
           assert(0);
         }
     }
-
-    lock.lock();
   }
 }
 
@@ -1151,6 +2288,10 @@ void handle_cb(librados::completion_t cb, void *arg)
   AioState *s = (AioState*)arg;
   s->times.response = getns();
 
+  // of an object and its hedge only the first response is used
+  if (s->req != NULL && !hedge_ctl.take_response(s))
+    return;
+
   // there might have been an error, although we can ignore obj not exists err.
   if (s->c->get_return_value()  < 0) {
     if (s->c->get_return_value() != -ENOENT) {
@@ -1164,9 +2305,22 @@ void handle_cb(librados::completion_t cb, void *arg)
   s->c->release();
   s->c = NULL;
 
-  work_lock.lock();
-  ready_ios.push_back(s);
-  work_lock.unlock();
+  enqueue_ready_io(s);
+}
 
-  work_cond.notify_one();
+/*
+ * Push a completed io to the workers, waking one only if some are asleep.
+ */
+void enqueue_ready_io(AioState *s)
+{
+  // the queue holds at least qdepth entries, so it is only full if more
+  // ios than that are in flight; wait for the workers to catch up.
+  while (!ready_ios.push(s))
+    std::this_thread::yield();
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_workers > 0) {
+    std::lock_guard<std::mutex> l(work_lock);
+    work_cond.notify_one();
+  }
 }
@@ -13,11 +13,19 @@
 #include <atomic>
 #include <thread>
 #include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 #include "include/rados/librados.hpp"
 #include "cls/cls_tabular.h"
 #include "cls/cls_tabular_utils.h"
 #include "cls/cls_tabular_processing.h"
 #include "re2/re2.h"
+#include "aio_queue.h"
+#include "query_spool.h"
 
 extern inline uint64_t __getns(clockid_t clock)
 {
@@ -48,10 +56,34 @@ struct timing {
   uint64_t eval2_ns;
 };
 
+struct ObjRequest;
+
 struct AioState {
   ceph::bufferlist bl;
   librados::AioCompletion *c;
   timing times;
+  uint64_t seq = 0;  // dispatch order, used for --ordered-output
+  int osd_slot = -1;  // OsdDispatch queue of the object, if used
+  std::string oid;
+  uint64_t obj_dispatch = 0;  // first dispatch of the object
+  ObjRequest *req = NULL;     // set when the object may be hedged
+  bool hedge = false;         // this is the hedged re-issue
+  bool hedged = false;        // a hedge was issued for the object
+  bool raw_read = false;      // plain read, no cls_info in bl
+};
+
+/*
+ * One object request and its hedged re-issue, if any. The first of the two
+ * to complete is handed to the workers, the other is cancelled and its
+ * result dropped. Freed by whichever completes last.
+ */
+struct ObjRequest {
+  std::mutex lock;
+  std::string oid;
+  ceph::bufferlist inbl;          // encoded query_op, empty for plain reads
+  AioState *ios[2] = {NULL, NULL};  // in flight: original, hedge
+  bool done = false;
+  bool hedged = false;
 };
 
 extern bool quiet;
@@ -64,6 +96,113 @@ extern uint64_t extra_row_cost;
 
 extern std::vector<timing> timings;
 
+/*
+ * AIMD control of the number of in-flight aio requests.
+ * Each completion reports its latency, minus the cls eval time since that
+ * depends on the object contents rather than on load. Once per window of
+ * completions, the window's mean latency is compared with the best window
+ * mean seen so far (the unloaded latency):
+ * - close to it: the OSDs are not queueing, so add one to the depth;
+ * - well above it: requests are queueing, so cut the depth by a quarter.
+ */
+struct QdepthController {
+  std::atomic<int> depth;
+  int min_depth;
+  int max_depth;
+
+  // current window, accumulated lock-free by the workers
+  std::atomic<uint64_t> win_ios;
+  std::atomic<uint64_t> win_lat_ns;
+
+  // best window mean, only touched under adjust_lock
+  uint64_t base_lat_ns;
+  std::mutex adjust_lock;
+
+  QdepthController() : depth(1), min_depth(1), max_depth(1),
+                       win_ios(0), win_lat_ns(0), base_lat_ns(0) {}
+
+  // depth is fixed if start == max
+  void init(int start, int max);
+  void on_complete(const timing& t);
+  int get() const { return depth; }
+};
+
+extern QdepthController qdepth_ctl;
+
+/*
+ * Locality aware dispatch order. Objects are queued per primary OSD, from
+ * the pg mapping of the pool, and taken round-robin across the OSDs so
+ * that all of them are kept busy rather than a few at a time. Within an
+ * OSD the --direction order is kept. With max_per_osd > 0 an OSD gets no
+ * new request while it has that many outstanding.
+ * Objects whose primary is not known share one extra queue.
+ */
+struct OsdDispatch {
+  std::vector<int> osds;  // osd id of each queue
+  std::vector<std::deque<std::string>> queues;
+  std::unique_ptr<std::atomic<int>[]> outstanding;
+  int max_per_osd = 0;
+  size_t next = 0;
+  size_t remaining = 0;
+
+  // takes the objects from oids. returns 0, or an error if the pg mapping
+  // could not be read, in which case all objects go in one queue.
+  int init(librados::Rados& cluster, librados::IoCtx& ioctx,
+           const std::string& pool, std::vector<std::string>& oids,
+           int max_per_osd);
+  bool empty() const { return remaining == 0; }
+
+  // next object on an OSD below the cap, false if there is none right now.
+  // only called by the dispatcher.
+  bool next_object(std::string& oid, int& slot);
+  void io_done(int slot) {
+    if (slot >= 0)
+      outstanding[slot]--;
+  }
+};
+
+extern OsdDispatch osd_dispatch;
+
+/*
+ * Straggler mitigation and per-object latency telemetry.
+ * With percentile > 0, a request still outstanding after the given
+ * percentile of the recent object latencies is issued a second time, either
+ * as the same exec_query_op (reads are idempotent) or as a plain read that
+ * is processed on the client. The first response is used.
+ * Every object latency (from its first dispatch) is kept for the summary,
+ * and optionally logged as csv: oid,seq,latency_ns,read_ns,eval_ns,hedged,
+ * hedge_won.
+ */
+struct HedgeController {
+  double percentile = 0;
+  bool use_read = false;
+  librados::IoCtx *ioctx = NULL;
+
+  std::mutex lock;
+  std::map<uint64_t, ObjRequest*> inflight;  // by seq
+  std::deque<uint64_t> recent_lat_ns;
+  std::vector<uint64_t> all_lat_ns;
+  FILE *log = NULL;
+
+  std::atomic<uint64_t> issued;
+  std::atomic<uint64_t> won;
+
+  HedgeController() : issued(0), won(0) {}
+
+  int init(librados::IoCtx *ioctx, double percentile, bool use_read,
+           const std::string& log_path);
+  bool enabled() const { return percentile > 0; }
+  void track(ObjRequest *req, uint64_t seq);
+  uint64_t threshold_ns();  // 0 until there are enough samples
+  void issue_hedges();      // called by the dispatcher
+  bool take_response(AioState *s);  // false if s lost, s is freed then
+  void record(const AioState *s);   // a completed object
+  void print_summary();
+  void finish();
+};
+
+extern HedgeController hedge_ctl;
+
 // query parameters to be encoded into query_op struct
 
 // query params old
@@ -87,6 +226,7 @@ extern int qop_index2_type;
 extern int qop_index_plan_type;
 extern int qop_index_batch_size;
 extern int qop_result_format;  // SkyFormatType enum
+extern int qop_pushback_threshold;
 extern std::string qop_db_schema_name;
 extern std::string qop_table_name;
 extern std::string qop_data_schema;
@@ -111,6 +251,10 @@ extern std::string idx_op_text_delims;
 extern int trans_op_format_type;
 extern bool perform_compaction;
 
+// Repartition op params
+extern std::string repart_dst_oid_prefix;
+extern std::set<uint64_t> repart_dst_written;
+
 // Example op params
 extern int expl_func_counter;
 extern int expl_func_id;
@@ -150,18 +294,126 @@ extern std::atomic<bool> print_header;
 extern std::atomic<long long int> row_counter;
 extern long long int row_limit;
 
-// rename work_lock
-extern int outstanding_ios;
+// schema shared by the results written to the stdout arrow stream
+extern Tables::arrow_ipc_stream arrow_stream;
+
+/*
+ * Single writer of the query results. Workers format the rows of each
+ * object into their own buffer and hand the whole buffer over here, so
+ * formatting runs in parallel and stdout sees a few large writes instead of
+ * a lock and a stream insertion per field.
+ * With ordered set, object buffers are written in dispatch order (seq),
+ * otherwise in completion order. When a header is expected no rows are
+ * written before it arrives.
+ * Buffers held back waiting for an earlier object are bounded: the
+ * dispatcher calls wait_for_space() before issuing the next object, which
+ * blocks while they exceed OUTPUT_PENDING_MAX bytes. Workers never block,
+ * so the object being waited for can always complete.
+ */
+class OutputWriter {
+public:
+  void start(bool ordered, bool expect_header);
+  void submit(uint64_t seq, std::string& data);   // takes the contents
+  void submit_header(std::string& data);          // takes the contents
+  void write_direct(std::string& data);
+  // false if timeout_ns (0 waits without a timeout) expired while full
+  bool wait_for_space(uint64_t timeout_ns);
+  void finish();  // writes everything left, then stops the writer thread
+  bool running() const { return started; }
+
+private:
+  void run();
+
+  std::mutex lock;
+  std::mutex direct_lock;
+  std::condition_variable cond;
+  std::condition_variable space_cond;
+  std::thread writer;
+  bool started = false;
+  bool done = false;
+  bool ordered = false;
+  bool header_pending = false;
+  uint64_t next_seq = 0;
+  std::string header;
+  std::vector<std::string> ready;
+  std::map<uint64_t, std::string> pending;
+  size_t pending_bytes = 0;
+};
+
+extern OutputWriter output_writer;
+
+// cross-object ORDER BY / GROUP BY, active when either is given
+extern ResultSpool result_spool;
+
+/*
+ * Client side query plan: the schemas and parsed predicates the query
+ * engine is run with on results the OSD did not fully process, i.e. plain
+ * reads, the pushdown_cols_only projection and results the OSD pushed back.
+ * Plans are built once per kind and set of predicates and shared by the
+ * workers, except with global aggregates, whose predicates keep per object
+ * state, so those are built for each object.
+ */
+struct ClientPlan {
+  Tables::schema_vec tbl_schema;
+  Tables::schema_vec qry_schema;
+  Tables::predicate_vec preds;
+
+  ClientPlan() {}
+  ~ClientPlan() {
+    for (auto p : preds)
+      delete p;
+  }
+  ClientPlan(const ClientPlan&) = delete;
+  ClientPlan& operator=(const ClientPlan&) = delete;
+};
+
+// pushdown_projection selects a plan over the pushdown_cols_only result
+// columns rather than the rows as stored, preds are over sky_tbl_schema.
+std::shared_ptr<ClientPlan> get_client_plan(bool pushdown_projection,
+                                            const std::string& preds);
+
+// objects whose processing was pushed back to us by a busy OSD
+extern std::atomic<uint64_t> pushed_back_objs;
+
+/*
+ * A query sharing the object scans of the main query (--batch-queries).
+ * The OSD evaluates it on each object alongside the main query, and its
+ * results, always fully processed there, are written to a file of its own.
+ */
+struct BatchQuery {
+  std::string project;
+  std::string select;
+  std::string query_schema;  // encoded into its query_op
+  std::string query_preds;
+  std::string path;
+  FILE *out = NULL;          // not opened with quiet
+
+  std::mutex lock;
+  bool header_pending = false;
+  Tables::arrow_ipc_stream stream;
+  long long int rows = 0;
+  std::atomic<uint64_t> result_count{0};
+};
+
+extern std::vector<std::unique_ptr<BatchQuery>> batch_queries;
+
+// in-flight aio count, incremented by the dispatcher and decremented by the
+// workers once they take a completed io.
+extern std::atomic<int> outstanding_ios;
 extern std::vector<std::string> target_objects;
-extern std::list<AioState*> ready_ios;
+
+// completed ios, pushed by handle_cb and popped by worker_exec_query_op
+extern MPMCQueue<AioState*> ready_ios;
 
 extern std::mutex dispatch_lock;
 extern std::condition_variable dispatch_cond;
 
+// only used to park idle workers, and by the non-query workers to share
+// target_objects.
 extern std::mutex work_lock;
 extern std::condition_variable work_cond;
 
-extern bool stop;
+extern std::atomic<bool> stop;
 
 // worker tasks for threads, corresponding to our cls methods
 void worker_build_index(librados::IoCtx *ioctx);
@@ -169,8 +421,14 @@ void worker_exec_build_sky_index_op(librados::IoCtx *ioctx, idx_op op);
 void worker_exec_runstats_op(librados::IoCtx *ioctx, stats_op op);
 void worker_compact_arrow_tables_op(librados::IoCtx *ioctx);
 void worker_transform_db_op(librados::IoCtx *ioctx, transform_op op);
+void worker_repartition_arrow_table_op(librados::IoCtx *ioctx, repartition_op op);
+int repartition_dst_objects(librados::IoCtx *ioctx,
+                            std::vector<std::string>& dst_oids);
 void worker_exec_query_op();  // default worker task for exec_query_op
 void handle_cb(librados::completion_t cb, void *arg);
+void enqueue_ready_io(AioState *s);
+void wait_io_slot(int max_ios, uint64_t timeout_ns=0);
+void print_spooled_results();
 void worker_lock_obj_init_op(librados::IoCtx *ioctx, lockobj_info op);
 void worker_lock_obj_free_op(librados::IoCtx *ioctx, lockobj_info op);
 void worker_lock_obj_get_op(librados::IoCtx *ioctx, lockobj_info op);
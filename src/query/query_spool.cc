@@ -0,0 +1,666 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <queue>
+#include <unordered_set>
+#include <boost/algorithm/string.hpp>
+#include "query/query_spool.h"
+#include "cls/cls_tabular_utils.h"
+
+using namespace Tables;
+
+// appends are buffered up to this size before each write()
+static const size_t SPOOL_WRITE_BUF = 1 << 20;
+
+// rows per arrow table handed back by finish()
+static const int64_t SPOOL_EMIT_BATCH_ROWS = 64 * 1024;
+
+// estimated memory per group kept in the hash table, used to choose the
+// number of hash partitions
+static const uint64_t SPOOL_GROUP_ENTRY_BYTES = 64;
+static const uint64_t SPOOL_MAX_PARTITIONS = 1024;
+
+static const uint64_t SPOOL_MIN_MEM_BUDGET = 1 << 20;
+
+
+SpoolFile::~SpoolFile()
+{
+  if (base)
+    munmap(base, size);
+  if (fd >= 0)
+    close(fd);
+}
+
+int SpoolFile::create(const std::string& dir)
+{
+  std::string path = dir + "/skyhook-spool-XXXXXX";
+  std::vector<char> tmpl(path.begin(), path.end());
+  tmpl.push_back('\0');
+  fd = mkstemp(tmpl.data());
+  if (fd < 0)
+    return -errno;
+  unlink(tmpl.data());
+  return 0;
+}
+
+int SpoolFile::flush()
+{
+  const char *p = buf.data();
+  size_t left = buf.size();
+  while (left > 0) {
+    ssize_t n = ::write(fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    p += n;
+    left -= n;
+  }
+  size += buf.size();
+  buf.clear();
+  return 0;
+}
+
+int SpoolFile::append(const char *data, size_t len, uint64_t nrows)
+{
+  buf.append(data, len);
+  rows += nrows;
+  if (buf.size() >= SPOOL_WRITE_BUF)
+    return flush();
+  return 0;
+}
+
+int SpoolFile::map()
+{
+  int ret = flush();
+  if (ret < 0)
+    return ret;
+  std::string().swap(buf);
+  if (size == 0)
+    return 0;
+  void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return -errno;
+  madvise(p, size, MADV_SEQUENTIAL);
+  base = static_cast<char*>(p);
+  return 0;
+}
+
+
+static inline uint32_t spool_u32(const char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline const char *spool_next_row(const char *row)
+{
+  return row + sizeof(uint32_t) + spool_u32(row);
+}
+
+// p points at the null byte of a column, returns the next column
+static inline const char *spool_skip_col(arrow::Type::type t, const char *p)
+{
+  if (*p++)
+    return p;
+  switch (t) {
+    case arrow::Type::BOOL:
+    case arrow::Type::INT8:
+    case arrow::Type::UINT8:
+      return p + 1;
+    case arrow::Type::INT16:
+    case arrow::Type::UINT16:
+      return p + 2;
+    case arrow::Type::INT32:
+    case arrow::Type::UINT32:
+    case arrow::Type::FLOAT:
+      return p + 4;
+    case arrow::Type::INT64:
+    case arrow::Type::UINT64:
+    case arrow::Type::DOUBLE:
+      return p + 8;
+    case arrow::Type::STRING:
+      return p + sizeof(uint32_t) + spool_u32(p);
+    default:
+      return p;
+  }
+}
+
+static inline const char *spool_col(const char *row, int col,
+                                    const std::vector<arrow::Type::type>& types)
+{
+  const char *p = row + sizeof(uint32_t);
+  for (int c = 0; c < col; c++)
+    p = spool_skip_col(types[c], p);
+  return p;
+}
+
+template <typename ArrayT>
+static inline void spool_put(std::string& out, const arrow::Array& a, int64_t i)
+{
+  auto v = static_cast<const ArrayT&>(a).Value(i);
+  out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename BuilderT, typename CType>
+static inline arrow::Status spool_get(arrow::ArrayBuilder *b, const char *p)
+{
+  CType v;
+  memcpy(&v, p, sizeof(v));
+  return static_cast<BuilderT*>(b)->Append(v);
+}
+
+template <typename CType>
+static inline int spool_cmp(const char *p1, const char *p2)
+{
+  CType v1, v2;
+  memcpy(&v1, p1, sizeof(v1));
+  memcpy(&v2, p2, sizeof(v2));
+  return v1 < v2 ? -1 : (v2 < v1 ? 1 : 0);
+}
+
+static bool spool_type_supported(arrow::Type::type t)
+{
+  switch (t) {
+    case arrow::Type::BOOL:
+    case arrow::Type::INT8:
+    case arrow::Type::INT16:
+    case arrow::Type::INT32:
+    case arrow::Type::INT64:
+    case arrow::Type::UINT8:
+    case arrow::Type::UINT16:
+    case arrow::Type::UINT32:
+    case arrow::Type::UINT64:
+    case arrow::Type::FLOAT:
+    case arrow::Type::DOUBLE:
+    case arrow::Type::STRING:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+int ResultSpool::init(const std::string& _dir,
+                      uint64_t _mem_budget,
+                      const std::string& _groupby_cols,
+                      const std::string& _orderby_cols)
+{
+  dir = _dir;
+  mem_budget = std::max(_mem_budget, SPOOL_MIN_MEM_BUDGET);
+  groupby_cols = _groupby_cols;
+  orderby_cols = _orderby_cols;
+  boost::trim(groupby_cols);
+  boost::trim(orderby_cols);
+  enabled = !groupby_cols.empty() || !orderby_cols.empty();
+  if (!enabled)
+    return 0;
+  return input.create(dir);
+}
+
+int ResultSpool::resolve_cols(const std::shared_ptr<arrow::Schema>& sch,
+                              std::string& errmsg)
+{
+  // resolved into locals and kept only on success, so a result that fails
+  // leaves the spool as it was for the next one.
+  std::vector<arrow::Type::type> col_types;
+  std::vector<int> gcols;
+  std::vector<sort_key> skeys;
+
+  for (int i = 0; i < sch->num_fields(); i++) {
+    arrow::Type::type t = sch->field(i)->type()->id();
+    if (!spool_type_supported(t)) {
+      errmsg.append("ERROR: spool: column " + sch->field(i)->name() +
+                    " has an unsupported type.");
+      return TablesErrCodes::UnsupportedSkyDataType;
+    }
+    col_types.push_back(t);
+  }
+
+  auto find_col = [&sch](std::string name) -> int {
+    boost::trim(name);
+    for (int i = 0; i < sch->num_fields(); i++) {
+      if (boost::iequals(sch->field(i)->name(), name))
+        return i;
+    }
+    return -1;
+  };
+
+  // "COL1,COL2"
+  if (!groupby_cols.empty()) {
+    std::vector<std::string> cols;
+    boost::split(cols, groupby_cols, boost::is_any_of(","),
+                 boost::token_compress_on);
+    for (auto& name : cols) {
+      int idx = find_col(name);
+      if (idx < 0) {
+        errmsg.append("ERROR: spool: groupby col " + name + " not present.");
+        return TablesErrCodes::RequestedColNotPresent;
+      }
+      gcols.push_back(idx);
+    }
+  }
+
+  // ";COL1,ASC;COL2,DESC;"
+  if (!orderby_cols.empty()) {
+    std::string s = orderby_cols;
+    boost::trim_if(s, boost::is_any_of(PRED_DELIM_OUTER));
+    std::vector<std::string> items;
+    boost::split(items, s, boost::is_any_of(PRED_DELIM_OUTER),
+                 boost::token_compress_on);
+    for (auto& item : items) {
+      std::vector<std::string> descr;
+      boost::split(descr, item, boost::is_any_of(PRED_DELIM_INNER),
+                   boost::token_compress_on);
+      std::string sort_by = descr.size() > 1 ? descr[1] : "ASC";
+      boost::trim(sort_by);
+      boost::to_upper(sort_by);
+      if (sort_by != "ASC" && sort_by != "DESC") {
+        errmsg.append("ERROR: spool: sorting by " + sort_by +
+                      " not supported. Use ASC/DESC.");
+        return TablesErrCodes::OpNotRecognized;
+      }
+      int idx = find_col(descr[0]);
+      if (idx < 0) {
+        errmsg.append("ERROR: spool: orderby col " + descr[0] +
+                      " not present.");
+        return TablesErrCodes::RequestedColNotPresent;
+      }
+      skeys.push_back({idx, sort_by == "DESC"});
+    }
+  }
+
+  int dcol = sch->GetFieldIndex("DELETED_VECTOR");
+  if (dcol >= 0 && col_types[dcol] != arrow::Type::BOOL)
+    dcol = -1;
+
+  types = std::move(col_types);
+  group_cols = std::move(gcols);
+  sort_keys = std::move(skeys);
+  del_col = dcol;
+  return 0;
+}
+
+int ResultSpool::append(const std::shared_ptr<arrow::Table>& table,
+                        std::string& errmsg)
+{
+  {
+    std::lock_guard<std::mutex> l(lock);
+    if (schema == nullptr) {
+      int ret = resolve_cols(table->schema(), errmsg);
+      if (ret != 0)
+        return ret;
+      schema = table->schema();
+    }
+  }
+
+  const int ncols = types.size();
+  if (table->num_columns() != ncols) {
+    errmsg.append("ERROR: spool: results have different schemas.");
+    return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+  }
+  for (int c = 0; c < ncols; c++) {
+    if (table->schema()->field(c)->type()->id() != types[c]) {
+      errmsg.append("ERROR: spool: results have different schemas.");
+      return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+    }
+  }
+
+  // encode the rows outside of the lock
+  std::string out;
+  uint64_t nrows = 0;
+  arrow::TableBatchReader reader(*table);
+  std::shared_ptr<arrow::RecordBatch> batch;
+  while (true) {
+    arrow::Status st = reader.ReadNext(&batch);
+    if (!st.ok()) {
+      errmsg.append("ERROR: spool: " + st.ToString());
+      return TablesErrCodes::ArrowStatusErr;
+    }
+    if (batch == nullptr)
+      break;
+
+    std::shared_ptr<arrow::BooleanArray> del_vec;
+    if (del_col >= 0)
+      del_vec = std::static_pointer_cast<arrow::BooleanArray>(
+          batch->column(del_col));
+
+    for (int64_t i = 0; i < batch->num_rows(); i++) {
+      if (del_vec && del_vec->IsValid(i) && del_vec->Value(i))
+        continue;
+
+      size_t start = out.size();
+      out.append(sizeof(uint32_t), '\0');
+      for (int c = 0; c < ncols; c++) {
+        const arrow::Array& a = *batch->column(c);
+        if (a.IsNull(i)) {
+          out.push_back(1);
+          continue;
+        }
+        out.push_back(0);
+        switch (types[c]) {
+          case arrow::Type::BOOL:   spool_put<arrow::BooleanArray>(out, a, i); break;
+          case arrow::Type::INT8:   spool_put<arrow::Int8Array>(out, a, i); break;
+          case arrow::Type::INT16:  spool_put<arrow::Int16Array>(out, a, i); break;
+          case arrow::Type::INT32:  spool_put<arrow::Int32Array>(out, a, i); break;
+          case arrow::Type::INT64:  spool_put<arrow::Int64Array>(out, a, i); break;
+          case arrow::Type::UINT8:  spool_put<arrow::UInt8Array>(out, a, i); break;
+          case arrow::Type::UINT16: spool_put<arrow::UInt16Array>(out, a, i); break;
+          case arrow::Type::UINT32: spool_put<arrow::UInt32Array>(out, a, i); break;
+          case arrow::Type::UINT64: spool_put<arrow::UInt64Array>(out, a, i); break;
+          case arrow::Type::FLOAT:  spool_put<arrow::FloatArray>(out, a, i); break;
+          case arrow::Type::DOUBLE: spool_put<arrow::DoubleArray>(out, a, i); break;
+          case arrow::Type::STRING: {
+            auto str = static_cast<const arrow::StringArray&>(a).GetView(i);
+            uint32_t len = str.size();
+            out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.append(str.data(), str.size());
+            break;
+          }
+          default:
+            break;
+        }
+      }
+      uint32_t len = out.size() - start - sizeof(uint32_t);
+      memcpy(&out[start], &len, sizeof(len));
+      nrows++;
+    }
+  }
+
+  std::lock_guard<std::mutex> l(lock);
+  int ret = input.append(out.data(), out.size(), nrows);
+  if (ret < 0) {
+    errmsg.append("ERROR: spool: write failed: " + std::string(strerror(-ret)));
+    return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+  }
+  return 0;
+}
+
+int ResultSpool::compare_rows(const char *r1, const char *r2) const
+{
+  for (const auto& key : sort_keys) {
+    const char *p1 = spool_col(r1, key.col, types);
+    const char *p2 = spool_col(r2, key.col, types);
+    int c;
+    if (*p1 || *p2) {
+      // nulls sort first
+      c = (*p1 && *p2) ? 0 : (*p1 ? -1 : 1);
+    } else {
+      p1++;
+      p2++;
+      switch (types[key.col]) {
+        case arrow::Type::BOOL:   c = spool_cmp<bool>(p1, p2); break;
+        case arrow::Type::INT8:   c = spool_cmp<int8_t>(p1, p2); break;
+        case arrow::Type::INT16:  c = spool_cmp<int16_t>(p1, p2); break;
+        case arrow::Type::INT32:  c = spool_cmp<int32_t>(p1, p2); break;
+        case arrow::Type::INT64:  c = spool_cmp<int64_t>(p1, p2); break;
+        case arrow::Type::UINT8:  c = spool_cmp<uint8_t>(p1, p2); break;
+        case arrow::Type::UINT16: c = spool_cmp<uint16_t>(p1, p2); break;
+        case arrow::Type::UINT32: c = spool_cmp<uint32_t>(p1, p2); break;
+        case arrow::Type::UINT64: c = spool_cmp<uint64_t>(p1, p2); break;
+        case arrow::Type::FLOAT:  c = spool_cmp<float>(p1, p2); break;
+        case arrow::Type::DOUBLE: c = spool_cmp<double>(p1, p2); break;
+        case arrow::Type::STRING: {
+          uint32_t l1 = spool_u32(p1);
+          uint32_t l2 = spool_u32(p2);
+          c = memcmp(p1 + sizeof(uint32_t), p2 + sizeof(uint32_t),
+                     std::min(l1, l2));
+          if (c == 0)
+            c = l1 < l2 ? -1 : (l2 < l1 ? 1 : 0);
+          break;
+        }
+        default:
+          c = 0;
+      }
+    }
+    if (c != 0)
+      return key.desc ? -c : c;
+  }
+  return 0;
+}
+
+/*
+ * Keep the first row of each group. When the groups may not fit in the
+ * memory budget the rows are hash partitioned, and each pass over the input
+ * only keeps the groups of one partition, so the hash table holds at most
+ * about mem_budget / SPOOL_GROUP_ENTRY_BYTES groups at a time.
+ */
+int ResultSpool::group(SpoolFile& in, SpoolFile& out)
+{
+  auto hash = [this](const char *row) -> size_t {
+    uint64_t h = 14695981039346656037ULL;  // FNV-1a
+    for (int col : group_cols) {
+      const char *p = spool_col(row, col, types);
+      const char *e = spool_skip_col(types[col], p);
+      for (; p < e; p++)
+        h = (h ^ static_cast<uint8_t>(*p)) * 1099511628211ULL;
+    }
+    return h;
+  };
+  auto eq = [this](const char *r1, const char *r2) -> bool {
+    for (int col : group_cols) {
+      const char *p1 = spool_col(r1, col, types);
+      const char *p2 = spool_col(r2, col, types);
+      size_t l1 = spool_skip_col(types[col], p1) - p1;
+      size_t l2 = spool_skip_col(types[col], p2) - p2;
+      if (l1 != l2 || memcmp(p1, p2, l1) != 0)
+        return false;
+    }
+    return true;
+  };
+
+  uint64_t nparts = in.num_rows() * SPOOL_GROUP_ENTRY_BYTES / mem_budget + 1;
+  nparts = std::min(nparts, SPOOL_MAX_PARTITIONS);
+
+  for (uint64_t part = 0; part < nparts; part++) {
+    std::unordered_set<const char*, decltype(hash), decltype(eq)>
+        groups(1024, hash, eq);
+    for (const char *row = in.begin(); row < in.end();
+         row = spool_next_row(row)) {
+      // high bits pick the partition, low bits the hash bucket
+      if (nparts > 1 && (hash(row) >> 40) % nparts != part)
+        continue;
+      if (groups.insert(row).second) {
+        int ret = out.append(row, spool_next_row(row) - row, 1);
+        if (ret < 0)
+          return ret;
+      }
+    }
+  }
+  return out.map();
+}
+
+/*
+ * External merge sort. Runs of rows up to mem_budget bytes are sorted and
+ * written to their own spool files, then merged with a heap. When all rows
+ * fit in one run they are returned without writing a run.
+ */
+int ResultSpool::sort_and_emit(SpoolFile& in,
+                               std::function<bool(const char *)> row_fn)
+{
+  if (sort_keys.empty()) {
+    for (const char *row = in.begin(); row < in.end();
+         row = spool_next_row(row)) {
+      if (!row_fn(row))
+        break;
+    }
+    return 0;
+  }
+
+  auto less = [this](const char *r1, const char *r2) {
+    return compare_rows(r1, r2) < 0;
+  };
+
+  std::vector<std::unique_ptr<SpoolFile>> runs;
+  std::vector<const char*> rows;
+  const char *row = in.begin();
+  while (row < in.end()) {
+    uint64_t run_bytes = 0;
+    rows.clear();
+    while (row < in.end() && (rows.empty() || run_bytes < mem_budget)) {
+      const char *next = spool_next_row(row);
+      rows.push_back(row);
+      run_bytes += (next - row) + sizeof(const char*);
+      row = next;
+    }
+    std::stable_sort(rows.begin(), rows.end(), less);
+
+    if (runs.empty() && row >= in.end()) {
+      for (const char *r : rows) {
+        if (!row_fn(r))
+          break;
+      }
+      return 0;
+    }
+
+    runs.emplace_back(new SpoolFile);
+    int ret = runs.back()->create(dir);
+    for (size_t i = 0; ret == 0 && i < rows.size(); i++)
+      ret = runs.back()->append(rows[i], spool_next_row(rows[i]) - rows[i], 1);
+    if (ret == 0)
+      ret = runs.back()->map();
+    if (ret < 0)
+      return ret;
+  }
+  std::vector<const char*>().swap(rows);
+
+  // min heap on the current row of each run, ties go to the earlier run
+  struct cursor {
+    const char *row;
+    size_t run;
+  };
+  auto greater = [this](const cursor& c1, const cursor& c2) {
+    int c = compare_rows(c1.row, c2.row);
+    return c != 0 ? c > 0 : c1.run > c2.run;
+  };
+  std::priority_queue<cursor, std::vector<cursor>, decltype(greater)>
+      heap(greater);
+  for (size_t i = 0; i < runs.size(); i++) {
+    if (runs[i]->begin() < runs[i]->end())
+      heap.push({runs[i]->begin(), i});
+  }
+  while (!heap.empty()) {
+    cursor c = heap.top();
+    heap.pop();
+    if (!row_fn(c.row))
+      break;
+    const char *next = spool_next_row(c.row);
+    if (next < runs[c.run]->end())
+      heap.push({next, c.run});
+  }
+  return 0;
+}
+
+int ResultSpool::finish(
+    std::function<bool(const std::shared_ptr<arrow::Table>&)> emit,
+    std::string& errmsg)
+{
+  int ret = input.map();
+  if (ret < 0) {
+    errmsg.append("ERROR: spool: " + std::string(strerror(-ret)));
+    return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+  }
+  if (input.num_rows() == 0)
+    return 0;
+
+  SpoolFile grouped;
+  SpoolFile *rows = &input;
+  if (!group_cols.empty()) {
+    ret = grouped.create(dir);
+    if (ret == 0)
+      ret = group(input, grouped);
+    if (ret < 0) {
+      errmsg.append("ERROR: spool: group: " + std::string(strerror(-ret)));
+      return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+    }
+    rows = &grouped;
+  }
+
+  // rows are handed back as arrow tables of the spooled schema
+  const size_t ncols = types.size();
+  std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders(ncols);
+  arrow::Status st;
+  for (size_t c = 0; c < ncols && st.ok(); c++)
+    st = arrow::MakeBuilder(arrow::default_memory_pool(),
+                            schema->field(c)->type(), &builders[c]);
+  if (!st.ok()) {
+    errmsg.append("ERROR: spool: " + st.ToString());
+    return TablesErrCodes::ArrowStatusErr;
+  }
+
+  int64_t nrows = 0;
+  bool more = true;
+  auto emit_table = [&]() {
+    std::vector<std::shared_ptr<arrow::Array>> arrays(ncols);
+    for (size_t c = 0; c < ncols && st.ok(); c++)
+      st = builders[c]->Finish(&arrays[c]);
+    if (!st.ok())
+      return;
+    std::shared_ptr<arrow::Schema> sch = schema;
+    auto metadata = schema->metadata();
+    if (metadata && metadata->size() > METADATA_NUM_ROWS)
+      sch = schema->WithMetadata(copy_arrow_metadata(metadata, nrows));
+    more = emit(arrow::Table::Make(sch, arrays, nrows));
+    nrows = 0;
+  };
+
+  ret = sort_and_emit(*rows, [&](const char *row) {
+    const char *p = row + sizeof(uint32_t);
+    for (size_t c = 0; c < ncols && st.ok(); c++) {
+      arrow::ArrayBuilder *b = builders[c].get();
+      const char *v = p + 1;
+      if (*p) {
+        st = b->AppendNull();
+      } else {
+        switch (types[c]) {
+          case arrow::Type::BOOL:   st = spool_get<arrow::BooleanBuilder, bool>(b, v); break;
+          case arrow::Type::INT8:   st = spool_get<arrow::Int8Builder, int8_t>(b, v); break;
+          case arrow::Type::INT16:  st = spool_get<arrow::Int16Builder, int16_t>(b, v); break;
+          case arrow::Type::INT32:  st = spool_get<arrow::Int32Builder, int32_t>(b, v); break;
+          case arrow::Type::INT64:  st = spool_get<arrow::Int64Builder, int64_t>(b, v); break;
+          case arrow::Type::UINT8:  st = spool_get<arrow::UInt8Builder, uint8_t>(b, v); break;
+          case arrow::Type::UINT16: st = spool_get<arrow::UInt16Builder, uint16_t>(b, v); break;
+          case arrow::Type::UINT32: st = spool_get<arrow::UInt32Builder, uint32_t>(b, v); break;
+          case arrow::Type::UINT64: st = spool_get<arrow::UInt64Builder, uint64_t>(b, v); break;
+          case arrow::Type::FLOAT:  st = spool_get<arrow::FloatBuilder, float>(b, v); break;
+          case arrow::Type::DOUBLE: st = spool_get<arrow::DoubleBuilder, double>(b, v); break;
+          case arrow::Type::STRING:
+            st = static_cast<arrow::StringBuilder*>(b)->Append(
+                v + sizeof(uint32_t), spool_u32(v));
+            break;
+          default:
+            break;
+        }
+      }
+      p = spool_skip_col(types[c], p);
+    }
+    if (++nrows == SPOOL_EMIT_BATCH_ROWS)
+      emit_table();
+    return more && st.ok();
+  });
+  if (ret < 0) {
+    errmsg.append("ERROR: spool: sort: " + std::string(strerror(-ret)));
+    return TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE;
+  }
+  if (st.ok() && more && nrows > 0)
+    emit_table();
+  if (!st.ok()) {
+    errmsg.append("ERROR: spool: " + st.ToString());
+    return TablesErrCodes::ArrowStatusErr;
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#ifndef SKYHOOK_QUERY_SPOOL_H
+#define SKYHOOK_QUERY_SPOOL_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <arrow/api.h>
+
+/*
+ * Append-only local file of encoded result rows, read back through mmap.
+ * The file is unlinked as soon as it is created, so it goes away with the
+ * process whichever way the process ends.
+ *
+ * Row encoding: uint32 payload length, then per column a null byte followed
+ * (when not null) by the value: fixed width little endian for numbers and
+ * bools, uint32 length plus bytes for strings.
+ */
+class SpoolFile {
+public:
+  SpoolFile() {}
+  ~SpoolFile();
+
+  SpoolFile(const SpoolFile&) = delete;
+  SpoolFile& operator=(const SpoolFile&) = delete;
+
+  int create(const std::string& dir);
+  int append(const char *data, size_t len, uint64_t nrows);
+  int map();  // flush and map read only, no appends after this
+
+  const char *begin() const { return base; }
+  const char *end() const { return base + size; }
+  uint64_t num_rows() const { return rows; }
+  uint64_t num_bytes() const { return size + buf.size(); }
+
+private:
+  int flush();
+
+  int fd = -1;
+  char *base = nullptr;
+  uint64_t size = 0;
+  uint64_t rows = 0;
+  std::string buf;
+};
+
+/*
+ * Client side ORDER BY and GROUP BY across objects.
+ * Workers append the rows of each object result to a spool file, then
+ * finish() runs a hash aggregation for GROUP BY (first row per group, as
+ * the in-storage GROUP BY does) and an external merge sort for ORDER BY,
+ * both within mem_budget bytes, and returns the rows as arrow tables.
+ * Rows marked deleted are not spooled.
+ */
+class ResultSpool {
+public:
+  int init(const std::string& dir,
+           uint64_t mem_budget,
+           const std::string& groupby_cols,
+           const std::string& orderby_cols);
+  bool active() const { return enabled; }
+
+  // thread safe
+  int append(const std::shared_ptr<arrow::Table>& table, std::string& errmsg);
+
+  // emit returns false to stop early, e.g. once the row limit is reached
+  int finish(std::function<bool(const std::shared_ptr<arrow::Table>&)> emit,
+             std::string& errmsg);
+
+  uint64_t num_rows() const { return input.num_rows(); }
+
+private:
+  struct sort_key {
+    int col;
+    bool desc;
+  };
+
+  int resolve_cols(const std::shared_ptr<arrow::Schema>& schema,
+                   std::string& errmsg);
+  int group(SpoolFile& in, SpoolFile& out);
+  int sort_and_emit(SpoolFile& in,
+                    std::function<bool(const char *)> row_fn);
+  int compare_rows(const char *r1, const char *r2) const;
+
+  bool enabled = false;
+  std::string dir;
+  uint64_t mem_budget = 0;
+  std::string groupby_cols;
+  std::string orderby_cols;
+
+  std::mutex lock;
+  SpoolFile input;
+  std::shared_ptr<arrow::Schema> schema;  // of the first result appended
+  std::vector<arrow::Type::type> types;
+  std::vector<int> group_cols;
+  std::vector<sort_key> sort_keys;
+  int del_col = -1;
+};
+
+#endif
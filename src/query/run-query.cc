@@ -9,6 +9,7 @@
 */
 
 #include <fstream>
+#include <cstring>
 #include <boost/program_options.hpp>
 #include "cls/cls_tabular_utils.h"
 #include "query/query.h"
@@ -27,7 +28,15 @@ int main(int argc, char **argv)
   bool transform_db;
   std::string logfile;
   int qdepth;
+  bool adaptive_qdepth;
+  int max_qdepth;
   std::string direction;
+  bool osd_locality;
+  int max_ios_per_osd;
+  double hedge_percentile;
+  bool hedge_read;
+  std::string latency_log;
+  int pushback_threshold;
   std::string conf;
 
   // user/client input, trimmed and encoded to skyhook structs for query_op
@@ -39,9 +48,15 @@ int main(int argc, char **argv)
   bool text_index_ignore_stopwords;
   bool lock_op;
   bool do_compaction;
+  bool do_repartition;
+  uint64_t repartition_objsize;
+  uint64_t repartition_batch_rows;
+  std::string repartition_table_name;
   int index_plan_type;
   int trans_format_type;
   std::string trans_format_str;
+  int trans_compression_type;
+  std::string trans_compression_str;
   std::string text_index_delims;
   std::string db_schema_name;
   std::string table_name;
@@ -69,6 +84,11 @@ int main(int argc, char **argv)
   bool fastpath = false;
   bool idx_unique = false;
   bool header = false;  // print csv header
+  bool ordered_output = false;
+  std::string spool_dir;
+  uint64_t spool_mem_mb;
+  std::string batch_queries_file;
+  std::string batch_output_prefix;
 
   // example options
   int example_counter;
@@ -124,6 +144,8 @@ int main(int argc, char **argv)
     ("query", po::value<std::string>(&query)->default_value("flatbuf"), "query name")
     ("wthreads", po::value<int>(&wthreads)->default_value(1), "num threads")
     ("qdepth", po::value<int>(&qdepth)->default_value(1), "queue depth")
+    ("adaptive-qdepth", po::bool_switch(&adaptive_qdepth)->default_value(false), "adapt the queue depth (AIMD) to the observed latency, starting from qdepth")
+    ("max-qdepth", po::value<int>(&max_qdepth)->default_value(128), "upper bound of the queue depth with adaptive-qdepth")
     ("build-index", po::bool_switch(&build_index)->default_value(false), "build index")
     ("use-index", po::bool_switch(&use_index)->default_value(false), "use index")
     ("old-projection", po::bool_switch(&old_projection)->default_value(false), "use older projection method")
@@ -131,9 +153,18 @@ int main(int argc, char **argv)
     ("extra-row-cost", po::value<uint64_t>(&extra_row_cost)->default_value(0), "extra row cost")
     ("log-file", po::value<std::string>(&logfile)->default_value(""), "log file")
     ("direction", po::value<std::string>(&direction)->default_value("fwd"), "direction for cache warmup testing. choose one of: fwd, bwd, rnd")
+    ("osd-locality", po::bool_switch(&osd_locality)->default_value(false), "dispatch objects round-robin across their primary OSDs")
+    ("max-ios-per-osd", po::value<int>(&max_ios_per_osd)->default_value(0), "with osd-locality, max outstanding requests per OSD (0 = no limit)")
+    ("hedge-percentile", po::value<double>(&hedge_percentile)->default_value(0), "re-issue requests outstanding longer than this percentile of recent object latencies (0 = off, flatbuf queries only)")
+    ("hedge-read", po::bool_switch(&hedge_read)->default_value(false), "hedge with a plain read processed on the client instead of re-issuing the cls query")
+    ("latency-log", po::value<std::string>(&latency_log)->default_value(""), "write per-object latencies to this csv file")
     ("conf", po::value<std::string>(&conf)->default_value(""), "path to ceph.conf")
     ("transform-db", po::bool_switch(&transform_db)->default_value(false), "transform DB")
     ("compact-table", po::bool_switch(&do_compaction)->default_value(false), "compact Arrow tables")
+    ("repartition", po::bool_switch(&do_repartition)->default_value(false), "repartition Arrow tables by key into objects of repartition-objsize bytes, written to table repartition-table-name")
+    ("repartition-objsize", po::value<uint64_t>(&repartition_objsize)->default_value(0), "target object size in bytes for repartition (def=0, keep num-objs objects)")
+    ("repartition-batch-rows", po::value<uint64_t>(&repartition_batch_rows)->default_value(0), "max rows per Arrow table within repartitioned objects (def=0, no limit)")
+    ("repartition-table-name", po::value<std::string>(&repartition_table_name)->default_value(""), "destination table name for repartition (def=<table-name>_repart)")
     // query parameters (old)
     ("extended-price", po::value<double>(&extended_price)->default_value(0.0), "extended price")
     ("order-key", po::value<int>(&order_key)->default_value(0.0), "order key")
@@ -165,8 +196,14 @@ int main(int argc, char **argv)
     ("index-plan-type", po::value<int>(&index_plan_type)->default_value(Tables::SIP_IDX_STANDARD), "If 2 indexes, for intersection plan use '2', for union plan use '3' (def='1')")
     ("runstats", po::value<std::string>(&runstats_args)->default_value(""), "Run statistics on the specified table name")
     ("transform-format-type", po::value<std::string>(&trans_format_str)->default_value("SFT_FLATBUF_FLEX_ROW"), "Destination format type ")
+    ("transform-compression", po::value<std::string>(&trans_compression_str)->default_value("none"), "Destination blob compression, one of: none, lz4, zstd")
     ("verbose", po::bool_switch(&print_verbose)->default_value(false), "Print detailed record metadata.")
     ("header", po::bool_switch(&header)->default_value(false), "Print row header (i.e., row schema")
+    ("ordered-output", po::bool_switch(&ordered_output)->default_value(false), "Write the results of each object in dispatch order rather than completion order")
+    ("spool-dir", po::value<std::string>(&spool_dir)->default_value("/tmp"), "Directory of the local spool files used for orderby/groupby across objects")
+    ("spool-mem", po::value<uint64_t>(&spool_mem_mb)->default_value(256), "Memory budget in MB for client side orderby/groupby, larger inputs are sorted/grouped externally")
+    ("batch-queries", po::value<std::string>(&batch_queries_file)->default_value(""), "File of more queries to evaluate in the same object scans, one per line as: project<TAB>select")
+    ("batch-output-prefix", po::value<std::string>(&batch_output_prefix)->default_value("batch"), "Results of the n-th batch query are written to <prefix>.<n>")
     ("limit", po::value<long long int>(&row_limit)->default_value(Tables::ROW_LIMIT_DEFAULT), "SQL limit option, limit num_rows of result set")
     ("example-counter", po::value<int>(&example_counter)->default_value(100), "Loop counter for example function")
     ("example-function-id", po::value<int>(&example_function_id)->default_value(1), "CLS function identifier for example function")
@@ -182,6 +219,7 @@ int main(int argc, char **argv)
     ("lock-obj-create", po::bool_switch(&lock_obj_create)->default_value(false), "Create Lock obj")
     ("client-format", po::value<std::string>(&client_format_str)->default_value("SFT_ANY"), "Data format type to return to client (def=SFT_ANY)")
     ("pushdown-cols-only", po::bool_switch(&pushdown_cols_only)->default_value(false), "Only pushdown cols")
+    ("pushback-threshold", po::value<int>(&pushback_threshold)->default_value(0), "let an OSD running more than this many queries return objects unprocessed, to be processed here (0 = never)")
  ;
 
   po::options_description all_opts("Allowed options");
@@ -341,6 +379,7 @@ int main(int argc, char **argv)
     boost::trim(index2_preds);
     boost::trim(text_index_delims);
     boost::trim(trans_format_str);
+    boost::trim(trans_compression_str);
     boost::trim(client_format_str);
 
     // standardize naming as uppercase
@@ -373,6 +412,8 @@ int main(int argc, char **argv)
     switch (trans_format_type) {
         case SFT_FLATBUF_FLEX_ROW:
         case SFT_ARROW:
+        case SFT_PARQUET:
+        case SFT_FLATBUF_UNION_COL:
         { // these are supported tranformation formats
             break;
         }
@@ -380,6 +421,13 @@ int main(int argc, char **argv)
             assert(Tables::TablesErrCodes::EINVALID_TRANSFORM_FORMAT);
     }
 
+    trans_compression_type = compression_type_from_string(trans_compression_str);
+    if (trans_compression_type < 0) {
+        cerr << "Error: transform-compression " << trans_compression_str
+             << " not supported. Use none, lz4 or zstd." << std::endl;
+        return 1;
+    }
+
     // verify client specified output format is valid
     skyhook_output_format = sky_format_type_from_string(client_format_str);
     switch (skyhook_output_format) {
@@ -387,6 +435,7 @@ int main(int argc, char **argv)
         case SFT_CSV:
         case SFT_PG_BINARY:
         case SFT_PYARROW_BINARY:
+        case SFT_ARROW_STREAM:
         { // these are supported final output formats for the client
             break;
         }
@@ -420,6 +469,60 @@ int main(int argc, char **argv)
     if (pushdown_cols_only == true) {
       assert(use_cls == true);
     }
+
+    // more queries to evaluate in the object scans of this one, their
+    // results are written to files of their own.
+    if (!batch_queries_file.empty()) {
+        if (query != "flatbuf" || !use_cls || index_read || hedge_read) {
+            cerr << "Error: batch-queries needs a flatbuf query with use-cls "
+                 << "and no index-read or hedge-read" << std::endl;
+            return 1;
+        }
+        std::ifstream batch_in(batch_queries_file);
+        if (!batch_in) {
+            cerr << "Error: could not read batch-queries "
+                 << batch_queries_file << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(batch_in, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::unique_ptr<BatchQuery> q(new BatchQuery);
+            size_t tab = line.find('\t');
+            q->project = line.substr(0, tab);
+            q->select = (tab == std::string::npos) ? SELECT_DEFAULT
+                                                   : line.substr(tab + 1);
+            if (q->project.empty())
+                q->project = PROJECT_DEFAULT;
+
+            schema_vec batch_schema = (q->project == PROJECT_DEFAULT) ?
+                sky_tbl_schema : schemaFromColNames(sky_tbl_schema, q->project);
+            predicate_vec batch_preds = predsFromString(sky_tbl_schema,
+                                                        q->select);
+            if (hasAggPreds(batch_preds)) {
+                cerr << "Error: batch query '" << line << "': aggregates "
+                     << "are not supported in batch queries" << std::endl;
+                return 1;
+            }
+            q->query_schema = schemaToString(batch_schema);
+            q->query_preds = predsToString(batch_preds, sky_tbl_schema);
+            q->header_pending = (header &&
+                skyhook_output_format != SkyFormatType::SFT_PYARROW_BINARY) ||
+                skyhook_output_format == SkyFormatType::SFT_ARROW_STREAM;
+            q->path = batch_output_prefix + "." +
+                      std::to_string(batch_queries.size() + 1);
+            if (!quiet) {
+                q->out = fopen(q->path.c_str(), "w");
+                if (q->out == NULL) {
+                    cerr << "Error: could not create " << q->path << ": "
+                         << strerror(errno) << std::endl;
+                    return 1;
+                }
+            }
+            batch_queries.push_back(std::move(q));
+        }
+    }
     // validate incoming query
     if (groupby_cols != "" || hasAggPreds(sky_qry_preds)) {
         schema_vec projection = schemaFromColNames(sky_tbl_schema, project_cols);
@@ -744,6 +847,7 @@ int main(int argc, char **argv)
     qop_groupby_cols = groupby_cols;
     qop_orderby_cols = orderby_cols;
     qop_result_format = skyhook_output_format;
+    qop_pushback_threshold = pushback_threshold;
     idx_op_idx_unique = idx_unique;
     idx_op_batch_size = index_batch_size;
     idx_op_idx_type = index_type;
@@ -780,6 +884,7 @@ int main(int argc, char **argv)
             cout << "DEBUG: run-query: qop_index_preds=" << qop_index_preds << endl;
             cout << "DEBUG: run-query: qop_index2_preds=" << qop_index2_preds << endl;
             cout << "DEBUG: run-query: qop_result_format=" << qop_result_format << endl;
+            cout << "DEBUG: run-query: qop_pushback_threshold=" << qop_pushback_threshold << endl;
         }
         else if (index_create or index_read) {
             cout << "DEBUG: run-query: idx_op_idx_unique=" << idx_op_idx_unique << endl;
@@ -795,6 +900,8 @@ int main(int argc, char **argv)
     skyhook_output_format = sky_format_type_from_string(client_format_str);
     if (skyhook_output_format == SFT_PG_BINARY)
         print_header = true;  // binary fstream always requires binary header
+    else if (skyhook_output_format == SFT_ARROW_STREAM)
+        print_header = true;  // stream starts with the schema message
     else
         print_header = header;
 
@@ -933,12 +1040,72 @@ int main(int argc, char **argv)
     return 0;
   }
 
+  // for REPARTITION ARROW TABLES job
+  // rows are hash partitioned by key with the same consistent hash as the
+  // data writer into a new set of objects sized to repartition_objsize, then
+  // each new object is rebatched in place. source objects are not removed,
+  // existing destination objects are overwritten or removed.
+  if (query == "flatbuf" && do_repartition) {
+
+    if (repartition_table_name.empty())
+        repartition_table_name = table_name + "_repart";
+    assert(repartition_table_name != table_name);
+    repart_dst_oid_prefix = oid_prefix + "." + repartition_table_name + ".";
+
+    // size the destination from the total bytes of the source objects.
+    uint64_t num_dst_objs = num_objs;
+    if (repartition_objsize > 0) {
+      uint64_t total_size = 0;
+      for (auto& oid : target_objects) {
+        uint64_t psize;
+        time_t pmtime;
+        if (ioctx.stat(oid, &psize, &pmtime) == 0)
+          total_size += psize;
+      }
+      num_dst_objs = std::max<uint64_t>(1,
+          (total_size + repartition_objsize - 1) / repartition_objsize);
+    }
+
+    repartition_op op(repartition_table_name, num_dst_objs,
+                     repartition_batch_rows);
+    if (debug)
+        cout << "DEBUG: repartition op=" << op.toString()
+             << " dst_oid_prefix=" << repart_dst_oid_prefix << endl;
+
+    // 1. partition each source object into the destination objects.
+    // 2. rebatch each destination object in place.
+    for (int phase = 0; phase < 2; phase++) {
+      if (phase == 1) {
+        op.num_objs = 0;
+        target_objects.clear();
+        int ret = repartition_dst_objects(&ioctx, target_objects);
+        checkret(ret, 0);
+      }
+
+      // kick off the workers
+      std::vector<std::thread> threads;
+      for (int i = 0; i < wthreads; i++) {
+        auto ioctx = new librados::IoCtx;
+        int ret = cluster.ioctx_create(pool.c_str(), *ioctx);
+        checkret(ret, 0);
+        threads.push_back(std::thread(worker_repartition_arrow_table_op, ioctx, op));
+      }
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    }
+
+    return 0;
+  }
+
   // for TRANSFORM OBJECT FORMAT job
   // launch transform operation here.
   if (query == "flatbuf" && transform_db) {
 
     // create idx_op for workers
-    transform_op op(qop_table_name, qop_query_schema, trans_op_format_type);
+    transform_op op(qop_table_name, qop_query_schema, trans_op_format_type,
+                    trans_compression_type);
 
     if (debug)
         cout << "DEBUG: transform op=" << op.toString() << endl;
@@ -1020,6 +1187,55 @@ int main(int argc, char **argv)
   outstanding_ios = 0;
   stop = false;
 
+  // without adaptive-qdepth the depth stays at qdepth
+  qdepth_ctl.init(qdepth, adaptive_qdepth ? max_qdepth : qdepth);
+
+  // at most max depth ios can complete before a worker takes them
+  ready_ios.init(qdepth_ctl.max_depth);
+
+  // orderby/groupby across objects are applied to the spooled results of
+  // all objects once every object has been processed.
+  if (!quiet && query == "flatbuf") {
+    int ret = result_spool.init(spool_dir, spool_mem_mb << 20,
+                                groupby_cols, orderby_cols);
+    if (ret < 0) {
+      cerr << "Error: could not create a spool file in " << spool_dir
+           << ": " << strerror(-ret) << std::endl;
+      return 1;
+    }
+  }
+
+  // results are formatted by the workers and written by this thread
+  // (the old fixed-schema queries print no header, nor does pyarrow)
+  if (!quiet)
+    output_writer.start(ordered_output,
+        print_header &&
+        (query == "flatbuf" || query == "example" || query == "wasm") &&
+        skyhook_output_format != SkyFormatType::SFT_PYARROW_BINARY);
+  uint64_t dispatch_seq = 0;
+
+  // how often the dispatcher looks for stragglers when hedging
+  const uint64_t hedge_check_ns = 2 * 1000 * 1000;
+  {
+    int ret = hedge_ctl.init(&ioctx,
+                             query == "flatbuf" ? hedge_percentile : 0,
+                             hedge_read, latency_log);
+    if (ret < 0) {
+      cerr << "Error: could not open latency-log " << latency_log << ": "
+           << strerror(-ret) << std::endl;
+      return 1;
+    }
+  }
+
+  if (osd_locality) {
+    int ret = osd_dispatch.init(cluster, ioctx, pool, target_objects,
+                                max_ios_per_osd);
+    if (ret < 0)
+      cerr << "Warning: could not read the pg mapping of pool " << pool
+           << " (" << strerror(-ret) << "), dispatching without locality"
+           << std::endl;
+  }
+
   // start worker threads
   std::vector<std::thread> threads;
   for (int i = 0; i < wthreads; i++) {
@@ -1027,24 +1243,51 @@ int main(int argc, char **argv)
   }
 
   // create the oid list, for dispatching workers
-  std::unique_lock<std::mutex> lock(dispatch_lock);
   while (true) {
-    while (outstanding_ios < qdepth) {
-      // get an object to process
-      if (target_objects.empty())
+    while (outstanding_ios < qdepth_ctl.get()) {
+      // with ordered output, hold off while too much output waits on an
+      // earlier object. the hedge checks below keep running meanwhile.
+      if (!output_writer.wait_for_space(
+              hedge_ctl.enabled() ? hedge_check_ns : 0))
         break;
-      std::string oid = target_objects.back();
-      target_objects.pop_back();
-      lock.unlock();
+
+      // get an object to process
+      std::string oid;
+      int osd_slot = -1;
+      if (osd_locality) {
+        if (!osd_dispatch.next_object(oid, osd_slot))
+          break;
+      } else {
+        if (target_objects.empty())
+          break;
+        oid = target_objects.back();
+        target_objects.pop_back();
+      }
+
+      // count the io before it can complete
+      outstanding_ios++;
 
       // dispatch an io request
       AioState *s = new AioState;
+      s->seq = dispatch_seq++;
+      s->osd_slot = osd_slot;
       s->c = librados::Rados::aio_create_completion(
           s, NULL, handle_cb);
 
       // keeps track of the worker latency
       memset(&s->times, 0, sizeof(s->times));
       s->times.dispatch = getns();
+      s->oid = oid;
+      s->obj_dispatch = s->times.dispatch;
+
+      // tracked before the io is issued, it may complete right away
+      if (hedge_ctl.enabled()) {
+        ObjRequest *req = new ObjRequest;
+        req->oid = oid;
+        req->ios[0] = s;
+        s->req = req;
+        hedge_ctl.track(req, s->seq);
+      }
 
       // set the now validated query op params into the op struct, and
       // encode the op into the inbound bl for the specified oid.
@@ -1072,15 +1315,39 @@ int main(int argc, char **argv)
         op.orderby_cols = qop_orderby_cols;
         op.index_preds = qop_index_preds;
         op.index2_preds = qop_index2_preds;
+        op.pushback_threshold = qop_pushback_threshold;
         ceph::bufferlist inbl;
         using ceph::encode;
-        encode(op, inbl);
+        if (batch_queries.empty()) {
+            encode(op, inbl);
+        }
+        else {
+            // this query first, then the batched ones over the same scan
+            query_batch_op batch;
+            batch.ops.push_back(op);
+            for (auto& q : batch_queries) {
+                query_op bop = op;
+                bop.fastpath = false;
+                bop.query_schema = q->query_schema;
+                bop.query_preds = q->query_preds;
+                bop.groupby_cols = "";
+                bop.orderby_cols = "";
+                bop.pushback_threshold = 0;
+                batch.ops.push_back(bop);
+            }
+            encode(batch, inbl);
+        }
+        if (s->req)
+            s->req->inbl = inbl;  // to re-issue the same op
 
         if (debug)
             cout << "DEBUG: run-query: launching aio_exec for oid=" << oid << endl;
 
         // Launch CEPH CLS Read
-        int ret = ioctx.aio_exec(oid, s->c, "tabular", "exec_query_op", inbl, &s->bl);
+        int ret = ioctx.aio_exec(oid, s->c, "tabular",
+                                 batch_queries.empty() ? "exec_query_op"
+                                                       : "exec_query_batch_op",
+                                 inbl, &s->bl);
         checkret(ret, 0);
 
       } else {
@@ -1191,29 +1458,35 @@ int main(int argc, char **argv)
         }
     }
 
-      lock.lock();
-      outstanding_ios++;
     }
-    if (target_objects.empty())
+    if (osd_locality ? osd_dispatch.empty() : target_objects.empty())
       break;
-    dispatch_cond.wait(lock);
+    if (hedge_ctl.enabled())
+      hedge_ctl.issue_hedges();
+    // below the depth only when every OSD with objects left is at its cap,
+    // then wait for any io to complete.
+    wait_io_slot(std::max(1, std::min(qdepth_ctl.get(), (int)outstanding_ios)),
+                 hedge_ctl.enabled() ? hedge_check_ns : 0);
   }
-  lock.unlock();
 
-  // drain any still-in-flight operations
-  while (true) {
-    lock.lock();
-    if (outstanding_ios == 0) {
-      lock.unlock();
-      break;
+  // drain any still-in-flight operations. the workers wake us as they take
+  // each io, so we are done as soon as the last one is taken.
+  while (outstanding_ios > 0) {
+
+    // the stragglers are what hedging is for, keep checking while draining
+    if (hedge_ctl.enabled()) {
+      hedge_ctl.issue_hedges();
+      wait_io_slot(1, hedge_check_ns);
+      continue;
     }
-    lock.unlock();
 
     // only report status messages during quiet operation
     // since otherwise we are printing as csv data to std out
     if (quiet)
         std::cout << "draining ios: " << outstanding_ios << " remaining\n";
-    sleep(1);
+
+    // the timeout only paces the status message
+    wait_io_slot(1, 1000000000ull);
   }
 
   // wait for all the workers to stop
@@ -1226,8 +1499,19 @@ int main(int argc, char **argv)
   for (auto& thread : threads) {
     thread.join();
   }
+
+  // the losing side of hedged requests may still be completing
+  if (hedge_ctl.enabled())
+    ioctx.aio_flush();
   ioctx.close();
 
+  hedge_ctl.finish();
+
+  // write out everything the workers produced before any trailer
+  output_writer.finish();
+  if (result_spool.active())
+    print_spooled_results();
+
   // all workers are done, now we check if we need to add any trailers to
   // binary output such as postgres or pyarrow raw binary data being returned
   // to those corresponding clients.
@@ -1258,12 +1542,68 @@ int main(int argc, char **argv)
         // force any remaining output to the pipe
         std::cout << std::flush;
     }
+
+    // end of stream marker, so readers know no more batches follow. when
+    // no object returned rows the header was never written, the stream
+    // still starts with the schema so readers can open it.
+    if ((skyhook_output_format == SkyFormatType::SFT_ARROW_STREAM) and !quiet) {
+        if (print_header.exchange(false)) {
+            std::string schema_msg;
+            int ret = Tables::printArrowIpcStreamSchema(arrow_stream,
+                                                        sky_qry_schema,
+                                                        schema_msg);
+            if (ret) {
+                cerr << "ERROR: run-query: arrow stream schema ERR=" << ret
+                     << std::endl;
+                assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+            }
+            std::cout << schema_msg;
+        }
+        std::cout << Tables::ARROW_IPC_STREAM_EOS << std::flush;
+    }
+  }
+
+  // the batch query outputs end the same way as stdout
+  for (auto& q : batch_queries) {
+    if (q->out == NULL)
+      continue;
+    if (skyhook_output_format == SkyFormatType::SFT_PG_BINARY) {
+      int16_t trailer = -1;
+      fwrite(&trailer, sizeof(trailer), 1, q->out);
+    }
+    if (skyhook_output_format == SkyFormatType::SFT_ARROW_STREAM) {
+      if (q->header_pending) {
+        std::string schema_msg;
+        Tables::schema_vec sc = schemaFromString(q->query_schema);
+        int ret = Tables::printArrowIpcStreamSchema(q->stream, sc, schema_msg);
+        if (ret) {
+          cerr << "ERROR: run-query: arrow stream schema ERR=" << ret
+               << std::endl;
+          assert(Tables::TablesErrCodes::ECLIENTSIDE_PROCESSING_FAILURE==0);
+        }
+        fwrite(schema_msg.data(), 1, schema_msg.size(), q->out);
+      }
+      fwrite(Tables::ARROW_IPC_STREAM_EOS.data(), 1,
+             Tables::ARROW_IPC_STREAM_EOS.size(), q->out);
+    }
+    if (fclose(q->out) != 0)
+      cerr << "Error: writing " << q->path << std::endl;
+    q->out = NULL;
   }
 
   // only report status messages during quiet operation
   // since otherwise we are printing as csv data to std out
   if (quiet) {
     std::cout << "total result row count: " << result_count << std::endl;
+    if (adaptive_qdepth)
+      std::cout << "final qdepth: " << qdepth_ctl.get() << std::endl;
+    if (pushback_threshold > 0)
+      std::cout << "objects pushed back by busy osds: " << pushed_back_objs
+                << std::endl;
+    for (size_t i = 0; i < batch_queries.size(); i++)
+      std::cout << "batch query " << (i + 1) << " result row count: "
+                << batch_queries[i]->result_count << std::endl;
+    hedge_ctl.print_summary();
   }
 
 
@@ -111,6 +111,8 @@ class SkyhookQuery : public ::testing::Test {
     }
 
     static void execute() {
+      ready_ios.init(target_objects.size());
+
       // read data
       for (auto oid : target_objects) {
         AioState *s = new AioState;
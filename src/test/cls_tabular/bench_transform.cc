@@ -0,0 +1,259 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+/*
+ * Micro-benchmark of transform_fb_to_arrow over a generated TPC-H lineitem
+ * flatbuffer, against the row at a time implementation it replaced.
+ *
+ * usage: ceph_perf_skyhook_transform [nrows] [iterations]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+
+using namespace Tables;
+
+/*
+ * The row at a time transform_fb_to_arrow as it was before the columns were
+ * built one at a time: one builder per column, every value appended through
+ * the ArrayBuilder of its column, strings copied out of the flexbuffer.
+ */
+static int transform_fb_to_arrow_rowwise(const char* fb,
+                                         const size_t fb_size,
+                                         schema_vec& query_schema,
+                                         std::string& errmsg,
+                                         std::shared_ptr<arrow::Table>* table)
+{
+    sky_root root = getSkyRoot(fb, fb_size);
+    delete_vector del_vec = root.delete_vec;
+    uint32_t nrows = root.nrows;
+
+    auto pool = arrow::default_memory_pool();
+    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builder_list;
+    std::vector<std::shared_ptr<arrow::Array>> array_list;
+    std::vector<std::shared_ptr<arrow::Field>> schema_vector;
+    std::shared_ptr<arrow::KeyValueMetadata> metadata (new arrow::KeyValueMetadata);
+    metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(root.nrows));
+
+    for (auto it = query_schema.begin(); it != query_schema.end(); ++it) {
+        col_info col = *it;
+        switch(col.type) {
+            case SDT_INT32:
+                builder_list.emplace_back(new arrow::Int32Builder(pool));
+                schema_vector.push_back(arrow::field(col.name, arrow::int32()));
+                break;
+            case SDT_FLOAT:
+                builder_list.emplace_back(new arrow::FloatBuilder(pool));
+                schema_vector.push_back(arrow::field(col.name, arrow::float32()));
+                break;
+            case SDT_DOUBLE:
+                builder_list.emplace_back(new arrow::DoubleBuilder(pool));
+                schema_vector.push_back(arrow::field(col.name, arrow::float64()));
+                break;
+            case SDT_CHAR:
+                builder_list.emplace_back(new arrow::Int8Builder(pool));
+                schema_vector.push_back(arrow::field(col.name, arrow::int8()));
+                break;
+            case SDT_DATE:
+            case SDT_STRING:
+                builder_list.emplace_back(new arrow::StringBuilder(pool));
+                schema_vector.push_back(arrow::field(col.name, arrow::utf8()));
+                break;
+            default:
+                errmsg.append("unsupported col.type=" + std::to_string(col.type));
+                return TablesErrCodes::UnsupportedSkyDataType;
+        }
+    }
+    builder_list.emplace_back(new arrow::Int64Builder(pool));
+    schema_vector.push_back(arrow::field("RID", arrow::int64()));
+    builder_list.emplace_back(new arrow::BooleanBuilder(pool));
+    schema_vector.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
+
+    for (uint32_t i = 0; i < nrows; i++) {
+        sky_rec rec = getSkyRec(static_cast<row_offs>(root.data_vec)->Get(i));
+        auto row = rec.data.AsVector();
+        for (auto it = query_schema.begin(); it != query_schema.end(); ++it) {
+            auto builder = builder_list[std::distance(query_schema.begin(), it)].get();
+            col_info col = *it;
+            if (col.nullable) {
+                int pos = col.idx / (8*sizeof(rec.nullbits.at(0)));
+                uint64_t col_bitmask = 1ull << (col.idx % (8*sizeof(rec.nullbits.at(0))));
+                if (col_bitmask & rec.nullbits.at(pos)) {
+                    builder->AppendNull();
+                    continue;
+                }
+            }
+            switch(col.type) {
+                case SDT_INT32:
+                    static_cast<arrow::Int32Builder *>(builder)->Append(row[col.idx].AsInt32());
+                    break;
+                case SDT_FLOAT:
+                    static_cast<arrow::FloatBuilder *>(builder)->Append(row[col.idx].AsFloat());
+                    break;
+                case SDT_DOUBLE:
+                    static_cast<arrow::DoubleBuilder *>(builder)->Append(row[col.idx].AsDouble());
+                    break;
+                case SDT_CHAR:
+                    static_cast<arrow::Int8Builder *>(builder)->Append(row[col.idx].AsInt8());
+                    break;
+                case SDT_DATE:
+                case SDT_STRING:
+                    static_cast<arrow::StringBuilder *>(builder)->Append(row[col.idx].AsString().str());
+                    break;
+            }
+        }
+        int num_cols = query_schema.size();
+        static_cast<arrow::Int64Builder *>(builder_list[ARROW_RID_INDEX(num_cols)].get())->Append(rec.RID);
+        static_cast<arrow::BooleanBuilder *>(builder_list[ARROW_DELVEC_INDEX(num_cols)].get())->Append(del_vec[i]);
+    }
+
+    for (auto& builder : builder_list) {
+        std::shared_ptr<arrow::Array> array;
+        if (!builder->Finish(&array).ok())
+            return TablesErrCodes::ArrowStatusErr;
+        array_list.push_back(array);
+    }
+    *table = arrow::Table::Make(std::make_shared<arrow::Schema>(schema_vector, metadata),
+                                array_list);
+    return 0;
+}
+
+/*
+ * A FLEX_ROW flatbuffer of nrows lineitem rows with deterministic
+ * dbgen-like values, 1% of the rows deleted.
+ */
+static void make_lineitem_fb(flatbuffers::FlatBufferBuilder& fbb, int nrows)
+{
+    static const char* instructs[] = {"DELIVER IN PERSON", "COLLECT COD",
+                                      "NONE", "TAKE BACK RETURN"};
+    static const char* modes[] = {"REG AIR", "AIR", "RAIL", "SHIP", "TRUCK",
+                                  "MAIL", "FOB"};
+    uint64_t seed = 42;
+    auto rnd = [&seed](uint64_t n) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return (seed >> 33) % n;
+    };
+
+    std::vector<flatbuffers::Offset<Tables::Record>> recs;
+    std::vector<uint8_t> delete_vec;
+    for (int i = 0; i < nrows; i++) {
+        char date[3][11];
+        for (auto& d : date)
+            snprintf(d, sizeof(d), "199%d-%02d-%02d", int(rnd(8)),
+                     int(rnd(12)) + 1, int(rnd(28)) + 1);
+        std::string comment = "carefully final deposits " +
+                              std::to_string(rnd(1000000));
+        flexbuffers::Builder flx;
+        flx.Vector([&]() {
+            flx.Add(static_cast<int32_t>(i / 4 + 1));
+            flx.Add(static_cast<int32_t>(rnd(200000)));
+            flx.Add(static_cast<int32_t>(rnd(10000)));
+            flx.Add(static_cast<int32_t>(i % 4 + 1));
+            flx.Add(static_cast<float>(rnd(50) + 1));
+            flx.Add(static_cast<double>(rnd(10000000)) / 100);
+            flx.Add(static_cast<float>(rnd(11)) / 100);
+            flx.Add(static_cast<double>(rnd(9)) / 100);
+            flx.Add(static_cast<int8_t>("ANR"[rnd(3)]));
+            flx.Add(static_cast<int8_t>("OF"[rnd(2)]));
+            flx.Add(date[0]);
+            flx.Add(date[1]);
+            flx.Add(date[2]);
+            flx.Add(instructs[rnd(4)]);
+            flx.Add(modes[rnd(7)]);
+            flx.Add(comment.c_str());
+        });
+        flx.Finish();
+        std::vector<uint64_t> nullbits(2, 0);
+        recs.push_back(CreateRecord(fbb, i, fbb.CreateVector(nullbits),
+                                    fbb.CreateVector(flx.GetBuffer())));
+        delete_vec.push_back(i % 100 == 7);
+    }
+    auto root = CreateTable(fbb, SFT_FLATBUF_FLEX_ROW, 2, 0, 0,
+                            fbb.CreateString(TPCH_LINEITEM_TEST_SCHEMA_STRING),
+                            fbb.CreateString("*"),
+                            fbb.CreateString("lineitem"),
+                            fbb.CreateVector(delete_vec),
+                            fbb.CreateVector(recs),
+                            nrows);
+    fbb.Finish(root);
+}
+
+template <typename F>
+static double best_of(int iterations, F f)
+{
+    double best = 0;
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::milli> d =
+            std::chrono::steady_clock::now() - start;
+        if (i == 0 || d.count() < best)
+            best = d.count();
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int nrows = argc > 1 ? atoi(argv[1]) : 100000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+
+    flatbuffers::FlatBufferBuilder fbb(1024);
+    make_lineitem_fb(fbb, nrows);
+    const char* fb = reinterpret_cast<const char*>(fbb.GetBufferPointer());
+    size_t fb_size = fbb.GetSize();
+    schema_vec schema = schemaFromString(TPCH_LINEITEM_TEST_SCHEMA_STRING);
+    schema_vec project = schemaFromString(TPCH_LINEITEM_TEST_SCHEMA_STRING_PROJECT);
+
+    std::cout << "lineitem rows=" << nrows << " fb bytes=" << fb_size
+              << " iterations=" << iterations << " (best of)" << std::endl;
+
+    struct {
+        const char* name;
+        schema_vec* schema;
+    } cases[] = {{"all cols", &schema}, {"project", &project}};
+    for (auto& c : cases) {
+        std::string errmsg;
+        std::shared_ptr<arrow::Table> rowwise, colwise;
+        double t_row = best_of(iterations, [&]() {
+            if (transform_fb_to_arrow_rowwise(fb, fb_size, *c.schema, errmsg, &rowwise))
+                exit(1);
+        });
+        double t_col = best_of(iterations, [&]() {
+            if (transform_fb_to_arrow(fb, fb_size, *c.schema, errmsg, &colwise))
+                exit(1);
+        });
+
+        // both hold the same columns, the metadata differs
+        if (rowwise->num_columns() != colwise->num_columns()) {
+            std::cerr << "column count differs" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < colwise->num_columns(); i++) {
+            if (!rowwise->column(i)->Equals(colwise->column(i))) {
+                std::cerr << "col " << colwise->field(i)->name()
+                          << " differs" << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << c.name << ": rowwise " << t_row << " ms, colwise "
+                  << t_col << " ms, speedup " << t_row / t_col << "x"
+                  << std::endl;
+    }
+    return 0;
+}
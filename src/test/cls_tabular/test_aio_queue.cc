@@ -0,0 +1,109 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "query/aio_queue.h"
+#include "gtest/gtest.h"
+
+TEST(MPMCQueue, Fifo) {
+  MPMCQueue<int> q;
+  q.init(8);
+  ASSERT_TRUE(q.empty());
+
+  for (int i = 0; i < 8; i++)
+    ASSERT_TRUE(q.push(i));
+  ASSERT_FALSE(q.empty());
+
+  int v;
+  for (int i = 0; i < 8; i++) {
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(i, v);
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+TEST(MPMCQueue, FullAndEmpty) {
+  MPMCQueue<int> q;
+  q.init(3);  // rounded up to 4
+
+  int v;
+  ASSERT_FALSE(q.pop(v));
+  for (int i = 0; i < 4; i++)
+    ASSERT_TRUE(q.push(i));
+  ASSERT_FALSE(q.push(4));
+
+  // a pop frees a cell for the next push, across the wrap around
+  ASSERT_TRUE(q.pop(v));
+  ASSERT_EQ(0, v);
+  ASSERT_TRUE(q.push(4));
+  ASSERT_FALSE(q.push(5));
+  for (int i = 1; i <= 4; i++) {
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(i, v);
+  }
+  ASSERT_FALSE(q.pop(v));
+  ASSERT_TRUE(q.empty());
+}
+
+TEST(MPMCQueue, Reinit) {
+  MPMCQueue<int> q;
+  q.init(2);
+  ASSERT_TRUE(q.push(1));
+  q.init(16);
+  ASSERT_TRUE(q.empty());
+  for (int i = 0; i < 16; i++)
+    ASSERT_TRUE(q.push(i));
+  ASSERT_FALSE(q.push(16));
+}
+
+TEST(MPMCQueue, ManyProducersManyConsumers) {
+  const int nthreads = 4;
+  const uint64_t per_thread = 100000;
+
+  MPMCQueue<uint64_t> q;
+  q.init(64);  // small, so producers and consumers keep meeting
+
+  std::atomic<uint64_t> sum(0);
+  std::atomic<uint64_t> popped(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&q, t, per_thread]() {
+      for (uint64_t i = 0; i < per_thread; i++) {
+        uint64_t v = t * per_thread + i + 1;
+        while (!q.push(v))
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&]() {
+      uint64_t v;
+      while (popped.load() < nthreads * per_thread) {
+        if (q.pop(v)) {
+          sum += v;
+          popped++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  // every value was popped exactly once
+  uint64_t n = nthreads * per_thread;
+  ASSERT_EQ(n, popped.load());
+  ASSERT_EQ(n * (n + 1) / 2, sum.load());
+  ASSERT_TRUE(q.empty());
+}
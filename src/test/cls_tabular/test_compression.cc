@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "cls/cls_tabular_utils.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static std::string compressible_blob() {
+  std::string data;
+  for (int i = 0; i < 5000; i++)
+    data += std::to_string(i % 97) + "|AIR|comment for row " +
+            std::to_string(i % 13) + "\n";
+  return data;
+}
+
+static std::string random_blob(size_t len) {
+  std::mt19937 gen(42);
+  std::string data(len, '\0');
+  for (auto& c : data)
+    c = static_cast<char>(gen());
+  return data;
+}
+
+class Compression : public ::testing::TestWithParam<CompressionType> {};
+
+TEST_P(Compression, BlobRoundTrip) {
+  std::string data = compressible_blob();
+  std::shared_ptr<arrow::Buffer> compressed;
+  ASSERT_EQ(0, compress_blob(GetParam(), data.data(), data.size(),
+                             &compressed));
+  ASSERT_LT(compressed->size(), (int64_t)data.size());
+
+  std::shared_ptr<arrow::Buffer> raw;
+  ASSERT_EQ(0, decompress_blob(GetParam(),
+                               reinterpret_cast<const char*>(compressed->data()),
+                               compressed->size(), &raw));
+  ASSERT_EQ((int64_t)data.size(), raw->size());
+  ASSERT_EQ(0, memcmp(data.data(), raw->data(), data.size()));
+}
+
+TEST_P(Compression, DecompressCorrupt) {
+  std::shared_ptr<arrow::Buffer> raw;
+
+  // shorter than the size prefix
+  ASSERT_NE(0, decompress_blob(GetParam(), "abc", 3, &raw));
+
+  // a size prefix followed by bytes the codec did not write
+  std::string junk(sizeof(uint64_t), '\0');
+  uint64_t raw_size = 1000;
+  memcpy(&junk[0], &raw_size, sizeof(raw_size));
+  junk += "this is not a compressed blob";
+  ASSERT_NE(0, decompress_blob(GetParam(), junk.data(), junk.size(), &raw));
+
+  // truncated
+  std::string data = compressible_blob();
+  std::shared_ptr<arrow::Buffer> compressed;
+  ASSERT_EQ(0, compress_blob(GetParam(), data.data(), data.size(),
+                             &compressed));
+  ASSERT_NE(0, decompress_blob(GetParam(),
+                               reinterpret_cast<const char*>(compressed->data()),
+                               compressed->size() / 2, &raw));
+}
+
+TEST_P(Compression, FbMetaRoundTrip) {
+  std::string data = compressible_blob();
+  flatbuffers::FlatBufferBuilder builder(1024);
+  createFbMeta(&builder, SFT_CSV,
+               reinterpret_cast<unsigned char*>(&data[0]), data.size(),
+               false, 7, data.size(), GetParam(), "ORDERKEY,LINENUMBER");
+
+  // stored compressed
+  const FB_Meta* stored = GetFB_Meta(builder.GetBufferPointer());
+  ASSERT_EQ(GetParam(), stored->blob_compression());
+  ASSERT_LT(stored->blob_data()->size(), data.size());
+
+  // and read back uncompressed
+  bufferlist bl;
+  bl.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+            builder.GetSize());
+  sky_meta meta = getSkyMeta(&bl);
+  ASSERT_EQ(0, meta.blob_errcode);
+  ASSERT_EQ(SFT_CSV, meta.blob_format);
+  ASSERT_EQ(data.size(), meta.blob_size);
+  ASSERT_EQ(0, memcmp(data.data(), meta.blob_data, data.size()));
+  ASSERT_EQ(7u, meta.blob_orig_off);
+  ASSERT_EQ("ORDERKEY,LINENUMBER", meta.blob_sort_cols);
+}
+
+TEST_P(Compression, FbMetaIncompressible) {
+  // stored as is when compressing does not make the blob smaller
+  std::string data = random_blob(4096);
+  flatbuffers::FlatBufferBuilder builder(1024);
+  createFbMeta(&builder, SFT_CSV,
+               reinterpret_cast<unsigned char*>(&data[0]), data.size(),
+               false, 0, 0, GetParam());
+  const FB_Meta* stored = GetFB_Meta(builder.GetBufferPointer());
+  ASSERT_EQ(none, stored->blob_compression());
+
+  bufferlist bl;
+  bl.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+            builder.GetSize());
+  sky_meta meta = getSkyMeta(&bl);
+  ASSERT_EQ(0, meta.blob_errcode);
+  ASSERT_EQ(data.size(), meta.blob_size);
+  ASSERT_EQ(0, memcmp(data.data(), meta.blob_data, data.size()));
+}
+
+TEST_P(Compression, FbMetaCorrupt) {
+  // a blob recorded as compressed that does not decompress
+  std::string junk(sizeof(uint64_t), '\0');
+  uint64_t raw_size = 1000;
+  memcpy(&junk[0], &raw_size, sizeof(raw_size));
+  junk += "this is not a compressed blob";
+
+  flatbuffers::FlatBufferBuilder builder(1024);
+  auto data_blob = builder.CreateVector(
+      reinterpret_cast<const unsigned char*>(junk.data()), junk.size());
+  builder.Finish(CreateFB_Meta(builder, SFT_CSV, data_blob, junk.size(),
+                               false, 0, 0, GetParam()));
+
+  bufferlist bl;
+  bl.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+            builder.GetSize());
+  sky_meta meta = getSkyMeta(&bl);
+  ASSERT_EQ(EBLOB_COMPRESSION_FAILURE, meta.blob_errcode);
+  ASSERT_EQ(nullptr, meta.blob_data);
+  ASSERT_EQ(0u, meta.blob_size);
+}
+
+INSTANTIATE_TEST_CASE_P(Codecs, Compression, ::testing::Values(lz4, zstd));
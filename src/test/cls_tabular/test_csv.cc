@@ -0,0 +1,208 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular_utils.h"
+#include "cls/cls_tabular_processing.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 200;
+
+static std::string csv_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_DATE) + " 0 1 SHIPDATE \n" +
+    " 2 " + std::to_string(SDT_STRING) + " 0 1 SHIPMODE \n" +
+    " 3 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE \n" +
+    " 4 " + std::to_string(SDT_INT64) + " 0 1 QUANTITY \n" +
+    " 5 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+static std::string shipdate(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "199%d-%02d-%02d", i % 10, i % 12 + 1, i % 28 + 1);
+  return buf;
+}
+
+static const char *shipmode(int i) {
+  const char *modes[] = {"AIR", "MAIL", "RAIL", "SHIP", "TRUCK"};
+  return modes[i % 5];
+}
+
+// every 4th row ends after SHIPMODE and every 7th row has a NULL price,
+// rows from ORDERKEY 150 on are junk after the key
+static std::string csv_text() {
+  std::string csv;
+  for (int i = 0; i < NROWS; i++) {
+    csv += std::to_string(i) + CSV_DELIM;
+    if (i >= 150) {
+      csv += "not|a|valid||row|at|all|";
+    } else {
+      csv += shipdate(i) + CSV_DELIM + shipmode(i) + CSV_DELIM;
+      if (i % 4 != 0) {
+        csv += (i % 7 == 0 ? std::string("NULL") : std::to_string(i * 1.5));
+        csv += CSV_DELIM + std::to_string(i % 50) + CSV_DELIM;
+        csv += "comment " + std::to_string(i);
+      }
+    }
+    csv += "\n";
+  }
+  return csv;
+}
+
+static std::vector<int64_t> int_col(const std::shared_ptr<arrow::Table>& t,
+                                    const std::string& name) {
+  std::vector<int64_t> vals;
+  auto col = t->GetColumnByName(name);
+  EXPECT_NE(nullptr, col) << name;
+  if (col == nullptr)
+    return vals;
+  for (int c = 0; c < col->num_chunks(); c++) {
+    auto arr = std::static_pointer_cast<arrow::Int32Array>(col->chunk(c));
+    for (int64_t i = 0; i < arr->length(); i++)
+      vals.push_back(arr->IsNull(i) ? -1 : arr->Value(i));
+  }
+  return vals;
+}
+
+class Csv : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      schema = schemaFromString(csv_schema());
+      csv = csv_text();
+    }
+
+    int process(const std::string& cols,
+                const std::string& preds_str,
+                std::shared_ptr<arrow::Table>* out,
+                const std::vector<uint32_t>& row_nums = {}) {
+      schema_vec query_schema = schemaFromColNames(schema, cols);
+      predicate_vec preds = predsFromString(schema, preds_str);
+      std::string no_cols;
+      std::string errmsg;
+      return processCsv(out, schema, query_schema, preds, no_cols, no_cols,
+                        csv.data(), csv.size(), SFT_CSV, errmsg, row_nums);
+    }
+
+    // the ORDERKEYs of the rows that pass, evaluated on whole rows
+    template <typename F>
+    std::vector<int64_t> expected(F pass) {
+      std::vector<int64_t> keys;
+      for (int i = 0; i < NROWS; i++) {
+        if (pass(i))
+          keys.push_back(i);
+      }
+      return keys;
+    }
+
+    schema_vec schema;
+    std::string csv;
+};
+
+TEST_F(Csv, PredicateOnEarlyField) {
+  // the junk and missing fields after ORDERKEY are never converted
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY", ";ORDERKEY,geq,140;", &out));
+  ASSERT_EQ(expected([](int i) { return i >= 140; }),
+            int_col(out, "ORDERKEY"));
+}
+
+TEST_F(Csv, PredicatesAnded) {
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY,PRICE",
+                       ";ORDERKEY,lt,100;QUANTITY,gt,20;", &out));
+  auto keys = expected([](int i) {
+    return i < 100 && i % 4 != 0 && i % 50 > 20;
+  });
+  ASSERT_EQ(keys, int_col(out, "ORDERKEY"));
+
+  // the selected rows convert the query columns, nulls included
+  auto price = out->GetColumnByName("PRICE");
+  ASSERT_NE(nullptr, price);
+  ASSERT_EQ((int64_t)keys.size(), price->length());
+  int64_t nulls = 0;
+  for (auto k : keys)
+    nulls += (k % 7 == 0);
+  ASSERT_EQ(nulls, price->null_count());
+}
+
+TEST_F(Csv, NullsNeverMatch) {
+  // NULL and missing fields are null, empty and junk fields read as 0
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY", ";PRICE,gt,0.0;", &out));
+  ASSERT_EQ(expected([](int i) {
+              return i < 150 && i % 4 != 0 && i % 7 != 0;
+            }),
+            int_col(out, "ORDERKEY"));
+}
+
+TEST_F(Csv, LikeOnString) {
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY", ";SHIPMODE,like,^(AIR|RAIL)$;", &out));
+  ASSERT_EQ(expected([](int i) {
+              return i < 150 && (i % 5 == 0 || i % 5 == 2);
+            }),
+            int_col(out, "ORDERKEY"));
+
+  // partial match, as the regex predicate does on arrow and flatbuffer rows
+  ASSERT_EQ(0, process("ORDERKEY", ";SHIPMODE,like,IR;", &out));
+  ASSERT_EQ(expected([](int i) { return i < 150 && i % 5 == 0; }),
+            int_col(out, "ORDERKEY"));
+}
+
+TEST_F(Csv, DatePredicates) {
+  // dates compare as dates, one is parsed per blob not per row
+  auto after = [](int i) {
+    return i < 150 && shipdate(i) > std::string("1995-06-15");
+  };
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY", ";SHIPDATE,after,1995-06-15;", &out));
+  ASSERT_EQ(expected(after), int_col(out, "ORDERKEY"));
+  ASSERT_EQ(0, process("ORDERKEY", ";SHIPDATE,gt,1995-06-15;", &out));
+  ASSERT_EQ(expected(after), int_col(out, "ORDERKEY"));
+
+  ASSERT_EQ(0, process("ORDERKEY,SHIPDATE",
+                       ";SHIPDATE,before,1992-01-01;ORDERKEY,lt,150;", &out));
+  ASSERT_EQ(expected([](int i) {
+              return i < 150 && shipdate(i) < std::string("1992-01-01");
+            }),
+            int_col(out, "ORDERKEY"));
+}
+
+TEST_F(Csv, RowNums) {
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("ORDERKEY", ";ORDERKEY,gt,2;", &out, {1, 3, 5}));
+  ASSERT_EQ(std::vector<int64_t>({3, 5}), int_col(out, "ORDERKEY"));
+
+  ASSERT_EQ(RowIndexOOB, process("ORDERKEY", "", &out, {NROWS}));
+}
+
+TEST_F(Csv, TransformToArrow) {
+  // all rows and columns, the rid is the line number
+  std::string errmsg;
+  std::shared_ptr<arrow::Table> table;
+  ASSERT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                      schema, errmsg, &table)) << errmsg;
+  ASSERT_EQ(NROWS, table->num_rows());
+  ASSERT_EQ((int)schema.size() + 2, table->num_columns());
+  ASSERT_EQ(expected([](int i) { return true; }), int_col(table, "ORDERKEY"));
+
+  auto rids = std::static_pointer_cast<arrow::Int64Array>(
+      table->GetColumnByName("RID")->chunk(0));
+  for (int i = 0; i < NROWS; i++)
+    ASSERT_EQ(i, rids->Value(i));
+
+  auto metadata = table->schema()->metadata();
+  ASSERT_EQ(std::to_string(NROWS), metadata->value(METADATA_NUM_ROWS));
+}
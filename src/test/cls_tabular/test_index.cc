@@ -0,0 +1,257 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/rados/librados.hpp"
+#include "include/encoding.h"
+#include "test/librados/test_cxx.h"
+#include "test/librados/test.h"
+#include "gtest/gtest.h"
+
+#include "cls/cls_tabular.h"
+#include "cls/sky_tabular_flatflex_writer.h"
+
+using namespace librados;
+using namespace Tables;
+
+static const std::string TABLE = "lineitem";
+static const int ROWS_PER_FB = 50;
+
+static std::string index_schema_str() {
+  return
+    " 0 " + std::to_string(SDT_INT64) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER \n" +
+    " 2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+// the fields of a row, as the loader parses them
+static std::vector<std::string> row_fields(uint64_t rid) {
+  return {std::to_string(rid / 4 + 1), std::to_string(rid % 4 + 1),
+          "comment " + std::to_string(rid)};
+}
+
+/*
+ * A FLEX_ROW flatbuffer of ROWS_PER_FB rows from first_rid, wrapped in an
+ * encoded bl as objects hold them.
+ */
+static bufferlist make_fb(const schema_vec& schema, uint64_t first_rid) {
+  flatbuffers::FlatBufferBuilder fbb(1024);
+  std::vector<flatbuffers::Offset<Tables::Record>> recs;
+  std::vector<uint8_t> delete_vec;
+  for (int i = 0; i < ROWS_PER_FB; i++) {
+    std::vector<std::string> f = row_fields(first_rid + i);
+    flexbuffers::Builder flx;
+    flx.Vector([&]() {
+      for (auto& col : schema) {
+        switch (col.type) {
+          case SDT_INT64:
+            flx.Add(static_cast<int64_t>(std::stoll(f[col.idx])));
+            break;
+          case SDT_INT32:
+            flx.Add(static_cast<int32_t>(std::stoi(f[col.idx])));
+            break;
+          default:
+            flx.Add(f[col.idx].c_str());
+            break;
+        }
+      }
+    });
+    flx.Finish();
+    std::vector<uint64_t> nullbits(2, 0);
+    recs.push_back(CreateRecord(fbb, first_rid + i,
+                                fbb.CreateVector(nullbits),
+                                fbb.CreateVector(flx.GetBuffer())));
+    delete_vec.push_back(0);
+  }
+  auto root = CreateTable(fbb, SFT_FLATBUF_FLEX_ROW, 2, 0, 0,
+                          fbb.CreateString(index_schema_str()),
+                          fbb.CreateString("*"),
+                          fbb.CreateString(TABLE),
+                          fbb.CreateVector(delete_vec),
+                          fbb.CreateVector(recs),
+                          ROWS_PER_FB);
+  fbb.Finish(root);
+
+  bufferlist fb;
+  fb.append(reinterpret_cast<const char*>(fbb.GetBufferPointer()),
+            fbb.GetSize());
+  bufferlist wrapped;
+  using ceph::encode;
+  encode(fb, wrapped);
+  return wrapped;
+}
+
+class SkyhookIndex : public ::testing::Test {
+  protected:
+    static void SetUpTestCase() {
+      pool_name = get_temp_pool_name();
+      ASSERT_EQ("", create_one_pool_pp(pool_name, rados));
+      ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+    }
+
+    static void TearDownTestCase() {
+      ioctx.close();
+      ASSERT_EQ(0, destroy_one_pool_pp(pool_name, rados));
+    }
+
+    virtual void SetUp() {
+      schema = schemaFromString(index_schema_str());
+    }
+
+    /*
+     * Loads nfbs flatbuffers into two objects: into append_oid with
+     * append_with_index_op and the entries the loader builds for idx_type,
+     * and into build_oid as plain data indexed by exec_build_sky_index_op.
+     * Both objects are rewritten from the first flatbuffer on.
+     */
+    void load(const std::string& append_oid,
+              const std::string& build_oid,
+              int idx_type,
+              const std::string& idx_colnames,
+              bool unique,
+              int nfbs) {
+      schema_vec idx_cols;
+      std::string prefix;
+      if (idx_type == SIT_IDX_RID) {
+        prefix = buildKeyPrefix(SIT_IDX_RID, "*", TABLE, {RID_INDEX});
+      } else {
+        idx_cols = schemaFromColNames(schema, idx_colnames);
+        std::vector<std::string> names;
+        for (auto& c : idx_cols)
+          names.push_back(c.name);
+        prefix = buildKeyPrefix(SIT_IDX_REC, "*", TABLE, names);
+      }
+
+      for (int n = 0; n < nfbs; n++) {
+        uint64_t first_rid = n * ROWS_PER_FB;
+        bufferlist data = make_fb(schema, first_rid);
+
+        idx_append_op op("*", TABLE, n == 0, 7);
+        op.data = data;
+        op.idx_prefixes.push_back(prefix);
+        for (int i = 0; i < ROWS_PER_FB; i++) {
+          uint64_t rid = first_rid + i;
+          std::string key;
+          if (idx_type == SIT_IDX_RID) {
+            key = prefix + u64tostr(rid);
+          } else {
+            std::vector<std::string> f = row_fields(rid);
+            std::vector<std::string_view> parsed(f.begin(), f.end());
+            std::string key_data;
+            indexKeyData(idx_cols, parsed, key_data);
+            key = indexRecKey(prefix, key_data, unique, rid);
+          }
+          op.rec_entries[key] = idx_rec_entry(0, i, rid);
+        }
+        bufferlist inbl, outbl;
+        using ceph::encode;
+        encode(op, inbl);
+        ASSERT_EQ(0, ioctx.exec(append_oid, "tabular",
+                                "append_with_index_op", inbl, outbl));
+
+        // the index of the old data goes with the object
+        if (n == 0) {
+          int ret = ioctx.remove(build_oid);
+          ASSERT_TRUE(ret == 0 || ret == -ENOENT);
+          ASSERT_EQ(0, ioctx.write_full(build_oid, data));
+        } else {
+          ASSERT_EQ(0, ioctx.append(build_oid, data, data.length()));
+        }
+      }
+
+      idx_op op(unique, false, 7, idx_type,
+                idx_cols.empty() ? index_schema_str() :
+                                   schemaToString(idx_cols), "");
+      bufferlist inbl, outbl;
+      using ceph::encode;
+      encode(op, inbl);
+      ASSERT_EQ(0, ioctx.exec(build_oid, "tabular", "exec_build_sky_index_op",
+                              inbl, outbl));
+    }
+
+    void assert_same(const std::string& oid1, const std::string& oid2) {
+      bufferlist data1, data2;
+      ASSERT_LT(0, ioctx.read(oid1, data1, 0, 0));
+      ASSERT_LT(0, ioctx.read(oid2, data2, 0, 0));
+      ASSERT_TRUE(data1.contents_equal(data2));
+
+      std::map<std::string, bufferlist> vals1, vals2;
+      ASSERT_EQ(0, ioctx.omap_get_vals(oid1, "", 100000, &vals1));
+      ASSERT_EQ(0, ioctx.omap_get_vals(oid2, "", 100000, &vals2));
+      ASSERT_FALSE(vals1.empty());
+      ASSERT_EQ(vals2.size(), vals1.size());
+      for (auto it1 = vals1.begin(), it2 = vals2.begin();
+           it1 != vals1.end(); ++it1, ++it2) {
+        ASSERT_EQ(it2->first, it1->first);
+        ASSERT_TRUE(it1->second.contents_equal(it2->second)) << it1->first;
+      }
+
+      bufferlist seq1, seq2;
+      ASSERT_LT(0, ioctx.getxattr(oid1, "fb_seq_num", seq1));
+      ASSERT_LT(0, ioctx.getxattr(oid2, "fb_seq_num", seq2));
+      ASSERT_TRUE(seq1.contents_equal(seq2));
+    }
+
+    // number of omap keys of oid starting with prefix
+    size_t count_keys(const std::string& oid, const std::string& prefix) {
+      std::map<std::string, bufferlist> vals;
+      EXPECT_EQ(0, ioctx.omap_get_vals(oid, "", prefix, 100000, &vals));
+      return vals.size();
+    }
+
+    schema_vec schema;
+
+    static Rados rados;
+    static IoCtx ioctx;
+    static std::string pool_name;
+};
+
+Rados SkyhookIndex::rados;
+IoCtx SkyhookIndex::ioctx;
+std::string SkyhookIndex::pool_name;
+
+TEST_F(SkyhookIndex, RidIndexMatchesBuild) {
+  load("rid.append", "rid.build", SIT_IDX_RID, "", true, 3);
+  assert_same("rid.append", "rid.build");
+
+  // one IDX_FB entry per fb, one IDX_RID entry per row, plus the marker
+  ASSERT_EQ(3u, count_keys("rid.append",
+                           buildKeyPrefix(SIT_IDX_FB, "*", TABLE)));
+  ASSERT_EQ(3u * ROWS_PER_FB + 1,
+            count_keys("rid.append",
+                       buildKeyPrefix(SIT_IDX_RID, "*", TABLE, {RID_INDEX})));
+}
+
+TEST_F(SkyhookIndex, RecIndexMatchesBuild) {
+  load("rec.append", "rec.build", SIT_IDX_REC, "ORDERKEY,LINENUMBER", true, 3);
+  assert_same("rec.append", "rec.build");
+}
+
+TEST_F(SkyhookIndex, RecIndexNotUniqueMatchesBuild) {
+  // an ORDERKEY has several rows, the rid keeps their keys apart
+  load("recnu.append", "recnu.build", SIT_IDX_REC, "ORDERKEY", false, 2);
+  assert_same("recnu.append", "recnu.build");
+  ASSERT_EQ(2u * ROWS_PER_FB + 1,
+            count_keys("recnu.append",
+                       buildKeyPrefix(SIT_IDX_REC, "*", TABLE, {"ORDERKEY"})));
+}
+
+TEST_F(SkyhookIndex, OverwriteClearsIndex) {
+  load("ow.append", "ow.build", SIT_IDX_RID, "", true, 3);
+
+  // rewriting the object drops the entries of the data it replaced
+  load("ow.append", "ow.build", SIT_IDX_RID, "", true, 1);
+  assert_same("ow.append", "ow.build");
+}
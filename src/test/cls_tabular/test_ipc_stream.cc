@@ -0,0 +1,201 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static bool deleted(int64_t rid) { return rid % 5 == 3; }
+
+/*
+ * An object result of nrows rows from first_rid: KEY, NAME, then RID and
+ * DELETED_VECTOR, every 5th row deleted. swap puts NAME first.
+ */
+static std::shared_ptr<arrow::Buffer> make_result(int64_t first_rid,
+                                                  int64_t nrows,
+                                                  bool swap = false) {
+  arrow::Int64Builder key_b, rid_b;
+  arrow::StringBuilder name_b;
+  arrow::BooleanBuilder del_b;
+  for (int64_t rid = first_rid; rid < first_rid + nrows; rid++) {
+    EXPECT_TRUE(key_b.Append(rid * 10).ok());
+    EXPECT_TRUE(name_b.Append("name " + std::to_string(rid)).ok());
+    EXPECT_TRUE(rid_b.Append(rid).ok());
+    EXPECT_TRUE(del_b.Append(deleted(rid)).ok());
+  }
+  std::shared_ptr<arrow::Array> key, name, rid, del;
+  EXPECT_TRUE(key_b.Finish(&key).ok());
+  EXPECT_TRUE(name_b.Finish(&name).ok());
+  EXPECT_TRUE(rid_b.Finish(&rid).ok());
+  EXPECT_TRUE(del_b.Finish(&del).ok());
+
+  std::shared_ptr<arrow::KeyValueMetadata> metadata(new arrow::KeyValueMetadata);
+  metadata->Append(ToString(METADATA_NUM_ROWS), std::to_string(nrows));
+  std::vector<std::shared_ptr<arrow::Field>> fields = {
+    arrow::field("KEY", arrow::int64()),
+    arrow::field("NAME", arrow::utf8())};
+  std::vector<std::shared_ptr<arrow::Array>> arrays = {key, name};
+  if (swap) {
+    std::swap(fields[0], fields[1]);
+    std::swap(arrays[0], arrays[1]);
+  }
+  fields.push_back(arrow::field("RID", arrow::int64()));
+  fields.push_back(arrow::field("DELETED_VECTOR", arrow::boolean()));
+  arrays.push_back(rid);
+  arrays.push_back(del);
+  auto table = arrow::Table::Make(
+      std::make_shared<arrow::Schema>(fields, metadata), arrays);
+
+  std::shared_ptr<arrow::Buffer> buffer;
+  EXPECT_EQ(0, convert_arrow_to_buffer(table, &buffer));
+  return buffer;
+}
+
+// appends the rows of a result to out, as run-query writes them
+static long long int append(std::shared_ptr<arrow::Buffer> buffer,
+                            bool header, long long int max,
+                            arrow_ipc_stream& stream, std::string& out) {
+  return printArrowbufAsIpcStream(
+      reinterpret_cast<const char*>(buffer->data()), buffer->size(),
+      header, false, max, stream, out);
+}
+
+// reads a whole stream back as a reader would, KEYs in order
+static std::shared_ptr<arrow::Schema> read_stream(const std::string& data,
+                                                  std::vector<int64_t>& keys) {
+  auto buffer = std::make_shared<arrow::Buffer>(
+      reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  auto input = std::make_shared<arrow::io::BufferReader>(buffer);
+  auto result = arrow::ipc::RecordBatchStreamReader::Open(input);
+  EXPECT_TRUE(result.ok());
+  if (!result.ok())
+    return nullptr;
+  auto reader = result.ValueOrDie();
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    EXPECT_TRUE(reader->ReadNext(&batch).ok());
+    if (batch == nullptr)
+      break;
+    auto key = std::static_pointer_cast<arrow::Int64Array>(
+        batch->GetColumnByName("KEY"));
+    auto name = std::static_pointer_cast<arrow::StringArray>(
+        batch->GetColumnByName("NAME"));
+    for (int64_t i = 0; i < batch->num_rows(); i++) {
+      keys.push_back(key->Value(i));
+      EXPECT_EQ("name " + std::to_string(key->Value(i) / 10),
+                name->GetString(i));
+    }
+  }
+  return reader->schema();
+}
+
+// the KEYs of the rows not deleted in [first_rid, first_rid + nrows)
+static void live_keys(int64_t first_rid, int64_t nrows,
+                      std::vector<int64_t>& keys) {
+  for (int64_t rid = first_rid; rid < first_rid + nrows; rid++) {
+    if (!deleted(rid))
+      keys.push_back(rid * 10);
+  }
+}
+
+TEST(ArrowIpcStream, Results) {
+  arrow_ipc_stream stream;
+  std::string out;
+  auto r1 = make_result(0, 100);
+  auto r2 = make_result(100, 50);
+  ASSERT_EQ(0, append(r1, true, 1000, stream, out));
+  ASSERT_EQ(80, append(r1, false, 1000, stream, out));
+  ASSERT_EQ(40, append(r2, false, 1000, stream, out));
+  out.append(ARROW_IPC_STREAM_EOS);
+
+  // the internal columns and the object metadata are not streamed
+  std::vector<int64_t> keys, expected;
+  auto schema = read_stream(out, keys);
+  ASSERT_TRUE(schema);
+  ASSERT_EQ(2, schema->num_fields());
+  ASSERT_EQ("KEY", schema->field(0)->name());
+  ASSERT_EQ("NAME", schema->field(1)->name());
+  ASSERT_FALSE(schema->metadata() && schema->metadata()->size() > 0);
+  live_keys(0, 150, expected);
+  ASSERT_EQ(expected, keys);
+}
+
+TEST(ArrowIpcStream, ColumnOrder) {
+  // a result whose columns are in another order is projected to the
+  // schema of the first one
+  arrow_ipc_stream stream;
+  std::string out;
+  auto r1 = make_result(0, 20);
+  auto r2 = make_result(20, 20, true);
+  ASSERT_EQ(0, append(r1, true, 1000, stream, out));
+  ASSERT_EQ(16, append(r1, false, 1000, stream, out));
+  ASSERT_EQ(16, append(r2, false, 1000, stream, out));
+  out.append(ARROW_IPC_STREAM_EOS);
+
+  std::vector<int64_t> keys, expected;
+  auto schema = read_stream(out, keys);
+  ASSERT_TRUE(schema);
+  ASSERT_EQ("KEY", schema->field(0)->name());
+  live_keys(0, 40, expected);
+  ASSERT_EQ(expected, keys);
+}
+
+TEST(ArrowIpcStream, RowLimit) {
+  arrow_ipc_stream stream;
+  std::string out;
+  auto r1 = make_result(0, 100);
+  ASSERT_EQ(0, append(r1, true, 1000, stream, out));
+  ASSERT_EQ(10, append(r1, false, 10, stream, out));
+  out.append(ARROW_IPC_STREAM_EOS);
+
+  std::vector<int64_t> keys, expected;
+  ASSERT_TRUE(read_stream(out, keys));
+  live_keys(0, 12, expected);
+  ASSERT_EQ(expected, keys);
+}
+
+TEST(ArrowIpcStream, Mismatch) {
+  arrow_ipc_stream stream;
+  std::string out;
+  ASSERT_EQ(0, append(make_result(0, 10), true, 1000, stream, out));
+
+  // a result without the stream columns is an error
+  std::shared_ptr<arrow::Schema> other = arrow::schema(
+      {arrow::field("KEY", arrow::utf8()), arrow::field("NAME", arrow::utf8())});
+  {
+    std::lock_guard<std::mutex> l(stream.lock);
+    stream.schema = other;
+  }
+  ASSERT_GT(0, append(make_result(0, 10), false, 1000, stream, out));
+}
+
+TEST(ArrowIpcStream, NoResults) {
+  // with no rows at all the stream still opens, with the query schema
+  arrow_ipc_stream stream;
+  schema_vec query_schema = schemaFromString(
+      " 0 " + std::to_string(SDT_INT64) + " 1 0 KEY \n" +
+      " 1 " + std::to_string(SDT_STRING) + " 0 1 NAME \n");
+  std::string out;
+  ASSERT_EQ(0, printArrowIpcStreamSchema(stream, query_schema, out));
+  out.append(ARROW_IPC_STREAM_EOS);
+
+  std::vector<int64_t> keys;
+  auto schema = read_stream(out, keys);
+  ASSERT_TRUE(schema);
+  ASSERT_EQ(2, schema->num_fields());
+  ASSERT_TRUE(schema->field(0)->type()->Equals(arrow::int64()));
+  ASSERT_TRUE(schema->field(1)->type()->Equals(arrow::utf8()));
+  ASSERT_TRUE(keys.empty());
+}
@@ -0,0 +1,126 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "cls/cls_tabular_processing.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 400;
+static const int ROW_GROUP_ROWS = 64;
+
+static const char* modes[] = {"REG AIR", "AIR", "RAIL", "SHIP", "TRUCK",
+                              "MAIL", "FOB"};
+
+static std::string parquet_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_STRING) + " 0 1 SHIPMODE \n" +
+    " 2 " + std::to_string(SDT_DATE) + " 0 1 SHIPDATE \n" +
+    " 3 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+static std::string shipmode(int i) { return modes[i % 7]; }
+
+static std::string shipdate(int i) {
+  char d[11];
+  snprintf(d, sizeof(d), "1995-%02d-%02d", (i / 28) % 12 + 1, i % 28 + 1);
+  return d;
+}
+
+class ProcessParquet : public ::testing::Test {
+  protected:
+    // NROWS rows in several row groups, each with its own dictionaries
+    virtual void SetUp() {
+      schema = schemaFromString(parquet_schema());
+      std::string csv;
+      for (int i = 0; i < NROWS; i++) {
+        csv += std::to_string(i) + CSV_DELIM + shipmode(i) + CSV_DELIM +
+               shipdate(i) + CSV_DELIM + "comment " + std::to_string(i) + "\n";
+      }
+      std::string errmsg;
+      std::shared_ptr<arrow::Table> table;
+      ASSERT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                          schema, errmsg, &table)) << errmsg;
+      ASSERT_EQ(0, convert_arrow_to_parquet_buffer(table, ROW_GROUP_ROWS,
+                                                   &buffer));
+    }
+
+    // the ORDERKEYs of the rows matching preds, from the parquet blob
+    std::vector<int> query(const std::string& preds_str,
+                           const std::string& cols = "ORDERKEY") {
+      schema_vec query_schema = schemaFromColNames(schema, cols);
+      predicate_vec preds = predsFromString(schema, preds_str);
+      std::string groupby, orderby, errmsg;
+      std::shared_ptr<arrow::Table> result;
+      EXPECT_EQ(0, processParquet(&result, schema, query_schema, preds,
+                                  groupby, orderby,
+                                  reinterpret_cast<const char*>(buffer->data()),
+                                  buffer->size(), errmsg)) << errmsg;
+      std::vector<int> keys;
+      if (!result)
+        return keys;
+      EXPECT_EQ(std::to_string(result->num_rows()),
+                result->schema()->metadata()->value(METADATA_NUM_ROWS));
+      auto col = result->GetColumnByName("ORDERKEY");
+      for (int c = 0; c < col->num_chunks(); c++) {
+        auto a = std::static_pointer_cast<arrow::Int32Array>(col->chunk(c));
+        for (int64_t i = 0; i < a->length(); i++)
+          keys.push_back(a->Value(i));
+      }
+      return keys;
+    }
+
+    template <typename F>
+    std::vector<int> expected(F match) {
+      std::vector<int> keys;
+      for (int i = 0; i < NROWS; i++) {
+        if (match(i))
+          keys.push_back(i);
+      }
+      return keys;
+    }
+
+    schema_vec schema;
+    std::shared_ptr<arrow::Buffer> buffer;
+};
+
+TEST_F(ProcessParquet, StringLike) {
+  // the column is only read for the predicate
+  auto keys = query(";shipmode,like,AIR;");
+  ASSERT_FALSE(keys.empty());
+  ASSERT_EQ(expected([](int i) {
+              return shipmode(i).find("AIR") != std::string::npos; }), keys);
+
+  keys = query(";shipmode,like,^R;", "ORDERKEY,SHIPMODE");
+  ASSERT_EQ(expected([](int i) { return shipmode(i)[0] == 'R'; }), keys);
+
+  ASSERT_TRUE(query(";shipmode,like,BOAT;").empty());
+}
+
+TEST_F(ProcessParquet, DateCompare) {
+  auto keys = query(";shipdate,lt,1995-03-01;");
+  ASSERT_EQ(expected([](int i) { return shipdate(i) < "1995-03-01"; }), keys);
+
+  keys = query(";shipdate,eq,1995-02-14;", "ORDERKEY,SHIPDATE");
+  ASSERT_EQ(expected([](int i) { return shipdate(i) == "1995-02-14"; }), keys);
+}
+
+TEST_F(ProcessParquet, DictAndOtherPreds) {
+  // a dictionary predicate and an integer predicate on the same rows
+  auto keys = query(";shipmode,like,TRUCK;orderkey,geq,200;");
+  ASSERT_EQ(expected([](int i) {
+              return shipmode(i) == "TRUCK" && i >= 200; }), keys);
+}
@@ -0,0 +1,232 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cls/sky_tabular_flatflex_writer.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+// ORDERKEY|LINENUMBER|SUPPKEY|PRICE|SHIPMODE
+static schema_vec test_schema(bool three_keys = false) {
+  return schemaFromString(
+    " 0 " + std::to_string(SDT_INT64) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER \n" +
+    " 2 " + std::to_string(SDT_UINT32) + (three_keys ? " 1" : " 0") +
+                                         " 0 SUPPKEY \n" +
+    " 3 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE \n" +
+    " 4 " + std::to_string(SDT_STRING) + " 0 1 SHIPMODE \n");
+}
+
+static std::vector<int> key_indexes(const schema_vec& schema) {
+  std::vector<int> keys;
+  for (auto& c : schema) {
+    if (c.is_key)
+      keys.push_back(c.idx);
+  }
+  return keys;
+}
+
+static std::unique_ptr<partitioner> make(const std::string& name,
+                                         const schema_vec& schema,
+                                         const std::string& col,
+                                         const std::string& bounds,
+                                         uint64_t num_objs,
+                                         std::string& errmsg) {
+  return std::unique_ptr<partitioner>(makePartitioner(
+      name, schema, key_indexes(schema), col, bounds, num_objs, errmsg));
+}
+
+static std::vector<std::string_view> row(const std::vector<std::string>& f) {
+  return std::vector<std::string_view>(f.begin(), f.end());
+}
+
+TEST(Partitioner, Errors) {
+  schema_vec schema = test_schema();
+  schema_vec nokeys = schemaFromString(
+    " 0 " + std::to_string(SDT_INT64) + " 0 0 ORDERKEY \n");
+  std::string errmsg;
+
+  ASSERT_EQ(nullptr, make("modulo", schema, "", "", 4, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("jump", nokeys, "", "", 4, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("hash", nokeys, "", "", 4, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("range", nokeys, "", "10", 4, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("range", schema, "NOPE", "10", 4, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  // n bounds make n+1 ranges
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("range", schema, "", "10,20,30", 3, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+
+  errmsg.clear();
+  ASSERT_EQ(nullptr, make("range", schema, "", "20,10", 3, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+}
+
+TEST(Partitioner, Jump) {
+  schema_vec schema = test_schema();
+  std::string errmsg;
+  auto part = make("jump", schema, "", "", 10, errmsg);
+  ASSERT_NE(nullptr, part);
+
+  // places the packed key, as hash_partition_arrow_table does
+  std::vector<std::string> f = {"1", "2", "3", "4.5", "AIR"};
+  auto r = row(f);
+  for (uint64_t key = 0; key < 1000; key++) {
+    uint64_t obj = part->partition(r, key, key);
+    ASSERT_EQ(jumpConsistentHash(key, 10), obj);
+    ASSERT_LT(obj, 10u);
+  }
+}
+
+TEST(Partitioner, JumpWideKeyHashes) {
+  schema_vec schema = test_schema(true);
+  std::string errmsg;
+  auto jump = make("jump", schema, "", "", 16, errmsg);
+  auto hash = make("hash", schema, "", "", 16, errmsg);
+  ASSERT_NE(nullptr, jump);
+  ASSERT_NE(nullptr, hash);
+
+  // three key cols do not fit the packed key, so all of them are hashed
+  std::set<uint64_t> objs;
+  for (int i = 0; i < 200; i++) {
+    std::vector<std::string> f = {std::to_string(i), "1",
+                                  std::to_string(i % 7), "0.0", "RAIL"};
+    auto r = row(f);
+    uint64_t obj = jump->partition(r, 0, i);
+    ASSERT_EQ(hash->partition(r, 0, i), obj);
+    objs.insert(obj);
+  }
+  ASSERT_GT(objs.size(), 1u);
+}
+
+TEST(Partitioner, JumpStringKeyHashes) {
+  // a string key col cannot be packed, so the key is hashed
+  schema_vec schema = schemaFromString(
+    " 0 " + std::to_string(SDT_INT64) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_STRING) + " 1 0 SHIPMODE \n");
+  std::string errmsg;
+  auto jump = make("jump", schema, "", "", 16, errmsg);
+  auto hash = make("hash", schema, "", "", 16, errmsg);
+  ASSERT_NE(nullptr, jump);
+  ASSERT_NE(nullptr, hash);
+
+  std::set<uint64_t> objs;
+  for (int i = 0; i < 200; i++) {
+    std::vector<std::string> f = {"1", "MODE" + std::to_string(i)};
+    auto r = row(f);
+    uint64_t obj = jump->partition(r, 1ull << 32, i);
+    ASSERT_EQ(hash->partition(r, 0, i), obj);
+    objs.insert(obj);
+  }
+  ASSERT_GT(objs.size(), 1u);
+}
+
+TEST(Partitioner, HashByValue) {
+  schema_vec schema = test_schema();
+  std::string errmsg;
+  auto part = make("hash", schema, "", "", 8, errmsg);
+  ASSERT_NE(nullptr, part);
+
+  // the packed key and line are not used, the key cols are
+  uint64_t obj = part->partition(row({"7", "3", "x", "y", "z"}), 1, 1);
+  ASSERT_EQ(obj, part->partition(row({"007", "3", "0", "0", "AIR"}), 2, 2));
+  ASSERT_EQ(obj, part->partition(row({" +7", "03", "9", "1", "SHIP"}), 3, 3));
+
+  // rows spread over all the objects
+  std::vector<int> counts(8, 0);
+  for (int i = 0; i < 4000; i++) {
+    uint64_t o = part->partition(row({std::to_string(i), "1"}), 0, i);
+    ASSERT_LT(o, 8u);
+    counts[o]++;
+  }
+  for (int c : counts)
+    ASSERT_GT(c, 0);
+}
+
+TEST(Partitioner, Range) {
+  schema_vec schema = test_schema();
+  std::string errmsg;
+
+  // the first key col by default, values below bound i go to object i
+  auto ints = make("range", schema, "", "10,20", 3, errmsg);
+  ASSERT_NE(nullptr, ints);
+  ASSERT_EQ(0u, ints->partition(row({"-5"}), 0, 0));
+  ASSERT_EQ(0u, ints->partition(row({"9"}), 0, 0));
+  ASSERT_EQ(1u, ints->partition(row({"10"}), 0, 0));
+  ASSERT_EQ(1u, ints->partition(row({"019"}), 0, 0));
+  ASSERT_EQ(2u, ints->partition(row({"20"}), 0, 0));
+  ASSERT_EQ(2u, ints->partition(row({"100000"}), 0, 0));
+
+  // numbers compare as numbers, not as text
+  auto doubles = make("range", schema, "PRICE", "2.5,10", 4, errmsg);
+  ASSERT_NE(nullptr, doubles);
+  ASSERT_EQ(0u, doubles->partition(row({"0", "0", "0", "2.49"}), 0, 0));
+  ASSERT_EQ(1u, doubles->partition(row({"0", "0", "0", "2.5"}), 0, 0));
+  ASSERT_EQ(1u, doubles->partition(row({"0", "0", "0", "9.99"}), 0, 0));
+  ASSERT_EQ(2u, doubles->partition(row({"0", "0", "0", "100"}), 0, 0));
+
+  auto strs = make("range", schema, "SHIPMODE", "G,P", 3, errmsg);
+  ASSERT_NE(nullptr, strs);
+  ASSERT_EQ(0u, strs->partition(row({"0", "0", "0", "0", "AIR"}), 0, 0));
+  ASSERT_EQ(1u, strs->partition(row({"0", "0", "0", "0", "MAIL"}), 0, 0));
+  ASSERT_EQ(2u, strs->partition(row({"0", "0", "0", "0", "TRUCK"}), 0, 0));
+
+  // no bounds, one range
+  auto one = make("range", schema, "", "", 1, errmsg);
+  ASSERT_NE(nullptr, one);
+  ASSERT_EQ(0u, one->partition(row({"123"}), 0, 0));
+}
+
+TEST(Partitioner, RoundRobin) {
+  schema_vec schema = test_schema();
+  std::string errmsg;
+  auto part = make("roundrobin", schema, "", "", 3, errmsg);
+  ASSERT_NE(nullptr, part);
+  std::vector<std::string> f = {"1", "2"};
+  auto r = row(f);
+  for (uint64_t line = 0; line < 10; line++)
+    ASSERT_EQ(line % 3, part->partition(r, 0, line));
+}
+
+TEST(Partitioner, IndexKeys) {
+  schema_vec schema = test_schema();
+  schema_vec cols = schemaFromColNames(schema, "ORDERKEY,LINENUMBER");
+  std::string key_data;
+  std::vector<std::string> f = {"5", "NULL", "1"};
+  indexKeyData(cols, row(f), key_data);
+  ASSERT_EQ(buildKeyData(SDT_INT64, 5) + IDX_KEY_DELIM_INNER +
+            buildKeyData(SDT_INT32, 0), key_data);
+
+  std::string prefix = buildKeyPrefix(SIT_IDX_REC, "*", "lineitem",
+                                      {"ORDERKEY", "LINENUMBER"});
+  ASSERT_EQ(prefix + key_data, indexRecKey(prefix, key_data, true, 9));
+  ASSERT_EQ(prefix + key_data + IDX_KEY_DELIM_OUTER + IDX_KEY_DELIM_UNIQUE +
+            IDX_KEY_DELIM_INNER + "9",
+            indexRecKey(prefix, key_data, false, 9));
+}
@@ -0,0 +1,425 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "query/query.h"
+#include "gtest/gtest.h"
+
+// count completions of latency lat_ns, of which eval_ns spent in the cls
+static void complete(QdepthController& ctl, int count, uint64_t lat_ns,
+                     uint64_t eval_ns = 0) {
+  for (int i = 0; i < count; i++) {
+    timing t = {};
+    t.dispatch = 1000;
+    t.response = t.dispatch + lat_ns;
+    t.eval_ns = eval_ns;
+    ctl.on_complete(t);
+  }
+}
+
+TEST(QdepthController, Fixed) {
+  QdepthController ctl;
+  ctl.init(8, 8);
+  ASSERT_EQ(8, ctl.get());
+  complete(ctl, 100, 1000000);
+  complete(ctl, 100, 100000000);
+  ASSERT_EQ(8, ctl.get());
+
+  // a max below the start does not lower the depth either
+  ctl.init(8, 2);
+  complete(ctl, 100, 1000000);
+  ASSERT_EQ(8, ctl.get());
+}
+
+TEST(QdepthController, GrowsToMax) {
+  QdepthController ctl;
+  ctl.init(1, 16);
+  ASSERT_EQ(1, ctl.get());
+
+  // steady latency: one more per window, never past max
+  complete(ctl, 4, 1000000);
+  ASSERT_EQ(2, ctl.get());
+  complete(ctl, 1000, 1000000);
+  ASSERT_EQ(16, ctl.get());
+}
+
+TEST(QdepthController, ShrinksWhenQueueing) {
+  QdepthController ctl;
+  ctl.init(1, 16);
+  // the windows of depths 1 to 15, up to 16 with none left over
+  complete(ctl, 126, 1000000);
+  ASSERT_EQ(16, ctl.get());
+
+  // a window well above the base latency cuts a quarter of the depth
+  complete(ctl, 16, 5000000);
+  ASSERT_EQ(12, ctl.get());
+  complete(ctl, 12, 5000000);
+  ASSERT_EQ(9, ctl.get());
+
+  // it keeps shrinking while the latency stays high, down to 1
+  complete(ctl, 60, 50000000);
+  ASSERT_EQ(1, ctl.get());
+}
+
+TEST(QdepthController, HoldsBetweenFactors) {
+  QdepthController ctl;
+  ctl.init(1, 16);
+  complete(ctl, 4, 1000000);
+  ASSERT_EQ(2, ctl.get());
+
+  // between 1.5 and 2 times the base the depth is held
+  complete(ctl, 40, 1800000);
+  ASSERT_EQ(2, ctl.get());
+}
+
+TEST(QdepthController, IgnoresEvalTime) {
+  QdepthController ctl;
+  ctl.init(1, 16);
+  complete(ctl, 4, 1000000);
+  ASSERT_EQ(2, ctl.get());
+
+  // objects that take longer to process on the osd are not load
+  complete(ctl, 4, 21000000, 20000000);
+  ASSERT_EQ(3, ctl.get());
+}
+
+// everything an OutputWriter session writes to stdout
+template <typename F>
+static std::string captured_output(F session) {
+  testing::internal::CaptureStdout();
+  session();
+  return testing::internal::GetCapturedStdout();
+}
+
+static void submit(OutputWriter& w, uint64_t seq, const std::string& s) {
+  std::string data = s;
+  w.submit(seq, data);
+}
+
+TEST(OutputWriter, Ordered) {
+  OutputWriter w;
+  ASSERT_EQ("a\nb\nc\nd\n", captured_output([&]() {
+    w.start(true, false);
+    submit(w, 2, "c\n");
+    submit(w, 0, "a\n");
+    submit(w, 3, "d\n");
+    submit(w, 1, "b\n");
+    w.finish();
+  }));
+  ASSERT_FALSE(w.running());
+}
+
+TEST(OutputWriter, OrderedSkipsMissing) {
+  // objects that never reported do not hold back the rest at the end
+  OutputWriter w;
+  ASSERT_EQ("a\nc\n", captured_output([&]() {
+    w.start(true, false);
+    submit(w, 2, "c\n");
+    submit(w, 0, "a\n");
+    w.finish();
+  }));
+}
+
+TEST(OutputWriter, HeaderFirst) {
+  OutputWriter w;
+  ASSERT_EQ("hdr\nrow1\nrow2\n", captured_output([&]() {
+    w.start(false, true);
+    submit(w, 0, "row1\n");
+    std::string header = "hdr\n";
+    w.submit_header(header);
+    submit(w, 1, "row2\n");
+    w.finish();
+  }));
+}
+
+TEST(OutputWriter, NotStarted) {
+  OutputWriter w;
+  ASSERT_EQ("b\na\n", captured_output([&]() {
+    submit(w, 1, "b\n");
+    submit(w, 0, "a\n");
+  }));
+  ASSERT_TRUE(w.wait_for_space(1));
+}
+
+TEST(OutputWriter, BoundedPending) {
+  // output held back for an earlier object blocks the dispatcher, but not
+  // the workers, until that object is written
+  int saved = dup(1);
+  int null = open("/dev/null", O_WRONLY);
+  ASSERT_LE(0, saved);
+  ASSERT_LE(0, null);
+  fflush(stdout);
+  dup2(null, 1);
+
+  OutputWriter w;
+  w.start(true, false);
+  ASSERT_TRUE(w.wait_for_space(1000000));
+  submit(w, 1, std::string(256 << 20, 'x'));
+  bool full = w.wait_for_space(10000000);
+  submit(w, 2, "y\n");
+  submit(w, 0, "x\n");
+  bool drained = w.wait_for_space(0);
+  w.finish();
+
+  fflush(stdout);
+  dup2(saved, 1);
+  close(saved);
+  close(null);
+  ASSERT_FALSE(full);
+  ASSERT_TRUE(drained);
+}
+
+// an OsdDispatch of the given queues, as init lays them out
+static void dispatch_queues(OsdDispatch& d,
+                            const std::vector<std::deque<std::string>>& queues,
+                            int max_per_osd) {
+  d.max_per_osd = max_per_osd;
+  d.next = 0;
+  d.remaining = 0;
+  d.osds.clear();
+  d.queues = queues;
+  d.outstanding.reset(new std::atomic<int>[queues.size()]);
+  for (size_t i = 0; i < queues.size(); i++) {
+    d.osds.push_back(i);
+    d.outstanding[i] = 0;
+    d.remaining += queues[i].size();
+  }
+}
+
+TEST(OsdDispatch, RoundRobin) {
+  OsdDispatch d;
+  dispatch_queues(d, {{"a0", "a1", "a2"}, {"b0"}, {"c0", "c1"}}, 0);
+  std::vector<std::string> order;
+  std::string oid;
+  int slot;
+  while (d.next_object(oid, slot)) {
+    ASSERT_EQ(oid[0] - 'a', slot);
+    order.push_back(oid);
+  }
+  ASSERT_TRUE(d.empty());
+  ASSERT_EQ(std::vector<std::string>({"a0", "b0", "c0", "a1", "c1", "a2"}),
+            order);
+}
+
+TEST(OsdDispatch, PerOsdCap) {
+  OsdDispatch d;
+  dispatch_queues(d, {{"a0", "a1", "a2"}, {"b0", "b1"}}, 1);
+  std::string oid;
+  int slot;
+  ASSERT_TRUE(d.next_object(oid, slot));
+  ASSERT_EQ("a0", oid);
+  ASSERT_TRUE(d.next_object(oid, slot));
+  ASSERT_EQ("b0", oid);
+
+  // both osds are at the cap until one of their ios completes
+  ASSERT_FALSE(d.next_object(oid, slot));
+  d.io_done(1);
+  ASSERT_TRUE(d.next_object(oid, slot));
+  ASSERT_EQ("b1", oid);
+  ASSERT_FALSE(d.next_object(oid, slot));
+  d.io_done(0);
+  d.io_done(-1);
+  ASSERT_TRUE(d.next_object(oid, slot));
+  ASSERT_EQ("a1", oid);
+  ASSERT_FALSE(d.empty());
+}
+
+// a completed object of latency lat_ns, dispatched once
+static AioState* completed_io(uint64_t seq, uint64_t lat_ns) {
+  AioState *s = new AioState;
+  memset(&s->times, 0, sizeof(s->times));
+  s->seq = seq;
+  s->oid = "obj." + std::to_string(seq);
+  s->times.dispatch = 1000;
+  s->times.response = s->times.dispatch + lat_ns;
+  return s;
+}
+
+static void record(HedgeController& h, uint64_t seq, uint64_t lat_ns) {
+  AioState *s = completed_io(seq, lat_ns);
+  h.record(s);
+  delete s;
+}
+
+TEST(HedgeController, Threshold) {
+  HedgeController h;
+  ASSERT_EQ(0, h.init(NULL, 90, false, ""));
+  ASSERT_TRUE(h.enabled());
+
+  // no hedging until there are enough samples
+  for (int i = 1; i < 20; i++)
+    record(h, i, i * 1000000);
+  ASSERT_EQ(0u, h.threshold_ns());
+  record(h, 20, 20 * 1000000);
+  ASSERT_EQ(19u * 1000000, h.threshold_ns());
+
+  // only the recent latencies count
+  for (int i = 0; i < 2000; i++)
+    record(h, 100 + i, 5000000);
+  ASSERT_EQ(5000000u, h.threshold_ns());
+
+  HedgeController off;
+  ASSERT_EQ(0, off.init(NULL, 0, false, ""));
+  ASSERT_FALSE(off.enabled());
+}
+
+TEST(HedgeController, Log) {
+  std::string path = testing::TempDir() + "hedge_log.csv";
+  HedgeController h;
+  ASSERT_EQ(0, h.init(NULL, 0, false, path));
+
+  // the latency is from the first dispatch of the object
+  AioState *s = completed_io(7, 3000);
+  s->obj_dispatch = 500;
+  s->times.read_ns = 10;
+  s->times.eval_ns = 20;
+  s->hedged = true;
+  s->hedge = true;
+  h.record(s);
+  delete s;
+  h.finish();
+
+  FILE *f = fopen(path.c_str(), "r");
+  ASSERT_TRUE(f != NULL);
+  char buf[256];
+  std::string log;
+  while (fgets(buf, sizeof(buf), f))
+    log += buf;
+  fclose(f);
+  unlink(path.c_str());
+  ASSERT_EQ("oid,seq,latency_ns,read_ns,eval_ns,hedged,hedge_won\n"
+            "obj.7,7,3500,10,20,1,1\n", log);
+}
+
+TEST(HedgeController, TakeResponse) {
+  HedgeController h;
+  ASSERT_EQ(0, h.init(NULL, 90, false, ""));
+
+  // a request that was never hedged: its response is used
+  ObjRequest *req = new ObjRequest;
+  AioState *s = completed_io(1, 1000);
+  s->req = req;
+  req->ios[0] = s;
+  h.track(req, s->seq);
+  ASSERT_TRUE(h.take_response(s));
+  ASSERT_TRUE(s->req == NULL);
+  ASSERT_FALSE(s->hedged);
+  ASSERT_TRUE(h.inflight.empty());
+  delete s;
+
+  // the second response of a hedged request is dropped and freed
+  req = new ObjRequest;
+  req->hedged = true;
+  req->done = true;
+  s = completed_io(2, 1000);
+  s->c = librados::Rados::aio_create_completion();
+  s->req = req;
+  s->hedge = true;
+  req->ios[1] = s;
+  ASSERT_FALSE(h.take_response(s));
+  ASSERT_EQ(0u, h.won.load());
+}
+
+// a worker giving back an io slot, as the query workers do
+static void release_slot() {
+  outstanding_ios--;
+  std::lock_guard<std::mutex> l(dispatch_lock);
+  dispatch_cond.notify_one();
+}
+
+TEST(WaitIoSlot, Free) {
+  outstanding_ios = 1;
+  uint64_t start = getns();
+  wait_io_slot(2, 0);
+  ASSERT_LT(getns() - start, 100000000u);
+  outstanding_ios = 0;
+}
+
+TEST(WaitIoSlot, Timeout) {
+  outstanding_ios = 2;
+  uint64_t start = getns();
+  wait_io_slot(2, 20000000);
+  ASSERT_GE(getns() - start, 20000000u);
+  ASSERT_EQ(2, outstanding_ios);
+  outstanding_ios = 0;
+}
+
+TEST(WaitIoSlot, WokenByCompletion) {
+  // the dispatcher continues as soon as a slot is free, not on a poll
+  outstanding_ios = 2;
+  std::thread worker([]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release_slot();
+  });
+  uint64_t start = getns();
+  wait_io_slot(2, 0);
+  uint64_t waited = getns() - start;
+  worker.join();
+  ASSERT_EQ(1, outstanding_ios);
+  ASSERT_LT(waited, 500000000u);
+  outstanding_ios = 0;
+}
+
+class ClientPlanTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      using namespace Tables;
+      sky_tbl_schema = schemaFromString(
+          " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+          " 1 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE \n" +
+          " 2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n");
+      sky_qry_schema = schemaFromColNames(sky_tbl_schema, "COMMENT");
+      sky_pushdown_cols_qry_schema = schemaFromColNames(sky_tbl_schema,
+                                                        "COMMENT,PRICE");
+    }
+};
+
+TEST_F(ClientPlanTest, Shared) {
+  // one plan per kind and set of preds, shared by every object
+  auto p1 = get_client_plan(false, ";price,gt,10.0;");
+  auto p2 = get_client_plan(false, ";price,gt,10.0;");
+  ASSERT_EQ(p1.get(), p2.get());
+  ASSERT_EQ(1u, p1->preds.size());
+  ASSERT_EQ(3u, p1->tbl_schema.size());
+  ASSERT_EQ(1u, p1->qry_schema.size());
+  ASSERT_EQ(2, p1->qry_schema[0].idx);
+
+  ASSERT_NE(p1.get(), get_client_plan(false, ";price,lt,10.0;").get());
+  ASSERT_NE(p1.get(), get_client_plan(true, ";price,gt,10.0;").get());
+}
+
+TEST_F(ClientPlanTest, PushdownProjection) {
+  // over the pushdown_cols_only result, cols are numbered from 0
+  auto p = get_client_plan(true, ";price,gt,10.0;");
+  ASSERT_EQ(2u, p->tbl_schema.size());
+  ASSERT_EQ("COMMENT", p->tbl_schema[0].name);
+  ASSERT_EQ(0, p->tbl_schema[0].idx);
+  ASSERT_EQ("PRICE", p->tbl_schema[1].name);
+  ASSERT_EQ(1, p->tbl_schema[1].idx);
+  ASSERT_EQ(1u, p->qry_schema.size());
+  ASSERT_EQ(0, p->qry_schema[0].idx);
+  ASSERT_EQ(1u, p->preds.size());
+  ASSERT_EQ(1, p->preds[0]->colIdx());
+}
+
+TEST_F(ClientPlanTest, AggregatesPerObject) {
+  // aggregate preds keep state, so each object gets its own plan
+  auto p1 = get_client_plan(false, ";price,sum,0.0;");
+  auto p2 = get_client_plan(false, ";price,sum,0.0;");
+  ASSERT_NE(p1.get(), p2.get());
+  ASSERT_TRUE(Tables::hasAggPreds(p1->preds));
+}
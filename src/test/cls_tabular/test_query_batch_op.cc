@@ -0,0 +1,188 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <errno.h>
+#include <string>
+#include <vector>
+
+#include "query/query.h"
+#include "include/rados/librados.hpp"
+#include "include/encoding.h"
+#include "test/librados/test_cxx.h"
+#include "test/librados/test.h"
+#include "gtest/gtest.h"
+
+using namespace librados;
+using namespace Tables;
+
+static const std::string OID = "obj.lineitem_batch.0";
+static const int NORDERS = 100;
+
+static std::string batch_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER \n" +
+    " 2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+// an SFT_ARROW object of NORDERS orders of 4 lines each
+static bufferlist arrow_object() {
+  schema_vec schema = schemaFromString(batch_schema());
+  std::string csv;
+  for (int o = 0; o < NORDERS; o++) {
+    for (int l = 1; l <= 4; l++)
+      csv += std::to_string(o) + CSV_DELIM + std::to_string(l) + CSV_DELIM +
+             "comment " + std::to_string(o * 4 + l) + "\n";
+  }
+  std::string errmsg;
+  std::shared_ptr<arrow::Table> table;
+  EXPECT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                      schema, errmsg, &table)) << errmsg;
+  std::shared_ptr<arrow::Buffer> buffer;
+  EXPECT_EQ(0, convert_arrow_to_buffer(table, &buffer));
+  flatbuffers::FlatBufferBuilder builder(1024);
+  createFbMeta(&builder, SFT_ARROW,
+               const_cast<unsigned char*>(buffer->data()), buffer->size());
+  bufferlist meta_bl;
+  meta_bl.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                 builder.GetSize());
+  bufferlist obj;
+  using ceph::encode;
+  encode(meta_bl, obj);
+  return obj;
+}
+
+// a query over the object, as run-query encodes it
+static query_op make_op(const std::string& cols, const std::string& preds) {
+  schema_vec schema = schemaFromString(batch_schema());
+  query_op op;
+  op.query = "flatbuf";
+  op.debug = false;
+  op.fastpath = false;
+  op.index_read = false;
+  op.mem_constrain = false;
+  op.index_type = SIT_IDX_UNK;
+  op.index2_type = SIT_IDX_UNK;
+  op.index_plan_type = SIP_IDX_STANDARD;
+  op.index_batch_size = 1000;
+  op.result_format = SFT_ARROW;
+  op.db_schema_name = "public";
+  op.table_name = "lineitem_batch";
+  op.data_schema = batch_schema();
+  op.query_schema = schemaToString(schemaFromColNames(schema, cols));
+  op.query_preds = preds;
+  return op;
+}
+
+// the rows of a query result, and the LINENUMBERs seen
+static int64_t result_rows(bufferlist& result, std::vector<int>& lines) {
+  sky_meta meta = getSkyMeta(&result);
+  EXPECT_EQ(SFT_ARROW, meta.blob_format);
+  std::shared_ptr<arrow::Table> table;
+  std::shared_ptr<arrow::Buffer> buffer = arrow::Buffer::Wrap(
+      reinterpret_cast<const uint8_t*>(meta.blob_data), meta.blob_size);
+  EXPECT_EQ(0, extract_arrow_from_buffer(&table, buffer));
+  auto col = table->GetColumnByName("LINENUMBER");
+  if (col != nullptr) {
+    for (int c = 0; c < col->num_chunks(); c++) {
+      auto a = std::static_pointer_cast<arrow::Int32Array>(col->chunk(c));
+      for (int64_t i = 0; i < a->length(); i++)
+        lines.push_back(a->Value(i));
+    }
+  }
+  return table->num_rows();
+}
+
+class SkyhookQueryBatch : public ::testing::Test {
+  protected:
+    static void SetUpTestCase() {
+      pool_name = get_temp_pool_name();
+      ASSERT_EQ("", create_one_pool_pp(pool_name, rados));
+      ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+      bufferlist obj = arrow_object();
+      ASSERT_EQ(0, ioctx.write_full(OID, obj));
+    }
+
+    static void TearDownTestCase() {
+      ioctx.close();
+      ASSERT_EQ(0, destroy_one_pool_pp(pool_name, rados));
+    }
+
+    int exec_batch(query_batch_op& batch, bufferlist& out) {
+      bufferlist inbl;
+      using ceph::encode;
+      encode(batch, inbl);
+      return ioctx.exec(OID, "tabular", "exec_query_batch_op", inbl, out);
+    }
+
+    static Rados rados;
+    static IoCtx ioctx;
+    static std::string pool_name;
+};
+
+Rados SkyhookQueryBatch::rados;
+IoCtx SkyhookQueryBatch::ioctx;
+std::string SkyhookQueryBatch::pool_name;
+
+TEST_F(SkyhookQueryBatch, SameAsSingleQueries) {
+  query_batch_op batch;
+  batch.ops.push_back(make_op("ORDERKEY,LINENUMBER", ";orderkey,lt,10;"));
+  batch.ops.push_back(make_op("LINENUMBER", ";linenumber,eq,2;"));
+  batch.ops.push_back(make_op("COMMENT", ";comment,like,comment 1;"));
+  bufferlist out;
+  ASSERT_EQ(0, exec_batch(batch, out));
+
+  // one cls_info and result per query, in batch order, each as the query
+  // returns it on its own
+  using ceph::encode;
+  using ceph::decode;
+  bufferlist::const_iterator it = out.begin();
+  std::vector<bufferlist> results;
+  for (auto& op : batch.ops) {
+    cls_info info;
+    bufferlist result;
+    decode(info, it);
+    decode(result, it);
+    ASSERT_TRUE(info.push_back_reason.empty());
+
+    bufferlist inbl, single_out;
+    encode(op, inbl);
+    ASSERT_EQ(0, ioctx.exec(OID, "tabular", "exec_query_op", inbl,
+                            single_out));
+    bufferlist::const_iterator sit = single_out.begin();
+    cls_info single_info;
+    bufferlist single;
+    decode(single_info, sit);
+    decode(single, sit);
+    ASSERT_TRUE(result.contents_equal(single));
+    results.push_back(result);
+  }
+  ASSERT_EQ(0u, it.get_remaining());
+
+  std::vector<int> lines;
+  ASSERT_EQ(10 * 4, result_rows(results[0], lines));
+  lines.clear();
+  ASSERT_EQ(NORDERS, result_rows(results[1], lines));
+  ASSERT_EQ(std::vector<int>(NORDERS, 2), lines);
+  lines.clear();
+  ASSERT_LT(0, result_rows(results[2], lines));
+}
+
+TEST_F(SkyhookQueryBatch, Invalid) {
+  // an empty batch, and index reads, which need their own reads
+  query_batch_op batch;
+  bufferlist out;
+  ASSERT_EQ(-EINVAL, exec_batch(batch, out));
+
+  batch.ops.push_back(make_op("ORDERKEY", ";orderkey,lt,10;"));
+  batch.ops.push_back(make_op("ORDERKEY", ";orderkey,lt,10;"));
+  batch.ops[1].index_read = true;
+  ASSERT_EQ(-EINVAL, exec_batch(batch, out));
+}
@@ -0,0 +1,241 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "query/query_spool.h"
+#include "gtest/gtest.h"
+
+// the rows as the test generates them and reads them back
+struct spool_row {
+  int64_t key;
+  std::string name;
+  double price;
+  int64_t rid;
+  bool price_null;
+
+  bool operator==(const spool_row& r) const {
+    return key == r.key && name == r.name && rid == r.rid &&
+           price_null == r.price_null && (price_null || price == r.price);
+  }
+};
+
+static const char *names[] = {"AIR", "MAIL", "RAIL", "SHIP", "TRUCK"};
+
+// rows as an object result: the columns, RID and DELETED_VECTOR
+static std::shared_ptr<arrow::Table> make_table(int64_t first_rid,
+                                                int64_t nrows,
+                                                int64_t nkeys,
+                                                std::vector<spool_row>& live) {
+  arrow::Int64Builder key_b;
+  arrow::StringBuilder name_b;
+  arrow::DoubleBuilder price_b;
+  arrow::Int64Builder rid_b;
+  arrow::BooleanBuilder del_b;
+  for (int64_t i = 0; i < nrows; i++) {
+    int64_t rid = first_rid + i;
+    spool_row r = {(rid * 7919) % nkeys, names[rid % 5], rid * 0.5, rid,
+                   rid % 11 == 0};
+    bool deleted = (rid % 13 == 0);
+    EXPECT_TRUE(key_b.Append(r.key).ok());
+    EXPECT_TRUE(name_b.Append(r.name).ok());
+    EXPECT_TRUE((r.price_null ? price_b.AppendNull() :
+                                price_b.Append(r.price)).ok());
+    EXPECT_TRUE(rid_b.Append(rid).ok());
+    EXPECT_TRUE(del_b.Append(deleted).ok());
+    if (!deleted)
+      live.push_back(r);
+  }
+  std::shared_ptr<arrow::Array> key, name, price, rid, del;
+  EXPECT_TRUE(key_b.Finish(&key).ok());
+  EXPECT_TRUE(name_b.Finish(&name).ok());
+  EXPECT_TRUE(price_b.Finish(&price).ok());
+  EXPECT_TRUE(rid_b.Finish(&rid).ok());
+  EXPECT_TRUE(del_b.Finish(&del).ok());
+  auto schema = arrow::schema({arrow::field("KEY", arrow::int64()),
+                               arrow::field("NAME", arrow::utf8()),
+                               arrow::field("PRICE", arrow::float64()),
+                               arrow::field("RID", arrow::int64()),
+                               arrow::field("DELETED_VECTOR", arrow::boolean())});
+  return arrow::Table::Make(schema, {key, name, price, rid, del});
+}
+
+static void read_rows(const std::shared_ptr<arrow::Table>& t,
+                      std::vector<spool_row>& rows) {
+  ASSERT_EQ(5, t->num_columns());
+  auto combined = t->CombineChunks(arrow::default_memory_pool());
+  ASSERT_TRUE(combined.ok());
+  auto c = combined.ValueOrDie();
+  if (c->num_rows() == 0)
+    return;
+  auto key = std::static_pointer_cast<arrow::Int64Array>(c->column(0)->chunk(0));
+  auto name = std::static_pointer_cast<arrow::StringArray>(c->column(1)->chunk(0));
+  auto price = std::static_pointer_cast<arrow::DoubleArray>(c->column(2)->chunk(0));
+  auto rid = std::static_pointer_cast<arrow::Int64Array>(c->column(3)->chunk(0));
+  auto del = std::static_pointer_cast<arrow::BooleanArray>(c->column(4)->chunk(0));
+  for (int64_t i = 0; i < c->num_rows(); i++) {
+    ASSERT_FALSE(del->Value(i));
+    rows.push_back({key->Value(i), name->GetString(i),
+                    price->IsNull(i) ? 0 : price->Value(i),
+                    rid->Value(i), price->IsNull(i)});
+  }
+}
+
+class QuerySpool : public ::testing::Test {
+  protected:
+    // appends ntables results of nrows rows each, and reads back all rows.
+    // the memory budget is the smallest the spool allows, so the rows are
+    // sorted in several runs and grouped in several partitions.
+    void run(const std::string& groupby,
+             const std::string& orderby,
+             int ntables,
+             int64_t nrows,
+             int64_t nkeys) {
+      ResultSpool spool;
+      ASSERT_EQ(0, spool.init("/tmp", 0, groupby, orderby));
+      ASSERT_TRUE(spool.active());
+      std::string errmsg;
+      for (int t = 0; t < ntables; t++) {
+        ASSERT_EQ(0, spool.append(make_table(t * nrows, nrows, nkeys, input),
+                                  errmsg)) << errmsg;
+      }
+      ASSERT_EQ(input.size(), spool.num_rows());
+      ASSERT_EQ(0, spool.finish(
+          [this](const std::shared_ptr<arrow::Table>& t) {
+            read_rows(t, output);
+            return true;
+          }, errmsg)) << errmsg;
+    }
+
+    std::vector<spool_row> input;   // live rows, in append order
+    std::vector<spool_row> output;
+};
+
+TEST_F(QuerySpool, Inactive) {
+  ResultSpool spool;
+  ASSERT_EQ(0, spool.init("/tmp", 1 << 20, "", " "));
+  ASSERT_FALSE(spool.active());
+}
+
+TEST_F(QuerySpool, OrderBySpills) {
+  run("", ";KEY,DESC;NAME,ASC;", 10, 20000, 5000);
+
+  // a stable sort, as the runs are merged with ties to the earlier run
+  std::vector<spool_row> expected = input;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const spool_row& a, const spool_row& b) {
+                     if (a.key != b.key)
+                       return a.key > b.key;
+                     return a.name < b.name;
+                   });
+  ASSERT_EQ(expected.size(), output.size());
+  ASSERT_TRUE(expected == output);
+}
+
+TEST_F(QuerySpool, OrderByNulls) {
+  run("", ";PRICE,ASC;", 2, 1000, 100);
+  ASSERT_EQ(input.size(), output.size());
+
+  // nulls sort first, the values after them in order
+  size_t nulls = 0;
+  while (nulls < output.size() && output[nulls].price_null)
+    nulls++;
+  for (size_t i = nulls; i < output.size(); i++) {
+    ASSERT_FALSE(output[i].price_null);
+    if (i > nulls)
+      ASSERT_LE(output[i - 1].price, output[i].price);
+  }
+  ASSERT_EQ((size_t)std::count_if(input.begin(), input.end(),
+                                  [](const spool_row& r) {
+                                    return r.price_null;
+                                  }), nulls);
+}
+
+TEST_F(QuerySpool, GroupBySpills) {
+  run("KEY", "", 10, 20000, 30011);
+
+  // the first row of each group, in any order
+  std::map<int64_t, spool_row> expected;
+  for (auto& r : input)
+    expected.emplace(r.key, r);
+  ASSERT_EQ(expected.size(), output.size());
+  for (auto& r : output) {
+    auto it = expected.find(r.key);
+    ASSERT_NE(expected.end(), it);
+    ASSERT_TRUE(it->second == r) << "key " << r.key << " rid " << r.rid;
+    expected.erase(it);
+  }
+}
+
+TEST_F(QuerySpool, GroupByOrderBy) {
+  run("NAME,KEY", ";NAME,ASC;KEY,ASC;", 4, 25000, 1000);
+
+  std::map<std::pair<std::string, int64_t>, spool_row> expected;
+  for (auto& r : input)
+    expected.emplace(std::make_pair(r.name, r.key), r);
+  ASSERT_EQ(expected.size(), output.size());
+  auto it = expected.begin();
+  for (size_t i = 0; i < output.size(); i++, ++it)
+    ASSERT_TRUE(it->second == output[i]) << "row " << i;
+}
+
+TEST_F(QuerySpool, FinishStopsEarly) {
+  ResultSpool spool;
+  ASSERT_EQ(0, spool.init("/tmp", 0, "", ";RID,ASC;"));
+  std::string errmsg;
+  for (int t = 0; t < 4; t++)
+    ASSERT_EQ(0, spool.append(make_table(t * 50000, 50000, 100, input),
+                              errmsg)) << errmsg;
+  int ntables = 0;
+  ASSERT_EQ(0, spool.finish(
+      [&](const std::shared_ptr<arrow::Table>& t) {
+        read_rows(t, output);
+        return ++ntables < 1;
+      }, errmsg)) << errmsg;
+  ASSERT_EQ(1, ntables);
+  ASSERT_LT(output.size(), input.size());
+  for (size_t i = 0; i < output.size(); i++)
+    ASSERT_TRUE(input[i] == output[i]);
+}
+
+TEST_F(QuerySpool, BadResultKeepsSpool) {
+  ResultSpool spool;
+  ASSERT_EQ(0, spool.init("/tmp", 0, "KEY", ""));
+  std::string errmsg;
+
+  // a result without the groupby col is refused and not spooled
+  arrow::Int64Builder other_b;
+  std::shared_ptr<arrow::Array> other;
+  ASSERT_TRUE(other_b.Append(1).ok());
+  ASSERT_TRUE(other_b.Finish(&other).ok());
+  auto no_key = arrow::Table::Make(
+      arrow::schema({arrow::field("OTHER", arrow::int64())}), {other});
+  ASSERT_NE(0, spool.append(no_key, errmsg));
+  ASSERT_FALSE(errmsg.empty());
+  ASSERT_EQ(0u, spool.num_rows());
+
+  // the next result is resolved on its own
+  errmsg.clear();
+  ASSERT_EQ(0, spool.append(make_table(0, 100, 10, input), errmsg)) << errmsg;
+
+  // later results must have the same schema
+  ASSERT_NE(0, spool.append(no_key, errmsg));
+
+  ASSERT_EQ(0, spool.finish(
+      [this](const std::shared_ptr<arrow::Table>& t) {
+        read_rows(t, output);
+        return true;
+      }, errmsg)) << errmsg;
+  ASSERT_EQ(10u, output.size());
+}
@@ -0,0 +1,167 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "cls/cls_tabular_processing.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 1000;
+
+static std::string repart_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER \n" +
+    " 2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+static bool deleted(int64_t rid) {
+  return rid % 10 == 3;
+}
+
+template <typename ArrayType>
+static std::vector<int64_t> values(const std::shared_ptr<arrow::ChunkedArray>& col) {
+  std::vector<int64_t> vals;
+  for (int c = 0; c < col->num_chunks(); c++) {
+    auto a = std::static_pointer_cast<ArrayType>(col->chunk(c));
+    for (int64_t i = 0; i < a->length(); i++)
+      vals.push_back(a->Value(i));
+  }
+  return vals;
+}
+
+class Repartition : public ::testing::Test {
+  protected:
+    // NROWS rows, 4 lines per order, with every 10th row deleted
+    virtual void SetUp() {
+      schema = schemaFromString(repart_schema());
+      std::string csv;
+      for (int i = 0; i < NROWS; i++) {
+        csv += std::to_string(i / 4 + 1) + CSV_DELIM +
+               std::to_string(i % 4 + 1) + CSV_DELIM +
+               "comment " + std::to_string(i) + "\n";
+      }
+      std::string errmsg;
+      ASSERT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                          schema, errmsg, &table)) << errmsg;
+
+      arrow::BooleanBuilder del_b;
+      for (int i = 0; i < NROWS; i++)
+        ASSERT_TRUE(del_b.Append(deleted(i)).ok());
+      std::shared_ptr<arrow::Array> del;
+      ASSERT_TRUE(del_b.Finish(&del).ok());
+      std::vector<std::shared_ptr<arrow::ChunkedArray>> cols;
+      for (int c = 0; c < table->num_columns(); c++)
+        cols.push_back(table->column(c));
+      cols[ARROW_DELVEC_INDEX(schema.size())] =
+          std::make_shared<arrow::ChunkedArray>(arrow::ArrayVector{del});
+      table = arrow::Table::Make(table->schema(), cols);
+    }
+
+    std::vector<int64_t> rids(const std::shared_ptr<arrow::Table>& t) {
+      return values<arrow::Int64Array>(t->column(ARROW_RID_INDEX(schema.size())));
+    }
+
+    schema_vec schema;
+    std::shared_ptr<arrow::Table> table;
+};
+
+TEST_F(Repartition, SplitKeepsEveryRow) {
+  std::vector<std::shared_ptr<arrow::Table>> batches;
+  ASSERT_EQ(0, split_arrow_table(table, 300, &batches));
+
+  // full batches, the rest in the last one
+  ASSERT_EQ(4u, batches.size());
+  std::vector<int64_t> all;
+  for (size_t i = 0; i < batches.size(); i++) {
+    int64_t expected = i < 3 ? 300 : NROWS - 900;
+    ASSERT_EQ(expected, batches[i]->num_rows());
+    ASSERT_EQ(std::to_string(expected),
+              batches[i]->schema()->metadata()->value(METADATA_NUM_ROWS));
+    ASSERT_EQ(table->num_columns(), batches[i]->num_columns());
+    auto r = rids(batches[i]);
+    all.insert(all.end(), r.begin(), r.end());
+  }
+  ASSERT_EQ(rids(table), all);
+}
+
+TEST_F(Repartition, SplitLimits) {
+  std::vector<std::shared_ptr<arrow::Table>> batches;
+  ASSERT_NE(0, split_arrow_table(table, 0, &batches));
+  ASSERT_TRUE(batches.empty());
+
+  // a batch size beyond the int range is not narrowed
+  ASSERT_EQ(0, split_arrow_table(table, int64_t(1) << 33, &batches));
+  ASSERT_EQ(1u, batches.size());
+  ASSERT_EQ(NROWS, batches[0]->num_rows());
+}
+
+TEST_F(Repartition, HashPartitionByKey) {
+  const uint64_t nparts = 7;
+  std::map<uint64_t, std::shared_ptr<arrow::Table>> parts;
+  ASSERT_EQ(0, hash_partition_arrow_table(table, nparts, &parts));
+
+  // every live row goes to the part its key hashes to, deleted rows are
+  // dropped
+  std::vector<bool> seen(NROWS, false);
+  for (auto& p : parts) {
+    ASSERT_LT(p.first, nparts);
+    auto t = p.second;
+    ASSERT_LT(0, t->num_rows());
+    auto orderkeys = values<arrow::Int32Array>(t->column(0));
+    auto linenums = values<arrow::Int32Array>(t->column(1));
+    auto r = rids(t);
+    auto dels = values<arrow::BooleanArray>(
+        t->column(ARROW_DELVEC_INDEX(schema.size())));
+    for (int64_t i = 0; i < t->num_rows(); i++) {
+      ASSERT_FALSE(dels[i]);
+      ASSERT_FALSE(deleted(r[i]));
+      ASSERT_FALSE(seen[r[i]]);
+      seen[r[i]] = true;
+      uint64_t key = (uint64_t(orderkeys[i]) << 32) | uint64_t(linenums[i]);
+      ASSERT_EQ(p.first, jumpConsistentHash(key, nparts));
+    }
+  }
+  for (int i = 0; i < NROWS; i++)
+    ASSERT_EQ(!deleted(i), seen[i]) << "rid " << i;
+}
+
+TEST_F(Repartition, HashPartitionConsistent) {
+  // one more destination only moves rows into the new one
+  std::map<uint64_t, std::shared_ptr<arrow::Table>> parts7, parts8;
+  ASSERT_EQ(0, hash_partition_arrow_table(table, 7, &parts7));
+  ASSERT_EQ(0, hash_partition_arrow_table(table, 8, &parts8));
+  std::map<int64_t, uint64_t> part_of;
+  for (auto& p : parts7) {
+    for (auto rid : rids(p.second))
+      part_of[rid] = p.first;
+  }
+  int64_t moved = 0;
+  for (auto& p : parts8) {
+    for (auto rid : rids(p.second)) {
+      if (p.first == 7)
+        moved++;
+      else
+        ASSERT_EQ(part_of[rid], p.first) << "rid " << rid;
+    }
+  }
+  ASSERT_LT(0, moved);
+}
+
+TEST_F(Repartition, HashPartitionErrors) {
+  std::map<uint64_t, std::shared_ptr<arrow::Table>> parts;
+  ASSERT_NE(0, hash_partition_arrow_table(table, 0, &parts));
+}
@@ -0,0 +1,231 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <errno.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "query/query.h"
+#include "include/rados/librados.hpp"
+#include "include/encoding.h"
+#include "test/librados/test_cxx.h"
+#include "test/librados/test.h"
+#include "gtest/gtest.h"
+
+using namespace librados;
+using namespace Tables;
+
+static const std::string SRC_PREFIX = "obj.lineitem.";
+static const std::string DST_TABLE = "lineitem_repart";
+static const std::string DST_PREFIX = "obj." + DST_TABLE + ".";
+
+static std::string repart_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER \n" +
+    " 2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+/*
+ * An SFT_ARROW object of the rows of orders [first_order, first_order +
+ * norders), 4 lines each, in ntables tables as the writer lays them out.
+ */
+static bufferlist arrow_object(int first_order, int norders, int ntables) {
+  schema_vec schema = schemaFromString(repart_schema());
+  bufferlist obj;
+  int per_table = norders / ntables;
+  for (int t = 0; t < ntables; t++) {
+    std::string csv;
+    for (int o = first_order + t * per_table;
+         o < first_order + (t + 1) * per_table; o++) {
+      for (int l = 1; l <= 4; l++)
+        csv += std::to_string(o) + CSV_DELIM + std::to_string(l) + CSV_DELIM +
+               "comment " + std::to_string(o * 4 + l) + "\n";
+    }
+    std::string errmsg;
+    std::shared_ptr<arrow::Table> table;
+    EXPECT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                        schema, errmsg, &table)) << errmsg;
+    std::shared_ptr<arrow::Buffer> buffer;
+    EXPECT_EQ(0, convert_arrow_to_buffer(table, &buffer));
+    flatbuffers::FlatBufferBuilder builder(1024);
+    createFbMeta(&builder, SFT_ARROW,
+                 const_cast<unsigned char*>(buffer->data()), buffer->size());
+    bufferlist meta_bl;
+    meta_bl.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                   builder.GetSize());
+    using ceph::encode;
+    encode(meta_bl, obj);
+  }
+  return obj;
+}
+
+class SkyhookRepartition : public ::testing::Test {
+  protected:
+    static void SetUpTestCase() {
+      pool_name = get_temp_pool_name();
+      ASSERT_EQ("", create_one_pool_pp(pool_name, rados));
+      ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+    }
+
+    static void TearDownTestCase() {
+      ioctx.close();
+      ASSERT_EQ(0, destroy_one_pool_pp(pool_name, rados));
+    }
+
+    virtual void SetUp() {
+      quiet = true;
+      repart_dst_oid_prefix = DST_PREFIX;
+      repart_dst_written.clear();
+    }
+
+    // runs one phase of the repartition job over oids, as run-query does
+    void run_phase(const std::vector<std::string>& oids, repartition_op op) {
+      target_objects = oids;
+      auto worker_ioctx = new librados::IoCtx;
+      ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), *worker_ioctx));
+      worker_repartition_arrow_table_op(worker_ioctx, op);
+      delete worker_ioctx;
+    }
+
+    // repartitions the source objects into ndst objects of batch_rows rows
+    // per table and returns the destinations
+    std::vector<std::string> repartition(const std::vector<std::string>& srcs,
+                                         uint64_t ndst,
+                                         uint64_t batch_rows) {
+      repart_dst_written.clear();
+      repartition_op op(DST_TABLE, ndst, batch_rows);
+      run_phase(srcs, op);
+      std::vector<std::string> dsts;
+      EXPECT_EQ(0, repartition_dst_objects(&ioctx, dsts));
+      op.num_objs = 0;
+      run_phase(dsts, op);
+      return dsts;
+    }
+
+    // the COMMENTs of the rows of oid, and the row count of its tables
+    void read_rows(const std::string& oid,
+                   std::multiset<std::string>& comments,
+                   std::vector<int64_t>& table_rows) {
+      bufferlist obj;
+      ASSERT_LT(0, ioctx.read(oid, obj, 0, 0));
+      bufferlist::const_iterator it = obj.begin();
+      while (it.get_remaining() > 0) {
+        bufferlist bl;
+        using ceph::decode;
+        decode(bl, it);
+        sky_meta meta = getSkyMeta(&bl);
+        ASSERT_EQ(SFT_ARROW, meta.blob_format);
+        std::shared_ptr<arrow::Table> table;
+        std::shared_ptr<arrow::Buffer> buffer = arrow::Buffer::Wrap(
+            reinterpret_cast<const uint8_t*>(meta.blob_data), meta.blob_size);
+        ASSERT_EQ(0, extract_arrow_from_buffer(&table, buffer));
+        ASSERT_EQ(DST_TABLE,
+                  table->schema()->metadata()->value(METADATA_TABLE_NAME));
+        table_rows.push_back(table->num_rows());
+        auto col = table->GetColumnByName("COMMENT");
+        for (int c = 0; c < col->num_chunks(); c++) {
+          auto a = std::static_pointer_cast<arrow::StringArray>(col->chunk(c));
+          for (int64_t i = 0; i < a->length(); i++)
+            comments.insert(a->GetString(i));
+        }
+      }
+    }
+
+    bool exists(const std::string& oid) {
+      uint64_t psize;
+      time_t pmtime;
+      return ioctx.stat(oid, &psize, &pmtime) == 0;
+    }
+
+    static Rados rados;
+    static IoCtx ioctx;
+    static std::string pool_name;
+};
+
+Rados SkyhookRepartition::rados;
+IoCtx SkyhookRepartition::ioctx;
+std::string SkyhookRepartition::pool_name;
+
+TEST_F(SkyhookRepartition, EveryRowOnce) {
+  // three sources of 100 orders in 5 tables each
+  std::vector<std::string> srcs;
+  for (int i = 0; i < 3; i++) {
+    srcs.push_back(SRC_PREFIX + std::to_string(i));
+    bufferlist obj = arrow_object(i * 100, 100, 5);
+    ASSERT_EQ(0, ioctx.write_full(srcs.back(), obj));
+  }
+
+  std::vector<std::string> dsts = repartition(srcs, 4, 150);
+  ASSERT_LT(0u, dsts.size());
+  ASSERT_GE(4u, dsts.size());
+
+  std::multiset<std::string> comments;
+  for (auto& oid : dsts) {
+    std::vector<int64_t> table_rows;
+    read_rows(oid, comments, table_rows);
+    ASSERT_FALSE(table_rows.empty());
+    for (size_t i = 0; i < table_rows.size(); i++) {
+      ASSERT_LE(table_rows[i], 150);
+      if (i + 1 < table_rows.size())
+        ASSERT_EQ(150, table_rows[i]) << oid;
+    }
+  }
+  ASSERT_EQ(3u * 100 * 4, comments.size());
+  for (int r = 1; r <= 3 * 100 * 4; r++)
+    ASSERT_EQ(1u, comments.count("comment " + std::to_string(r))) << r;
+
+  // the sources are kept
+  for (auto& oid : srcs)
+    ASSERT_TRUE(exists(oid));
+}
+
+TEST_F(SkyhookRepartition, RerunReplacesDestinations) {
+  std::vector<std::string> srcs = {SRC_PREFIX + "big"};
+  bufferlist obj = arrow_object(1000, 200, 4);
+  ASSERT_EQ(0, ioctx.write_full(srcs[0], obj));
+
+  // a first run to many destinations, then to a single one: the
+  // destinations of the first run that the second did not write are gone
+  std::vector<std::string> dsts = repartition(srcs, 6, 1000);
+  ASSERT_LT(1u, dsts.size());
+  dsts = repartition(srcs, 1, 1000);
+  ASSERT_EQ(std::vector<std::string>({DST_PREFIX + "0"}), dsts);
+  for (int i = 1; i < 6; i++)
+    ASSERT_FALSE(exists(DST_PREFIX + std::to_string(i)));
+
+  std::multiset<std::string> comments;
+  std::vector<int64_t> table_rows;
+  read_rows(dsts[0], comments, table_rows);
+  ASSERT_EQ(200u * 4, comments.size());
+  ASSERT_EQ(std::vector<int64_t>({200 * 4}), table_rows);
+}
+
+TEST_F(SkyhookRepartition, StaleDestinationsRemoved) {
+  // left by an earlier run: destinations 0..7, and objects of other tables
+  bufferlist old;
+  old.append("stale");
+  for (int i = 0; i < 8; i++)
+    ASSERT_EQ(0, ioctx.write_full(DST_PREFIX + std::to_string(i), old));
+  ASSERT_EQ(0, ioctx.write_full(DST_PREFIX + "idx", old));
+  ASSERT_EQ(0, ioctx.write_full(SRC_PREFIX + "7", old));
+
+  // this run wrote destinations 1 and 3 of 4
+  repart_dst_written = {1, 3};
+  std::vector<std::string> dsts;
+  ASSERT_EQ(0, repartition_dst_objects(&ioctx, dsts));
+  ASSERT_EQ(std::vector<std::string>({DST_PREFIX + "1", DST_PREFIX + "3"}),
+            dsts);
+  for (int i = 0; i < 8; i++)
+    ASSERT_EQ(i == 1 || i == 3, exists(DST_PREFIX + std::to_string(i))) << i;
+  ASSERT_TRUE(exists(DST_PREFIX + "idx"));
+  ASSERT_TRUE(exists(SRC_PREFIX + "7"));
+}
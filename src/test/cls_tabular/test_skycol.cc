@@ -0,0 +1,128 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular_utils.h"
+#include "cls/cls_tabular_processing.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 1000;
+static const uint64_t BIG_BASE = 18446744073709551000ull;  // above 2^63
+
+// one column per encoding transform_arrow_to_skycol picks:
+// ORDERKEY frame of reference, SHIPMODE dictionary, FLAG run length,
+// COMMENT and PRICE plain, BIG frame of reference of unsigned values above
+// the int64 range, DISCOUNT frame of reference with nulls.
+static std::string skycol_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_STRING) + " 0 1 SHIPMODE \n" +
+    " 2 " + std::to_string(SDT_INT32) + " 0 1 FLAG \n" +
+    " 3 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n" +
+    " 4 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE \n" +
+    " 5 " + std::to_string(SDT_UINT64) + " 0 1 BIG \n" +
+    " 6 " + std::to_string(SDT_INT64) + " 0 1 DISCOUNT \n";
+}
+
+static std::string skycol_csv() {
+  const char *modes[] = {"AIR", "MAIL", "RAIL", "SHIP", "TRUCK"};
+  std::string csv;
+  for (int i = 0; i < NROWS; i++) {
+    csv += std::to_string(100000 + i * 3) + CSV_DELIM;
+    csv += std::string(modes[(i * 7) % 5]) + CSV_DELIM;
+    csv += std::to_string(i / 100) + CSV_DELIM;
+    csv += "comment " + std::to_string(i * 13) + CSV_DELIM;
+    csv += std::to_string(i * 0.25) + CSV_DELIM;
+    csv += std::to_string(BIG_BASE + (i * 37) % 600) + CSV_DELIM;
+    csv += (i % 10 == 0 ? std::string("NULL") : std::to_string(i % 11 - 5));
+    csv += "\n";
+  }
+  return csv;
+}
+
+class SkyCol : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      schema = schemaFromString(skycol_schema());
+      csv = skycol_csv();
+      std::string errmsg;
+      ASSERT_EQ(0, transform_csv_to_arrow(csv.data(), csv.size(), SFT_CSV,
+                                          schema, errmsg, &table)) << errmsg;
+      ASSERT_EQ(NROWS, table->num_rows());
+      ASSERT_EQ(0, transform_arrow_to_skycol(table, errmsg, flatbldr))
+          << errmsg;
+    }
+
+    int process(const std::string& preds_str,
+                std::shared_ptr<arrow::Table>* out) {
+      predicate_vec preds = predsFromString(schema, preds_str);
+      std::string no_cols;
+      std::string errmsg;
+      int ret = processSkyColFb(
+          out, schema, schema, preds, no_cols, no_cols,
+          reinterpret_cast<const char*>(flatbldr.GetBufferPointer()),
+          flatbldr.GetSize(), errmsg);
+      EXPECT_EQ(0, ret) << errmsg;
+      return ret;
+    }
+
+    schema_vec schema;
+    std::string csv;
+    std::shared_ptr<arrow::Table> table;
+    flatbuffers::FlatBufferBuilder flatbldr;
+};
+
+TEST_F(SkyCol, RoundTrip) {
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process("", &out));
+  ASSERT_EQ(NROWS, out->num_rows());
+
+  // every column decodes to the values it was encoded from
+  for (auto& col : schema) {
+    auto expected = table->GetColumnByName(col.name);
+    auto actual = out->GetColumnByName(col.name);
+    ASSERT_NE(nullptr, actual) << col.name;
+    ASSERT_TRUE(expected->type()->Equals(actual->type())) << col.name;
+    ASSERT_TRUE(expected->Equals(actual)) << col.name;
+  }
+}
+
+TEST_F(SkyCol, SmallerThanText) {
+  ASSERT_LT(flatbldr.GetSize(), csv.size());
+}
+
+TEST_F(SkyCol, PredicatesOnEncodedColumns) {
+  // unsigned values above the int64 range compare as unsigned
+  uint64_t bound = BIG_BASE + 300;
+  int expected = 0;
+  for (int i = 0; i < NROWS; i++) {
+    if (BIG_BASE + (i * 37) % 600 > bound)
+      expected++;
+  }
+  std::shared_ptr<arrow::Table> out;
+  ASSERT_EQ(0, process(";BIG,gt," + std::to_string(bound) + ";", &out));
+  ASSERT_EQ(expected, out->num_rows());
+
+  // matched once per dictionary entry, not once per row
+  ASSERT_EQ(0, process(";SHIPMODE,like,RAIL;", &out));
+  ASSERT_EQ(NROWS / 5, out->num_rows());
+
+  // frame of reference and run length columns, and-ed
+  ASSERT_EQ(0, process(";ORDERKEY,lt,100300;FLAG,eq,0;", &out));
+  ASSERT_EQ(100, out->num_rows());
+
+  // null rows never match
+  ASSERT_EQ(0, process(";DISCOUNT,geq,-5;", &out));
+  ASSERT_EQ(NROWS - NROWS / 10, out->num_rows());
+}
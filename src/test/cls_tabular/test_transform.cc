@@ -0,0 +1,157 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 100;
+static const int FIRST_RID = 1000;
+
+static std::string transform_schema() {
+  return
+    " 0 " + std::to_string(SDT_INT32) + " 1 0 ORDERKEY \n" +
+    " 1 " + std::to_string(SDT_INT64) + " 0 1 PARTKEY \n" +
+    " 2 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE \n" +
+    " 3 " + std::to_string(SDT_STRING) + " 0 1 COMMENT \n";
+}
+
+static bool deleted(int i) { return i % 7 == 2; }
+static bool null_partkey(int i) { return i % 5 == 0; }
+static bool null_comment(int i) { return i % 11 == 3; }
+
+/*
+ * A FLEX_ROW flatbuffer of NROWS rows with every 7th row deleted and some
+ * null PARTKEYs and COMMENTs.
+ */
+static void make_fb(flatbuffers::FlatBufferBuilder& fbb) {
+  std::vector<flatbuffers::Offset<Tables::Record>> recs;
+  std::vector<uint8_t> delete_vec;
+  for (int i = 0; i < NROWS; i++) {
+    flexbuffers::Builder flx;
+    flx.Vector([&]() {
+      flx.Add(static_cast<int32_t>(i / 4 + 1));
+      flx.Add(static_cast<int64_t>(null_partkey(i) ? 0 : 100000 + i));
+      flx.Add(static_cast<double>(i) * 1.5);
+      flx.Add(null_comment(i) ? "" : ("comment " + std::to_string(i)).c_str());
+    });
+    flx.Finish();
+    std::vector<uint64_t> nullbits(2, 0);
+    if (null_partkey(i))
+      nullbits[0] |= 1ull << 1;
+    if (null_comment(i))
+      nullbits[0] |= 1ull << 3;
+    recs.push_back(CreateRecord(fbb, FIRST_RID + i,
+                                fbb.CreateVector(nullbits),
+                                fbb.CreateVector(flx.GetBuffer())));
+    delete_vec.push_back(deleted(i));
+  }
+  auto root = CreateTable(fbb, SFT_FLATBUF_FLEX_ROW, 2, 0, 0,
+                          fbb.CreateString(transform_schema()),
+                          fbb.CreateString("*"),
+                          fbb.CreateString("lineitem"),
+                          fbb.CreateVector(delete_vec),
+                          fbb.CreateVector(recs),
+                          NROWS);
+  fbb.Finish(root);
+}
+
+class TransformFbToArrow : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      make_fb(fbb);
+    }
+
+    std::shared_ptr<arrow::Table> transform(schema_vec query_schema) {
+      std::string errmsg;
+      std::shared_ptr<arrow::Table> table;
+      EXPECT_EQ(0, transform_fb_to_arrow(
+                       reinterpret_cast<const char*>(fbb.GetBufferPointer()),
+                       fbb.GetSize(), query_schema, errmsg, &table)) << errmsg;
+      return table;
+    }
+
+    flatbuffers::FlatBufferBuilder fbb;
+};
+
+TEST_F(TransformFbToArrow, KeepsDeletedRows) {
+  schema_vec schema = schemaFromString(transform_schema());
+  auto table = transform(schema);
+  ASSERT_TRUE(table);
+  ASSERT_EQ(NROWS, table->num_rows());
+  ASSERT_EQ(std::to_string(NROWS),
+            table->schema()->metadata()->value(METADATA_NUM_ROWS));
+  ASSERT_EQ(ARROW_DELVEC_INDEX(schema.size()) + 1, table->num_columns());
+
+  auto rids = std::static_pointer_cast<arrow::Int64Array>(
+      table->column(ARROW_RID_INDEX(schema.size()))->chunk(0));
+  auto dels = std::static_pointer_cast<arrow::BooleanArray>(
+      table->column(ARROW_DELVEC_INDEX(schema.size()))->chunk(0));
+  auto orderkeys = std::static_pointer_cast<arrow::Int32Array>(
+      table->column(0)->chunk(0));
+  for (int i = 0; i < NROWS; i++) {
+    ASSERT_EQ(FIRST_RID + i, rids->Value(i));
+    ASSERT_EQ(deleted(i), dels->Value(i)) << i;
+    ASSERT_EQ(i / 4 + 1, orderkeys->Value(i));
+  }
+}
+
+TEST_F(TransformFbToArrow, Nulls) {
+  schema_vec schema = schemaFromString(transform_schema());
+  auto table = transform(schema);
+  ASSERT_TRUE(table);
+
+  auto partkeys = std::static_pointer_cast<arrow::Int64Array>(
+      table->column(1)->chunk(0));
+  auto prices = std::static_pointer_cast<arrow::DoubleArray>(
+      table->column(2)->chunk(0));
+  auto comments = std::static_pointer_cast<arrow::StringArray>(
+      table->column(3)->chunk(0));
+  for (int i = 0; i < NROWS; i++) {
+    ASSERT_EQ(null_partkey(i), partkeys->IsNull(i)) << i;
+    if (!null_partkey(i))
+      ASSERT_EQ(100000 + i, partkeys->Value(i));
+    ASSERT_FALSE(prices->IsNull(i));
+    ASSERT_EQ(i * 1.5, prices->Value(i));
+    ASSERT_EQ(null_comment(i), comments->IsNull(i)) << i;
+    if (!null_comment(i))
+      ASSERT_EQ("comment " + std::to_string(i), comments->GetString(i));
+  }
+}
+
+TEST_F(TransformFbToArrow, QuerySchema) {
+  // a projection keeps the cols asked for, in their order
+  schema_vec schema = schemaFromString(transform_schema());
+  schema_vec query_schema = schemaFromColNames(schema, "COMMENT,ORDERKEY");
+  auto table = transform(query_schema);
+  ASSERT_TRUE(table);
+  ASSERT_EQ(NROWS, table->num_rows());
+  ASSERT_EQ(ARROW_DELVEC_INDEX(query_schema.size()) + 1, table->num_columns());
+  ASSERT_EQ("COMMENT", table->field(0)->name());
+  ASSERT_EQ("ORDERKEY", table->field(1)->name());
+
+  auto comments = std::static_pointer_cast<arrow::StringArray>(
+      table->column(0)->chunk(0));
+  auto orderkeys = std::static_pointer_cast<arrow::Int32Array>(
+      table->column(1)->chunk(0));
+  auto dels = std::static_pointer_cast<arrow::BooleanArray>(
+      table->column(ARROW_DELVEC_INDEX(query_schema.size()))->chunk(0));
+  for (int i = 0; i < NROWS; i++) {
+    ASSERT_EQ(i / 4 + 1, orderkeys->Value(i));
+    if (!null_comment(i))
+      ASSERT_EQ("comment " + std::to_string(i), comments->GetString(i));
+    ASSERT_EQ(deleted(i), dels->Value(i));
+  }
+}
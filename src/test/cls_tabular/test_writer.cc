@@ -0,0 +1,622 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+/*
+ * End to end tests of sky_tabular_flatflex_writer: the writer is run on a
+ * generated input and the objects it writes to local files are read back.
+ */
+
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/encoding.h"
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "cls/sky_tabular_flatflex_writer.h"
+#include "gtest/gtest.h"
+
+using namespace Tables;
+
+static const int NROWS = 500;
+static const std::string TABLE = "lineitem";
+
+static const char* modes[] = {"REG AIR", "AIR", "RAIL", "SHIP", "TRUCK",
+                              "MAIL", "FOB"};
+
+// as the schema files of the writer lay them out
+static std::string writer_schema() {
+  return
+    "0 " + std::to_string(SDT_INT64) + " 1 0 ORDERKEY\n" +
+    "1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER\n" +
+    "2 " + std::to_string(SDT_DOUBLE) + " 0 1 PRICE\n" +
+    "3 " + std::to_string(SDT_DATE) + " 0 1 SHIPDATE\n" +
+    "4 " + std::to_string(SDT_STRING) + " 0 1 SHIPMODE\n" +
+    "5 " + std::to_string(SDT_STRING) + " 0 1 COMMENT\n";
+}
+
+// a row as generated and as read back from the objects
+struct writer_row {
+  int64_t rid;
+  int64_t orderkey;
+  int32_t linenumber;
+  bool price_null;
+  double price;
+  std::string shipdate;
+  std::string shipmode;
+  std::string comment;
+
+  bool operator==(const writer_row& r) const {
+    return rid == r.rid && orderkey == r.orderkey &&
+           linenumber == r.linenumber && price_null == r.price_null &&
+           (price_null || price == r.price) && shipdate == r.shipdate &&
+           shipmode == r.shipmode && comment == r.comment;
+  }
+  bool operator<(const writer_row& r) const { return rid < r.rid; }
+};
+
+static std::ostream& operator<<(std::ostream& os, const writer_row& r) {
+  return os << r.rid << "|" << r.orderkey << "|" << r.linenumber << "|"
+            << (r.price_null ? std::string("NULL") : std::to_string(r.price))
+            << "|" << r.shipdate << "|" << r.shipmode << "|" << r.comment;
+}
+
+// the row of input line i, counted from 1, keys in no particular order
+static writer_row input_row(int i) {
+  writer_row r;
+  r.rid = i;
+  r.orderkey = (i * 7919) % 997 - 100;
+  r.linenumber = i % 7 + 1;
+  r.price_null = (i % 13 == 0);
+  r.price = r.price_null ? 0 : i * 1.25;
+  char d[11];
+  snprintf(d, sizeof(d), "199%d-%02d-%02d", i % 8, i % 12 + 1, i % 28 + 1);
+  r.shipdate = d;
+  r.shipmode = modes[i % 7];
+  r.comment = "comment " + std::to_string(i);
+  return r;
+}
+
+// a line of the input file, with a trailing delimiter as dbgen writes them
+static std::string input_line(int i) {
+  writer_row r = input_row(i);
+  std::ostringstream ss;
+  ss.precision(17);
+  if (i % 17 == 0)
+    ss << " ";
+  if (i % 19 == 0 && r.orderkey >= 0)
+    ss << "+";
+  ss << r.orderkey << "|" << r.linenumber << "|";
+  if (r.price_null)
+    ss << "NULL";
+  else
+    ss << r.price;
+  ss << "|" << r.shipdate << "|" << r.shipmode << "|" << r.comment << "|";
+  return ss.str();
+}
+
+class Writer : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      std::string tmpl = testing::TempDir() + "skywriterXXXXXX";
+      ASSERT_TRUE(mkdtemp(&tmpl[0]) != NULL);
+      dir = tmpl;
+      schema = schemaFromString(writer_schema());
+
+      std::ofstream sf(dir + "/schema.txt");
+      sf << writer_schema();
+      std::ofstream in(dir + "/input.csv");
+      for (int i = 1; i <= NROWS; i++)
+        in << input_line(i) << "\n";
+    }
+
+    // replaces the input of the writer
+    void write_input(const std::string& schema_str,
+                     const std::vector<std::string>& lines) {
+      schema = schemaFromString(schema_str);
+      std::ofstream sf(dir + "/schema.txt");
+      sf << schema_str;
+      std::ofstream in(dir + "/input.csv");
+      for (auto& l : lines)
+        in << l << "\n";
+    }
+
+    virtual void TearDown() {
+      ASSERT_EQ(0, system(("rm -rf '" + dir + "'").c_str()));
+    }
+
+    // runs the writer on the input in dir, returns its exit status. All
+    // the lines are loaded unless args set rid_start_value.
+    int run(const std::string& args) {
+      std::string cmd = "cd '" + dir + "' && " SKY_WRITER
+        " --csv_delim '|' --input_file_name input.csv"
+        " --input_file_schema schema.txt --table_name " + TABLE +
+        (args.find("--rid_start_value") == std::string::npos ?
+         " --rid_start_value 0" : "") +
+        " --default_oid 0 " + args + " > writer.log 2>&1";
+      int status = system(cmd.c_str());
+      return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    std::string obj_file(const std::string& format, uint64_t oid) {
+      return dir + "/skyhook." + format + "." + TABLE + "." +
+             std::to_string(oid);
+    }
+
+    bool exists(const std::string& format, uint64_t oid) {
+      return access(obj_file(format, oid).c_str(), F_OK) == 0;
+    }
+
+    // the fbmetas of an object, as the cls reads them
+    std::vector<bufferlist> read_fbmetas(const std::string& format,
+                                         uint64_t oid) {
+      std::ifstream f(obj_file(format, oid), std::ios::binary);
+      std::stringstream ss;
+      ss << f.rdbuf();
+      bufferlist obj;
+      obj.append(ss.str());
+      std::vector<bufferlist> metas;
+      bufferlist::const_iterator it = obj.begin();
+      while (it.get_remaining() > 0) {
+        bufferlist bl;
+        using ceph::decode;
+        decode(bl, it);
+        metas.push_back(bl);
+      }
+      return metas;
+    }
+
+    // the table of an fbmeta, as transform_fb_to_arrow lays it out
+    std::shared_ptr<arrow::Table> read_table(bufferlist& bl) {
+      sky_meta meta = getSkyMeta(&bl);
+      EXPECT_EQ(0, meta.blob_errcode);
+      std::shared_ptr<arrow::Table> table;
+      std::string errmsg;
+      if (meta.blob_format == SFT_FLATBUF_FLEX_ROW) {
+        EXPECT_EQ(0, transform_fb_to_arrow(meta.blob_data, meta.blob_size,
+                                           schema, errmsg, &table)) << errmsg;
+      } else {
+        EXPECT_EQ(SFT_ARROW, meta.blob_format);
+        std::shared_ptr<arrow::Buffer> buffer = arrow::Buffer::Wrap(
+            reinterpret_cast<const uint8_t*>(meta.blob_data), meta.blob_size);
+        EXPECT_EQ(0, extract_arrow_from_buffer(&table, buffer));
+      }
+      return table;
+    }
+
+    std::vector<writer_row> table_rows(std::shared_ptr<arrow::Table> table) {
+      std::vector<writer_row> rows;
+      if (!table)
+        return rows;
+      auto chunk = [&table](const std::string& name) {
+        auto col = table->GetColumnByName(name);
+        EXPECT_TRUE(col != nullptr) << name;
+        EXPECT_EQ(1, col->num_chunks()) << name;
+        return col->chunk(0);
+      };
+      auto rid = std::static_pointer_cast<arrow::Int64Array>(chunk("RID"));
+      auto ok = std::static_pointer_cast<arrow::Int64Array>(chunk("ORDERKEY"));
+      auto ln = std::static_pointer_cast<arrow::Int32Array>(chunk("LINENUMBER"));
+      auto price = std::static_pointer_cast<arrow::DoubleArray>(chunk("PRICE"));
+      auto date = std::static_pointer_cast<arrow::StringArray>(chunk("SHIPDATE"));
+      auto mode = std::static_pointer_cast<arrow::StringArray>(chunk("SHIPMODE"));
+      auto comment = std::static_pointer_cast<arrow::StringArray>(chunk("COMMENT"));
+      for (int64_t i = 0; i < table->num_rows(); i++) {
+        writer_row r;
+        r.rid = rid->Value(i);
+        r.orderkey = ok->Value(i);
+        r.linenumber = ln->Value(i);
+        r.price_null = price->IsNull(i);
+        r.price = r.price_null ? 0 : price->Value(i);
+        r.shipdate = date->GetString(i);
+        r.shipmode = mode->GetString(i);
+        r.comment = comment->GetString(i);
+        rows.push_back(r);
+      }
+      return rows;
+    }
+
+    // the rows of an object, fbmeta after fbmeta
+    std::vector<writer_row> object_rows(const std::string& format,
+                                        uint64_t oid) {
+      std::vector<writer_row> rows;
+      for (auto& bl : read_fbmetas(format, oid)) {
+        auto t = table_rows(read_table(bl));
+        rows.insert(rows.end(), t.begin(), t.end());
+      }
+      return rows;
+    }
+
+    // the rows of all the objects, by oid
+    std::map<uint64_t, std::vector<writer_row>> all_rows(
+        const std::string& format, uint64_t num_objs) {
+      std::map<uint64_t, std::vector<writer_row>> rows;
+      for (uint64_t oid = 0; oid < num_objs; oid++) {
+        if (exists(format, oid))
+          rows[oid] = object_rows(format, oid);
+      }
+      return rows;
+    }
+
+    // every input line in rows exactly once, with its values
+    void assert_every_row_once(
+        const std::map<uint64_t, std::vector<writer_row>>& objs,
+        int nrows = NROWS) {
+      std::vector<writer_row> rows;
+      for (auto& o : objs)
+        rows.insert(rows.end(), o.second.begin(), o.second.end());
+      std::sort(rows.begin(), rows.end());
+      ASSERT_EQ((size_t)nrows, rows.size());
+      for (int i = 0; i < nrows; i++)
+        ASSERT_EQ(input_row(i + 1), rows[i]);
+    }
+
+    std::string dir;
+    schema_vec schema;
+};
+
+TEST_F(Writer, EveryRowOnce) {
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 7 --flush_rows 30 --read_rows 500"
+                   " --num_threads 4"));
+  auto objs = all_rows("SFT_FLATBUF_FLEX_ROW", 7);
+  ASSERT_EQ(7u, objs.size());
+  assert_every_row_once(objs);
+}
+
+TEST_F(Writer, ThreadsWriteSameObjects) {
+  // more threads change the order of rows within an object, not the
+  // object of a row
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 5 --flush_rows 40 --read_rows 500"
+                   " --num_threads 1"));
+  auto single = all_rows("SFT_FLATBUF_FLEX_ROW", 5);
+  // with one thread the input order is kept
+  for (auto& o : single)
+    ASSERT_TRUE(std::is_sorted(o.second.begin(), o.second.end()));
+
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 5 --flush_rows 40 --read_rows 500"
+                   " --num_threads 3"));
+  auto multi = all_rows("SFT_FLATBUF_FLEX_ROW", 5);
+  ASSERT_EQ(single.size(), multi.size());
+  for (auto& o : multi) {
+    std::sort(o.second.begin(), o.second.end());
+    ASSERT_EQ(single[o.first], o.second) << "oid " << o.first;
+  }
+}
+
+TEST_F(Writer, LeftoverBucketsFlushed) {
+  // without hashing all rows go to default_oid, the last bucket is short
+  // of flush_rows
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing false"
+                   " --num_objs 1 --flush_rows 64 --read_rows 500"
+                   " --num_threads 2"));
+  auto metas = read_fbmetas("SFT_FLATBUF_FLEX_ROW", 0);
+  ASSERT_EQ(8u, metas.size());
+  assert_every_row_once(all_rows("SFT_FLATBUF_FLEX_ROW", 1));
+
+  // nor are buckets of the hashed objects lost
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 3 --flush_rows 1000 --read_rows 500"
+                   " --num_threads 2"));
+  assert_every_row_once(all_rows("SFT_FLATBUF_FLEX_ROW", 3));
+}
+
+TEST_F(Writer, ReadRows) {
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 3 --flush_rows 50 --read_rows 120"
+                   " --num_threads 2"));
+  assert_every_row_once(all_rows("SFT_FLATBUF_FLEX_ROW", 3), 120);
+}
+
+TEST(WriterFields, Signed) {
+  ASSERT_EQ(42, parseSigned<int32_t>("42"));
+  ASSERT_EQ(-42, parseSigned<int32_t>("-42"));
+  ASSERT_EQ(42, parseSigned<int32_t>("  +42"));
+  ASSERT_EQ(-7, parseSigned<int8_t>("\t-7"));
+  ASSERT_EQ(INT64_MIN, parseSigned<int64_t>("-9223372036854775808"));
+  ASSERT_EQ(12, parseSigned<int16_t>("12abc"));
+  // a field is not terminated, the parse stops at its end
+  std::string_view f = std::string_view("123|456").substr(0, 3);
+  ASSERT_EQ(123, parseSigned<int64_t>(f));
+  ASSERT_EQ(0, parseSigned<int64_t>("abc"));
+  ASSERT_EQ(0, parseSigned<int64_t>(""));
+}
+
+TEST(WriterFields, Unsigned) {
+  ASSERT_EQ(42u, parseUnsigned<uint16_t>("42"));
+  ASSERT_EQ(42u, parseUnsigned<uint16_t>(" +42"));
+  ASSERT_EQ(UINT64_MAX, parseUnsigned<uint64_t>("18446744073709551615"));
+  ASSERT_EQ(0u, parseUnsigned<uint32_t>("-1"));
+  ASSERT_EQ(0u, parseUnsigned<uint32_t>("x"));
+}
+
+TEST(WriterFields, Double) {
+  ASSERT_EQ(1.25, parseDouble("1.25"));
+  ASSERT_EQ(-1.25, parseDouble(" -1.25"));
+  ASSERT_EQ(1e10, parseDouble("+1e10"));
+  ASSERT_EQ(0.1, parseDouble("0.1"));
+  std::string_view f = std::string_view("2.5|9").substr(0, 3);
+  ASSERT_EQ(2.5, parseDouble(f));
+  ASSERT_EQ(0.0, parseDouble("abc"));
+}
+
+TEST(WriterFields, Bool) {
+  for (auto t : {"1", "t", "T", "true", "TRUE", " true"})
+    ASSERT_TRUE(parseBool(t)) << t;
+  for (auto f : {"0", "f", "false", "FALSE", "", "yes"})
+    ASSERT_FALSE(parseBool(f)) << f;
+}
+
+TEST_F(Writer, TypedFields) {
+  // every type parsed by the writer, as transform_fb_to_arrow reads it back
+  write_input(
+    "0 " + std::to_string(SDT_INT8) + " 1 0 A\n" +
+    "1 " + std::to_string(SDT_INT16) + " 0 1 B\n" +
+    "2 " + std::to_string(SDT_UINT16) + " 0 1 C\n" +
+    "3 " + std::to_string(SDT_UINT64) + " 0 1 D\n" +
+    "4 " + std::to_string(SDT_FLOAT) + " 0 1 E\n" +
+    "5 " + std::to_string(SDT_BOOL) + " 0 1 F\n" +
+    "6 " + std::to_string(SDT_STRING) + " 0 0 G\n",
+    {"-128|-32768|65535|18446744073709551615|1.5|true|x|",
+     "127|NULL|0|1|-0.25|0|NULL|",
+     "+5| 7|NULL|NULL|NULL|NULL||"});
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing false"
+                   " --num_objs 1 --flush_rows 10 --read_rows 3"));
+  auto metas = read_fbmetas("SFT_FLATBUF_FLEX_ROW", 0);
+  ASSERT_EQ(1u, metas.size());
+  auto table = read_table(metas[0]);
+  ASSERT_TRUE(table);
+  ASSERT_EQ(3, table->num_rows());
+  auto col = [&table](const std::string& name) {
+    return table->GetColumnByName(name)->chunk(0);
+  };
+
+  auto a = std::static_pointer_cast<arrow::Int8Array>(col("A"));
+  ASSERT_EQ(-128, a->Value(0));
+  ASSERT_EQ(127, a->Value(1));
+  ASSERT_EQ(5, a->Value(2));
+
+  auto b = std::static_pointer_cast<arrow::Int16Array>(col("B"));
+  ASSERT_EQ(-32768, b->Value(0));
+  ASSERT_TRUE(b->IsNull(1));
+  ASSERT_EQ(7, b->Value(2));
+
+  auto c = std::static_pointer_cast<arrow::UInt16Array>(col("C"));
+  ASSERT_EQ(65535, c->Value(0));
+  ASSERT_EQ(0, c->Value(1));
+  ASSERT_TRUE(c->IsValid(1));
+  ASSERT_TRUE(c->IsNull(2));
+
+  auto d = std::static_pointer_cast<arrow::UInt64Array>(col("D"));
+  ASSERT_EQ(UINT64_MAX, d->Value(0));
+  ASSERT_EQ(1u, d->Value(1));
+  ASSERT_TRUE(d->IsNull(2));
+
+  auto e = std::static_pointer_cast<arrow::FloatArray>(col("E"));
+  ASSERT_EQ(1.5f, e->Value(0));
+  ASSERT_EQ(-0.25f, e->Value(1));
+  ASSERT_TRUE(e->IsNull(2));
+
+  auto f = std::static_pointer_cast<arrow::BooleanArray>(col("F"));
+  ASSERT_TRUE(f->Value(0));
+  ASSERT_FALSE(f->Value(1));
+  ASSERT_TRUE(f->IsNull(2));
+
+  // G is not nullable, "NULL" loads as an empty value
+  auto g = std::static_pointer_cast<arrow::StringArray>(col("G"));
+  ASSERT_EQ("x", g->GetString(0));
+  ASSERT_TRUE(g->IsValid(1));
+  ASSERT_EQ("", g->GetString(2));
+}
+
+TEST_F(Writer, ArrowSameAsFlexRow) {
+  // the same rows in the same objects and buckets, nulls included
+  const std::string args = " --use_hashing true --num_objs 4 --flush_rows 60"
+                           " --read_rows 500 --num_threads 1";
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW" + args));
+  ASSERT_EQ(0, run("--data_format SFT_ARROW" + args));
+  for (uint64_t oid = 0; oid < 4; oid++) {
+    ASSERT_TRUE(exists("SFT_ARROW", oid));
+    ASSERT_EQ(read_fbmetas("SFT_FLATBUF_FLEX_ROW", oid).size(),
+              read_fbmetas("SFT_ARROW", oid).size());
+    ASSERT_EQ(object_rows("SFT_FLATBUF_FLEX_ROW", oid),
+              object_rows("SFT_ARROW", oid));
+  }
+  assert_every_row_once(all_rows("SFT_ARROW", 4));
+}
+
+TEST_F(Writer, ArrowLayout) {
+  // laid out as transform_fb_to_arrow lays out a flexbuffer object
+  ASSERT_EQ(0, run("--data_format SFT_ARROW --use_hashing false"
+                   " --num_objs 1 --flush_rows 100 --read_rows 500"));
+  auto metas = read_fbmetas("SFT_ARROW", 0);
+  ASSERT_EQ(5u, metas.size());
+  for (auto& bl : metas) {
+    auto table = read_table(bl);
+    ASSERT_TRUE(table);
+    ASSERT_EQ(100, table->num_rows());
+
+    auto schema = table->schema();
+    ASSERT_EQ(8, schema->num_fields());
+    ASSERT_TRUE(schema->field(0)->type()->Equals(arrow::int64()));
+    ASSERT_TRUE(schema->field(1)->type()->Equals(arrow::int32()));
+    ASSERT_TRUE(schema->field(2)->type()->Equals(arrow::float64()));
+    ASSERT_TRUE(schema->field(3)->type()->Equals(arrow::utf8()));
+    ASSERT_EQ("RID", schema->field(6)->name());
+    ASSERT_EQ("DELETED_VECTOR", schema->field(7)->name());
+    auto deleted = std::static_pointer_cast<arrow::BooleanArray>(
+        table->GetColumnByName("DELETED_VECTOR")->chunk(0));
+    ASSERT_EQ(0, deleted->true_count());
+
+    auto metadata = schema->metadata();
+    ASSERT_TRUE(metadata);
+    ASSERT_EQ(std::to_string(SFT_ARROW),
+              metadata->value(METADATA_DATA_FORMAT_TYPE));
+    ASSERT_EQ(schemaToString(schema_vec(this->schema)),
+              metadata->value(METADATA_DATA_SCHEMA));
+    ASSERT_EQ(TABLE, metadata->value(METADATA_TABLE_NAME));
+    ASSERT_EQ("100", metadata->value(METADATA_NUM_ROWS));
+  }
+}
+
+TEST_F(Writer, Compression) {
+  const std::string args = " --use_hashing true --num_objs 3 --flush_rows 80"
+                           " --read_rows 500 --num_threads 2";
+  for (std::string format : {"SFT_FLATBUF_FLEX_ROW", "SFT_ARROW"}) {
+    for (std::string codec : {"lz4", "zstd"}) {
+      ASSERT_EQ(0, run("--data_format " + format + " --compression " + codec +
+                       args));
+      for (uint64_t oid = 0; oid < 3; oid++) {
+        // getSkyMeta returns the blobs decompressed, the fbmeta is read
+        // as written
+        for (auto& bl : read_fbmetas(format, oid))
+          ASSERT_EQ(compression_type_from_string(codec),
+                    GetFB_Meta(bl.c_str())->blob_compression()) << format;
+      }
+      assert_every_row_once(all_rows(format, 3));
+    }
+  }
+}
+
+TEST_F(Writer, StringKeySpreads) {
+  // string keys are hashed, not packed as 0 into one object
+  std::vector<std::string> lines;
+  for (int i = 0; i < 400; i++)
+    lines.push_back("KEY" + std::to_string(i) + "|" + std::to_string(i) + "|");
+  write_input("0 " + std::to_string(SDT_STRING) + " 1 0 NAME\n" +
+              "1 " + std::to_string(SDT_INT32) + " 0 0 VAL\n", lines);
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                   " --num_objs 4 --flush_rows 1000 --read_rows 400"));
+  int64_t rows = 0;
+  for (uint64_t oid = 0; oid < 4; oid++) {
+    ASSERT_TRUE(exists("SFT_FLATBUF_FLEX_ROW", oid)) << oid;
+    for (auto& bl : read_fbmetas("SFT_FLATBUF_FLEX_ROW", oid)) {
+      auto table = read_table(bl);
+      ASSERT_TRUE(table);
+      ASSERT_GT(table->num_rows(), 0);
+      rows += table->num_rows();
+    }
+  }
+  ASSERT_EQ(400, rows);
+}
+
+TEST_F(Writer, ClusteredBucketsSorted) {
+  // cluster_by names are matched as the schema has them and recorded in the
+  // blob_sort_cols format of fb_meta.fbs
+  auto by_line_order = [](const writer_row& a, const writer_row& b) {
+    if (a.linenumber != b.linenumber)
+      return a.linenumber < b.linenumber;
+    return a.orderkey < b.orderkey;
+  };
+  for (std::string format : {"SFT_FLATBUF_FLEX_ROW", "SFT_ARROW"}) {
+    ASSERT_EQ(0, run("--data_format " + format + " --use_hashing true"
+                     " --num_objs 3 --flush_rows 50 --read_rows 500"
+                     " --num_threads 2 --cluster_by ' linenumber,OrderKey'"));
+    for (uint64_t oid = 0; oid < 3; oid++) {
+      for (auto& bl : read_fbmetas(format, oid)) {
+        bufferlist meta_bl(bl);
+        ASSERT_EQ("LINENUMBER,ORDERKEY", getSkyMeta(&meta_bl).blob_sort_cols);
+        auto rows = table_rows(read_table(bl));
+        ASSERT_FALSE(rows.empty());
+        ASSERT_TRUE(std::is_sorted(rows.begin(), rows.end(), by_line_order))
+            << format << " oid " << oid;
+      }
+    }
+    assert_every_row_once(all_rows(format, 3));
+  }
+
+  // without cluster_by the rows are not sorted, nor said to be
+  ASSERT_EQ(0, run("--data_format SFT_ARROW --use_hashing true --num_objs 3"
+                   " --flush_rows 50 --read_rows 500"));
+  auto metas = read_fbmetas("SFT_ARROW", 0);
+  ASSERT_FALSE(metas.empty());
+  ASSERT_EQ("", getSkyMeta(&metas[0]).blob_sort_cols);
+
+  ASSERT_NE(0, run("--data_format SFT_ARROW --cluster_by NOPE"));
+}
+
+TEST_F(Writer, BucketMemFlushesEarly) {
+  // no bucket reaches flush_rows, so without a budget each object is one
+  // fbmeta
+  const std::string args = " --use_hashing true --num_objs 4"
+                           " --flush_rows 100000 --read_rows 500"
+                           " --num_threads 1";
+  ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW" + args));
+  for (uint64_t oid = 0; oid < 4; oid++)
+    ASSERT_EQ(1u, read_fbmetas("SFT_FLATBUF_FLEX_ROW", oid).size());
+
+  // past the budget buckets are flushed early as more fbmetas, in rid order
+  // within each object
+  for (std::string format : {"SFT_FLATBUF_FLEX_ROW", "SFT_ARROW"}) {
+    for (std::string evict : {"largest", "lru"}) {
+      ASSERT_EQ(0, run("--data_format " + format + args +
+                       " --max_bucket_mem 8192 --evict " + evict));
+      size_t fbmetas = 0;
+      for (uint64_t oid = 0; oid < 4; oid++) {
+        fbmetas += read_fbmetas(format, oid).size();
+        auto rows = object_rows(format, oid);
+        ASSERT_TRUE(std::is_sorted(rows.begin(), rows.end()))
+            << format << " " << evict << " oid " << oid;
+      }
+      ASSERT_GT(fbmetas, 4u) << format << " " << evict;
+      assert_every_row_once(all_rows(format, 4));
+    }
+  }
+
+  ASSERT_NE(0, run("--data_format SFT_ARROW" + args +
+                   " --max_bucket_mem 8192 --evict fifo"));
+}
+
+TEST_F(Writer, BucketMemClustered) {
+  // each early flushed bucket is sorted on its own
+  ASSERT_EQ(0, run("--data_format SFT_ARROW --use_hashing true --num_objs 3"
+                   " --flush_rows 100000 --read_rows 500 --num_threads 2"
+                   " --max_bucket_mem 8192 --cluster_by ORDERKEY"));
+  size_t fbmetas = 0;
+  for (uint64_t oid = 0; oid < 3; oid++) {
+    for (auto& bl : read_fbmetas("SFT_ARROW", oid)) {
+      fbmetas++;
+      auto rows = table_rows(read_table(bl));
+      ASSERT_TRUE(std::is_sorted(rows.begin(), rows.end(),
+          [](const writer_row& a, const writer_row& b) {
+            return a.orderkey < b.orderkey;
+          }));
+    }
+  }
+  ASSERT_GT(fbmetas, 3u);
+  assert_every_row_once(all_rows("SFT_ARROW", 3));
+}
+
+TEST_F(Writer, RidStartValue) {
+  // lines from rid_start_value are loaded, numbered from 1 in input order
+  for (std::string threads : {"1", "3"}) {
+    ASSERT_EQ(0, run("--data_format SFT_FLATBUF_FLEX_ROW --use_hashing true"
+                     " --num_objs 3 --flush_rows 20 --read_rows 50"
+                     " --rid_start_value 100 --num_threads " + threads));
+    std::vector<writer_row> rows;
+    for (auto& o : all_rows("SFT_FLATBUF_FLEX_ROW", 3))
+      rows.insert(rows.end(), o.second.begin(), o.second.end());
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(51u, rows.size());
+    for (int i = 0; i < 51; i++) {
+      writer_row expected = input_row(100 + i);
+      expected.rid = i + 1;
+      ASSERT_EQ(expected, rows[i]);
+    }
+  }
+}
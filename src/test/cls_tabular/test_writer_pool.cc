@@ -0,0 +1,253 @@
+/*
+* Copyright (C) 2018 The Regents of the University of California
+* All Rights Reserved
+*
+* This library can redistribute it and/or modify under the terms
+* of the GNU Lesser General Public License Version 2.1 as published
+* by the Free Software Foundation.
+*
+*/
+
+/*
+ * Tests of sky_tabular_flatflex_writer loading into a pool: the writer is
+ * run against the test cluster and the objects it writes are read back.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cls/cls_tabular.h"
+#include "cls/cls_tabular_utils.h"
+#include "include/rados/librados.hpp"
+#include "include/encoding.h"
+#include "test/librados/test_cxx.h"
+#include "test/librados/test.h"
+#include "gtest/gtest.h"
+
+using namespace librados;
+using namespace Tables;
+
+static const int NROWS = 200;
+static const std::string TABLE = "lineitem";
+static const std::string OID = "skyhook.SFT_FLATBUF_FLEX_ROW." + TABLE + ".0";
+static const std::string RID_OID = TABLE + ".rids";
+
+static std::string pool_schema() {
+  return
+    "0 " + std::to_string(SDT_INT64) + " 1 0 ORDERKEY\n" +
+    "1 " + std::to_string(SDT_INT32) + " 1 0 LINENUMBER\n" +
+    "2 " + std::to_string(SDT_STRING) + " 0 1 COMMENT\n";
+}
+
+class SkyhookWriterPool : public ::testing::Test {
+  protected:
+    static void SetUpTestCase() {
+      pool_name = get_temp_pool_name();
+      ASSERT_EQ("", create_one_pool_pp(pool_name, rados));
+    }
+
+    static void TearDownTestCase() {
+      ASSERT_EQ(0, destroy_one_pool_pp(pool_name, rados));
+    }
+
+    virtual void SetUp() {
+      ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+      std::string tmpl = testing::TempDir() + "skywriterXXXXXX";
+      ASSERT_TRUE(mkdtemp(&tmpl[0]) != NULL);
+      dir = tmpl;
+      std::ofstream sf(dir + "/schema.txt");
+      sf << pool_schema();
+      std::ofstream in(dir + "/input.csv");
+      for (int i = 1; i <= NROWS; i++)
+        in << (i + 3) / 4 << "|" << (i - 1) % 4 + 1 << "|comment " << i
+           << "|\n";
+    }
+
+    virtual void TearDown() {
+      ioctx.remove(OID);
+      ioctx.remove(RID_OID);
+      ioctx.close();
+      ASSERT_EQ(0, system(("rm -rf '" + dir + "'").c_str()));
+    }
+
+    // runs the writer on the input in dir into the pool, all rows to oid 0
+    int run(const std::string& args) {
+      std::string cmd = "cd '" + dir + "' && " SKY_WRITER
+        " --csv_delim '|' --input_file_name input.csv"
+        " --input_file_schema schema.txt --table_name " + TABLE +
+        " --rid_start_value 0 --default_oid 0 --use_hashing false"
+        " --num_objs 1 --flush_rows 50 --read_rows " + std::to_string(NROWS) +
+        " --data_format SFT_FLATBUF_FLEX_ROW --pool " + pool_name + " " +
+        args + " > writer.log 2>&1";
+      int status = system(cmd.c_str());
+      return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    // the rows of each fbmeta of the object, and their rids
+    std::vector<int64_t> fbmeta_rows(std::vector<int64_t> *rids = NULL) {
+      std::vector<int64_t> rows;
+      bufferlist obj;
+      EXPECT_LT(0, ioctx.read(OID, obj, 0, 0));
+      schema_vec schema = schemaFromString(pool_schema());
+      bufferlist::const_iterator it = obj.begin();
+      while (it.get_remaining() > 0) {
+        bufferlist bl;
+        using ceph::decode;
+        decode(bl, it);
+        sky_meta meta = getSkyMeta(&bl);
+        std::shared_ptr<arrow::Table> table;
+        std::string errmsg;
+        EXPECT_EQ(0, transform_fb_to_arrow(meta.blob_data, meta.blob_size,
+                                           schema, errmsg, &table)) << errmsg;
+        rows.push_back(table ? table->num_rows() : -1);
+        if (table && rids) {
+          auto rid = std::static_pointer_cast<arrow::Int64Array>(
+              table->GetColumnByName("RID")->chunk(0));
+          for (int64_t i = 0; i < rid->length(); i++)
+            rids->push_back(rid->Value(i));
+        }
+      }
+      return rows;
+    }
+
+    // an object as an earlier load and index build leave it
+    void old_object() {
+      bufferlist data;
+      data.append("old data");
+      ASSERT_EQ(0, ioctx.write_full(OID, data));
+      std::map<std::string, bufferlist> entries;
+      entries["IDX_FB:*:" + TABLE + ":1"] = data;
+      ASSERT_EQ(0, ioctx.omap_set(OID, entries));
+      bufferlist seq;
+      using ceph::encode;
+      encode((unsigned int)7, seq);
+      ASSERT_EQ(0, ioctx.setxattr(OID, "fb_seq_num", seq));
+    }
+
+    static Rados rados;
+    static std::string pool_name;
+    IoCtx ioctx;
+    std::string dir;
+};
+
+Rados SkyhookWriterPool::rados;
+std::string SkyhookWriterPool::pool_name;
+
+TEST_F(SkyhookWriterPool, Load) {
+  ASSERT_EQ(0, run(""));
+  ASSERT_EQ(std::vector<int64_t>({50, 50, 50, 50}), fbmeta_rows());
+}
+
+TEST_F(SkyhookWriterPool, OverwriteClearsOldObject) {
+  // the old data, its index entries and fb_seq_num are all replaced
+  old_object();
+  ASSERT_EQ(0, run("--overwrite_objs true"));
+  ASSERT_EQ(std::vector<int64_t>({50, 50, 50, 50}), fbmeta_rows());
+  std::map<std::string, bufferlist> entries;
+  ASSERT_EQ(0, ioctx.omap_get_vals(OID, "", 100, &entries));
+  ASSERT_TRUE(entries.empty());
+  bufferlist seq;
+  ASSERT_EQ(-ENODATA, ioctx.getxattr(OID, "fb_seq_num", seq));
+
+  // and a load that creates the object works as well
+  ASSERT_EQ(0, ioctx.remove(OID));
+  ASSERT_EQ(0, run("--overwrite_objs true"));
+  ASSERT_EQ(std::vector<int64_t>({50, 50, 50, 50}), fbmeta_rows());
+}
+
+TEST_F(SkyhookWriterPool, AppendKeepsObject) {
+  ASSERT_EQ(0, run(""));
+  ASSERT_EQ(0, run(""));
+  ASSERT_EQ(std::vector<int64_t>(8, 50), fbmeta_rows());
+}
+
+TEST_F(SkyhookWriterPool, AllocRidBlock) {
+  // consecutive blocks from 1, per table
+  auto alloc = [this](const std::string& table, uint64_t count,
+                      uint64_t *first) {
+    rid_alloc_op op(table, count);
+    bufferlist inbl, outbl;
+    using ceph::encode;
+    encode(op, inbl);
+    int ret = ioctx.exec(RID_OID, "tabular", "alloc_rid_block_op", inbl,
+                         outbl);
+    if (ret >= 0) {
+      bufferlist::const_iterator it = outbl.begin();
+      using ceph::decode;
+      decode(*first, it);
+    }
+    return ret;
+  };
+  uint64_t first = 0;
+  ASSERT_EQ(0, alloc(TABLE, 100, &first));
+  ASSERT_EQ(1u, first);
+  ASSERT_EQ(0, alloc(TABLE, 10, &first));
+  ASSERT_EQ(101u, first);
+  ASSERT_EQ(0, alloc("orders", 10, &first));
+  ASSERT_EQ(1u, first);
+  ASSERT_EQ(0, alloc(TABLE, 1, &first));
+  ASSERT_EQ(111u, first);
+  ASSERT_EQ(-EINVAL, alloc(TABLE, 0, &first));
+}
+
+TEST_F(SkyhookWriterPool, RidAllocLoads) {
+  // loads that take their rids from the rid object never reuse one
+  const std::string args = "--rid_alloc_obj " + RID_OID +
+                           " --rid_block_size 64";
+  ASSERT_EQ(0, run(args));
+  ASSERT_EQ(0, run(args + " --num_threads 3"));
+  std::vector<int64_t> rids;
+  ASSERT_EQ(std::vector<int64_t>(8, 50), fbmeta_rows(&rids));
+  ASSERT_EQ((size_t)NROWS * 2, rids.size());
+  std::sort(rids.begin(), rids.end());
+  ASSERT_TRUE(std::adjacent_find(rids.begin(), rids.end()) == rids.end());
+  ASSERT_LT(0, rids.front());
+
+  // and without the rid object each load numbers its rows from 1
+  ASSERT_EQ(0, ioctx.remove(OID));
+  ASSERT_EQ(0, run(""));
+  ASSERT_EQ(0, run(""));
+  rids.clear();
+  fbmeta_rows(&rids);
+  std::sort(rids.begin(), rids.end());
+  ASSERT_EQ(1, rids.front());
+  ASSERT_EQ(NROWS, rids.back());
+  ASSERT_EQ(2, std::count(rids.begin(), rids.end(), 1));
+}
+
+TEST_F(SkyhookWriterPool, IndexedLoad) {
+  // index cols are matched as the schema names them, entries are built for
+  // every row along with the data
+  ASSERT_EQ(0, run("--index_rid true --index_cols 'orderkey, linenumber'"
+                   " --index_unique true"));
+  ASSERT_EQ(std::vector<int64_t>({50, 50, 50, 50}), fbmeta_rows());
+  std::map<std::string, bufferlist> entries;
+  ASSERT_EQ(0, ioctx.omap_get_vals(OID, "", 1000, &entries));
+  const std::string rid_prefix = buildKeyPrefix(SIT_IDX_RID, "*", TABLE,
+                                                {RID_INDEX});
+  const std::string rec_prefix = buildKeyPrefix(SIT_IDX_REC, "*", TABLE,
+                                                {"ORDERKEY", "LINENUMBER"});
+  const std::string fb_prefix = buildKeyPrefix(SIT_IDX_FB, "*", TABLE);
+  // the marker keys of the indexes, then their entries
+  ASSERT_EQ(1u, entries.count(rid_prefix));
+  ASSERT_EQ(1u, entries.count(rec_prefix));
+  entries.erase(rid_prefix);
+  entries.erase(rec_prefix);
+  int rid_entries = 0, rec_entries = 0, fb_entries = 0;
+  for (auto& e : entries) {
+    if (e.first.compare(0, rid_prefix.size(), rid_prefix) == 0)
+      rid_entries++;
+    else if (e.first.compare(0, rec_prefix.size(), rec_prefix) == 0)
+      rec_entries++;
+    else if (e.first.compare(0, fb_prefix.size(), fb_prefix) == 0)
+      fb_entries++;
+  }
+  ASSERT_EQ(NROWS, rid_entries);
+  ASSERT_EQ(NROWS, rec_entries);
+  ASSERT_EQ(4, fb_entries);
+}